@@ -0,0 +1,86 @@
+//========================================================================
+//
+// GooArena.cc
+//
+// Monotonic (bump) allocator.
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "gmem.h"
+#include "GooArena.h"
+
+//------------------------------------------------------------------------
+
+// Size of a normal arena block, including its header.
+#define gooArenaBlockSize 65536
+
+// Requests larger than this get a block of their own, so that the
+// rest of the current block isn't wasted.
+#define gooArenaMaxSmallAlloc (gooArenaBlockSize / 8)
+
+struct GooArenaBlock {
+  GooArenaBlock *next;
+  double align;			// force alignment of the data
+  // data follows
+};
+
+//------------------------------------------------------------------------
+// GooArena
+//------------------------------------------------------------------------
+
+GooArena::GooArena(int maxSizeA) {
+  blocks = NULL;
+  cur = NULL;
+  left = 0;
+  size = 0;
+  maxSize = maxSizeA;
+}
+
+GooArena::~GooArena() {
+  GooArenaBlock *block, *next;
+
+  for (block = blocks; block; block = next) {
+    next = block->next;
+    gfree(block);
+  }
+}
+
+void *GooArena::allocBlock(int n) {
+  GooArenaBlock *block;
+  int blockSize;
+
+  if (n > gooArenaMaxSmallAlloc) {
+    blockSize = (int)sizeof(GooArenaBlock) + n;
+  } else {
+    blockSize = gooArenaBlockSize;
+  }
+  if (n < 0 || blockSize > maxSize - size) {
+    return NULL;
+  }
+  block = (GooArenaBlock *)gmalloc(blockSize);
+  size += blockSize;
+
+  if (n > gooArenaMaxSmallAlloc) {
+    // keep allocating from the current block
+    if (blocks) {
+      block->next = blocks->next;
+      blocks->next = block;
+    } else {
+      block->next = NULL;
+      blocks = block;
+    }
+    return block + 1;
+  }
+
+  block->next = blocks;
+  blocks = block;
+  cur = (char *)(block + 1) + n;
+  left = blockSize - (int)sizeof(GooArenaBlock) - n;
+  return block + 1;
+}
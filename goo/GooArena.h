@@ -0,0 +1,65 @@
+//========================================================================
+//
+// GooArena.h
+//
+// Monotonic (bump) allocator.
+//
+//========================================================================
+
+#ifndef GOOARENA_H
+#define GOOARENA_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "gtypes.h"
+
+struct GooArenaBlock;
+
+//------------------------------------------------------------------------
+// GooArena
+//------------------------------------------------------------------------
+
+// Memory is handed out from large blocks and is never freed
+// individually: everything allocated from an arena is released at
+// once when the arena is deleted.  Objects placed in an arena must not
+// be deleted with delete or gfree.  An arena is not thread safe.
+class GooArena {
+public:
+
+  // Create an arena that hands out at most <maxSizeA> bytes.  No
+  // memory is allocated until the first call to alloc.
+  GooArena(int maxSizeA);
+
+  ~GooArena();
+
+  // Allocate <n> bytes, aligned for any basic type.  Returns NULL if
+  // the arena is full; the caller should then use the heap instead.
+  void *alloc(int n) {
+    char *p;
+    n = (n + 7) & ~7;
+    if (n > left) {
+      return allocBlock(n);
+    }
+    p = cur;
+    cur += n;
+    left -= n;
+    return p;
+  }
+
+  // Return the number of bytes taken from the heap for blocks.
+  int getSize() { return size; }
+
+private:
+
+  void *allocBlock(int n);
+
+  GooArenaBlock *blocks;	// list of blocks, most recent first
+  char *cur;			// free space in the current block
+  int left;			// bytes left in the current block
+  int size;			// total size of all blocks
+  int maxSize;			// maximum total size
+};
+
+#endif
@@ -35,6 +35,28 @@
 // gUnlockMutex(&m);
 // ...
 // gDestroyMutex(&m);
+//
+// Condition variables are used together with a mutex:
+//
+// GooCond c;
+// gInitCond(&c);
+// ...
+// gLockMutex(&m);
+//   while (!condition) gCondWait(&c, &m);
+// gUnlockMutex(&m);
+// ...
+// gCondBroadcast(&c);
+// ...
+// gDestroyCond(&c);
+//
+// Mutexes are recursive: a thread that already holds <m> may lock it
+// again (and must unlock it the same number of times).  Windows
+// critical sections behave this way natively.
+//
+// Atomic counters, for reference counts shared between threads:
+// GooAtomicCounter c;
+// n = gAtomicIncrement(&c);    // returns the new value
+// n = gAtomicDecrement(&c);
 
 #ifdef _WIN32
 
@@ -47,17 +69,58 @@ typedef CRITICAL_SECTION GooMutex;
 #define gLockMutex(m) EnterCriticalSection(m)
 #define gUnlockMutex(m) LeaveCriticalSection(m)
 
+typedef CONDITION_VARIABLE GooCond;
+
+#define gInitCond(c) InitializeConditionVariable(c)
+#define gDestroyCond(c)
+#define gCondWait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define gCondBroadcast(c) WakeAllConditionVariable(c)
+
+typedef volatile LONG GooAtomicCounter;
+
+#define gAtomicIncrement(v) InterlockedIncrement(v)
+#define gAtomicDecrement(v) InterlockedDecrement(v)
+
 #else // assume pthreads
 
 #include <pthread.h>
 
 typedef pthread_mutex_t GooMutex;
 
-#define gInitMutex(m) pthread_mutex_init(m, NULL)
+#define gInitMutex(m) { \
+    pthread_mutexattr_t mutexattr; \
+    pthread_mutexattr_init(&mutexattr); \
+    pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE); \
+    pthread_mutex_init(m, &mutexattr); \
+    pthread_mutexattr_destroy(&mutexattr); \
+  }
 #define gDestroyMutex(m) pthread_mutex_destroy(m)
 #define gLockMutex(m) pthread_mutex_lock(m)
 #define gUnlockMutex(m) pthread_mutex_unlock(m)
 
+typedef pthread_cond_t GooCond;
+
+#define gInitCond(c) pthread_cond_init(c, NULL)
+#define gDestroyCond(c) pthread_cond_destroy(c)
+#define gCondWait(c, m) pthread_cond_wait(c, m)
+#define gCondBroadcast(c) pthread_cond_broadcast(c)
+
+typedef volatile int GooAtomicCounter;
+
+#define gAtomicIncrement(v) (__sync_fetch_and_add(v, 1) + 1)
+#define gAtomicDecrement(v) (__sync_fetch_and_sub(v, 1) - 1)
+
 #endif
 
+// Locks a mutex for the lifetime of the MutexLocker object, which
+// makes it easy to release the lock on every return path.
+class MutexLocker {
+public:
+  MutexLocker(GooMutex *mutexA) : mutex(mutexA) { gLockMutex(mutex); }
+  ~MutexLocker() { gUnlockMutex(mutex); }
+
+private:
+  GooMutex *mutex;
+};
+
 #endif
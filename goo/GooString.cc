@@ -37,7 +37,9 @@
 #include <ctype.h>
 #include <assert.h>
 #include <math.h>
+#include <new>
 #include "gmem.h"
+#include "GooArena.h"
 #include "GooString.h"
 
 static const int MAXIMUM_DOUBLE_PREC = 16;
@@ -175,24 +177,28 @@ GooString* GooString::Set(const char *s1, int s1Len, const char *s2, int s2Len)
 GooString::GooString() {
   s = NULL;
   length = 0;
+  inArena = gFalse;
   Set(NULL);
 }
 
 GooString::GooString(const char *sA) {
   s = NULL;
   length = 0;
+  inArena = gFalse;
   Set(sA, CALC_STRING_LEN);
 }
 
 GooString::GooString(const char *sA, int lengthA) {
   s = NULL;
   length = 0;
+  inArena = gFalse;
   Set(sA, lengthA);
 }
 
 GooString::GooString(GooString *str, int idx, int lengthA) {
   s = NULL;
   length = 0;
+  inArena = gFalse;
   assert(idx + lengthA <= str->length);
   Set(str->getCString() + idx, lengthA);
 }
@@ -200,15 +206,37 @@ GooString::GooString(GooString *str, int idx, int lengthA) {
 GooString::GooString(GooString *str) {
   s = NULL;
   length = 0;
+  inArena = gFalse;
   Set(str->getCString(), str->length);
 }
 
 GooString::GooString(GooString *str1, GooString *str2) {
   s = NULL;
   length = 0;
+  inArena = gFalse;
   Set(str1->getCString(), str1->length, str2->getCString(), str2->length);
 }
 
+GooString *GooString::create(GooArena *arena, const char *sA, int lengthA) {
+  GooString *str;
+  void *p;
+
+  if (!arena || !(p = arena->alloc(sizeof(GooString)))) {
+    return new GooString(sA, lengthA);
+  }
+  str = new(p) GooString(sA, lengthA);
+  str->inArena = gTrue;
+  return str;
+}
+
+void GooString::destroy(GooString *str) {
+  if (str->inArena) {
+    str->~GooString();
+  } else {
+    delete str;
+  }
+}
+
 GooString *GooString::fromInt(int x) {
   char buf[24]; // enough space for 64-bit ints plus a little extra
   char *p;
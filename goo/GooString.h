@@ -35,6 +35,8 @@
 #include <stdlib.h> // for NULL
 #include "gtypes.h"
 
+class GooArena;
+
 class GooString {
 public:
 
@@ -57,6 +59,15 @@ public:
   // length of string (or its substring)
   GooString* Set(const char *s1, int s1Len=CALC_STRING_LEN, const char *s2=NULL, int s2Len=CALC_STRING_LEN);
 
+  // Create a string from <lengthA> chars at <sA>, placing the
+  // GooString object in <arena> if it has room (characters that don't
+  // fit in the object itself are still kept on the heap).  Strings made
+  // with a non-NULL arena must be freed with destroy(), never delete.
+  static GooString *create(GooArena *arena, const char *sA, int lengthA);
+
+  // Free a string made with new or create().
+  static void destroy(GooString *str);
+
   // Copy a string.
   GooString(GooString *str);
   GooString *copy() { return new GooString(this); }
@@ -158,6 +169,7 @@ private:
 
   char sStatic[STR_STATIC_SIZE];
   int length;
+  GBool inArena;		// allocated from a GooArena by create()
   char *s;
 
   void resize(int newLength);
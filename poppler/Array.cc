@@ -28,7 +28,11 @@
 
 #include <stdlib.h>
 #include <stddef.h>
+#include <limits.h>
+#include <string.h>
+#include <new>
 #include "goo/gmem.h"
+#include "goo/GooArena.h"
 #include "Object.h"
 #include "Array.h"
 
@@ -41,6 +45,35 @@ Array::Array(XRef *xrefA) {
   elems = NULL;
   size = length = 0;
   ref = 1;
+  arena = NULL;
+  elemsInArena = gFalse;
+}
+
+Array::Array(Array *arrayA) {
+  int i;
+
+  xref = arrayA->xref;
+  size = length = arrayA->length;
+  ref = 1;
+  arena = NULL;
+  elemsInArena = gFalse;
+
+  elems = (Object *)gmallocn(size, sizeof(Object));
+  for (i = 0; i < length; ++i) {
+    arrayA->elems[i].copy(&elems[i]);
+  }
+}
+
+Array *Array::create(XRef *xrefA, GooArena *arenaA) {
+  Array *array;
+  void *p;
+
+  if (!arenaA || !(p = arenaA->alloc(sizeof(Array)))) {
+    return new Array(xrefA);
+  }
+  array = new(p) Array(xrefA);
+  array->arena = arenaA;
+  return array;
 }
 
 Array::~Array() {
@@ -48,17 +81,46 @@ Array::~Array() {
 
   for (i = 0; i < length; ++i)
     elems[i].free();
-  gfree(elems);
+  if (!elemsInArena) {
+    gfree(elems);
+  }
+}
+
+void Array::destroy(Array *array) {
+  if (array->arena) {
+    array->~Array();
+  } else {
+    delete array;
+  }
 }
 
 void Array::add(Object *elem) {
+  Object *elems1;
+
   if (length == size) {
     if (length == 0) {
       size = 8;
     } else {
       size *= 2;
     }
-    elems = (Object *)greallocn(elems, size, sizeof(Object));
+    if (arena && size <= INT_MAX / (int)sizeof(Object) &&
+	(elems1 = (Object *)arena->alloc(size * sizeof(Object)))) {
+      if (length > 0) {
+	memcpy(elems1, elems, length * sizeof(Object));
+      }
+      if (!elemsInArena) {
+	gfree(elems);
+      }
+      elems = elems1;
+      elemsInArena = gTrue;
+    } else if (elemsInArena) {
+      elems1 = (Object *)gmallocn(size, sizeof(Object));
+      memcpy(elems1, elems, length * sizeof(Object));
+      elems = elems1;
+      elemsInArena = gFalse;
+    } else {
+      elems = (Object *)greallocn(elems, size, sizeof(Object));
+    }
   }
   elems[length] = *elem;
   ++length;
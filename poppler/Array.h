@@ -27,9 +27,15 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class XRef;
+class GooArena;
 
 //------------------------------------------------------------------------
 // Array
@@ -41,12 +47,31 @@ public:
   // Constructor.
   Array(XRef *xrefA);
 
+  // Copy an array.  The copy is always on the heap.
+  Array(Array *arrayA);
+
+  // Create an array in <arena> (or on the heap, if <arena> is NULL or
+  // full).  The elements are allocated from the arena too.  Arrays
+  // made this way must be freed with destroy(), never delete.
+  static Array *create(XRef *xrefA, GooArena *arenaA);
+
   // Destructor.
   ~Array();
 
+  // Free an array made with new or create().
+  static void destroy(Array *array);
+
+  // Was this array allocated from an arena?
+  GBool isInArena() { return arena != NULL; }
+
   // Reference counting.
+#if MULTITHREADED
+  int incRef() { return gAtomicIncrement(&ref); }
+  int decRef() { return gAtomicDecrement(&ref); }
+#else
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
+#endif
 
   // Get number of elements.
   int getLength() { return length; }
@@ -65,7 +90,13 @@ private:
   Object *elems;		// array of elements
   int size;			// size of <elems> array
   int length;			// number of elements in array
+#if MULTITHREADED
+  GooAtomicCounter ref;		// reference count
+#else
   int ref;			// reference count
+#endif
+  GooArena *arena;		// arena holding this array, or NULL
+  GBool elemsInArena;		// is <elems> allocated from <arena>?
 };
 
 #endif
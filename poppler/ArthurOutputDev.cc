@@ -108,7 +108,8 @@ void ArthurOutputDev::startDoc(XRef *xrefA) {
   globalParams->getEnableFreeType(),
   gFalse,
 #endif
-  m_painter->testRenderHint(QPainter::TextAntialiasing));
+  m_painter->testRenderHint(QPainter::TextAntialiasing),
+  globalParams->getGlyphCacheSize());
 }
 
 void ArthurOutputDev::startPage(int pageNum, GfxState *state)
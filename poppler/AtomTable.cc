@@ -0,0 +1,178 @@
+//========================================================================
+//
+// AtomTable.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "poppler-config.h"
+#include "AtomTable.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+//------------------------------------------------------------------------
+
+// Maximum number of interned atoms; later strings get private copies.
+#define atomTableMaxAtoms 65536
+
+// Longer strings aren't interned.  (Names are limited to 127 bytes.)
+#define atomMaxLength 127
+
+// Initial number of hash table buckets (must be a power of 2).
+#define atomTableInitialSize 1024
+
+// Interned atoms are allocated from blocks of this size.
+#define atomBlockSize 65536
+
+static AtomHeader **atomTab = NULL;	// hash table
+static int atomTabSize = 0;		// number of buckets
+static int nAtoms = 0;			// number of interned atoms
+static char *atomBlock = NULL;		// free space in the current block
+static int atomBlockLeft = 0;		// bytes left in the current block
+
+#if MULTITHREADED
+
+class AtomTableMutex {
+public:
+  AtomTableMutex() { gInitMutex(&mutex); }
+  ~AtomTableMutex() { gDestroyMutex(&mutex); }
+  GooMutex mutex;
+};
+
+static AtomTableMutex atomTableMutex;
+
+#  define lockAtomTable   gLockMutex(&atomTableMutex.mutex)
+#  define unlockAtomTable gUnlockMutex(&atomTableMutex.mutex)
+
+#else
+
+#  define lockAtomTable
+#  define unlockAtomTable
+
+#endif
+
+static inline Guint atomHash(const char *s, int len) {
+  Guint h;
+  int i;
+
+  h = 2166136261u;
+  for (i = 0; i < len; ++i) {
+    h = (h ^ (Guchar)s[i]) * 16777619u;
+  }
+  return h;
+}
+
+static inline char *atomString(AtomHeader *atom) {
+  return (char *)(atom + 1);
+}
+
+static char *makePrivateAtom(const char *s, int len) {
+  AtomHeader *atom;
+
+  atom = (AtomHeader *)gmalloc(sizeof(AtomHeader) + len + 1);
+  atom->next = NULL;
+  atom->hash = 0;
+  atom->id = -1;
+  memcpy(atomString(atom), s, len);
+  atomString(atom)[len] = '\0';
+  return atomString(atom);
+}
+
+static void expandAtomTable() {
+  AtomHeader **oldTab;
+  AtomHeader *atom, *next;
+  int oldSize, i;
+
+  oldSize = atomTabSize;
+  oldTab = atomTab;
+  atomTabSize = oldSize ? 2 * oldSize : atomTableInitialSize;
+  atomTab = (AtomHeader **)gmallocn(atomTabSize, sizeof(AtomHeader *));
+  for (i = 0; i < atomTabSize; ++i) {
+    atomTab[i] = NULL;
+  }
+  for (i = 0; i < oldSize; ++i) {
+    for (atom = oldTab[i]; atom; atom = next) {
+      next = atom->next;
+      atom->next = atomTab[atom->hash & (atomTabSize - 1)];
+      atomTab[atom->hash & (atomTabSize - 1)] = atom;
+    }
+  }
+  gfree(oldTab);
+}
+
+//------------------------------------------------------------------------
+// AtomTable
+//------------------------------------------------------------------------
+
+char *AtomTable::intern(const char *s, int len) {
+  AtomHeader *atom;
+  Guint h;
+  int n;
+
+  if (len > atomMaxLength) {
+    return makePrivateAtom(s, len);
+  }
+  h = atomHash(s, len);
+
+  lockAtomTable;
+  if (atomTabSize) {
+    for (atom = atomTab[h & (atomTabSize - 1)]; atom; atom = atom->next) {
+      if (atom->hash == h &&
+	  !memcmp(atomString(atom), s, len) && !atomString(atom)[len]) {
+	unlockAtomTable;
+	return atomString(atom);
+      }
+    }
+  }
+  if (nAtoms == atomTableMaxAtoms) {
+    unlockAtomTable;
+    return makePrivateAtom(s, len);
+  }
+
+  if (nAtoms >= atomTabSize) {
+    expandAtomTable();
+  }
+  // keep the headers aligned
+  n = (int)sizeof(AtomHeader) +
+      ((len + 1 + (int)sizeof(void *) - 1) & ~((int)sizeof(void *) - 1));
+  if (n > atomBlockLeft) {
+    atomBlock = (char *)gmalloc(atomBlockSize);
+    atomBlockLeft = atomBlockSize;
+  }
+  atom = (AtomHeader *)atomBlock;
+  atomBlock += n;
+  atomBlockLeft -= n;
+  atom->hash = h;
+  atom->id = nAtoms++;
+  memcpy(atomString(atom), s, len);
+  atomString(atom)[len] = '\0';
+  atom->next = atomTab[h & (atomTabSize - 1)];
+  atomTab[h & (atomTabSize - 1)] = atom;
+  unlockAtomTable;
+
+  return atomString(atom);
+}
+
+void AtomTable::free(char *atom) {
+  if (getID(atom) < 0) {
+    gfree((AtomHeader *)atom - 1);
+  }
+}
+
+int AtomTable::getNumAtoms() {
+  int n;
+
+  lockAtomTable;
+  n = nAtoms;
+  unlockAtomTable;
+  return n;
+}
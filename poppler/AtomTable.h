@@ -0,0 +1,64 @@
+//========================================================================
+//
+// AtomTable.h
+//
+//========================================================================
+
+#ifndef ATOMTABLE_H
+#define ATOMTABLE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include <string.h>
+#include "goo/gtypes.h"
+
+//------------------------------------------------------------------------
+
+struct AtomHeader {
+  AtomHeader *next;		// next atom in hash bucket
+  Guint hash;			// hash of the string
+  int id;			// atom ID, or -1 for a private copy
+};
+
+//------------------------------------------------------------------------
+// AtomTable
+//------------------------------------------------------------------------
+
+// Name and command (operator) strings are stored as atoms: each
+// distinct string is interned once, for the life of the process, in a
+// global table, and gets a small integer ID.  Two interned atoms are
+// equal if and only if their pointers are equal, and copying or
+// freeing an interned atom costs nothing.
+//
+// Once the table is full, or for very long strings, a private copy
+// with ID -1 is made instead; it has to be freed like any other
+// string.  Atoms must only be copied and freed with AtomTable::copy
+// and AtomTable::free.
+//
+// The table is shared by all threads.
+class AtomTable {
+public:
+
+  // Return the atom for the <len> bytes at <s>.
+  static char *intern(const char *s, int len);
+  static char *intern(const char *s) { return intern(s, strlen(s)); }
+
+  // Copy an atom.
+  static char *copy(char *atom)
+    { return getID(atom) >= 0 ? atom : intern(atom); }
+
+  // Free an atom.
+  static void free(char *atom);
+
+  // Return the ID of an interned atom (0, 1, ...), or -1 for a private
+  // copy.
+  static int getID(char *atom)
+    { return ((AtomHeader *)atom - 1)->id; }
+
+  // Return the number of interned atoms.
+  static int getNumAtoms();
+};
+
+#endif
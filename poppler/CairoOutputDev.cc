@@ -54,6 +54,8 @@
 #include "CharCodeToUnicode.h"
 #include "FontEncodingTables.h"
 #include "PDFDocEncoding.h"
+#include "XRef.h"
+#include "ImageCache.h"
 #include <fofi/FoFiTrueType.h>
 #include <splash/SplashBitmap.h>
 #include "CairoOutputDev.h"
@@ -2008,15 +2010,28 @@ void CairoOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   cairo_surface_t *image;
   cairo_pattern_t *pattern, *maskPattern;
   ImageStream *imgStr;
+  Stream *pixStr;
   cairo_matrix_t matrix;
   unsigned char *buffer;
   int stride, i;
   GfxRGB *lookup = NULL;
 
-  /* TODO: Do we want to cache these? */
-  imgStr = new ImageStream(str, width,
-			   colorMap->getNumPixelComps(),
-			   colorMap->getBits());
+  /* Images used on several pages (logos, watermarks) are decoded once
+   * and then read from the document's image cache */
+  pixStr = NULL;
+  if (xref && xref->getImageCache()) {
+    pixStr = xref->getImageCache()->getPixelStream(ref, str, width, height,
+						   colorMap->getNumPixelComps(),
+						   colorMap->getBits());
+  }
+  if (pixStr) {
+    imgStr = new ImageStream(pixStr, width,
+			     colorMap->getNumPixelComps(), 8);
+  } else {
+    imgStr = new ImageStream(str, width,
+			     colorMap->getNumPixelComps(),
+			     colorMap->getBits());
+  }
   imgStr->reset();
 
 #if 0
@@ -2144,6 +2159,10 @@ void CairoOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 cleanup:
   imgStr->close();
   delete imgStr;
+  if (pixStr) {
+    delete pixStr;
+    str->close();
+  }
 }
 
 
@@ -46,31 +46,51 @@
 #include "Error.h"
 #include "Link.h"
 #include "PageLabelInfo.h"
+#include "Linearization.h"
 #include "Catalog.h"
 #include "Form.h"
 #include "OptionalContent.h"
 
+// The page tree is normally only a few levels deep; anything deeper
+// than this is taken to be a loop.
+#define maxPageTreeDepth 256
+
+// Page attributes which can be inherited from the page tree.
+static char *inheritedPageAttrs[] = {
+  "Resources", "MediaBox", "CropBox", "Rotate"
+};
+#define nInheritedPageAttrs \
+  ((int)(sizeof(inheritedPageAttrs) / sizeof(inheritedPageAttrs[0])))
+
 //------------------------------------------------------------------------
 // Catalog
 //------------------------------------------------------------------------
 
 Catalog::Catalog(XRef *xrefA) {
-  Object catDict, pagesDict, pagesDictRef;
+  Object catDict;
   Object obj, obj2;
-  Object optContentProps;
-  char *alreadyRead;
+  Guint missing;
   int numPages0;
   int i;
 
   ok = gTrue;
   xref = xrefA;
+  missing = xref->getMissingCount();
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
   pages = NULL;
   pageRefs = NULL;
   numPages = pagesSize = 0;
+  pageTreeRead = pageRefsRead = gFalse;
+  parentAttrs = NULL;
+  destNameTreeRead = embeddedFileNameTreeRead = jsNameTreeRead = gFalse;
   baseURI = NULL;
   pageLabelInfo = NULL;
+  pageLabelInfoRead = gFalse;
   form = NULL;
   optContent = NULL;
+  optContentRead = gFalse;
 
   xref->getCatalog(&catDict);
   if (!catDict.isDict()) {
@@ -86,67 +106,56 @@ Catalog::Catalog(XRef *xrefA) {
   }
 
 
-  // read page tree
-  catDict.dictLookup("Pages", &pagesDict);
-  // This should really be isDict("Pages"), but I've seen at least one
-  // PDF file where the /Type entry is missing.
-  if (!pagesDict.isDict()) {
-    error(-1, "Top-level pages object is wrong type (%s)",
-	  pagesDict.getTypeName());
-    goto err2;
-  }
-  pagesDict.dictLookup("Count", &obj);
-  // some PDF files actually use real numbers here ("/Count 9.0")
-  if (!obj.isNum()) {
-    error(-1, "Page count in top-level pages object is wrong type (%s)",
-	  obj.getTypeName());
-    pagesSize = numPages0 = 0;
-  } else {
-    pagesSize = numPages0 = (int)obj.getNum();
-  }
-  obj.free();
-  pages = (Page **)gmallocn(pagesSize, sizeof(Page *));
-  pageRefs = (Ref *)gmallocn(pagesSize, sizeof(Ref));
-  for (i = 0; i < pagesSize; ++i) {
-    pages[i] = NULL;
-    pageRefs[i].num = -1;
-    pageRefs[i].gen = -1;
-  }
-  alreadyRead = (char *)gmalloc(xref->getNumObjects());
-  memset(alreadyRead, 0, xref->getNumObjects());
-  if (catDict.dictLookupNF("Pages", &pagesDictRef)->isRef() &&
-      pagesDictRef.getRefNum() >= 0 &&
-      pagesDictRef.getRefNum() < xref->getNumObjects()) {
-    alreadyRead[pagesDictRef.getRefNum()] = 1;
-  }
-  pagesDictRef.free();
-  numPages = readPageTree(pagesDict.getDict(), NULL, 0, alreadyRead);
-  gfree(alreadyRead);
-  if (numPages != numPages0) {
-    error(-1, "Page count in top-level pages object is incorrect");
-  }
-  pagesDict.free();
-
-  // read named destination dictionary
-  catDict.dictLookup("Dests", &dests);
-
-  // read root of named destination tree - PDF1.6 table 3.28
-  if (catDict.dictLookup("Names", &obj)->isDict()) {
-    obj.dictLookup("Dests", &obj2);
-    destNameTree.init(xref, &obj2);
-    obj2.free();
-    obj.dictLookup("EmbeddedFiles", &obj2);
-    embeddedFileNameTree.init(xref, &obj2);
-    obj2.free();
-    obj.dictLookup("JavaScript", &obj2);
-    jsNameTree.init(xref, &obj2);
-    obj2.free();
+  // read page tree -- the first page of a linearized file can be read
+  // without going through the tree
+  if (!readLinearizedFirstPage(&catDict)) {
+    catDict.dictLookup("Pages", &pagesRoot);
+    // This should really be isDict("Pages"), but I've seen at least one
+    // PDF file where the /Type entry is missing.
+    if (!pagesRoot.isDict()) {
+      error(-1, "Top-level pages object is wrong type (%s)",
+	    pagesRoot.getTypeName());
+      goto err2;
+    }
+    pagesRoot.dictLookup("Count", &obj);
+    // some PDF files actually use real numbers here ("/Count 9.0")
+    if (!obj.isNum()) {
+      error(-1, "Page count in top-level pages object is wrong type (%s)",
+	    obj.getTypeName());
+      numPages0 = 0;
+    } else {
+      numPages0 = (int)obj.getNum();
+    }
+    obj.free();
+    pagesSize = numPages0 > 0 ? numPages0 : 0;
+    pages = (Page **)gmallocn(pagesSize, sizeof(Page *));
+    pageRefs = (Ref *)gmallocn(pagesSize, sizeof(Ref));
+    for (i = 0; i < pagesSize; ++i) {
+      pages[i] = NULL;
+      pageRefs[i].num = -1;
+      pageRefs[i].gen = -1;
+    }
+    // read the pages as they are asked for, if the page count agrees
+    // with the root's kids; otherwise the whole tree has to be read to
+    // know how many pages there are, and form fields need to see all
+    // their widgets, so they also need all the pages up front
+    if (numPages0 > 0 && !(form && form->getNumFields() > 0) &&
+	checkPageCount(numPages0)) {
+      numPages = numPages0;
+    } else {
+      numPages = readWholePageTree(gTrue);
+      if (numPages != numPages0) {
+	error(-1, "Page count in top-level pages object is incorrect");
+      }
+    }
   }
-  obj.free();
 
-  if (catDict.dictLookup("PageLabels", &obj)->isDict())
-    pageLabelInfo = new PageLabelInfo(&obj, numPages);
-  obj.free();
+  // the named destination dictionary, the names dictionary (PDF1.6
+  // table 3.28) and the page labels are read the first time they're
+  // needed
+  catDict.dictLookupNF("Dests", &dests);
+  catDict.dictLookupNF("Names", &names);
+  catDict.dictLookupNF("PageLabels", &pageLabels);
 
   // read page mode
   pageMode = pageModeNone;
@@ -192,37 +201,39 @@ Catalog::Catalog(XRef *xrefA) {
   }
   obj.free();
 
-  // get the metadata stream
-  catDict.dictLookup("Metadata", &metadata);
-
-  // get the structure tree root
-  catDict.dictLookup("StructTreeRoot", &structTreeRoot);
-
-  // get the outline dictionary
-  catDict.dictLookup("Outlines", &outline);
-
-  // get the Optional Content dictionary
-  if (catDict.dictLookup("OCProperties", &optContentProps)->isDict()) {
-    optContent = new OCGs(&optContentProps, xref);
-    if (!optContent->isOk ()) {
-      delete optContent;
-      optContent = NULL;
-    }
-  }
-  optContentProps.free();
+  // the metadata stream, the structure tree root, the outline
+  // dictionary and the Optional Content dictionary are also read when
+  // they're needed
+  catDict.dictLookupNF("Metadata", &metadata);
+  catDict.dictLookupNF("StructTreeRoot", &structTreeRoot);
+  catDict.dictLookupNF("Outlines", &outline);
+  catDict.dictLookupNF("OCProperties", &optContentProps);
 
   // perform form-related loading after all widgets have been loaded
   if (form) 
     form->postWidgetsLoad();
 
+  // if any of the above hasn't arrived yet, the catalog has to be read
+  // again later
+  if (xref->getMissingCount() != missing) {
+    ok = gFalse;
+  }
+
   catDict.free();
   return;
 
  err2:
-  pagesDict.free();
+  pagesRoot.free();
  err1:
   catDict.free();
   dests.initNull();
+  names.initNull();
+  pageLabels.initNull();
+  metadata.initNull();
+  structTreeRoot.initNull();
+  outline.initNull();
+  optContentProps.initNull();
+  pagesRoot.initNull();
   ok = gFalse;
 }
 
@@ -238,20 +249,28 @@ Catalog::~Catalog() {
     gfree(pages);
     gfree(pageRefs);
   }
+  pagesRoot.free();
   dests.free();
+  names.free();
   destNameTree.free();
   embeddedFileNameTree.free();
   jsNameTree.free();
   if (baseURI) {
     delete baseURI;
   }
+  delete parentAttrs;
   delete pageLabelInfo;
+  pageLabels.free();
   delete form;
   delete optContent;
+  optContentProps.free();
   metadata.free();
   structTreeRoot.free();
   outline.free();
   acroForm.free();
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 GooString *Catalog::readMetadata() {
@@ -260,7 +279,13 @@ GooString *Catalog::readMetadata() {
   Object obj;
   int c;
 
-  if (!metadata.isStream()) {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  if (!resolveEntry(&metadata) || !metadata.isStream()) {
+#if MULTITHREADED
+    gUnlockMutex(&mutex);
+#endif
     return NULL;
   }
   dict = metadata.streamGetDict();
@@ -275,19 +300,552 @@ GooString *Catalog::readMetadata() {
     s->append(c);
   }
   metadata.streamClose();
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
   return s;
 }
 
+Page *Catalog::getPage(int i) {
+  Page *page;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  // (loading a page can correct numPages)
+  if (i >= 1 && i <= numPages && !pages[i-1]) {
+    loadPage(i-1);
+  }
+  page = (i >= 1 && i <= numPages) ? pages[i-1] : (Page *)NULL;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return page;
+}
+
+Ref Catalog::getPageRef(int i) {
+  Ref ref;
+
+  ref.num = ref.gen = -1;
+  if (getPage(i)) {
+#if MULTITHREADED
+    gLockMutex(&mutex);
+#endif
+    ref = pageRefs[i-1];
+#if MULTITHREADED
+    gUnlockMutex(&mutex);
+#endif
+  }
+  return ref;
+}
+
+// Read page <idx> (zero-based) into pages[idx].  Called with the mutex
+// held.
+void Catalog::loadPage(int idx) {
+  Object obj;
+  PageAttrs *attrs;
+  Guint missing;
+
+  missing = xref->getMissingCount();
+
+  // if the page's ref is already known, fetch the page directly and
+  // take the inherited attributes from its ancestors
+  if (!pageTreeRead && pageRefs[idx].num >= 0) {
+    xref->fetch(pageRefs[idx].num, pageRefs[idx].gen, &obj);
+    if (obj.isDict("Page") && (attrs = makePageAttrs(obj.getDict()))) {
+      pages[idx] = new Page(xref, idx + 1, obj.getDict(), pageRefs[idx],
+			    attrs, form);
+    }
+    obj.free();
+  }
+
+  if (!pages[idx] && !pageTreeRead && getPagesRoot() &&
+      !findPageInTree(getPagesRoot(), NULL, 0, idx, 0) &&
+      xref->getMissingCount() == missing) {
+    // the page counts in the tree don't add up: fall back to reading
+    // the whole tree, which also corrects numPages
+    error(-1, "Page count in pages object is incorrect");
+    readWholePageTree(gTrue);
+  }
+  if (xref->getMissingCount() != missing) {
+    // the page, or the part of the tree leading to it, hasn't arrived
+    // yet -- leave it for next time
+    if (pages[idx]) {
+      delete pages[idx];
+      pages[idx] = NULL;
+    }
+  }
+}
+
+// Check the top-level page count <count> against the sum of the counts
+// of the root's kids (a page counts as one).  The counts further down
+// are checked as the pages are looked up.  If some kid hasn't arrived
+// yet, the count is trusted for now.  Only called from the
+// constructor.
+GBool Catalog::checkPageCount(int count) {
+  Object kids, kid, obj;
+  Guint missing;
+  GBool ok1;
+  int n, i;
+
+  if (!getPagesRoot()) {
+    return gFalse;
+  }
+  missing = xref->getMissingCount();
+  if (!getPagesRoot()->lookup("Kids", &kids)->isArray()) {
+    kids.free();
+    return gFalse;
+  }
+  ok1 = gTrue;
+  n = 0;
+  for (i = 0; ok1 && i < kids.arrayGetLength(); ++i) {
+    kids.arrayGet(i, &kid);
+    if (xref->getMissingCount() != missing) {
+      kid.free();
+      kids.free();
+      return gTrue;
+    }
+    if (kid.isDict("Page")) {
+      ++n;
+    // This should really be isDict("Pages"), but I've seen at least one
+    // PDF file where the /Type entry is missing.
+    } else if (kid.isDict()) {
+      kid.dictLookup("Count", &obj);
+      if (obj.isNum() && obj.getNum() >= 0) {
+	n += (int)obj.getNum();
+      } else {
+	ok1 = gFalse;
+      }
+      obj.free();
+    }
+    kid.free();
+  }
+  kids.free();
+  return ok1 && n == count;
+}
+
+// For a linearized file, read the first page straight from the object
+// named in the linearization dictionary, and take the page count from
+// there, so that neither the page tree nor anything else outside the
+// first-page section of the file needs to be fetched.  If the page
+// inherits attributes, they're taken from its /Parent chain, and if
+// that can't be read, the tree is read the normal way.  The top-level
+// pages object is fetched when it's needed.
+GBool Catalog::readLinearizedFirstPage(Object *catDict) {
+  Linearization *lin;
+  Object pageDict, obj;
+  PageAttrs *attrs;
+  Ref ref;
+  GBool ownAttrs;
+  int idx, i;
+
+  lin = xref->getLinearization();
+  if (!lin || (form && form->getNumFields() > 0)) {
+    return gFalse;
+  }
+  idx = lin->getPageFirst();
+  if (idx < 0 || idx >= lin->getNumPages()) {
+    return gFalse;
+  }
+  ref.num = lin->getObjectNumberFirst();
+  ref.gen = 0;
+  if (!xref->fetch(ref.num, ref.gen, &pageDict)->isDict("Page")) {
+    pageDict.free();
+    return gFalse;
+  }
+  // a page object in a linearized file normally carries all of its
+  // attributes; only if it doesn't are its ancestors fetched
+  ownAttrs = gTrue;
+  for (i = 0; i < nInheritedPageAttrs; ++i) {
+    if (pageDict.dictLookupNF(inheritedPageAttrs[i], &obj)->isNull()) {
+      ownAttrs = gFalse;
+    }
+    obj.free();
+  }
+  if (ownAttrs) {
+    attrs = new PageAttrs(NULL, pageDict.getDict());
+  } else if (!(attrs = makePageAttrs(pageDict.getDict()))) {
+    pageDict.free();
+    return gFalse;
+  }
+
+  catDict->dictLookupNF("Pages", &pagesRoot);
+  numPages = pagesSize = lin->getNumPages();
+  pages = (Page **)gmallocn(pagesSize, sizeof(Page *));
+  pageRefs = (Ref *)gmallocn(pagesSize, sizeof(Ref));
+  for (i = 0; i < pagesSize; ++i) {
+    pages[i] = NULL;
+    pageRefs[i].num = -1;
+    pageRefs[i].gen = -1;
+  }
+  pages[idx] = new Page(xref, idx + 1, pageDict.getDict(), ref, attrs, form);
+  pageRefs[idx] = ref;
+  pageDict.free();
+  return gTrue;
+}
+
+// Fetch the catalog entry <obj> in place if it's still a ref.  If it
+// hasn't arrived yet, it is left as a ref, to be fetched again next
+// time, and false is returned.  Called with the mutex held (or from the
+// constructor).
+GBool Catalog::resolveEntry(Object *obj) {
+  Object obj1;
+  Guint missing;
+
+  if (obj->isRef()) {
+    missing = xref->getMissingCount();
+    obj->fetch(xref, &obj1);
+    if (xref->getMissingCount() != missing) {
+      obj1.free();
+      return gFalse;
+    }
+    obj->free();
+    *obj = obj1;
+  }
+  return gTrue;
+}
+
+// Return the top-level pages object, fetching it first if needed, or
+// NULL if it isn't a dictionary (or hasn't arrived yet).
+Dict *Catalog::getPagesRoot() {
+  if (!resolveEntry(&pagesRoot) || !pagesRoot.isDict()) {
+    return NULL;
+  }
+  return pagesRoot.getDict();
+}
+
+Object *Catalog::getStructTreeRoot() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  resolveEntry(&structTreeRoot);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return &structTreeRoot;
+}
+
+Object *Catalog::getOutline() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  resolveEntry(&outline);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return &outline;
+}
+
+OCGs *Catalog::getOptContentConfig() {
+  OCGs *ocgs;
+  Guint missing;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  if (!optContentRead) {
+    missing = xref->getMissingCount();
+    if (resolveEntry(&optContentProps) && optContentProps.isDict()) {
+      optContent = new OCGs(&optContentProps, xref);
+      if (!optContent->isOk()) {
+	delete optContent;
+	optContent = NULL;
+      }
+    }
+    if (xref->getMissingCount() == missing) {
+      optContentRead = gTrue;
+    } else if (optContent) {
+      // try again next time
+      delete optContent;
+      optContent = NULL;
+    }
+  }
+  ocgs = optContent;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return ocgs;
+}
+
+// Read the name tree <key> of the names dictionary into <tree> the
+// first time it's needed.  Called with the mutex held.
+void Catalog::readNameTree(NameTree *tree, GBool *treeRead, char *key) {
+  Object obj;
+  Guint missing;
+
+  if (*treeRead) {
+    return;
+  }
+  missing = xref->getMissingCount();
+  if (resolveEntry(&names) && names.isDict()) {
+    names.dictLookup(key, &obj);
+    tree->init(xref, &obj);
+    obj.free();
+  }
+  if (xref->getMissingCount() == missing) {
+    *treeRead = gTrue;
+  } else {
+    // try again next time
+    tree->free();
+  }
+}
+
+// Return the page label info, reading it the first time it's needed.
+// Called with the mutex held.
+PageLabelInfo *Catalog::getPageLabelInfo() {
+  Guint missing;
+
+  if (!pageLabelInfoRead) {
+    missing = xref->getMissingCount();
+    if (resolveEntry(&pageLabels) && pageLabels.isDict()) {
+      pageLabelInfo = new PageLabelInfo(&pageLabels, numPages);
+    }
+    if (xref->getMissingCount() == missing) {
+      pageLabelInfoRead = gTrue;
+    } else if (pageLabelInfo) {
+      // try again next time
+      delete pageLabelInfo;
+      pageLabelInfo = NULL;
+    }
+  }
+  return pageLabelInfo;
+}
+
+// Build the attributes of the page <pageDict>, inheriting from the
+// page tree nodes on its /Parent chain.  The attributes of the last
+// parent node are kept, since consecutive pages usually share it.
+// Returns NULL if the chain is broken (or hasn't arrived yet); the page
+// then has to be found by walking down the tree.  Called with the mutex
+// held (or from the constructor).
+PageAttrs *Catalog::makePageAttrs(Dict *pageDict) {
+  Object parents[maxPageTreeDepth];
+  Object parentRef;
+  PageAttrs *attrs, *attrs1;
+  Ref ref;
+  Guint missing;
+  GBool chainOk;
+  int n, i;
+
+  pageDict->lookupNF("Parent", &parentRef);
+  if (!parentRef.isRef()) {
+    parentRef.free();
+    return new PageAttrs(NULL, pageDict);
+  }
+  ref = parentRef.getRef();
+  if (parentAttrs &&
+      ref.num == parentAttrsRef.num && ref.gen == parentAttrsRef.gen) {
+    parentRef.free();
+    return new PageAttrs(parentAttrs, pageDict);
+  }
+
+  missing = xref->getMissingCount();
+  chainOk = gTrue;
+  n = 0;
+  while (!parentRef.isNull()) {
+    if (n == maxPageTreeDepth ||
+	!parentRef.fetch(xref, &parents[n])->isDict() ||
+	xref->getMissingCount() != missing) {
+      if (n < maxPageTreeDepth) {
+	parents[n].free();
+      }
+      chainOk = gFalse;
+      break;
+    }
+    parentRef.free();
+    parents[n++].dictLookupNF("Parent", &parentRef);
+  }
+  parentRef.free();
+
+  attrs = NULL;
+  if (chainOk) {
+    for (i = n - 1; i >= 0; --i) {
+      attrs1 = new PageAttrs(attrs, parents[i].getDict());
+      delete attrs;
+      attrs = attrs1;
+    }
+    delete parentAttrs;
+    parentAttrs = attrs;
+    parentAttrsRef = ref;
+    attrs = new PageAttrs(parentAttrs, pageDict);
+  }
+  for (i = 0; i < n; ++i) {
+    parents[i].free();
+  }
+  return attrs;
+}
+
+// Look for page <idx> (zero-based) in the page tree node <pagesDict>,
+// whose first page is page <start>.  Subtrees which don't contain the
+// page are skipped using their /Count entries, so that only the nodes
+// on the way to the page and their kids need to be fetched; the refs
+// of the pages met on the way are recorded in pageRefs.  Before going
+// down a level, the node's /Count is checked against the sum of its
+// kids' counts.  Returns false if the page isn't there or the counts
+// don't add up -- the caller then has to read the whole tree.
+GBool Catalog::findPageInTree(Dict *pagesDict, PageAttrs *attrs, int start,
+			      int idx, int depth) {
+  Object kids, kid, kidRef, obj;
+  PageAttrs *attrs1;
+  Ref ref;
+  GBool found;
+  Guint missing;
+  int start0, count, kidIdx, kidStart, i;
+
+  if (depth > maxPageTreeDepth) {
+    return gFalse;
+  }
+  missing = xref->getMissingCount();
+  pagesDict->lookup("Kids", &kids);
+  if (!kids.isArray()) {
+    kids.free();
+    return gFalse;
+  }
+
+  // find the kid which holds the page
+  start0 = start;
+  kidIdx = kidStart = -1;
+  for (i = 0; i < kids.arrayGetLength(); ++i) {
+    kids.arrayGetNF(i, &kidRef);
+
+    // a kid which is already known to be a page doesn't need to be
+    // fetched again
+    if (kidRef.isRef() && start != idx && start < pagesSize &&
+	pageRefs[start].num == kidRef.getRefNum() &&
+	pageRefs[start].gen == kidRef.getRefGen()) {
+      kidRef.free();
+      ++start;
+      continue;
+    }
+
+    kids.arrayGet(i, &kid);
+    if (xref->getMissingCount() != missing) {
+      // the kid hasn't arrived yet, so the pages after it can't be
+      // numbered
+      kid.free();
+      kidRef.free();
+      kids.free();
+      return gFalse;
+    }
+    if (kid.isDict("Page")) {
+      if (start < pagesSize) {
+	if (kidRef.isRef()) {
+	  pageRefs[start] = kidRef.getRef();
+	} else {
+	  pageRefs[start].num = pageRefs[start].gen = -1;
+	}
+      }
+      count = 1;
+
+    // This should really be isDict("Pages"), but I've seen at least one
+    // PDF file where the /Type entry is missing.
+    } else if (kid.isDict()) {
+      kid.dictLookup("Count", &obj);
+      count = obj.isNum() ? (int)obj.getNum() : -1;
+      obj.free();
+      if (count < 0) {
+	kid.free();
+	kidRef.free();
+	kids.free();
+	return gFalse;
+      }
+    } else {
+      count = 0;
+    }
+    if (idx >= start && idx < start + count) {
+      kidIdx = i;
+      kidStart = start;
+    }
+    start += count;
+    kid.free();
+    kidRef.free();
+  }
+  pagesDict->lookup("Count", &obj);
+  if (kidIdx < 0 || !obj.isNum() || (int)obj.getNum() != start - start0) {
+    obj.free();
+    kids.free();
+    return gFalse;
+  }
+  obj.free();
+
+  // read the page, or go down a level
+  attrs1 = new PageAttrs(attrs, pagesDict);
+  kids.arrayGetNF(kidIdx, &kidRef);
+  kids.arrayGet(kidIdx, &kid);
+  if (kid.isDict("Page")) {
+    if (kidRef.isRef()) {
+      ref = kidRef.getRef();
+    } else {
+      ref.num = ref.gen = -1;
+    }
+    pages[idx] = new Page(xref, idx + 1, kid.getDict(), ref,
+			  new PageAttrs(attrs1, kid.getDict()), form);
+    found = gTrue;
+  } else {
+    found = findPageInTree(kid.getDict(), attrs1, kidStart, idx, depth + 1);
+  }
+  kid.free();
+  kidRef.free();
+  delete attrs1;
+  kids.free();
+  return found;
+}
+
+// Walk the whole page tree, recording the ref of every page and, if
+// <makePages> is set, reading every page that hasn't been read yet.
+// Returns the number of pages found, and sets numPages to it if the
+// whole tree could be read.  Called with the mutex held (or
+// from the constructor).
+int Catalog::readWholePageTree(GBool makePages) {
+  Object catDict, pagesRootRef;
+  char *alreadyRead;
+  Guint missing;
+  int n;
+
+  missing = xref->getMissingCount();
+  alreadyRead = (char *)gmalloc(xref->getNumObjects());
+  memset(alreadyRead, 0, xref->getNumObjects());
+  if (xref->getCatalog(&catDict)->isDict() &&
+      catDict.dictLookupNF("Pages", &pagesRootRef)->isRef() &&
+      pagesRootRef.getRefNum() >= 0 &&
+      pagesRootRef.getRefNum() < xref->getNumObjects()) {
+    alreadyRead[pagesRootRef.getRefNum()] = 1;
+  }
+  pagesRootRef.free();
+  catDict.free();
+  if (getPagesRoot()) {
+    n = readPageTree(getPagesRoot(), NULL, 0, alreadyRead, makePages);
+  } else {
+    error(-1, "Top-level pages object is wrong type (%s)",
+	  pagesRoot.getTypeName());
+    n = 0;
+  }
+  gfree(alreadyRead);
+  if (xref->getMissingCount() == missing) {
+    pageRefsRead = gTrue;
+    if (makePages) {
+      pageTreeRead = gTrue;
+    }
+    // the tree is the authority on the number of pages, whatever the
+    // top-level count says
+    if (n >= 0) {
+      numPages = n;
+    }
+  }
+  return n;
+}
+
 int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
-			  char *alreadyRead) {
+			  char *alreadyRead, GBool makePages) {
   Object kids;
   Object kid;
   Object kidRef;
   PageAttrs *attrs1, *attrs2;
   Page *page;
+  Guint missing;
   int i, j;
 
-  attrs1 = new PageAttrs(attrs, pagesDict);
+  missing = xref->getMissingCount();
+  attrs1 = makePages ? new PageAttrs(attrs, pagesDict) : (PageAttrs *)NULL;
   pagesDict->lookup("Kids", &kids);
   if (!kids.isArray()) {
     error(-1, "Kids object (page %d) is wrong type (%s)",
@@ -307,12 +865,23 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
       alreadyRead[kidRef.getRefNum()] = 1;
     }
     kids.arrayGet(i, &kid);
+    if (xref->getMissingCount() != missing) {
+      goto err2;
+    }
     if (kid.isDict("Page")) {
-      attrs2 = new PageAttrs(attrs1, kid.getDict());
-      page = new Page(xref, start+1, kid.getDict(), kidRef.getRef(), attrs2, form);
-      if (!page->isOk()) {
-	++start;
-	goto err3;
+      if (start < pagesSize && pages[start]) {
+	// already read on demand
+	page = pages[start];
+      } else if (makePages) {
+	attrs2 = new PageAttrs(attrs1, kid.getDict());
+	page = new Page(xref, start+1, kid.getDict(), kidRef.getRef(), attrs2,
+			form);
+	if (!page->isOk() || xref->getMissingCount() != missing) {
+	  ++start;
+	  goto err3;
+	}
+      } else {
+	page = NULL;
       }
       if (start >= pagesSize) {
 	pagesSize += 32;
@@ -333,8 +902,8 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
     // This should really be isDict("Pages"), but I've seen at least one
     // PDF file where the /Type entry is missing.
     } else if (kid.isDict()) {
-      if ((start = readPageTree(kid.getDict(), attrs1, start, alreadyRead))
-	  < 0)
+      if ((start = readPageTree(kid.getDict(), attrs1, start, alreadyRead,
+				makePages)) < 0)
 	goto err2;
     } else {
       error(-1, "Kid object (page %d) is wrong type (%s)",
@@ -354,17 +923,38 @@ int Catalog::readPageTree(Dict *pagesDict, PageAttrs *attrs, int start,
   kidRef.free();
   kids.free();
   delete attrs1;
-  ok = gFalse;
+  // a part of the tree which hasn't arrived yet isn't an error
+  if (xref->getMissingCount() == missing) {
+    ok = gFalse;
+  }
   return -1;
 }
 
 int Catalog::findPage(int num, int gen) {
-  int i;
+  int i, n;
 
-  for (i = 0; i < numPages; ++i) {
-    if (pageRefs[i].num == num && pageRefs[i].gen == gen)
-      return i + 1;
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  for (n = 0; n < 2; ++n) {
+    for (i = 0; i < numPages; ++i) {
+      if (pageRefs[i].num == num && pageRefs[i].gen == gen) {
+#if MULTITHREADED
+	gUnlockMutex(&mutex);
+#endif
+	return i + 1;
+      }
+    }
+    if (pageRefsRead) {
+      break;
+    }
+    // only the refs of the pages read so far are known -- collect the
+    // rest without building the pages
+    readWholePageTree(gFalse);
   }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
   return 0;
 }
 
@@ -375,18 +965,25 @@ LinkDest *Catalog::findDest(GooString *name) {
 
   // try named destination dictionary then name tree
   found = gFalse;
-  if (dests.isDict()) {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  if (resolveEntry(&dests) && dests.isDict()) {
     if (!dests.dictLookup(name->getCString(), &obj1)->isNull())
       found = gTrue;
     else
       obj1.free();
   }
   if (!found) {
+    readNameTree(&destNameTree, &destNameTreeRead, "Dests");
     if (destNameTree.lookup(name, &obj1))
       found = gTrue;
     else
       obj1.free();
   }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
   if (!found)
     return NULL;
 
@@ -412,10 +1009,44 @@ LinkDest *Catalog::findDest(GooString *name) {
   return dest;
 }
 
+Object *Catalog::getDests() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  resolveEntry(&dests);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return &dests;
+}
+
+int Catalog::numEmbeddedFiles() {
+  int n;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  readNameTree(&embeddedFileNameTree, &embeddedFileNameTreeRead,
+	       "EmbeddedFiles");
+  n = embeddedFileNameTree.numEntries();
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return n;
+}
+
 EmbFile *Catalog::embeddedFile(int i)
 {
     Object efDict;
     Object obj;
+#if MULTITHREADED
+    gLockMutex(&mutex);
+#endif
+    readNameTree(&embeddedFileNameTree, &embeddedFileNameTreeRead,
+		 "EmbeddedFiles");
+#if MULTITHREADED
+    gUnlockMutex(&mutex);
+#endif
     obj = embeddedFileNameTree.getValue(i);
     EmbFile *embeddedFile = 0;
     if (obj.isRef()) {
@@ -429,8 +1060,29 @@ EmbFile *Catalog::embeddedFile(int i)
     return embeddedFile;
 }
 
+int Catalog::numJS() {
+  int n;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  readNameTree(&jsNameTree, &jsNameTreeRead, "JavaScript");
+  n = jsNameTree.numEntries();
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return n;
+}
+
 GooString *Catalog::getJS(int i)
 {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  readNameTree(&jsNameTree, &jsNameTreeRead, "JavaScript");
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
   Object obj = jsNameTree.getValue(i);
   if (obj.isRef()) {
     Ref r = obj.getRef();
@@ -597,14 +1249,26 @@ void NameTree::free()
     delete entries[i];
 
   gfree(entries);
+  entries = NULL;
+  size = length = 0;
 }
 
 GBool Catalog::labelToIndex(GooString *label, int *index)
 {
+  PageLabelInfo *labelInfo;
+  GBool found;
   char *end;
 
-  if (pageLabelInfo != NULL) {
-    if (!pageLabelInfo->labelToIndex(label, index))
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  labelInfo = getPageLabelInfo();
+  found = labelInfo && labelInfo->labelToIndex(label, index);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (labelInfo != NULL) {
+    if (!found)
       return gFalse;
   } else {
     *index = strtol(label->getCString(), &end, 10) - 1;
@@ -620,13 +1284,23 @@ GBool Catalog::labelToIndex(GooString *label, int *index)
 
 GBool Catalog::indexToLabel(int index, GooString *label)
 {
+  PageLabelInfo *labelInfo;
+  GBool found;
   char buffer[32];
 
   if (index < 0 || index >= numPages)
     return gFalse;
 
-  if (pageLabelInfo != NULL) {
-    return pageLabelInfo->indexToLabel(index, label);
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  labelInfo = getPageLabelInfo();
+  found = labelInfo && labelInfo->indexToLabel(index, label);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (labelInfo != NULL) {
+    return found;
   } else {
     snprintf(buffer, sizeof (buffer), "%d", index + 1);
     label->append(buffer);	      
@@ -32,6 +32,12 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class XRef;
 class Object;
 class Page;
@@ -149,11 +155,14 @@ public:
   // Get number of pages.
   int getNumPages() { return numPages; }
 
-  // Get a page.
-  Page *getPage(int i) { return pages[i-1]; }
+  // Get a page.  Pages are read from the page tree the first time
+  // they are asked for.  Returns NULL if <i> is out of range, or if
+  // the page hasn't arrived yet (see ByteRangeStream).
+  Page *getPage(int i);
 
-  // Get the reference for a page object.
-  Ref *getPageRef(int i) { return &pageRefs[i-1]; }
+  // Get the reference for a page object.  Returns a ref with num = -1
+  // if <i> is out of range or the page isn't a separate object.
+  Ref getPageRef(int i);
 
   // Return base URI, or NULL if none.
   GooString *getBaseURI() { return baseURI; }
@@ -163,7 +172,7 @@ public:
   GooString *readMetadata();
 
   // Return the structure tree root object.
-  Object *getStructTreeRoot() { return &structTreeRoot; }
+  Object *getStructTreeRoot();
 
   // Find a page, given its object ID.  Returns page number, or 0 if
   // not found.
@@ -173,16 +182,16 @@ public:
   // NULL if <name> is not a destination.
   LinkDest *findDest(GooString *name);
 
-  Object *getDests() { return &dests; }
+  Object *getDests();
 
   // Get the number of embedded files
-  int numEmbeddedFiles() { return embeddedFileNameTree.numEntries(); }
+  int numEmbeddedFiles();
 
   // Get the i'th file embedded (at the Document level) in the document
   EmbFile *embeddedFile(int i);
 
   // Get the number of javascript scripts
-  int numJS() { return jsNameTree.numEntries(); }
+  int numJS();
 
   // Get the i'th JavaScript script (at the Document level) in the document
   GooString *getJS(int i);
@@ -191,11 +200,14 @@ public:
   GBool labelToIndex(GooString *label, int *index);
   GBool indexToLabel(int index, GooString *label);
 
-  Object *getOutline() { return &outline; }
+  // The named destinations, the name trees, the page labels, the
+  // metadata, the structure tree root, the outline and the optional
+  // content config are read the first time they're asked for.
+  Object *getOutline();
 
   Object *getAcroForm() { return &acroForm; }
 
-  OCGs *getOptContentConfig() { return optContent; }
+  OCGs *getOptContentConfig();
 
   Form* getForm() { return form; }
 
@@ -224,29 +236,60 @@ public:
 private:
 
   XRef *xref;			// the xref table for this PDF file
-  Page **pages;			// array of pages
-  Ref *pageRefs;		// object ID for each page
+  Page **pages;			// array of pages, NULL if not read yet
+  Ref *pageRefs;		// object ID for each page, num = -1 if
+				//   not known yet
   Form *form;
   int numPages;			// number of pages
   int pagesSize;		// size of pages array
+  Object pagesRoot;		// top-level pages object (a Ref until
+				//   it's needed, for linearized files)
+  GBool pageTreeRead;		// set once all pages have been read
+  GBool pageRefsRead;		// set once all page refs are known
+  PageAttrs *parentAttrs;	// attributes of the parent node of the
+  Ref parentAttrsRef;		//   last page read by its ref
   Object dests;			// named destination dictionary
+  Object names;			// names dictionary
   NameTree destNameTree;	// named destination name-tree
   NameTree embeddedFileNameTree;  // embedded file name-tree
   NameTree jsNameTree;		// Java Script name-tree
+  GBool destNameTreeRead;	// set once the corresponding name tree
+  GBool embeddedFileNameTreeRead; //   has been read
+  GBool jsNameTreeRead;
   GooString *baseURI;		// base URI for URI-type links
   Object metadata;		// metadata stream
   Object structTreeRoot;	// structure tree root dictionary
   Object outline;		// outline dictionary
   Object acroForm;		// AcroForm dictionary
+  Object optContentProps;	// Optional Content dictionary
   OCGs *optContent;		// Optional Content groups
+  GBool optContentRead;		// set once <optContent> has been read
   GBool ok;			// true if catalog is valid
+  Object pageLabels;		// page labels number tree
   PageLabelInfo *pageLabelInfo; // info about page labels
+  GBool pageLabelInfoRead;	// set once <pageLabelInfo> has been read
   PageMode pageMode;		// page mode
   PageLayout pageLayout;	// page layout
+#if MULTITHREADED
+  GooMutex mutex;		// protects the metadata stream, the pages
+				//   read so far and the entries which
+				//   are read on demand
+#endif
 
+  GBool readLinearizedFirstPage(Object *catDict);
+  GBool resolveEntry(Object *obj);
+  Dict *getPagesRoot();
+  void loadPage(int idx);
+  PageAttrs *makePageAttrs(Dict *pageDict);
+  GBool findPageInTree(Dict *pagesDict, PageAttrs *attrs, int start,
+		       int idx, int depth);
+  GBool checkPageCount(int count);
+  int readWholePageTree(GBool makePages);
   int readPageTree(Dict *pages, PageAttrs *attrs, int start,
-		   char *alreadyRead);
+		   char *alreadyRead, GBool makePages);
   Object *findDestInTree(Object *tree, GooString *name, Object *obj);
+  void readNameTree(NameTree *tree, GBool *treeRead, char *key);
+  PageLabelInfo *getPageLabelInfo();
 };
 
 #endif
@@ -335,6 +335,49 @@ int DecryptStream::lookChar() {
   return c;
 }
 
+int DecryptStream::getChars(int nChars, Guchar *buffer) {
+  Guchar in[16];
+  int n, m, i;
+
+  n = 0;
+  switch (algo) {
+  case cryptRC4:
+    if (nChars > 0 && state.rc4.buf != EOF) {
+      buffer[n++] = (Guchar)state.rc4.buf;
+      state.rc4.buf = EOF;
+    }
+    m = str->getChars(nChars - n, buffer + n);
+    for (i = 0; i < m; ++i) {
+      buffer[n + i] = rc4DecryptByte(state.rc4.state, &state.rc4.x,
+				     &state.rc4.y, buffer[n + i]);
+    }
+    n += m;
+    break;
+  case cryptAES:
+    while (n < nChars) {
+      if (state.aes.bufIdx == 16) {
+	if (str->getChars(16, in) < 16) {
+	  break;
+	}
+	aesDecryptBlock(&state.aes, in, str->lookChar() == EOF);
+	if (state.aes.bufIdx == 16) {
+	  break;
+	}
+      }
+      m = 16 - state.aes.bufIdx;
+      if (m > nChars - n) {
+	m = nChars - n;
+      }
+      memcpy(buffer + n, state.aes.buf + state.aes.bufIdx, m);
+      state.aes.bufIdx += m;
+      n += m;
+    }
+    break;
+  }
+  charactersRead += n;
+  return n;
+}
+
 GBool DecryptStream::isBinary(GBool last) {
   return str->isBinary(last);
 }
@@ -30,12 +30,36 @@
 #endif
 
 #include <stddef.h>
+#include <limits.h>
 #include <string.h>
+#include <new>
 #include "goo/gmem.h"
+#include "goo/GooArena.h"
 #include "Object.h"
 #include "XRef.h"
 #include "Dict.h"
 
+//------------------------------------------------------------------------
+
+// Dictionaries with more than this many entries get a hash index.
+#define dictHashThreshold 8
+
+struct DictHashEntry {
+  int idx;			// index in entries, or -1 if unused
+  Guint hash;			// hash of the key
+};
+
+static inline Guint dictHash(const char *key) {
+  const Guchar *p;
+  Guint h;
+
+  h = 2166136261u;
+  for (p = (const Guchar *)key; *p; ++p) {
+    h = (h ^ *p) * 16777619u;
+  }
+  return h;
+}
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
@@ -45,47 +69,169 @@ Dict::Dict(XRef *xrefA) {
   entries = NULL;
   size = length = 0;
   ref = 1;
+  arena = NULL;
+  entriesInArena = gFalse;
+  hashTab = NULL;
+  hashSize = 0;
 }
 
 Dict::Dict(Dict* dictA) {
   xref = dictA->xref;
   size = length = dictA->length;
   ref = 1;
+  arena = NULL;
+  entriesInArena = gFalse;
+  hashTab = NULL;
+  hashSize = 0;
 
   entries = (DictEntry *)gmallocn(size, sizeof(DictEntry));
   for (int i=0; i<length; i++) {
-    entries[i].key = strdup(dictA->entries[i].key);
+    entries[i].key = AtomTable::copy(dictA->entries[i].key);
     dictA->entries[i].val.copy(&entries[i].val);
   }
+  if (length > dictHashThreshold) {
+    buildHash();
+  }
+}
+
+Dict *Dict::create(XRef *xrefA, GooArena *arenaA) {
+  Dict *dict;
+  void *p;
+
+  if (!arenaA || !(p = arenaA->alloc(sizeof(Dict)))) {
+    return new Dict(xrefA);
+  }
+  dict = new(p) Dict(xrefA);
+  dict->arena = arenaA;
+  return dict;
 }
 
 Dict::~Dict() {
   int i;
 
   for (i = 0; i < length; ++i) {
-    gfree(entries[i].key);
+    AtomTable::free(entries[i].key);
     entries[i].val.free();
   }
-  gfree(entries);
+  if (!entriesInArena) {
+    gfree(entries);
+  }
+  gfree(hashTab);
+}
+
+void Dict::destroy(Dict *dict) {
+  if (dict->arena) {
+    dict->~Dict();
+  } else {
+    delete dict;
+  }
 }
 
 void Dict::add(char *key, Object *val) {
+  addAtom(AtomTable::intern(key), val);
+  gfree(key);
+}
+
+void Dict::addAtom(char *key, Object *val) {
+  DictEntry *entries1;
+
   if (length == size) {
     if (length == 0) {
       size = 8;
     } else {
       size *= 2;
     }
-    entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
+    if (arena && size <= INT_MAX / (int)sizeof(DictEntry) &&
+	(entries1 = (DictEntry *)arena->alloc(size * sizeof(DictEntry)))) {
+      if (length > 0) {
+	memcpy(entries1, entries, length * sizeof(DictEntry));
+      }
+      if (!entriesInArena) {
+	gfree(entries);
+      }
+      entries = entries1;
+      entriesInArena = gTrue;
+    } else if (entriesInArena) {
+      entries1 = (DictEntry *)gmallocn(size, sizeof(DictEntry));
+      memcpy(entries1, entries, length * sizeof(DictEntry));
+      entries = entries1;
+      entriesInArena = gFalse;
+    } else {
+      entries = (DictEntry *)greallocn(entries, size, sizeof(DictEntry));
+    }
+    if (size > dictHashThreshold) {
+      buildHash();
+    }
   }
   entries[length].key = key;
   entries[length].val = *val;
   ++length;
+  if (hashTab) {
+    addToHash(length - 1);
+  }
+}
+
+// (Re)build the hash index, with room for <size> entries.
+void Dict::buildHash() {
+  int i;
+
+  gfree(hashTab);
+  for (hashSize = 32; hashSize < 2 * size; hashSize *= 2) ;
+  hashTab = (DictHashEntry *)gmallocn(hashSize, sizeof(DictHashEntry));
+  for (i = 0; i < hashSize; ++i) {
+    hashTab[i].idx = -1;
+  }
+  for (i = 0; i < length; ++i) {
+    addToHash(i);
+  }
+}
+
+// Add entry <i> to the hash index.  If the key is already there, the
+// later entry wins, as in the linear search.
+void Dict::addToHash(int i) {
+  DictHashEntry *e;
+  Guint h;
+  int j;
+
+  h = dictHash(entries[i].key);
+  for (j = h & (hashSize - 1); ; j = (j + 1) & (hashSize - 1)) {
+    e = &hashTab[j];
+    if (e->idx < 0) {
+      break;
+    }
+    if (e->hash == h && !strcmp(entries[e->idx].key, entries[i].key)) {
+      break;
+    }
+  }
+  e->idx = i;
+  e->hash = h;
 }
 
 inline DictEntry *Dict::find(char *key) {
+  DictHashEntry *e;
+  Guint h;
   int i;
 
+  if (hashTab) {
+    h = dictHash(key);
+    for (i = h & (hashSize - 1); ; i = (i + 1) & (hashSize - 1)) {
+      e = &hashTab[i];
+      if (e->idx < 0) {
+	return NULL;
+      }
+      if (e->hash == h &&
+	  (entries[e->idx].key == key || !strcmp(entries[e->idx].key, key))) {
+	return &entries[e->idx];
+      }
+    }
+  }
+
+  // keys from the lexer are usually interned atoms, so try comparing
+  // pointers before strings
+  for (i = length - 1; i >=0; --i) {
+    if (key == entries[i].key)
+      return &entries[i];
+  }
   for (i = length - 1; i >=0; --i) {
     if (!strcmp(key, entries[i].key))
       return &entries[i];
@@ -111,6 +257,9 @@ void Dict::remove(char *key) {
   tmp = entries[length];
   if (i!=length) //don't copy the last entry if it is deleted 
     entries[i] = tmp;
+  if (hashTab) {
+    buildHash();
+  }
 }
 
 void Dict::set(char *key, Object *val) {
@@ -120,7 +269,7 @@ void Dict::set(char *key, Object *val) {
     e->val.free();
     e->val = *val;
   } else {
-    add (copyString(key), val);
+    addAtom (AtomTable::intern(key), val);
   }
 }
 
@@ -29,17 +29,26 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+class GooArena;
+
 //------------------------------------------------------------------------
 // Dict
 //------------------------------------------------------------------------
 
 struct DictEntry {
-  char *key;
+  char *key;			// atom (see AtomTable)
   Object val;
 };
 
+struct DictHashEntry;
+
 class Dict {
 public:
 
@@ -47,19 +56,40 @@ public:
   Dict(XRef *xrefA);
   Dict(Dict* dictA);
 
+  // Create a dictionary in <arena> (or on the heap, if <arena> is NULL
+  // or full).  The entries are allocated from the arena too.
+  // Dictionaries made this way must be freed with destroy(), never
+  // delete.
+  static Dict *create(XRef *xrefA, GooArena *arenaA);
+
   // Destructor.
   ~Dict();
 
+  // Free a dictionary made with new or create().
+  static void destroy(Dict *dict);
+
+  // Was this dictionary allocated from an arena?
+  GBool isInArena() { return arena != NULL; }
+
   // Reference counting.
+#if MULTITHREADED
+  int incRef() { return gAtomicIncrement(&ref); }
+  int decRef() { return gAtomicDecrement(&ref); }
+#else
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
+#endif
 
   // Get number of entries.
   int getLength() { return length; }
 
-  // Add an entry.  NB: does not copy key.
+  // Add an entry.  NB: takes ownership of key, which must have been
+  // allocated with gmalloc.
   void add(char *key, Object *val);
 
+  // Add an entry whose key is an atom.  NB: does not copy key.
+  void addAtom(char *key, Object *val);
+
   // Update the value of an existing entry, otherwise create it
   void set(char *key, Object *val);
   // Remove an entry. This invalidate indexes
@@ -90,9 +120,20 @@ private:
   DictEntry *entries;		// array of entries
   int size;			// size of <entries> array
   int length;			// number of entries in dictionary
+#if MULTITHREADED
+  GooAtomicCounter ref;		// reference count
+#else
   int ref;			// reference count
+#endif
+  GooArena *arena;		// arena holding this dict, or NULL
+  GBool entriesInArena;		// is <entries> allocated from <arena>?
+  DictHashEntry *hashTab;	// hash index of <entries>, only for
+				//   large dictionaries (else NULL)
+  int hashSize;			// number of buckets in <hashTab>
 
   DictEntry *find(char *key);
+  void buildHash();
+  void addToHash(int i);
 };
 
 #endif
@@ -0,0 +1,1621 @@
+//========================================================================
+//
+// DisplayListOutputDev.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <limits.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "goo/GooString.h"
+#include "Object.h"
+#include "Stream.h"
+#include "Function.h"
+#include "GfxFont.h"
+#include "DisplayListOutputDev.h"
+
+//------------------------------------------------------------------------
+
+enum DisplayListOpKind {
+  dlState,			// changed state fields, see below
+  dlSaveState,
+  dlRestoreState,
+  dlUpdateAll,
+  dlUpdateCTM,			// iArg = 1 if the CTM is to be concatenated
+  dlUpdateLineDash,
+  dlUpdateFlatness,
+  dlUpdateLineJoin,
+  dlUpdateLineCap,
+  dlUpdateMiterLimit,
+  dlUpdateLineWidth,
+  dlUpdateStrokeAdjust,
+  dlUpdateAlphaIsShape,
+  dlUpdateTextKnockout,
+  dlUpdateFillColorSpace,
+  dlUpdateStrokeColorSpace,
+  dlUpdateFillColor,
+  dlUpdateStrokeColor,
+  dlUpdateBlendMode,
+  dlUpdateFillOpacity,
+  dlUpdateStrokeOpacity,
+  dlUpdateFillOverprint,
+  dlUpdateStrokeOverprint,
+  dlUpdateTransfer,
+  dlUpdateFont,
+  dlUpdateTextMat,
+  dlUpdateCharSpace,
+  dlUpdateRender,
+  dlUpdateRise,
+  dlUpdateWordSpace,
+  dlUpdateHorizScaling,
+  dlUpdateTextPos,
+  dlUpdateTextShift,
+  dlStroke,
+  dlFill,
+  dlEOFill,
+  dlClip,
+  dlEOClip,
+  dlClipToStrokePath,
+  dlBeginStringOp,
+  dlEndStringOp,
+  dlBeginString,
+  dlEndString,
+  dlDrawChar,
+  dlBeginType3Char,
+  dlEndType3Char,
+  dlBeginTextObject,
+  dlEndTextObject,
+  dlDrawImageMask,
+  dlDrawImage,
+  dlDrawMaskedImage,
+  dlDrawSoftMaskedImage,
+  dlType3D0,
+  dlType3D1,
+  dlBeginTransparencyGroup,
+  dlEndTransparencyGroup,
+  dlPaintTransparencyGroup,
+  dlSetSoftMask,
+  dlClearSoftMask,
+  dlSetVectorAntialias
+};
+
+// The state fields which the output devices read from the GfxState
+// are recorded whenever they differ from the values recorded last
+// (Gfx doesn't tell the device about all of its changes, e.g., to the
+// CTM of a Type 3 char).  A dlState op has a mask of the fields it
+// sets, in <iArg>, and their values, in this order, in its numbers.
+#define dlCTM              0x0000001	// old CTM, new CTM
+#define dlFillColor        0x0000002	// nComps, comps
+#define dlStrokeColor      0x0000004	// nComps, comps
+#define dlBlendMode        0x0000008
+#define dlFillOpacity      0x0000010
+#define dlStrokeOpacity    0x0000020
+#define dlFillOverprint    0x0000040
+#define dlStrokeOverprint  0x0000080
+#define dlLineWidth        0x0000100
+#define dlLineDash         0x0000200	// length, start, dash
+#define dlFlatness         0x0000400
+#define dlLineJoin         0x0000800
+#define dlLineCap          0x0001000
+#define dlMiterLimit       0x0002000
+#define dlStrokeAdjust     0x0004000
+#define dlAlphaIsShape     0x0008000
+#define dlTextKnockout     0x0010000
+#define dlFont             0x0020000	// font size (the font is <font>)
+#define dlTextMat          0x0040000
+#define dlCharSpace        0x0080000
+#define dlWordSpace        0x0100000
+#define dlHorizScaling     0x0200000
+#define dlLeading          0x0400000
+#define dlRise             0x0800000
+#define dlRender           0x1000000
+
+struct DisplayListOp {
+  int kind;			// DisplayListOpKind
+  int iArg;			// integer argument
+  int nums;			// index of the first numeric argument
+				//   in DisplayList::nums
+  union {			// object argument (owned by the list)
+    GfxPath *path;
+    GfxColorSpace *colorSpace;
+    GfxFont *font;
+    Function *func;
+    Function **funcs;
+    GooString *s;
+    DisplayListImage *image;
+  };
+};
+
+struct DisplayListImage {
+  Object ref;			// image XObject, or null
+  int width, height;
+  GfxImageColorMap *colorMap;	// NULL for image masks
+  int *maskColors;		// NULL if none
+  GBool invert;			// for image masks
+  GBool interpolate;
+  GBool inlineImg;
+  Guchar *data;			// image data, after the stream filters
+  int dataLen;
+  int maskWidth, maskHeight;	// for (soft) masked images
+  GfxImageColorMap *maskColorMap;
+  GBool maskInvert;
+  GBool maskInterpolate;
+  Guchar *maskData;
+  int maskDataLen;
+};
+
+// Read the data of an image with <nBits> bits per pixel.  Returns
+// NULL for bogus image sizes.
+static Guchar *readImageData(Stream *str, int width, int height, int nBits,
+			     int *len) {
+  Guchar *data;
+  int rowSize;
+
+  *len = 0;
+  if (width <= 0 || height <= 0 || nBits <= 0 ||
+      width > (INT_MAX - 7) / nBits) {
+    return NULL;
+  }
+  rowSize = (width * nBits + 7) / 8;
+  if (height > INT_MAX / rowSize) {
+    return NULL;
+  }
+  data = (Guchar *)gmalloc(rowSize * height);
+  str->reset();
+  *len = str->getChars(rowSize * height, data);
+  str->close();
+  return data;
+}
+
+static void freeImage(DisplayListImage *img) {
+  img->ref.free();
+  delete img->colorMap;
+  gfree(img->maskColors);
+  gfree(img->data);
+  delete img->maskColorMap;
+  gfree(img->maskData);
+  delete img;
+}
+
+static GBool sameMatrix(double *m1, double *m2) {
+  return m1[0] == m2[0] && m1[1] == m2[1] && m1[2] == m2[2] &&
+         m1[3] == m2[3] && m1[4] == m2[4] && m1[5] == m2[5];
+}
+
+// <r> = <a> * <b>
+static void concatMatrix(double *a, double *b, double *r) {
+  r[0] = a[0] * b[0] + a[1] * b[2];
+  r[1] = a[0] * b[1] + a[1] * b[3];
+  r[2] = a[2] * b[0] + a[3] * b[2];
+  r[3] = a[2] * b[1] + a[3] * b[3];
+  r[4] = a[4] * b[0] + a[5] * b[2] + b[4];
+  r[5] = a[4] * b[1] + a[5] * b[3] + b[5];
+}
+
+static GBool invertMatrix(double *m, double *r) {
+  double det;
+
+  det = m[0] * m[3] - m[1] * m[2];
+  if (det == 0) {
+    return gFalse;
+  }
+  det = 1 / det;
+  r[0] = m[3] * det;
+  r[1] = -m[1] * det;
+  r[2] = -m[2] * det;
+  r[3] = m[0] * det;
+  r[4] = (m[2] * m[5] - m[3] * m[4]) * det;
+  r[5] = (m[1] * m[4] - m[0] * m[5]) * det;
+  return gTrue;
+}
+
+// If the default CTMs <m1> and <m2> only differ in the resolution,
+// set <t> to the scaling (and translation) which maps <m1> to <m2>.
+// This is more accurate than going through the inverse of <m1>, so
+// that glyphs and lines which are exactly on a pixel boundary stay
+// there.
+static GBool getScaling(double *m1, double *m2, double *t) {
+  if (m1[1] == 0 && m1[2] == 0 && m2[1] == 0 && m2[2] == 0 &&
+      m1[0] != 0 && m1[3] != 0) {
+    t[0] = m2[0] / m1[0];
+    t[3] = m2[3] / m1[3];
+  } else if (m1[0] == 0 && m1[3] == 0 && m2[0] == 0 && m2[3] == 0 &&
+	     m1[1] != 0 && m1[2] != 0) {
+    t[0] = m2[2] / m1[2];
+    t[3] = m2[1] / m1[1];
+  } else {
+    return gFalse;
+  }
+  t[1] = t[2] = 0;
+  t[4] = m2[4] - m1[4] * t[0];
+  t[5] = m2[5] - m1[5] * t[3];
+  return gTrue;
+}
+
+static GBool sameColor(GfxColor *c1, GfxColor *c2, int nComps) {
+  int i;
+
+  for (i = 0; i < nComps; ++i) {
+    if (c1->c[i] != c2->c[i]) {
+      return gFalse;
+    }
+  }
+  return gTrue;
+}
+
+// Number of color components recorded for a color in <colorSpace>.
+static int getNumColorComps(GfxColorSpace *colorSpace) {
+  int n;
+
+  n = colorSpace->getNComps();
+  return n > gfxColorMaxComps ? gfxColorMaxComps : n < 0 ? 0 : n;
+}
+
+//------------------------------------------------------------------------
+// DisplayList
+//------------------------------------------------------------------------
+
+DisplayList::DisplayList(int pageNumA, GfxState *state) {
+  int i;
+
+  pageNum = pageNumA;
+  box.x1 = state->getX1();
+  box.y1 = state->getY1();
+  box.x2 = state->getX2();
+  box.y2 = state->getY2();
+  rotate = state->getRotate();
+  for (i = 0; i < 6; ++i) {
+    baseCTM[i] = state->getCTM()[i];
+  }
+  ops = NULL;
+  opsLen = opsSize = 0;
+  nums = NULL;
+  numsLen = numsSize = 0;
+  size = sizeof(DisplayList);
+}
+
+DisplayList::~DisplayList() {
+  DisplayListOp *op;
+  int i;
+
+  for (i = 0; i < opsLen; ++i) {
+    op = &ops[i];
+    switch (op->kind) {
+    case dlState:
+      if ((op->iArg & dlFont) && op->font) {
+	op->font->decRefCnt();
+      }
+      break;
+    case dlStroke:
+    case dlFill:
+    case dlEOFill:
+    case dlClip:
+    case dlEOClip:
+    case dlClipToStrokePath:
+      delete op->path;
+      break;
+    case dlUpdateFillColorSpace:
+    case dlUpdateStrokeColorSpace:
+    case dlBeginTransparencyGroup:
+      delete op->colorSpace;
+      break;
+    case dlUpdateTransfer:
+      delete op->funcs[0];
+      delete op->funcs[1];
+      delete op->funcs[2];
+      delete op->funcs[3];
+      gfree(op->funcs);
+      break;
+    case dlSetSoftMask:
+      delete op->func;
+      break;
+    case dlBeginString:
+      delete op->s;
+      break;
+    case dlDrawImageMask:
+    case dlDrawImage:
+    case dlDrawMaskedImage:
+    case dlDrawSoftMaskedImage:
+      freeImage(op->image);
+      break;
+    }
+  }
+  gfree(ops);
+  gfree(nums);
+}
+
+DisplayListOp *DisplayList::addOp(int kind) {
+  DisplayListOp *op;
+
+  if (opsLen == opsSize) {
+    opsSize = opsSize ? 2 * opsSize : 256;
+    ops = (DisplayListOp *)greallocn(ops, opsSize, sizeof(DisplayListOp));
+  }
+  op = &ops[opsLen++];
+  op->kind = kind;
+  op->iArg = 0;
+  op->nums = numsLen;
+  op->path = NULL;
+  size += sizeof(DisplayListOp);
+  return op;
+}
+
+// Add a numeric argument to the last op.
+void DisplayList::addNum(double x) {
+  if (numsLen == numsSize) {
+    numsSize = numsSize ? 2 * numsSize : 1024;
+    nums = (double *)greallocn(nums, numsSize, sizeof(double));
+  }
+  nums[numsLen++] = x;
+  size += sizeof(double);
+}
+
+void DisplayList::addNums(double *x, int n) {
+  int i;
+
+  for (i = 0; i < n; ++i) {
+    addNum(x[i]);
+  }
+}
+
+// Map a CTM of the recording to the replay, with <t> = inverse(base
+// CTM of the recording) * base CTM of the replay.
+static void mapCTM(double *ctm, double *t, GBool identity, double *r) {
+  int i;
+
+  if (identity) {
+    for (i = 0; i < 6; ++i) {
+      r[i] = ctm[i];
+    }
+  } else {
+    concatMatrix(ctm, t, r);
+  }
+}
+
+static Unicode *getUnicode(double *x, int uLen, Unicode **buf, int *bufSize) {
+  int i;
+
+  if (uLen == 0) {
+    return NULL;
+  }
+  if (uLen > *bufSize) {
+    *bufSize = uLen;
+    *buf = (Unicode *)greallocn(*buf, *bufSize, sizeof(Unicode));
+  }
+  for (i = 0; i < uLen; ++i) {
+    (*buf)[i] = (Unicode)x[i];
+  }
+  return *buf;
+}
+
+void DisplayList::applyState(GfxState *state, DisplayListOp *op,
+			     double *t, GBool identity) {
+  GfxColor color;
+  double m0[6], m1[6], im0[6], adj[6], ctm[6];
+  double *x, *dash;
+  int mask, n, i;
+
+  mask = op->iArg;
+  x = nums + op->nums;
+  if (mask & dlCTM) {
+    // the device may have changed the CTM itself (e.g., to draw into
+    // a transparency group's bitmap) -- keep that change
+    mapCTM(x, t, identity, m0);
+    mapCTM(x + 6, t, identity, m1);
+    if (sameMatrix(state->getCTM(), m0) || !invertMatrix(m0, im0)) {
+      state->setCTM(m1[0], m1[1], m1[2], m1[3], m1[4], m1[5]);
+    } else {
+      concatMatrix(im0, state->getCTM(), adj);
+      concatMatrix(m1, adj, ctm);
+      state->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]);
+    }
+    x += 12;
+  }
+  if (mask & dlFillColor) {
+    color = *state->getFillColor();
+    n = (int)*x++;
+    for (i = 0; i < n; ++i) {
+      color.c[i] = (GfxColorComp)*x++;
+    }
+    state->setFillColor(&color);
+  }
+  if (mask & dlStrokeColor) {
+    color = *state->getStrokeColor();
+    n = (int)*x++;
+    for (i = 0; i < n; ++i) {
+      color.c[i] = (GfxColorComp)*x++;
+    }
+    state->setStrokeColor(&color);
+  }
+  if (mask & dlBlendMode) {
+    state->setBlendMode((GfxBlendMode)(int)*x++);
+  }
+  if (mask & dlFillOpacity) {
+    state->setFillOpacity(*x++);
+  }
+  if (mask & dlStrokeOpacity) {
+    state->setStrokeOpacity(*x++);
+  }
+  if (mask & dlFillOverprint) {
+    state->setFillOverprint((GBool)*x++);
+  }
+  if (mask & dlStrokeOverprint) {
+    state->setStrokeOverprint((GBool)*x++);
+  }
+  if (mask & dlLineWidth) {
+    state->setLineWidth(*x++);
+  }
+  if (mask & dlLineDash) {
+    n = (int)x[0];
+    dash = n > 0 ? (double *)gmallocn(n, sizeof(double)) : (double *)NULL;
+    for (i = 0; i < n; ++i) {
+      dash[i] = x[2 + i];
+    }
+    state->setLineDash(dash, n, x[1]);
+    x += 2 + n;
+  }
+  if (mask & dlFlatness) {
+    state->setFlatness((int)*x++);
+  }
+  if (mask & dlLineJoin) {
+    state->setLineJoin((int)*x++);
+  }
+  if (mask & dlLineCap) {
+    state->setLineCap((int)*x++);
+  }
+  if (mask & dlMiterLimit) {
+    state->setMiterLimit(*x++);
+  }
+  if (mask & dlStrokeAdjust) {
+    state->setStrokeAdjust((GBool)*x++);
+  }
+  if (mask & dlAlphaIsShape) {
+    state->setAlphaIsShape((GBool)*x++);
+  }
+  if (mask & dlTextKnockout) {
+    state->setTextKnockout((GBool)*x++);
+  }
+  if (mask & dlFont) {
+    if (op->font) {
+      op->font->incRefCnt();
+    }
+    state->setFont(op->font, *x++);
+  }
+  if (mask & dlTextMat) {
+    state->setTextMat(x[0], x[1], x[2], x[3], x[4], x[5]);
+    x += 6;
+  }
+  if (mask & dlCharSpace) {
+    state->setCharSpace(*x++);
+  }
+  if (mask & dlWordSpace) {
+    state->setWordSpace(*x++);
+  }
+  if (mask & dlHorizScaling) {
+    state->setHorizScaling(*x++ * 100);
+  }
+  if (mask & dlLeading) {
+    state->setLeading(*x++);
+  }
+  if (mask & dlRise) {
+    state->setRise(*x++);
+  }
+  if (mask & dlRender) {
+    state->setRender((int)*x++);
+  }
+}
+
+void DisplayList::replay(OutputDev *out, double hDPI, double vDPI) {
+  GfxState *state;
+  DisplayListOp *op;
+  DisplayListImage *img;
+  MemStream *str, *maskStr;
+  Function *funcs[4];
+  GfxColor color;
+  Object obj;
+  Unicode *uBuf, *u;
+  double t[6], ibase[6];
+  double *x;
+  GBool identity, vaa;
+  int uBufSize, depth, i, j;
+
+  state = new GfxState(hDPI, vDPI, &box, rotate, out->upsideDown());
+  t[0] = t[3] = 1;
+  t[1] = t[2] = t[4] = t[5] = 0;
+  identity = sameMatrix(baseCTM, state->getCTM());
+  if (!identity && !getScaling(baseCTM, state->getCTM(), t)) {
+    if (!invertMatrix(baseCTM, ibase)) {
+      delete state;
+      return;
+    }
+    concatMatrix(ibase, state->getCTM(), t);
+  }
+  uBuf = NULL;
+  uBufSize = 0;
+  vaa = gFalse;
+
+  out->startPage(pageNum, state);
+  out->setDefaultCTM(state->getCTM());
+
+  for (i = 0; i < opsLen; ++i) {
+    op = &ops[i];
+    x = nums + op->nums;
+    switch (op->kind) {
+    case dlState:
+      applyState(state, op, t, identity);
+      break;
+    case dlSaveState:
+      out->saveState(state);
+      state = state->save();
+      break;
+    case dlRestoreState:
+      if (state->hasSaves()) {
+	state = state->restore();
+	out->restoreState(state);
+      }
+      break;
+    case dlUpdateAll:
+      out->updateAll(state);
+      break;
+    case dlUpdateCTM:
+      if (op->iArg) {
+	state->concatCTM(x[0], x[1], x[2], x[3], x[4], x[5]);
+      }
+      out->updateCTM(state, x[0], x[1], x[2], x[3], x[4], x[5]);
+      break;
+    case dlUpdateLineDash:
+      out->updateLineDash(state);
+      break;
+    case dlUpdateFlatness:
+      out->updateFlatness(state);
+      break;
+    case dlUpdateLineJoin:
+      out->updateLineJoin(state);
+      break;
+    case dlUpdateLineCap:
+      out->updateLineCap(state);
+      break;
+    case dlUpdateMiterLimit:
+      out->updateMiterLimit(state);
+      break;
+    case dlUpdateLineWidth:
+      out->updateLineWidth(state);
+      break;
+    case dlUpdateStrokeAdjust:
+      out->updateStrokeAdjust(state);
+      break;
+    case dlUpdateAlphaIsShape:
+      out->updateAlphaIsShape(state);
+      break;
+    case dlUpdateTextKnockout:
+      out->updateTextKnockout(state);
+      break;
+    case dlUpdateFillColorSpace:
+      state->setFillColorSpace(op->colorSpace->copy());
+      out->updateFillColorSpace(state);
+      break;
+    case dlUpdateStrokeColorSpace:
+      state->setStrokeColorSpace(op->colorSpace->copy());
+      out->updateStrokeColorSpace(state);
+      break;
+    case dlUpdateFillColor:
+      out->updateFillColor(state);
+      break;
+    case dlUpdateStrokeColor:
+      out->updateStrokeColor(state);
+      break;
+    case dlUpdateBlendMode:
+      out->updateBlendMode(state);
+      break;
+    case dlUpdateFillOpacity:
+      out->updateFillOpacity(state);
+      break;
+    case dlUpdateStrokeOpacity:
+      out->updateStrokeOpacity(state);
+      break;
+    case dlUpdateFillOverprint:
+      out->updateFillOverprint(state);
+      break;
+    case dlUpdateStrokeOverprint:
+      out->updateStrokeOverprint(state);
+      break;
+    case dlUpdateTransfer:
+      for (j = 0; j < 4; ++j) {
+	funcs[j] = op->funcs[j] ? op->funcs[j]->copy() : (Function *)NULL;
+      }
+      state->setTransfer(funcs);
+      out->updateTransfer(state);
+      break;
+    case dlUpdateFont:
+      out->updateFont(state);
+      break;
+    case dlUpdateTextMat:
+      out->updateTextMat(state);
+      break;
+    case dlUpdateCharSpace:
+      out->updateCharSpace(state);
+      break;
+    case dlUpdateRender:
+      out->updateRender(state);
+      break;
+    case dlUpdateRise:
+      out->updateRise(state);
+      break;
+    case dlUpdateWordSpace:
+      out->updateWordSpace(state);
+      break;
+    case dlUpdateHorizScaling:
+      out->updateHorizScaling(state);
+      break;
+    case dlUpdateTextPos:
+      out->updateTextPos(state);
+      break;
+    case dlUpdateTextShift:
+      out->updateTextShift(state, x[0]);
+      break;
+    case dlStroke:
+      state->setPath(op->path->copy());
+      out->stroke(state);
+      state->clearPath();
+      break;
+    case dlFill:
+      state->setPath(op->path->copy());
+      out->fill(state);
+      state->clearPath();
+      break;
+    case dlEOFill:
+      state->setPath(op->path->copy());
+      out->eoFill(state);
+      state->clearPath();
+      break;
+    case dlClip:
+      state->setPath(op->path->copy());
+      state->clip();
+      out->clip(state);
+      state->clearPath();
+      break;
+    case dlEOClip:
+      state->setPath(op->path->copy());
+      state->clip();
+      out->eoClip(state);
+      state->clearPath();
+      break;
+    case dlClipToStrokePath:
+      state->setPath(op->path->copy());
+      state->clipToStrokePath();
+      out->clipToStrokePath(state);
+      state->clearPath();
+      break;
+    case dlBeginStringOp:
+      out->beginStringOp(state);
+      break;
+    case dlEndStringOp:
+      out->endStringOp(state);
+      break;
+    case dlBeginString:
+      out->beginString(state, op->s);
+      break;
+    case dlEndString:
+      out->endString(state);
+      break;
+    case dlDrawChar:
+      u = getUnicode(x + 8, (int)x[7], &uBuf, &uBufSize);
+      out->drawChar(state, x[0], x[1], x[2], x[3], x[4], x[5],
+		    (CharCode)x[6], op->iArg, u, (int)x[7]);
+      break;
+    case dlBeginType3Char:
+      u = getUnicode(x + 6, (int)x[5], &uBuf, &uBufSize);
+      if (out->beginType3Char(state, x[0], x[1], x[2], x[3],
+			      (CharCode)x[4], u, (int)x[5])) {
+	// the device has drawn the char (from its cache) -- skip the
+	// char procedure, as Gfx would
+	depth = 1;
+	while (depth > 0 && i + 1 < opsLen) {
+	  ++i;
+	  if (ops[i].kind == dlBeginType3Char) {
+	    ++depth;
+	  } else if (ops[i].kind == dlEndType3Char) {
+	    --depth;
+	  }
+	}
+      }
+      break;
+    case dlEndType3Char:
+      out->endType3Char(state);
+      break;
+    case dlBeginTextObject:
+      out->beginTextObject(state);
+      break;
+    case dlEndTextObject:
+      out->endTextObject(state);
+      break;
+    case dlDrawImageMask:
+    case dlDrawImage:
+    case dlDrawMaskedImage:
+    case dlDrawSoftMaskedImage:
+      img = op->image;
+      obj.initNull();
+      str = new MemStream((char *)img->data, 0, img->dataLen, &obj);
+      maskStr = NULL;
+      if (img->maskData) {
+	obj.initNull();
+	maskStr = new MemStream((char *)img->maskData, 0, img->maskDataLen,
+				&obj);
+      }
+      if (op->kind == dlDrawImageMask) {
+	out->drawImageMask(state, img->ref.isNull() ? NULL : &img->ref, str,
+			   img->width, img->height, img->invert,
+			   img->interpolate, img->inlineImg);
+      } else if (op->kind == dlDrawImage) {
+	out->drawImage(state, img->ref.isNull() ? NULL : &img->ref, str,
+		       img->width, img->height, img->colorMap,
+		       img->interpolate, img->maskColors, img->inlineImg);
+      } else if (op->kind == dlDrawMaskedImage) {
+	out->drawMaskedImage(state, img->ref.isNull() ? NULL : &img->ref, str,
+			     img->width, img->height, img->colorMap,
+			     img->interpolate, maskStr,
+			     img->maskWidth, img->maskHeight,
+			     img->maskInvert, img->maskInterpolate);
+      } else {
+	out->drawSoftMaskedImage(state, img->ref.isNull() ? NULL : &img->ref,
+				 str, img->width, img->height, img->colorMap,
+				 img->interpolate, maskStr,
+				 img->maskWidth, img->maskHeight,
+				 img->maskColorMap, img->maskInterpolate);
+      }
+      delete maskStr;
+      delete str;
+      break;
+    case dlType3D0:
+      out->type3D0(state, x[0], x[1]);
+      break;
+    case dlType3D1:
+      out->type3D1(state, x[0], x[1], x[2], x[3], x[4], x[5]);
+      break;
+    case dlBeginTransparencyGroup:
+      out->beginTransparencyGroup(state, x, op->colorSpace,
+				  (op->iArg & 1) ? gTrue : gFalse,
+				  (op->iArg & 2) ? gTrue : gFalse,
+				  (op->iArg & 4) ? gTrue : gFalse);
+      break;
+    case dlEndTransparencyGroup:
+      out->endTransparencyGroup(state);
+      break;
+    case dlPaintTransparencyGroup:
+      out->paintTransparencyGroup(state, x);
+      break;
+    case dlSetSoftMask:
+      for (j = 0; j < gfxColorMaxComps; ++j) {
+	color.c[j] = (GfxColorComp)x[4 + j];
+      }
+      out->setSoftMask(state, x, op->iArg, op->func, &color);
+      break;
+    case dlClearSoftMask:
+      out->clearSoftMask(state);
+      break;
+    case dlSetVectorAntialias:
+      // Gfx turns anti-aliasing off and back on around shaded fills,
+      // if the device anti-aliases
+      if (!op->iArg) {
+	if ((vaa = out->getVectorAntialias())) {
+	  out->setVectorAntialias(gFalse);
+	}
+      } else if (vaa) {
+	out->setVectorAntialias(gTrue);
+      }
+      break;
+    }
+  }
+
+  while (state->hasSaves()) {
+    state = state->restore();
+    out->restoreState(state);
+  }
+  out->endPage();
+
+  delete state;
+  gfree(uBuf);
+}
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+DisplayListOutputDev::DisplayListOutputDev() {
+  list = NULL;
+  shadow = NULL;
+}
+
+DisplayListOutputDev::~DisplayListOutputDev() {
+  delete list;
+  if (shadow) {
+    while (shadow->hasSaves()) {
+      shadow = shadow->restore();
+    }
+    delete shadow;
+  }
+}
+
+DisplayList *DisplayListOutputDev::takeDisplayList() {
+  DisplayList *l;
+
+  l = list;
+  list = NULL;
+  return l;
+}
+
+void DisplayListOutputDev::startPage(int pageNum, GfxState *state) {
+  delete list;
+  if (shadow) {
+    while (shadow->hasSaves()) {
+      shadow = shadow->restore();
+    }
+    delete shadow;
+  }
+  list = new DisplayList(pageNum, state);
+  // <state> is the default state for the page (GfxState::copy() can't
+  // be used here, it shares the path with the original)
+  shadow = new GfxState(state->getHDPI(), state->getVDPI(), &list->box,
+			list->rotate, upsideDown());
+}
+
+void DisplayListOutputDev::endPage() {
+  if (shadow) {
+    while (shadow->hasSaves()) {
+      shadow = shadow->restore();
+    }
+    delete shadow;
+    shadow = NULL;
+  }
+}
+
+// Record the state fields which have changed since the last call.
+void DisplayListOutputDev::sync(GfxState *state) {
+  DisplayListOp *op;
+  GfxFont *font;
+  double *ctm, *dash1, *dash2;
+  double start1, start2;
+  int mask, len1, len2, nFill, nStroke, i;
+
+  mask = 0;
+  if (!sameMatrix(state->getCTM(), shadow->getCTM())) {
+    mask |= dlCTM;
+  }
+  nFill = getNumColorComps(state->getFillColorSpace());
+  if (!sameColor(state->getFillColor(), shadow->getFillColor(), nFill)) {
+    mask |= dlFillColor;
+  }
+  nStroke = getNumColorComps(state->getStrokeColorSpace());
+  if (!sameColor(state->getStrokeColor(), shadow->getStrokeColor(),
+		 nStroke)) {
+    mask |= dlStrokeColor;
+  }
+  if (state->getBlendMode() != shadow->getBlendMode()) {
+    mask |= dlBlendMode;
+  }
+  if (state->getFillOpacity() != shadow->getFillOpacity()) {
+    mask |= dlFillOpacity;
+  }
+  if (state->getStrokeOpacity() != shadow->getStrokeOpacity()) {
+    mask |= dlStrokeOpacity;
+  }
+  if (state->getFillOverprint() != shadow->getFillOverprint()) {
+    mask |= dlFillOverprint;
+  }
+  if (state->getStrokeOverprint() != shadow->getStrokeOverprint()) {
+    mask |= dlStrokeOverprint;
+  }
+  if (state->getLineWidth() != shadow->getLineWidth()) {
+    mask |= dlLineWidth;
+  }
+  state->getLineDash(&dash1, &len1, &start1);
+  shadow->getLineDash(&dash2, &len2, &start2);
+  if (len1 != len2 || start1 != start2 ||
+      (len1 > 0 && memcmp(dash1, dash2, len1 * sizeof(double)))) {
+    mask |= dlLineDash;
+  }
+  if (state->getFlatness() != shadow->getFlatness()) {
+    mask |= dlFlatness;
+  }
+  if (state->getLineJoin() != shadow->getLineJoin()) {
+    mask |= dlLineJoin;
+  }
+  if (state->getLineCap() != shadow->getLineCap()) {
+    mask |= dlLineCap;
+  }
+  if (state->getMiterLimit() != shadow->getMiterLimit()) {
+    mask |= dlMiterLimit;
+  }
+  if (state->getStrokeAdjust() != shadow->getStrokeAdjust()) {
+    mask |= dlStrokeAdjust;
+  }
+  if (state->getAlphaIsShape() != shadow->getAlphaIsShape()) {
+    mask |= dlAlphaIsShape;
+  }
+  if (state->getTextKnockout() != shadow->getTextKnockout()) {
+    mask |= dlTextKnockout;
+  }
+  if (state->getFont() != shadow->getFont() ||
+      state->getFontSize() != shadow->getFontSize()) {
+    mask |= dlFont;
+  }
+  if (!sameMatrix(state->getTextMat(), shadow->getTextMat())) {
+    mask |= dlTextMat;
+  }
+  if (state->getCharSpace() != shadow->getCharSpace()) {
+    mask |= dlCharSpace;
+  }
+  if (state->getWordSpace() != shadow->getWordSpace()) {
+    mask |= dlWordSpace;
+  }
+  if (state->getHorizScaling() != shadow->getHorizScaling()) {
+    mask |= dlHorizScaling;
+  }
+  if (state->getLeading() != shadow->getLeading()) {
+    mask |= dlLeading;
+  }
+  if (state->getRise() != shadow->getRise()) {
+    mask |= dlRise;
+  }
+  if (state->getRender() != shadow->getRender()) {
+    mask |= dlRender;
+  }
+  if (!mask) {
+    return;
+  }
+
+  op = list->addOp(dlState);
+  op->iArg = mask;
+  if (mask & dlCTM) {
+    list->addNums(shadow->getCTM(), 6);
+    ctm = state->getCTM();
+    list->addNums(ctm, 6);
+    shadow->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]);
+  }
+  if (mask & dlFillColor) {
+    addColor(state->getFillColor(), nFill);
+    shadow->setFillColor(state->getFillColor());
+  }
+  if (mask & dlStrokeColor) {
+    addColor(state->getStrokeColor(), nStroke);
+    shadow->setStrokeColor(state->getStrokeColor());
+  }
+  if (mask & dlBlendMode) {
+    list->addNum(state->getBlendMode());
+    shadow->setBlendMode(state->getBlendMode());
+  }
+  if (mask & dlFillOpacity) {
+    list->addNum(state->getFillOpacity());
+    shadow->setFillOpacity(state->getFillOpacity());
+  }
+  if (mask & dlStrokeOpacity) {
+    list->addNum(state->getStrokeOpacity());
+    shadow->setStrokeOpacity(state->getStrokeOpacity());
+  }
+  if (mask & dlFillOverprint) {
+    list->addNum(state->getFillOverprint());
+    shadow->setFillOverprint(state->getFillOverprint());
+  }
+  if (mask & dlStrokeOverprint) {
+    list->addNum(state->getStrokeOverprint());
+    shadow->setStrokeOverprint(state->getStrokeOverprint());
+  }
+  if (mask & dlLineWidth) {
+    list->addNum(state->getLineWidth());
+    shadow->setLineWidth(state->getLineWidth());
+  }
+  if (mask & dlLineDash) {
+    list->addNum(len1);
+    list->addNum(start1);
+    list->addNums(dash1, len1);
+    dash2 = len1 > 0 ? (double *)gmallocn(len1, sizeof(double))
+                     : (double *)NULL;
+    for (i = 0; i < len1; ++i) {
+      dash2[i] = dash1[i];
+    }
+    shadow->setLineDash(dash2, len1, start1);
+  }
+  if (mask & dlFlatness) {
+    list->addNum(state->getFlatness());
+    shadow->setFlatness(state->getFlatness());
+  }
+  if (mask & dlLineJoin) {
+    list->addNum(state->getLineJoin());
+    shadow->setLineJoin(state->getLineJoin());
+  }
+  if (mask & dlLineCap) {
+    list->addNum(state->getLineCap());
+    shadow->setLineCap(state->getLineCap());
+  }
+  if (mask & dlMiterLimit) {
+    list->addNum(state->getMiterLimit());
+    shadow->setMiterLimit(state->getMiterLimit());
+  }
+  if (mask & dlStrokeAdjust) {
+    list->addNum(state->getStrokeAdjust());
+    shadow->setStrokeAdjust(state->getStrokeAdjust());
+  }
+  if (mask & dlAlphaIsShape) {
+    list->addNum(state->getAlphaIsShape());
+    shadow->setAlphaIsShape(state->getAlphaIsShape());
+  }
+  if (mask & dlTextKnockout) {
+    list->addNum(state->getTextKnockout());
+    shadow->setTextKnockout(state->getTextKnockout());
+  }
+  if (mask & dlFont) {
+    // one reference for the op, one for the shadow state
+    if ((font = state->getFont())) {
+      font->incRefCnt();
+      font->incRefCnt();
+    }
+    op->font = font;
+    list->addNum(state->getFontSize());
+    shadow->setFont(font, state->getFontSize());
+  }
+  if (mask & dlTextMat) {
+    list->addNums(state->getTextMat(), 6);
+    ctm = state->getTextMat();
+    shadow->setTextMat(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]);
+  }
+  if (mask & dlCharSpace) {
+    list->addNum(state->getCharSpace());
+    shadow->setCharSpace(state->getCharSpace());
+  }
+  if (mask & dlWordSpace) {
+    list->addNum(state->getWordSpace());
+    shadow->setWordSpace(state->getWordSpace());
+  }
+  if (mask & dlHorizScaling) {
+    list->addNum(state->getHorizScaling());
+    shadow->setHorizScaling(state->getHorizScaling() * 100);
+  }
+  if (mask & dlLeading) {
+    list->addNum(state->getLeading());
+    shadow->setLeading(state->getLeading());
+  }
+  if (mask & dlRise) {
+    list->addNum(state->getRise());
+    shadow->setRise(state->getRise());
+  }
+  if (mask & dlRender) {
+    list->addNum(state->getRender());
+    shadow->setRender(state->getRender());
+  }
+}
+
+void DisplayListOutputDev::addColor(GfxColor *color, int nComps) {
+  int i;
+
+  list->addNum(nComps);
+  for (i = 0; i < nComps; ++i) {
+    list->addNum(color->c[i]);
+  }
+}
+
+// Add an op, after recording the state changes which precede it.
+// Returns NULL if there is no page.
+DisplayListOp *DisplayListOutputDev::addOp(GfxState *state, int kind) {
+  if (!list || !shadow) {
+    return NULL;
+  }
+  sync(state);
+  return list->addOp(kind);
+}
+
+void DisplayListOutputDev::addPathOp(GfxState *state, int kind) {
+  DisplayListOp *op;
+
+  if ((op = addOp(state, kind))) {
+    op->path = state->getPath()->copy();
+  }
+}
+
+void DisplayListOutputDev::addCharArgs(double x, double y,
+				       double dx, double dy,
+				       CharCode code, Unicode *u, int uLen) {
+  int i;
+
+  list->addNum(x);
+  list->addNum(y);
+  list->addNum(dx);
+  list->addNum(dy);
+  list->addNum(code);
+  list->addNum(u ? uLen : 0);
+  if (u) {
+    for (i = 0; i < uLen; ++i) {
+      list->addNum(u[i]);
+    }
+  }
+}
+
+void DisplayListOutputDev::saveState(GfxState *state) {
+  if (addOp(state, dlSaveState)) {
+    shadow = shadow->save();
+  }
+}
+
+void DisplayListOutputDev::restoreState(GfxState *state) {
+  // Gfx has already popped its state, so the changes can't be
+  // recorded until the shadow state is popped, too
+  if (list && shadow && shadow->hasSaves()) {
+    list->addOp(dlRestoreState);
+    shadow = shadow->restore();
+  }
+}
+
+void DisplayListOutputDev::updateAll(GfxState *state) {
+  addOp(state, dlUpdateAll);
+}
+
+void DisplayListOutputDev::updateCTM(GfxState *state, double m11, double m12,
+				     double m21, double m22,
+				     double m31, double m32) {
+  DisplayListOp *op;
+  double ctm[6];
+  GBool concat;
+  int i;
+
+  // if Gfx got the new CTM by concatenating <m> (the usual case),
+  // record that, so the replay computes the CTM the way Gfx does
+  // rather than scaling the CTM of the recording -- that is off by a
+  // rounding error, which can move the edges of lines and glyphs
+  // that are exactly on a pixel boundary
+  concat = gFalse;
+  if (list && shadow) {
+    for (i = 0; i < 6; ++i) {
+      ctm[i] = shadow->getCTM()[i];
+    }
+    shadow->concatCTM(m11, m12, m21, m22, m31, m32);
+    if (sameMatrix(state->getCTM(), shadow->getCTM())) {
+      concat = gTrue;
+    } else {
+      shadow->setCTM(ctm[0], ctm[1], ctm[2], ctm[3], ctm[4], ctm[5]);
+    }
+  }
+  if ((op = addOp(state, dlUpdateCTM))) {
+    op->iArg = concat;
+    list->addNum(m11);
+    list->addNum(m12);
+    list->addNum(m21);
+    list->addNum(m22);
+    list->addNum(m31);
+    list->addNum(m32);
+  }
+}
+
+void DisplayListOutputDev::updateLineDash(GfxState *state) {
+  addOp(state, dlUpdateLineDash);
+}
+
+void DisplayListOutputDev::updateFlatness(GfxState *state) {
+  addOp(state, dlUpdateFlatness);
+}
+
+void DisplayListOutputDev::updateLineJoin(GfxState *state) {
+  addOp(state, dlUpdateLineJoin);
+}
+
+void DisplayListOutputDev::updateLineCap(GfxState *state) {
+  addOp(state, dlUpdateLineCap);
+}
+
+void DisplayListOutputDev::updateMiterLimit(GfxState *state) {
+  addOp(state, dlUpdateMiterLimit);
+}
+
+void DisplayListOutputDev::updateLineWidth(GfxState *state) {
+  addOp(state, dlUpdateLineWidth);
+}
+
+void DisplayListOutputDev::updateStrokeAdjust(GfxState *state) {
+  addOp(state, dlUpdateStrokeAdjust);
+}
+
+void DisplayListOutputDev::updateAlphaIsShape(GfxState *state) {
+  addOp(state, dlUpdateAlphaIsShape);
+}
+
+void DisplayListOutputDev::updateTextKnockout(GfxState *state) {
+  addOp(state, dlUpdateTextKnockout);
+}
+
+void DisplayListOutputDev::updateFillColorSpace(GfxState *state) {
+  DisplayListOp *op;
+
+  if ((op = addOp(state, dlUpdateFillColorSpace))) {
+    op->colorSpace = state->getFillColorSpace()->copy();
+  }
+}
+
+void DisplayListOutputDev::updateStrokeColorSpace(GfxState *state) {
+  DisplayListOp *op;
+
+  if ((op = addOp(state, dlUpdateStrokeColorSpace))) {
+    op->colorSpace = state->getStrokeColorSpace()->copy();
+  }
+}
+
+void DisplayListOutputDev::updateFillColor(GfxState *state) {
+  addOp(state, dlUpdateFillColor);
+}
+
+void DisplayListOutputDev::updateStrokeColor(GfxState *state) {
+  addOp(state, dlUpdateStrokeColor);
+}
+
+void DisplayListOutputDev::updateBlendMode(GfxState *state) {
+  addOp(state, dlUpdateBlendMode);
+}
+
+void DisplayListOutputDev::updateFillOpacity(GfxState *state) {
+  addOp(state, dlUpdateFillOpacity);
+}
+
+void DisplayListOutputDev::updateStrokeOpacity(GfxState *state) {
+  addOp(state, dlUpdateStrokeOpacity);
+}
+
+void DisplayListOutputDev::updateFillOverprint(GfxState *state) {
+  addOp(state, dlUpdateFillOverprint);
+}
+
+void DisplayListOutputDev::updateStrokeOverprint(GfxState *state) {
+  addOp(state, dlUpdateStrokeOverprint);
+}
+
+void DisplayListOutputDev::updateTransfer(GfxState *state) {
+  DisplayListOp *op;
+  Function **transfer;
+  int i;
+
+  if ((op = addOp(state, dlUpdateTransfer))) {
+    transfer = state->getTransfer();
+    op->funcs = (Function **)gmallocn(4, sizeof(Function *));
+    for (i = 0; i < 4; ++i) {
+      op->funcs[i] = transfer[i] ? transfer[i]->copy() : (Function *)NULL;
+    }
+  }
+}
+
+void DisplayListOutputDev::updateFont(GfxState *state) {
+  addOp(state, dlUpdateFont);
+}
+
+void DisplayListOutputDev::updateTextMat(GfxState *state) {
+  addOp(state, dlUpdateTextMat);
+}
+
+void DisplayListOutputDev::updateCharSpace(GfxState *state) {
+  addOp(state, dlUpdateCharSpace);
+}
+
+void DisplayListOutputDev::updateRender(GfxState *state) {
+  addOp(state, dlUpdateRender);
+}
+
+void DisplayListOutputDev::updateRise(GfxState *state) {
+  addOp(state, dlUpdateRise);
+}
+
+void DisplayListOutputDev::updateWordSpace(GfxState *state) {
+  addOp(state, dlUpdateWordSpace);
+}
+
+void DisplayListOutputDev::updateHorizScaling(GfxState *state) {
+  addOp(state, dlUpdateHorizScaling);
+}
+
+void DisplayListOutputDev::updateTextPos(GfxState *state) {
+  addOp(state, dlUpdateTextPos);
+}
+
+void DisplayListOutputDev::updateTextShift(GfxState *state, double shift) {
+  if (addOp(state, dlUpdateTextShift)) {
+    list->addNum(shift);
+  }
+}
+
+void DisplayListOutputDev::stroke(GfxState *state) {
+  addPathOp(state, dlStroke);
+}
+
+void DisplayListOutputDev::fill(GfxState *state) {
+  addPathOp(state, dlFill);
+}
+
+void DisplayListOutputDev::eoFill(GfxState *state) {
+  addPathOp(state, dlEOFill);
+}
+
+void DisplayListOutputDev::clip(GfxState *state) {
+  addPathOp(state, dlClip);
+}
+
+void DisplayListOutputDev::eoClip(GfxState *state) {
+  addPathOp(state, dlEOClip);
+}
+
+void DisplayListOutputDev::clipToStrokePath(GfxState *state) {
+  addPathOp(state, dlClipToStrokePath);
+}
+
+void DisplayListOutputDev::beginStringOp(GfxState *state) {
+  addOp(state, dlBeginStringOp);
+}
+
+void DisplayListOutputDev::endStringOp(GfxState *state) {
+  addOp(state, dlEndStringOp);
+}
+
+void DisplayListOutputDev::beginString(GfxState *state, GooString *s) {
+  DisplayListOp *op;
+
+  if ((op = addOp(state, dlBeginString))) {
+    op->s = s->copy();
+  }
+}
+
+void DisplayListOutputDev::endString(GfxState *state) {
+  addOp(state, dlEndString);
+}
+
+void DisplayListOutputDev::drawChar(GfxState *state, double x, double y,
+				    double dx, double dy,
+				    double originX, double originY,
+				    CharCode code, int nBytes,
+				    Unicode *u, int uLen) {
+  DisplayListOp *op;
+  int i;
+
+  // numbers: x, y, dx, dy, originX, originY, code, uLen, u
+  if ((op = addOp(state, dlDrawChar))) {
+    op->iArg = nBytes;
+    list->addNum(x);
+    list->addNum(y);
+    list->addNum(dx);
+    list->addNum(dy);
+    list->addNum(originX);
+    list->addNum(originY);
+    list->addNum(code);
+    list->addNum(u ? uLen : 0);
+    if (u) {
+      for (i = 0; i < uLen; ++i) {
+	list->addNum(u[i]);
+      }
+    }
+  }
+}
+
+GBool DisplayListOutputDev::beginType3Char(GfxState *state,
+					   double x, double y,
+					   double dx, double dy,
+					   CharCode code,
+					   Unicode *u, int uLen) {
+  // numbers: x, y, dx, dy, code, uLen, u
+  if (addOp(state, dlBeginType3Char)) {
+    addCharArgs(x, y, dx, dy, code, u, uLen);
+  }
+  return gFalse;
+}
+
+void DisplayListOutputDev::endType3Char(GfxState *state) {
+  addOp(state, dlEndType3Char);
+}
+
+void DisplayListOutputDev::beginTextObject(GfxState *state) {
+  addOp(state, dlBeginTextObject);
+}
+
+void DisplayListOutputDev::endTextObject(GfxState *state) {
+  addOp(state, dlEndTextObject);
+}
+
+DisplayListImage *DisplayListOutputDev::addImageOp(GfxState *state, int kind,
+						   Object *ref, Stream *str,
+						   int width, int height,
+						   GfxImageColorMap *colorMap,
+						   GBool interpolate,
+						   GBool inlineImg) {
+  DisplayListOp *op;
+  DisplayListImage *img;
+  Guchar *data;
+  int nBits, len;
+
+  if (!list || !shadow) {
+    return NULL;
+  }
+  nBits = colorMap ? colorMap->getNumPixelComps() * colorMap->getBits() : 1;
+  if (!(data = readImageData(str, width, height, nBits, &len))) {
+    return NULL;
+  }
+  op = addOp(state, kind);
+  op->image = img = new DisplayListImage;
+  if (ref) {
+    ref->copy(&img->ref);
+  } else {
+    img->ref.initNull();
+  }
+  img->width = width;
+  img->height = height;
+  img->colorMap = colorMap ? colorMap->copy() : (GfxImageColorMap *)NULL;
+  img->maskColors = NULL;
+  img->invert = gFalse;
+  img->interpolate = interpolate;
+  img->inlineImg = inlineImg;
+  img->data = data;
+  img->dataLen = len;
+  img->maskWidth = img->maskHeight = 0;
+  img->maskColorMap = NULL;
+  img->maskInvert = gFalse;
+  img->maskInterpolate = gFalse;
+  img->maskData = NULL;
+  img->maskDataLen = 0;
+  list->size += sizeof(DisplayListImage) + len;
+  return img;
+}
+
+void DisplayListOutputDev::drawImageMask(GfxState *state, Object *ref,
+					 Stream *str, int width, int height,
+					 GBool invert, GBool interpolate,
+					 GBool inlineImg) {
+  DisplayListImage *img;
+
+  if ((img = addImageOp(state, dlDrawImageMask, ref, str, width, height,
+			NULL, interpolate, inlineImg))) {
+    img->invert = invert;
+  }
+}
+
+void DisplayListOutputDev::drawImage(GfxState *state, Object *ref,
+				     Stream *str, int width, int height,
+				     GfxImageColorMap *colorMap,
+				     GBool interpolate, int *maskColors,
+				     GBool inlineImg) {
+  DisplayListImage *img;
+  int n, i;
+
+  if ((img = addImageOp(state, dlDrawImage, ref, str, width, height,
+			colorMap, interpolate, inlineImg))) {
+    if (maskColors) {
+      n = 2 * colorMap->getNumPixelComps();
+      img->maskColors = (int *)gmallocn(n, sizeof(int));
+      for (i = 0; i < n; ++i) {
+	img->maskColors[i] = maskColors[i];
+      }
+    }
+  }
+}
+
+void DisplayListOutputDev::drawMaskedImage(GfxState *state, Object *ref,
+					   Stream *str,
+					   int width, int height,
+					   GfxImageColorMap *colorMap,
+					   GBool interpolate,
+					   Stream *maskStr,
+					   int maskWidth, int maskHeight,
+					   GBool maskInvert,
+					   GBool maskInterpolate) {
+  DisplayListImage *img;
+
+  if ((img = addImageOp(state, dlDrawMaskedImage, ref, str, width, height,
+			colorMap, interpolate, gFalse))) {
+    img->maskWidth = maskWidth;
+    img->maskHeight = maskHeight;
+    img->maskInvert = maskInvert;
+    img->maskInterpolate = maskInterpolate;
+    img->maskData = readImageData(maskStr, maskWidth, maskHeight, 1,
+				  &img->maskDataLen);
+    list->size += img->maskDataLen;
+  }
+}
+
+void DisplayListOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
+					       Stream *str,
+					       int width, int height,
+					       GfxImageColorMap *colorMap,
+					       GBool interpolate,
+					       Stream *maskStr,
+					       int maskWidth, int maskHeight,
+					       GfxImageColorMap *maskColorMap,
+					       GBool maskInterpolate) {
+  DisplayListImage *img;
+
+  if ((img = addImageOp(state, dlDrawSoftMaskedImage, ref, str,
+			width, height, colorMap, interpolate, gFalse))) {
+    img->maskWidth = maskWidth;
+    img->maskHeight = maskHeight;
+    img->maskColorMap = maskColorMap->copy();
+    img->maskInterpolate = maskInterpolate;
+    img->maskData = readImageData(maskStr, maskWidth, maskHeight,
+				  maskColorMap->getNumPixelComps() *
+				    maskColorMap->getBits(),
+				  &img->maskDataLen);
+    list->size += img->maskDataLen;
+  }
+}
+
+void DisplayListOutputDev::type3D0(GfxState *state, double wx, double wy) {
+  if (addOp(state, dlType3D0)) {
+    list->addNum(wx);
+    list->addNum(wy);
+  }
+}
+
+void DisplayListOutputDev::type3D1(GfxState *state, double wx, double wy,
+				   double llx, double lly,
+				   double urx, double ury) {
+  if (addOp(state, dlType3D1)) {
+    list->addNum(wx);
+    list->addNum(wy);
+    list->addNum(llx);
+    list->addNum(lly);
+    list->addNum(urx);
+    list->addNum(ury);
+  }
+}
+
+void DisplayListOutputDev::beginTransparencyGroup(GfxState *state,
+						  double *bbox,
+						  GfxColorSpace *blendingColorSpace,
+						  GBool isolated,
+						  GBool knockout,
+						  GBool forSoftMask) {
+  DisplayListOp *op;
+
+  if ((op = addOp(state, dlBeginTransparencyGroup))) {
+    op->iArg = (isolated ? 1 : 0) | (knockout ? 2 : 0) |
+               (forSoftMask ? 4 : 0);
+    op->colorSpace = blendingColorSpace ? blendingColorSpace->copy()
+                                        : (GfxColorSpace *)NULL;
+    list->addNums(bbox, 4);
+  }
+}
+
+void DisplayListOutputDev::endTransparencyGroup(GfxState *state) {
+  addOp(state, dlEndTransparencyGroup);
+}
+
+void DisplayListOutputDev::paintTransparencyGroup(GfxState *state,
+						  double *bbox) {
+  if (addOp(state, dlPaintTransparencyGroup)) {
+    list->addNums(bbox, 4);
+  }
+}
+
+void DisplayListOutputDev::setSoftMask(GfxState *state, double *bbox,
+				       GBool alpha, Function *transferFunc,
+				       GfxColor *backdropColor) {
+  DisplayListOp *op;
+  int i;
+
+  if ((op = addOp(state, dlSetSoftMask))) {
+    op->iArg = alpha;
+    op->func = transferFunc ? transferFunc->copy() : (Function *)NULL;
+    list->addNums(bbox, 4);
+    for (i = 0; i < gfxColorMaxComps; ++i) {
+      list->addNum(backdropColor->c[i]);
+    }
+  }
+}
+
+void DisplayListOutputDev::clearSoftMask(GfxState *state) {
+  addOp(state, dlClearSoftMask);
+}
+
+void DisplayListOutputDev::setVectorAntialias(GBool vaa) {
+  DisplayListOp *op;
+
+  if (list) {
+    op = list->addOp(dlSetVectorAntialias);
+    op->iArg = vaa;
+  }
+}
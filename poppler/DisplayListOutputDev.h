@@ -0,0 +1,249 @@
+//========================================================================
+//
+// DisplayListOutputDev.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef DISPLAYLISTOUTPUTDEV_H
+#define DISPLAYLISTOUTPUTDEV_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "GfxState.h"
+#include "Page.h"
+#include "OutputDev.h"
+
+struct DisplayListOp;
+struct DisplayListImage;
+class DisplayListOutputDev;
+
+//------------------------------------------------------------------------
+// DisplayList
+//
+// The output device calls for one page, as recorded by a
+// DisplayListOutputDev: state changes, paths, characters, and images
+// (with their data already run through the stream filters).  The list
+// can be replayed into any other output device at any resolution, so
+// that a thumbnail, a preview, and a full resolution rendering of a
+// page only parse the content stream, load the fonts, and decode the
+// images once.
+//
+// Replaying is not quite the same as displaying the page directly:
+// the calls which Gfx makes depending on the device (shaded fills,
+// tiling patterns, text filled with a pattern) are recorded as they
+// were reduced for DisplayListOutputDev, i.e., to plain fills.  The
+// CTM changes made by the content stream are replayed as the same
+// concatenations, so that at another resolution edges which fall
+// exactly on a pixel boundary end up on the same side of it; other
+// CTM changes (e.g., for Type 3 chars) are scaled from the recording.
+//------------------------------------------------------------------------
+
+class DisplayList {
+public:
+
+  ~DisplayList();
+
+  // Replay the page into <out> at a resolution of <hDPI> x <vDPI>,
+  // with the page box and rotation the list was recorded with.  This
+  // does what Page::display() does, from startPage() to endPage().
+  // A list can be replayed any number of times, but not from several
+  // threads at once.
+  void replay(OutputDev *out, double hDPI, double vDPI);
+
+  // Number of recorded calls.
+  int getNumOps() { return opsLen; }
+
+  // Approximate memory used by the list, in bytes (not counting the
+  // fonts, which are shared with the document).
+  int getSize() { return size; }
+
+private:
+
+  friend class DisplayListOutputDev;
+
+  DisplayList(int pageNumA, GfxState *state);
+  DisplayListOp *addOp(int kind);
+  void addNum(double x);
+  void addNums(double *x, int n);
+  void applyState(GfxState *state, DisplayListOp *op,
+		  double *t, GBool identity);
+
+  int pageNum;			// page number
+  PDFRectangle box;		// page box, as passed to GfxState
+  int rotate;			// page rotation
+  double baseCTM[6];		// default CTM of the recording
+  DisplayListOp *ops;		// the recorded calls
+  int opsLen, opsSize;
+  double *nums;			// numeric arguments of the calls
+  int numsLen, numsSize;
+  int size;			// see getSize()
+};
+
+//------------------------------------------------------------------------
+// DisplayListOutputDev
+//------------------------------------------------------------------------
+
+class DisplayListOutputDev: public OutputDev {
+public:
+
+  // Constructor.
+  DisplayListOutputDev();
+
+  // Destructor.
+  virtual ~DisplayListOutputDev();
+
+  // Return the list recorded for the last page displayed, or NULL if
+  // there is none.  The caller owns the list.
+  DisplayList *takeDisplayList();
+
+  //----- get info about output device
+
+  // Does this device use upside-down coordinates?
+  // (Upside-down means (0,0) is the top left corner of the page.)
+  virtual GBool upsideDown() { return gTrue; }
+
+  // Does this device use drawChar() or drawString()?
+  virtual GBool useDrawChar() { return gTrue; }
+
+  // Does this device use beginType3Char/endType3Char?  Otherwise,
+  // text in Type 3 fonts will be drawn with drawChar/drawString.
+  virtual GBool interpretType3Chars() { return gTrue; }
+
+  //----- initialization and control
+
+  // Start a page.
+  virtual void startPage(int pageNum, GfxState *state);
+
+  // End a page.
+  virtual void endPage();
+
+  //----- save/restore graphics state
+  virtual void saveState(GfxState *state);
+  virtual void restoreState(GfxState *state);
+
+  //----- update graphics state
+  virtual void updateAll(GfxState *state);
+  virtual void updateCTM(GfxState *state, double m11, double m12,
+			 double m21, double m22, double m31, double m32);
+  virtual void updateLineDash(GfxState *state);
+  virtual void updateFlatness(GfxState *state);
+  virtual void updateLineJoin(GfxState *state);
+  virtual void updateLineCap(GfxState *state);
+  virtual void updateMiterLimit(GfxState *state);
+  virtual void updateLineWidth(GfxState *state);
+  virtual void updateStrokeAdjust(GfxState *state);
+  virtual void updateAlphaIsShape(GfxState *state);
+  virtual void updateTextKnockout(GfxState *state);
+  virtual void updateFillColorSpace(GfxState *state);
+  virtual void updateStrokeColorSpace(GfxState *state);
+  virtual void updateFillColor(GfxState *state);
+  virtual void updateStrokeColor(GfxState *state);
+  virtual void updateBlendMode(GfxState *state);
+  virtual void updateFillOpacity(GfxState *state);
+  virtual void updateStrokeOpacity(GfxState *state);
+  virtual void updateFillOverprint(GfxState *state);
+  virtual void updateStrokeOverprint(GfxState *state);
+  virtual void updateTransfer(GfxState *state);
+
+  //----- update text state
+  virtual void updateFont(GfxState *state);
+  virtual void updateTextMat(GfxState *state);
+  virtual void updateCharSpace(GfxState *state);
+  virtual void updateRender(GfxState *state);
+  virtual void updateRise(GfxState *state);
+  virtual void updateWordSpace(GfxState *state);
+  virtual void updateHorizScaling(GfxState *state);
+  virtual void updateTextPos(GfxState *state);
+  virtual void updateTextShift(GfxState *state, double shift);
+
+  //----- path painting
+  virtual void stroke(GfxState *state);
+  virtual void fill(GfxState *state);
+  virtual void eoFill(GfxState *state);
+
+  //----- path clipping
+  virtual void clip(GfxState *state);
+  virtual void eoClip(GfxState *state);
+  virtual void clipToStrokePath(GfxState *state);
+
+  //----- text drawing
+  virtual void beginStringOp(GfxState *state);
+  virtual void endStringOp(GfxState *state);
+  virtual void beginString(GfxState *state, GooString *s);
+  virtual void endString(GfxState *state);
+  virtual void drawChar(GfxState *state, double x, double y,
+			double dx, double dy,
+			double originX, double originY,
+			CharCode code, int nBytes, Unicode *u, int uLen);
+  virtual GBool beginType3Char(GfxState *state, double x, double y,
+			       double dx, double dy,
+			       CharCode code, Unicode *u, int uLen);
+  virtual void endType3Char(GfxState *state);
+  virtual void beginTextObject(GfxState *state);
+  virtual void endTextObject(GfxState *state);
+
+  //----- image drawing
+  virtual void drawImageMask(GfxState *state, Object *ref, Stream *str,
+			     int width, int height, GBool invert,
+			     GBool interpolate, GBool inlineImg);
+  virtual void drawImage(GfxState *state, Object *ref, Stream *str,
+			 int width, int height, GfxImageColorMap *colorMap,
+			 GBool interpolate, int *maskColors, GBool inlineImg);
+  virtual void drawMaskedImage(GfxState *state, Object *ref, Stream *str,
+			       int width, int height,
+			       GfxImageColorMap *colorMap, GBool interpolate,
+			       Stream *maskStr, int maskWidth, int maskHeight,
+			       GBool maskInvert, GBool maskInterpolate);
+  virtual void drawSoftMaskedImage(GfxState *state, Object *ref, Stream *str,
+				   int width, int height,
+				   GfxImageColorMap *colorMap,
+				   GBool interpolate,
+				   Stream *maskStr,
+				   int maskWidth, int maskHeight,
+				   GfxImageColorMap *maskColorMap,
+				   GBool maskInterpolate);
+
+  //----- Type 3 font operators
+  virtual void type3D0(GfxState *state, double wx, double wy);
+  virtual void type3D1(GfxState *state, double wx, double wy,
+		       double llx, double lly, double urx, double ury);
+
+  //----- transparency groups and soft masks
+  virtual void beginTransparencyGroup(GfxState *state, double *bbox,
+				      GfxColorSpace *blendingColorSpace,
+				      GBool isolated, GBool knockout,
+				      GBool forSoftMask);
+  virtual void endTransparencyGroup(GfxState *state);
+  virtual void paintTransparencyGroup(GfxState *state, double *bbox);
+  virtual void setSoftMask(GfxState *state, double *bbox, GBool alpha,
+			   Function *transferFunc, GfxColor *backdropColor);
+  virtual void clearSoftMask(GfxState *state);
+
+  // Gfx turns anti-aliasing off for shaded fills; record that, so
+  // that the replay does the same on devices which anti-alias.
+  virtual GBool getVectorAntialias() { return gTrue; }
+  virtual void setVectorAntialias(GBool vaa);
+
+private:
+
+  void sync(GfxState *state);
+  DisplayListOp *addOp(GfxState *state, int kind);
+  void addPathOp(GfxState *state, int kind);
+  void addColor(GfxColor *color, int nComps);
+  void addCharArgs(double x, double y, double dx, double dy,
+		   CharCode code, Unicode *u, int uLen);
+  DisplayListImage *addImageOp(GfxState *state, int kind, Object *ref,
+			       Stream *str, int width, int height,
+			       GfxImageColorMap *colorMap,
+			       GBool interpolate, GBool inlineImg);
+
+  DisplayList *list;		// the list being recorded
+  GfxState *shadow;		// the state as of the recorded calls
+};
+
+#endif
@@ -33,4 +33,7 @@
 
 #define errFileIO          10   // file I/O error
 
+#define errDataNotAvailable 11	// the part of the file needed hasn't
+				// arrived yet (see ByteRangeStream)
+
 #endif
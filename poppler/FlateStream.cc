@@ -13,12 +13,21 @@ FlateStream::FlateStream(Stream *strA, int predictor, int columns, int colors, i
 {
   if (predictor != 1) {
     pred = new StreamPredictor(this, predictor, columns, colors, bits);
+    if (!pred->isOk()) {
+      delete pred;
+      pred = NULL;
+    }
   } else {
     pred = NULL;
   }
-  out_pos = 0;
+  // the zlib header is checked by reset(), so inflate gets the raw
+  // deflate data -- this also means that, like the built-in decoder,
+  // we don't insist on a correct Adler-32 checksum
   memset(&d_stream, 0, sizeof(d_stream));
-  inflateInit(&d_stream);
+  inflateInit2(&d_stream, -MAX_WBITS);
+  readAhead = gFalse;
+  eof = gTrue;
+  outPtr = outEnd = outBuf;
 }
 
 FlateStream::~FlateStream() {
@@ -27,84 +36,132 @@ FlateStream::~FlateStream() {
   delete str;
 }
 
-void FlateStream::reset() {
-  //FIXME: what are the semantics of reset?
-  //i.e. how much intialization has to happen in the constructor?
-
-  /* reinitialize zlib */
-  inflateEnd(&d_stream);
-  memset(&d_stream, 0, sizeof(d_stream));
-  inflateInit(&d_stream);
-
+void FlateStream::unfilteredReset() {
+  eof = gTrue;
+  outPtr = outEnd = outBuf;
   str->reset();
-  d_stream.avail_in = 0;
-  status = Z_OK;
-  out_pos = 0;
-  out_buf_len = 0;
 }
 
-int FlateStream::getRawChar() {
-  if (fill_buffer())
-    return EOF;
+void FlateStream::reset() {
+  int cmf, flg;
 
-  return out_buf[out_pos++];
-}
+  unfilteredReset();
+  inflateReset(&d_stream);
+  d_stream.avail_in = 0;
+  readAhead = str->canReadAhead();
+
+  // read header
+  cmf = str->getChar();
+  flg = str->getChar();
+  if (cmf == EOF || flg == EOF)
+    return;
+  if ((cmf & 0x0f) != 0x08) {
+    error(getPos(), "Unknown compression method in flate stream");
+    return;
+  }
+  if ((((cmf << 8) + flg) % 31) != 0) {
+    error(getPos(), "Bad FCHECK in flate stream");
+    return;
+  }
+  if (flg & 0x20) {
+    error(getPos(), "FDICT bit set in flate stream");
+    return;
+  }
 
-int FlateStream::getChar() {
-  if (pred)
-    return pred->getChar();
-  else
-    return getRawChar();
+  eof = gFalse;
 }
 
 int FlateStream::lookChar() {
-  if (pred)
+  if (pred) {
     return pred->lookChar();
-
-  if (fill_buffer())
+  }
+  if (outPtr >= outEnd && !fillBuf()) {
     return EOF;
+  }
+  return *outPtr;
+}
 
-  return out_buf[out_pos];
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawChars(nChars, buffer);
 }
 
-int FlateStream::fill_buffer() {
-  /* only fill the buffer if it has all been used */
-  if (out_pos >= out_buf_len) {
-    /* check if the flatestream has been exhausted */
-    if (status == Z_STREAM_END) {
-      return -1;
-    }
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
 
-    /* set to the begining of out_buf */
-    d_stream.avail_out = sizeof(out_buf);
-    d_stream.next_out = out_buf;
-    out_pos = 0;
-
-    while (1) {
-      /* buffer is empty so we need to fill it */
-      if (d_stream.avail_in == 0) {
-	int c;
-	/* read from the source stream */
-	while (d_stream.avail_in < sizeof(in_buf) && (c = str->getChar()) != EOF) {
-	  in_buf[d_stream.avail_in++] = c;
-	}
-	d_stream.next_in = in_buf;
+  n = 0;
+  while (n < nChars) {
+    if (outPtr < outEnd) {
+      m = (int)(outEnd - outPtr);
+      if (m > nChars - n) {
+	m = nChars - n;
       }
-
-      /* keep decompressing until we can't anymore */
-      if (d_stream.avail_out == 0 || d_stream.avail_in == 0 || (status != Z_OK && status != Z_BUF_ERROR))
+      memcpy(buffer + n, outPtr, m);
+      outPtr += m;
+    } else if (nChars - n >= flateOutBufSize) {
+      // no point in going through outBuf
+      if (!(m = inflateSome(buffer + n, nChars - n))) {
 	break;
-      status = inflate(&d_stream, Z_SYNC_FLUSH);
+      }
+    } else if (!fillBuf()) {
+      break;
+    } else {
+      continue;
     }
-
-    out_buf_len = sizeof(out_buf) - d_stream.avail_out;
-    if (status != Z_OK && status != Z_STREAM_END)
-      return -1;
-    if (!out_buf_len)
-      return -1;
+    n += m;
   }
+  return n;
+}
+
+GBool FlateStream::fillBuf() {
+  outPtr = outBuf;
+  outEnd = outBuf + inflateSome(outBuf, flateOutBufSize);
+  return outPtr < outEnd;
+}
 
-  return 0;
+// Inflate up to <size> bytes into <out>.  Returns the number of bytes
+// produced, which is zero only at the end of the data.  Whatever was
+// decoded before a data error is still returned, like the built-in
+// decoder does.
+int FlateStream::inflateSome(Guchar *out, int size) {
+  int n, c, status;
+
+  if (eof) {
+    return 0;
+  }
+  d_stream.next_out = out;
+  d_stream.avail_out = size;
+  do {
+    if (d_stream.avail_in == 0) {
+      if (readAhead) {
+	n = str->getChars(flateInBufSize, inBuf);
+      } else if ((c = str->getChar()) != EOF) {
+	inBuf[0] = (Guchar)c;
+	n = 1;
+      } else {
+	n = 0;
+      }
+      if (n == 0) {
+	// truncated stream: return what has been decoded so far
+	error(getPos(), "Unexpected end of file in flate stream");
+	eof = gTrue;
+	break;
+      }
+      d_stream.next_in = inBuf;
+      d_stream.avail_in = n;
+    }
+    status = inflate(&d_stream, Z_NO_FLUSH);
+    if (status == Z_STREAM_END) {
+      eof = gTrue;
+    } else if (status != Z_OK) {
+      error(getPos(), "Bad flate stream: %s",
+	    d_stream.msg ? d_stream.msg : "unknown error");
+      eof = gTrue;
+    }
+  } while (!eof && d_stream.avail_out == (uInt)size);
+  return size - (int)d_stream.avail_out;
 }
 
 GooString *FlateStream::getPSFilter(int psLevel, char *indent) {
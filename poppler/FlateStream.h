@@ -41,6 +41,20 @@ extern "C" {
 #include <zlib.h>
 }
 
+//------------------------------------------------------------------------
+// FlateStream
+//
+// Flate decoder built on zlib's inflate().  The compressed data is
+// read from the underlying stream in blocks with getChars() -- except
+// where the data after the stream belongs to someone else (see
+// Stream::canReadAhead()), in which case it is read one char at a
+// time.  Large getChars() requests are inflated straight into the
+// caller's buffer.
+//------------------------------------------------------------------------
+
+#define flateInBufSize 4096
+#define flateOutBufSize 16384
+
 class FlateStream: public FilterStream {
 public:
 
@@ -48,22 +62,31 @@ public:
   virtual ~FlateStream();
   virtual StreamKind getKind() { return strFlate; }
   virtual void reset();
-  virtual int getChar();
+  virtual int getChar()
+    { return pred ? pred->getChar() : getRawChar(); }
   virtual int lookChar();
-  virtual int getRawChar();
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getRawChar()
+    { return (outPtr >= outEnd && !fillBuf()) ? EOF : *outPtr++; }
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
+  virtual void unfilteredReset();
 
 private:
-  int fill_buffer(void);
-  z_stream d_stream;
-  StreamPredictor *pred;
-  int status;
-  /* in_buf currently needs to be 1 or we over read from EmbedStreams */
-  unsigned char in_buf[1];
-  unsigned char out_buf[4096];
-  int out_pos;
-  int out_buf_len;
+
+  GBool fillBuf();
+  int inflateSome(Guchar *out, int size);
+
+  z_stream d_stream;		// zlib state
+  StreamPredictor *pred;	// predictor
+  GBool readAhead;		// set if the input can be read in blocks
+  GBool eof;			// set when the end of the data (or an
+				//   error) is reached
+  Guchar inBuf[flateInBufSize];	// compressed data
+  Guchar outBuf[flateOutBufSize]; // decompressed data
+  Guchar *outPtr;		// next char in outBuf
+  Guchar *outEnd;		// end of valid data in outBuf
 };
 
 #endif
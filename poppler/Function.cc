@@ -538,7 +538,7 @@ ExponentialFunction::ExponentialFunction(ExponentialFunction *func) {
 }
 
 void ExponentialFunction::transform(double *in, double *out) {
-  double x;
+  double x, t;
   int i;
 
   if (in[0] < domain[0][0]) {
@@ -548,8 +548,10 @@ void ExponentialFunction::transform(double *in, double *out) {
   } else {
     x = in[0];
   }
+  // most shadings use a linear interpolation (e = 1)
+  t = e == 1 ? x : pow(x, e);
   for (i = 0; i < n; ++i) {
-    out[i] = c0[i] + pow(x, e) * (c1[i] - c0[i]);
+    out[i] = c0[i] + t * (c1[i] - c0[i]);
     if (hasRange) {
       if (out[i] < range[i][0]) {
 	out[i] = range[i][0];
@@ -1012,12 +1014,772 @@ void PSStack::roll(int n, int j) {
     }
   } else {
     j = n - j;
-    obj = stack[sp + n - 1];
-    for (k = sp + n - 1; k > sp; --k) {
-      stack[k] = stack[k-1];
+    for (i = 0; i < j; ++i) {
+      obj = stack[sp + n - 1];
+      for (k = sp + n - 1; k > sp; --k) {
+        stack[k] = stack[k-1];
+      }
+      stack[sp] = obj;
+    }
+  }
+}
+
+//------------------------------------------------------------------------
+// PostScript function compiler
+//------------------------------------------------------------------------
+
+// In most Type 4 functions the depth of the operand stack and the type
+// of each stack entry at any point of the program don't depend on the
+// input values.  Such a program is compiled into register code: every
+// value computed by an operator gets its own register, the stack
+// operators (dup, exch, index, roll, ...) just rename registers at
+// compile time, and operators whose operands are all constants are
+// evaluated by the compiler.  Stack overflow, underflow, and type
+// checks are thus done once, when compiling; programs for which they
+// can't be done statically are interpreted.
+
+enum PSInstrOp {
+  psiMove,
+  psiAbs,
+  psiIAbs,
+  psiNeg,
+  psiINeg,
+  psiCeiling,
+  psiFloor,
+  psiRound,
+  psiTruncate,
+  psiCvi,
+  psiSqrt,
+  psiSin,
+  psiCos,
+  psiLn,
+  psiLog,
+  psiINot,
+  psiBNot,
+  psiAdd,
+  psiIAdd,
+  psiSub,
+  psiISub,
+  psiMul,
+  psiIMul,
+  psiDiv,
+  psiIdiv,
+  psiMod,
+  psiAtan,
+  psiExp,
+  psiBitshift,
+  psiAnd,			// bitwise, also used for booleans
+  psiOr,
+  psiXor,
+  psiEq,
+  psiNe,
+  psiGe,
+  psiGt,
+  psiLe,
+  psiLt,
+  psiJz,			// jump to <b> if register <a> is zero
+  psiJmp			// jump to <b>
+};
+
+struct PSInstr {
+  PSInstrOp op;
+  int dst;			// result register
+  int a, b;			// operand registers, or jump target
+};
+
+// Booleans are held as 0/1, and integers as exact doubles.
+static inline void psExecInstr(PSInstr *instr, double *r) {
+  double x, y, result;
+  int i1, i2;
+
+  x = r[instr->a];
+  y = r[instr->b];
+  switch (instr->op) {
+  case psiMove:
+    result = x;
+    break;
+  case psiAbs:
+    result = fabs(x);
+    break;
+  case psiIAbs:
+    result = abs((int)x);
+    break;
+  case psiNeg:
+    result = -x;
+    break;
+  case psiINeg:
+    result = -(int)x;
+    break;
+  case psiCeiling:
+    result = ceil(x);
+    break;
+  case psiFloor:
+    result = floor(x);
+    break;
+  case psiRound:
+    result = (x >= 0) ? floor(x + 0.5) : ceil(x - 0.5);
+    break;
+  case psiTruncate:
+    result = (x >= 0) ? floor(x) : ceil(x);
+    break;
+  case psiCvi:
+    result = (int)x;
+    break;
+  case psiSqrt:
+    result = sqrt(x);
+    break;
+  case psiSin:
+    result = sin(x * M_PI / 180.0);
+    break;
+  case psiCos:
+    result = cos(x * M_PI / 180.0);
+    break;
+  case psiLn:
+    result = log(x);
+    break;
+  case psiLog:
+    result = log10(x);
+    break;
+  case psiINot:
+    result = ~(int)x;
+    break;
+  case psiBNot:
+    result = (x == 0) ? 1 : 0;
+    break;
+  case psiAdd:
+    result = x + y;
+    break;
+  case psiIAdd:
+    result = (int)x + (int)y;
+    break;
+  case psiSub:
+    result = x - y;
+    break;
+  case psiISub:
+    result = (int)x - (int)y;
+    break;
+  case psiMul:
+    result = x * y;
+    break;
+  case psiIMul:
+    result = (int)x * (int)y;
+    break;
+  case psiDiv:
+    result = x / y;
+    break;
+  case psiIdiv:
+    i2 = (int)y;
+    result = i2 ? (int)x / i2 : 0;
+    break;
+  case psiMod:
+    i2 = (int)y;
+    result = i2 ? (int)x % i2 : 0;
+    break;
+  case psiAtan:
+    result = atan2(x, y) * 180.0 / M_PI;
+    if (result < 0) {
+      result += 360.0;
+    }
+    break;
+  case psiExp:
+    result = pow(x, y);
+    break;
+  case psiBitshift:
+    i1 = (int)x;
+    i2 = (int)y;
+    if (i2 > 0) {
+      result = i1 << i2;
+    } else if (i2 < 0) {
+      result = (int)((Guint)i1 >> -i2);
+    } else {
+      result = i1;
+    }
+    break;
+  case psiAnd:
+    result = (int)x & (int)y;
+    break;
+  case psiOr:
+    result = (int)x | (int)y;
+    break;
+  case psiXor:
+    result = (int)x ^ (int)y;
+    break;
+  case psiEq:
+    result = (x == y) ? 1 : 0;
+    break;
+  case psiNe:
+    result = (x != y) ? 1 : 0;
+    break;
+  case psiGe:
+    result = (x >= y) ? 1 : 0;
+    break;
+  case psiGt:
+    result = (x > y) ? 1 : 0;
+    break;
+  case psiLe:
+    result = (x <= y) ? 1 : 0;
+    break;
+  case psiLt:
+    result = (x < y) ? 1 : 0;
+    break;
+  default:
+    return;
+  }
+  r[instr->dst] = result;
+}
+
+// Give up on programs which would take too long to compile (each
+// if/ifelse is compiled twice).
+#define psCompileMaxSteps 100000
+
+// The type of an operand at compile time.  If the branches of an
+// ifelse leave an integer and a real in the same stack entry, its type
+// is psTypeNum.  Integers are held as doubles, so such an entry can be
+// used like a real (its value is the same either way), but not by the
+// integer-only operators.
+enum PSCompiledType {
+  psTypeBool,
+  psTypeInt,
+  psTypeReal,
+  psTypeNum
+};
+
+struct PSCompiledValue {
+  PSCompiledType type;
+  GBool isConst;
+  double val;			// the value, if isConst
+  int reg;			// register holding the value, if !isConst
+};
+
+struct PSCompiledStack {
+  PSCompiledValue stack[psStackSize];	// stack[0] is the bottom
+  int depth;
+};
+
+class PSCompiler {
+public:
+
+  PSCompiler(PSObject *codeA, int nInputs);
+  ~PSCompiler();
+
+  // Compile the block starting at <codePtr>, updating <stk> to the
+  // stack state at its end.  Returns false if the block can't be
+  // compiled.
+  GBool compileBlock(int codePtr, PSCompiledStack *stk);
+
+  // Return the register holding <v>.
+  int getReg(PSCompiledValue *v);
+
+  PSInstr *instrs;
+  int nInstrs;
+  double *regs;
+  int nRegs;
+
+private:
+
+  GBool compileIf(int condReg, int thenPtr, int elsePtr,
+		  PSCompiledStack *stk);
+  void emitMerge(PSCompiledStack *stk, PSCompiledStack *merged);
+  GBool compileOp(PSOp op, PSCompiledStack *stk);
+  GBool pushResult(PSCompiledStack *stk, PSInstrOp op, PSCompiledType type,
+		   PSCompiledValue *v1, PSCompiledValue *v2);
+  GBool pop(PSCompiledStack *stk, PSCompiledValue *v);
+  GBool push(PSCompiledStack *stk, PSCompiledValue *v);
+  GBool popConstInt(PSCompiledStack *stk, int *i);
+  int emit(PSInstrOp op, int dst, int a, int b);
+  int newReg(double val);
+
+  PSObject *code;
+  int instrsSize;
+  int regsSize;
+  int *consts;			// registers holding constants
+  int nConsts;
+  int constsSize;
+  int nSteps;
+};
+
+PSCompiler::PSCompiler(PSObject *codeA, int nInputs) {
+  int i;
+
+  code = codeA;
+  instrs = NULL;
+  nInstrs = instrsSize = 0;
+  regs = NULL;
+  nRegs = regsSize = 0;
+  consts = NULL;
+  nConsts = constsSize = 0;
+  nSteps = 0;
+  for (i = 0; i < nInputs; ++i) {
+    newReg(0);
+  }
+}
+
+PSCompiler::~PSCompiler() {
+  gfree(instrs);
+  gfree(regs);
+  gfree(consts);
+}
+
+GBool PSCompiler::compileBlock(int codePtr, PSCompiledStack *stk) {
+  PSCompiledValue v;
+  PSOp op;
+  int thenPtr, elsePtr;
+
+  while (1) {
+    if (++nSteps > psCompileMaxSteps) {
+      return gFalse;
+    }
+    switch (code[codePtr].type) {
+    case psInt:
+      v.type = psTypeInt;
+      v.isConst = gTrue;
+      v.val = code[codePtr++].intg;
+      if (!push(stk, &v)) {
+	return gFalse;
+      }
+      break;
+    case psReal:
+      v.type = psTypeReal;
+      v.isConst = gTrue;
+      v.val = code[codePtr++].real;
+      if (!push(stk, &v)) {
+	return gFalse;
+      }
+      break;
+    case psOperator:
+      op = code[codePtr++].op;
+      if (op == psOpReturn) {
+	return gTrue;
+      } else if (op == psOpIf || op == psOpIfelse) {
+	if (!pop(stk, &v) || v.type != psTypeBool) {
+	  return gFalse;
+	}
+	thenPtr = codePtr + 2;
+	elsePtr = (op == psOpIfelse) ? code[codePtr].blk : -1;
+	if (!v.isConst) {
+	  if (!compileIf(v.reg, thenPtr, elsePtr, stk)) {
+	    return gFalse;
+	  }
+	} else if (v.val != 0) {
+	  if (!compileBlock(thenPtr, stk)) {
+	    return gFalse;
+	  }
+	} else if (elsePtr >= 0) {
+	  if (!compileBlock(elsePtr, stk)) {
+	    return gFalse;
+	  }
+	}
+	codePtr = code[codePtr + 1].blk;
+      } else if (!compileOp(op, stk)) {
+	return gFalse;
+      }
+      break;
+    default:
+      return gFalse;
+    }
+  }
+}
+
+// The two branches must leave the same number of entries on the stack,
+// each either a boolean in both branches or a number in both branches.
+// Entries which differ between the branches are moved into new
+// registers at the end of each branch.  The branches are compiled once
+// without keeping the code, to find these entries.
+GBool PSCompiler::compileIf(int condReg, int thenPtr, int elsePtr,
+			    PSCompiledStack *stk) {
+  PSCompiledStack thenStk, elseStk, merged;
+  PSCompiledValue *v1, *v2;
+  int start, jz, jmp, elseStart, i;
+
+  start = nInstrs;
+  thenStk = *stk;
+  if (!compileBlock(thenPtr, &thenStk)) {
+    return gFalse;
+  }
+  elseStk = *stk;
+  if (elsePtr >= 0 && !compileBlock(elsePtr, &elseStk)) {
+    return gFalse;
+  }
+  nInstrs = start;
+  if (thenStk.depth != elseStk.depth) {
+    return gFalse;
+  }
+  merged.depth = thenStk.depth;
+  for (i = 0; i < merged.depth; ++i) {
+    v1 = &thenStk.stack[i];
+    v2 = &elseStk.stack[i];
+    merged.stack[i] = *v1;
+    if (v1->type != v2->type) {
+      if (v1->type == psTypeBool || v2->type == psTypeBool) {
+	return gFalse;
+      }
+      merged.stack[i].type = psTypeNum;
+    }
+    if (v1->isConst != v2->isConst ||
+	(v1->isConst ? memcmp(&v1->val, &v2->val, sizeof(double)) != 0
+	             : v1->reg != v2->reg)) {
+      merged.stack[i].isConst = gFalse;
+      merged.stack[i].reg = newReg(0);
+    }
+  }
+
+  jz = emit(psiJz, 0, condReg, 0);
+  thenStk = *stk;
+  compileBlock(thenPtr, &thenStk);
+  emitMerge(&thenStk, &merged);
+  jmp = emit(psiJmp, 0, 0, 0);
+  elseStart = nInstrs;
+  elseStk = *stk;
+  if (elsePtr >= 0) {
+    compileBlock(elsePtr, &elseStk);
+  }
+  emitMerge(&elseStk, &merged);
+  if (nInstrs == elseStart) {
+    // nothing to do if the condition is false
+    nInstrs = jmp;
+    instrs[jz].b = nInstrs;
+  } else {
+    instrs[jz].b = elseStart;
+    instrs[jmp].b = nInstrs;
+  }
+  *stk = merged;
+  return gTrue;
+}
+
+void PSCompiler::emitMerge(PSCompiledStack *stk, PSCompiledStack *merged) {
+  PSCompiledValue *v;
+  int i;
+
+  for (i = 0; i < merged->depth; ++i) {
+    v = &stk->stack[i];
+    if (!merged->stack[i].isConst &&
+	(v->isConst || v->reg != merged->stack[i].reg)) {
+      emit(psiMove, merged->stack[i].reg, getReg(v), 0);
+    }
+  }
+}
+
+GBool PSCompiler::compileOp(PSOp op, PSCompiledStack *stk) {
+  PSCompiledValue v1, v2;
+  PSCompiledValue *window;
+  PSCompiledType type;
+  int n, j, i;
+
+  switch (op) {
+
+  //----- stack operators
+  case psOpDup:
+    if (stk->depth < 1) {
+      return gFalse;
+    }
+    return push(stk, &stk->stack[stk->depth - 1]);
+  case psOpExch:
+    if (stk->depth < 2) {
+      return gFalse;
+    }
+    v1 = stk->stack[stk->depth - 1];
+    stk->stack[stk->depth - 1] = stk->stack[stk->depth - 2];
+    stk->stack[stk->depth - 2] = v1;
+    return gTrue;
+  case psOpPop:
+    return pop(stk, &v1);
+  case psOpCopy:
+    if (!popConstInt(stk, &n) || n < 0 || n > stk->depth ||
+	stk->depth + n > psStackSize) {
+      return gFalse;
+    }
+    for (i = 0; i < n; ++i) {
+      stk->stack[stk->depth + i] = stk->stack[stk->depth - n + i];
+    }
+    stk->depth += n;
+    return gTrue;
+  case psOpIndex:
+    if (!popConstInt(stk, &i) || i < 0 || i >= stk->depth) {
+      return gFalse;
+    }
+    return push(stk, &stk->stack[stk->depth - 1 - i]);
+  case psOpRoll:
+    if (!popConstInt(stk, &j) || !popConstInt(stk, &n) ||
+	n < 0 || n > stk->depth) {
+      return gFalse;
+    }
+    if (n == 0) {
+      return gTrue;
+    }
+    j %= n;
+    if (j < 0) {
+      j += n;
+    }
+    window = &stk->stack[stk->depth - n];
+    for (i = 0; i < j; ++i) {
+      v1 = window[n - 1];
+      memmove(window + 1, window, (n - 1) * sizeof(PSCompiledValue));
+      window[0] = v1;
+    }
+    return gTrue;
+
+  //----- constants
+  case psOpTrue:
+  case psOpFalse:
+    v1.type = psTypeBool;
+    v1.isConst = gTrue;
+    v1.val = (op == psOpTrue) ? 1 : 0;
+    return push(stk, &v1);
+
+  //----- unary operators
+  case psOpAbs:
+  case psOpNeg:
+  case psOpCeiling:
+  case psOpFloor:
+  case psOpRound:
+  case psOpTruncate:
+  case psOpCvi:
+  case psOpCvr:
+  case psOpSqrt:
+  case psOpSin:
+  case psOpCos:
+  case psOpLn:
+  case psOpLog:
+    if (!pop(stk, &v1) || v1.type == psTypeBool) {
+      return gFalse;
     }
-    stack[sp] = obj;
+    if (v1.type == psTypeInt) {
+      switch (op) {
+      case psOpAbs:
+	return pushResult(stk, psiIAbs, psTypeInt, &v1, &v1);
+      case psOpNeg:
+	return pushResult(stk, psiINeg, psTypeInt, &v1, &v1);
+      case psOpCeiling:
+      case psOpFloor:
+      case psOpRound:
+      case psOpTruncate:
+      case psOpCvi:
+	return push(stk, &v1);
+      case psOpCvr:
+	v1.type = psTypeReal;
+	return push(stk, &v1);
+      default:
+	break;
+      }
+    }
+    // these keep the type of a psTypeNum operand, and its value if
+    // it is an integer
+    switch (op) {
+    case psOpAbs:
+      return pushResult(stk, psiAbs, v1.type, &v1, &v1);
+    case psOpNeg:
+      return pushResult(stk, psiNeg, v1.type, &v1, &v1);
+    case psOpCeiling:
+      return pushResult(stk, psiCeiling, v1.type, &v1, &v1);
+    case psOpFloor:
+      return pushResult(stk, psiFloor, v1.type, &v1, &v1);
+    case psOpRound:
+      return pushResult(stk, psiRound, v1.type, &v1, &v1);
+    case psOpTruncate:
+      return pushResult(stk, psiTruncate, v1.type, &v1, &v1);
+    case psOpCvi:
+      return pushResult(stk, psiCvi, psTypeInt, &v1, &v1);
+    case psOpCvr:
+      v1.type = psTypeReal;
+      return push(stk, &v1);
+    case psOpSqrt:
+      return pushResult(stk, psiSqrt, psTypeReal, &v1, &v1);
+    case psOpSin:
+      return pushResult(stk, psiSin, psTypeReal, &v1, &v1);
+    case psOpCos:
+      return pushResult(stk, psiCos, psTypeReal, &v1, &v1);
+    case psOpLn:
+      return pushResult(stk, psiLn, psTypeReal, &v1, &v1);
+    case psOpLog:
+      return pushResult(stk, psiLog, psTypeReal, &v1, &v1);
+    default:
+      return gFalse;
+    }
+  case psOpNot:
+    if (!pop(stk, &v1) ||
+	(v1.type != psTypeInt && v1.type != psTypeBool)) {
+      return gFalse;
+    }
+    return pushResult(stk, v1.type == psTypeInt ? psiINot : psiBNot, v1.type,
+		      &v1, &v1);
+
+  //----- binary operators
+  default:
+    if (!pop(stk, &v2) || !pop(stk, &v1)) {
+      return gFalse;
+    }
+    switch (op) {
+    case psOpAnd:
+    case psOpOr:
+    case psOpXor:
+      if ((v1.type != psTypeInt && v1.type != psTypeBool) ||
+	  v2.type != v1.type) {
+	return gFalse;
+      }
+      return pushResult(stk, op == psOpAnd ? psiAnd :
+			     op == psOpOr ? psiOr : psiXor,
+			v1.type, &v1, &v2);
+    case psOpEq:
+    case psOpNe:
+      if ((v1.type == psTypeBool) != (v2.type == psTypeBool)) {
+	return gFalse;
+      }
+      return pushResult(stk, op == psOpEq ? psiEq : psiNe, psTypeBool,
+			&v1, &v2);
+    case psOpIdiv:
+    case psOpMod:
+    case psOpBitshift:
+      if (v1.type != psTypeInt || v2.type != psTypeInt) {
+	return gFalse;
+      }
+      return pushResult(stk, op == psOpIdiv ? psiIdiv :
+			     op == psOpMod ? psiMod : psiBitshift,
+			psTypeInt, &v1, &v2);
+    default:
+      break;
+    }
+    if (v1.type == psTypeBool || v2.type == psTypeBool) {
+      return gFalse;
+    }
+    if (v1.type == psTypeInt && v2.type == psTypeInt) {
+      switch (op) {
+      case psOpAdd:
+	return pushResult(stk, psiIAdd, psTypeInt, &v1, &v2);
+      case psOpSub:
+	return pushResult(stk, psiISub, psTypeInt, &v1, &v2);
+      case psOpMul:
+	return pushResult(stk, psiIMul, psTypeInt, &v1, &v2);
+      default:
+	break;
+      }
+    }
+    // the result of add, sub, and mul is an integer if both operands
+    // are integers
+    type = (v1.type == psTypeReal || v2.type == psTypeReal) ? psTypeReal
+                                                             : psTypeNum;
+    switch (op) {
+    case psOpAdd:
+      return pushResult(stk, psiAdd, type, &v1, &v2);
+    case psOpSub:
+      return pushResult(stk, psiSub, type, &v1, &v2);
+    case psOpMul:
+      return pushResult(stk, psiMul, type, &v1, &v2);
+    case psOpDiv:
+      return pushResult(stk, psiDiv, psTypeReal, &v1, &v2);
+    case psOpAtan:
+      return pushResult(stk, psiAtan, psTypeReal, &v1, &v2);
+    case psOpExp:
+      return pushResult(stk, psiExp, psTypeReal, &v1, &v2);
+    case psOpGe:
+      return pushResult(stk, psiGe, psTypeBool, &v1, &v2);
+    case psOpGt:
+      return pushResult(stk, psiGt, psTypeBool, &v1, &v2);
+    case psOpLe:
+      return pushResult(stk, psiLe, psTypeBool, &v1, &v2);
+    case psOpLt:
+      return pushResult(stk, psiLt, psTypeBool, &v1, &v2);
+    default:
+      return gFalse;
+    }
+  }
+}
+
+// Push the result of <op> applied to <v1> and <v2> (which is the same
+// as <v1> for unary operators).  If both operands are constants, the
+// result is computed here.
+GBool PSCompiler::pushResult(PSCompiledStack *stk, PSInstrOp op,
+			     PSCompiledType type,
+			     PSCompiledValue *v1, PSCompiledValue *v2) {
+  PSCompiledValue result;
+  PSInstr instr;
+  double r[3];
+
+  result.type = type;
+  if (v1->isConst && v2->isConst) {
+    r[0] = v1->val;
+    r[1] = v2->val;
+    r[2] = 0;
+    instr.op = op;
+    instr.dst = 2;
+    instr.a = 0;
+    instr.b = 1;
+    psExecInstr(&instr, r);
+    result.isConst = gTrue;
+    result.val = r[2];
+  } else {
+    result.isConst = gFalse;
+    result.reg = newReg(0);
+    emit(op, result.reg, getReg(v1), getReg(v2));
   }
+  return push(stk, &result);
+}
+
+GBool PSCompiler::pop(PSCompiledStack *stk, PSCompiledValue *v) {
+  if (stk->depth == 0) {
+    return gFalse;
+  }
+  *v = stk->stack[--stk->depth];
+  return gTrue;
+}
+
+GBool PSCompiler::push(PSCompiledStack *stk, PSCompiledValue *v) {
+  if (stk->depth == psStackSize) {
+    return gFalse;
+  }
+  stk->stack[stk->depth++] = *v;
+  return gTrue;
+}
+
+// The operands of copy, index, and roll have to be known when
+// compiling.
+GBool PSCompiler::popConstInt(PSCompiledStack *stk, int *i) {
+  PSCompiledValue v;
+
+  if (!pop(stk, &v) || v.type != psTypeInt || !v.isConst) {
+    return gFalse;
+  }
+  *i = (int)v.val;
+  return gTrue;
+}
+
+int PSCompiler::getReg(PSCompiledValue *v) {
+  int i;
+
+  if (!v->isConst) {
+    return v->reg;
+  }
+  for (i = 0; i < nConsts; ++i) {
+    if (!memcmp(&regs[consts[i]], &v->val, sizeof(double))) {
+      return consts[i];
+    }
+  }
+  if (nConsts == constsSize) {
+    constsSize += 16;
+    consts = (int *)greallocn(consts, constsSize, sizeof(int));
+  }
+  consts[nConsts] = newReg(v->val);
+  return consts[nConsts++];
+}
+
+int PSCompiler::emit(PSInstrOp op, int dst, int a, int b) {
+  if (nInstrs == instrsSize) {
+    instrsSize += 64;
+    instrs = (PSInstr *)greallocn(instrs, instrsSize, sizeof(PSInstr));
+  }
+  instrs[nInstrs].op = op;
+  instrs[nInstrs].dst = dst;
+  instrs[nInstrs].a = a;
+  instrs[nInstrs].b = b;
+  return nInstrs++;
+}
+
+int PSCompiler::newReg(double val) {
+  if (nRegs == regsSize) {
+    regsSize += 64;
+    regs = (double *)greallocn(regs, regsSize, sizeof(double));
+  }
+  regs[nRegs] = val;
+  return nRegs++;
 }
 
 class PostScriptFunctionKey : public PopplerCacheKey
@@ -1108,6 +1870,11 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   codeSize = 0;
   ok = gFalse;
   cache = new PopplerCache(5);
+  instrs = NULL;
+  nInstrs = 0;
+  regs = NULL;
+  nRegs = 0;
+  outRegs = NULL;
 
   //----- initialize the generic stuff
   if (!init(dict)) {
@@ -1146,6 +1913,8 @@ PostScriptFunction::PostScriptFunction(Object *funcObj, Dict *dict) {
   
   stack = new PSStack();
 
+  compile();
+
  err2:
   str->close();
  err1:
@@ -1159,6 +1928,18 @@ PostScriptFunction::PostScriptFunction(PostScriptFunction *func) {
   codeString = func->codeString->copy();
   stack = new PSStack();
   memcpy(stack, func->stack, sizeof(PSStack));
+  if (func->instrs) {
+    instrs = (PSInstr *)gmallocn(nInstrs, sizeof(PSInstr));
+    memcpy(instrs, func->instrs, nInstrs * sizeof(PSInstr));
+  }
+  if (func->regs) {
+    regs = (double *)gmallocn(nRegs, sizeof(double));
+    memcpy(regs, func->regs, nRegs * sizeof(double));
+  }
+  if (func->outRegs) {
+    outRegs = (int *)gmallocn(n, sizeof(int));
+    memcpy(outRegs, func->outRegs, n * sizeof(int));
+  }
   
   cache = new PopplerCache(func->cache->size());
   for (int i = 0; i < func->cache->numberOfItems(); ++i)
@@ -1174,10 +1955,40 @@ PostScriptFunction::~PostScriptFunction() {
   delete codeString;
   delete stack;
   delete cache;
+  gfree(instrs);
+  gfree(regs);
+  gfree(outRegs);
 }
 
 void PostScriptFunction::transform(double *in, double *out) {
+  PSInstr *instr;
   int i;
+
+  if (outRegs) {
+    for (i = 0; i < m; ++i) {
+      regs[i] = in[i];
+    }
+    for (i = 0; i < nInstrs; ) {
+      instr = &instrs[i];
+      if (instr->op == psiJz) {
+	i = regs[instr->a] == 0 ? instr->b : i + 1;
+      } else if (instr->op == psiJmp) {
+	i = instr->b;
+      } else {
+	psExecInstr(instr, regs);
+	++i;
+      }
+    }
+    for (i = 0; i < n; ++i) {
+      out[i] = regs[outRegs[i]];
+      if (out[i] < range[i][0]) {
+	out[i] = range[i][0];
+      } else if (out[i] > range[i][1]) {
+	out[i] = range[i][1];
+      }
+    }
+    return;
+  }
   
   PostScriptFunctionKey key(m, in, false);
   PopplerCacheItem *item = cache->lookup(key);
@@ -1445,7 +2256,7 @@ void PostScriptFunction::exec(PSStack *stack, int codePtr) {
 	if (i2 > 0) {
 	  stack->pushInt(i1 << i2);
 	} else if (i2 < 0) {
-	  stack->pushInt((int)((Guint)i1 >> i2));
+	  stack->pushInt((int)((Guint)i1 >> -i2));
 	} else {
 	  stack->pushInt(i1);
 	}
@@ -1702,3 +2513,44 @@ void PostScriptFunction::exec(PSStack *stack, int codePtr) {
     }
   }
 }
+
+void PostScriptFunction::compile() {
+  PSCompiler *compiler;
+  PSCompiledStack *stk;
+  PSCompiledValue *v;
+  int i;
+
+  if (m > psStackSize) {
+    return;
+  }
+  compiler = new PSCompiler(code, m);
+  stk = new PSCompiledStack;
+  stk->depth = m;
+  for (i = 0; i < m; ++i) {
+    stk->stack[i].type = psTypeReal;
+    stk->stack[i].isConst = gFalse;
+    stk->stack[i].reg = i;
+  }
+  if (compiler->compileBlock(0, stk) && stk->depth >= n) {
+    outRegs = (int *)gmallocn(n, sizeof(int));
+    for (i = 0; i < n; ++i) {
+      v = &stk->stack[stk->depth - n + i];
+      if (v->type == psTypeBool) {
+	gfree(outRegs);
+	outRegs = NULL;
+	break;
+      }
+      outRegs[i] = compiler->getReg(v);
+    }
+    if (outRegs) {
+      instrs = compiler->instrs;
+      nInstrs = compiler->nInstrs;
+      regs = compiler->regs;
+      nRegs = compiler->nRegs;
+      compiler->instrs = NULL;
+      compiler->regs = NULL;
+    }
+  }
+  delete stk;
+  delete compiler;
+}
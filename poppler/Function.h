@@ -34,6 +34,7 @@ class Dict;
 class Stream;
 struct PSObject;
 class PSStack;
+struct PSInstr;
 class PopplerCache;
 
 //------------------------------------------------------------------------
@@ -232,6 +233,7 @@ private:
   GooString *getToken(Stream *str);
   void resizeCode(int newSize);
   void exec(PSStack *stack, int codePtr);
+  void compile();
 
   GooString *codeString;
   PSObject *code;
@@ -239,6 +241,15 @@ private:
   int codeSize;
   GBool ok;
   PopplerCache *cache;
+
+  // compiled form of the program (NULL if it couldn't be compiled,
+  // in which case the code is interpreted)
+  PSInstr *instrs;		// register instructions
+  int nInstrs;
+  double *regs;			// register file: inputs, constants, and
+				//   intermediate results
+  int nRegs;
+  int *outRegs;			// register holding each output [n]
 };
 
 #endif
@@ -51,6 +51,7 @@
 #include "goo/gmem.h"
 #include "goo/GooTimer.h"
 #include "goo/GooHash.h"
+#include "goo/GooArena.h"
 #include "GlobalParams.h"
 #include "CharTypes.h"
 #include "Object.h"
@@ -79,6 +80,10 @@
 // constants
 //------------------------------------------------------------------------
 
+// Max size of the arena holding the objects parsed from a page's
+// content streams; beyond this they are allocated on the heap.
+#define gfxArenaMaxSize (4 * 1024 * 1024)
+
 // Max recursive depth for a function shading fill.
 #define functionMaxDepth 6
 
@@ -539,6 +544,10 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, int pageNum, Dict *resDict, Catalog *cata
   formDepth = 0;
   abortCheckCbk = abortCheckCbkA;
   abortCheckCbkData = abortCheckCbkDataA;
+  for (i = 0; i < gfxOpCacheSize; ++i) {
+    opCache[i].atomID = -1;
+  }
+  arena = new GooArena(gfxArenaMaxSize);
 
   // set crop box
   if (cropBox) {
@@ -590,6 +599,10 @@ Gfx::Gfx(XRef *xrefA, OutputDev *outA, Dict *resDict, Catalog *catalogA,
   formDepth = 0;
   abortCheckCbk = abortCheckCbkA;
   abortCheckCbkData = abortCheckCbkDataA;
+  for (i = 0; i < gfxOpCacheSize; ++i) {
+    opCache[i].atomID = -1;
+  }
+  arena = new GooArena(gfxArenaMaxSize);
 
   // set crop box
   if (cropBox) {
@@ -625,9 +638,11 @@ Gfx::~Gfx() {
   while (mcStack) {
     popMarkedContent();
   }
+  delete arena;
 }
 
 void Gfx::display(Object *obj, GBool topLevel) {
+  Lexer *lexer;
   Object obj2;
   int i;
 
@@ -645,7 +660,9 @@ void Gfx::display(Object *obj, GBool topLevel) {
     error(-1, "Weird page contents");
     return;
   }
-  parser = new Parser(xref, new Lexer(xref, obj), gFalse);
+  lexer = new Lexer(xref, obj);
+  lexer->setArena(arena);
+  parser = new Parser(xref, lexer, gFalse);
   go(topLevel);
   delete parser;
   parser = NULL;
@@ -776,13 +793,25 @@ void Gfx::go(GBool topLevel) {
 
 void Gfx::execOp(Object *cmd, Object args[], int numArgs) {
   Operator *op;
+  GfxOpCacheEntry *cacheEntry;
   char *name;
   Object *argPtr;
-  int i;
+  int id, i;
 
-  // find operator
+  // find operator: command names are atoms, so the binary search only
+  // needs to be done once for each operator
   name = cmd->getCmd();
-  if (!(op = findOp(name))) {
+  if ((id = cmd->getCmdID()) >= 0) {
+    cacheEntry = &opCache[id & (gfxOpCacheSize - 1)];
+    if (cacheEntry->atomID != id) {
+      cacheEntry->atomID = id;
+      cacheEntry->op = findOp(name);
+    }
+    op = cacheEntry->op;
+  } else {
+    op = findOp(name);
+  }
+  if (!op) {
     if (ignoreUndef == 0)
       error(getPos(), "Unknown operator '%s'", name);
     return;
@@ -3060,6 +3089,11 @@ void Gfx::doGouraudTriangleShFill(GfxGouraudTriangleShading *shading) {
   GfxColor color0, color1, color2;
   int i;
 
+  if (out->useShadedFills() &&
+      out->gouraudTriangleShadedFill(state, shading)) {
+    return;
+  }
+
   for (i = 0; i < shading->getNTriangles(); ++i) {
     shading->getTriangle(i, &x0, &y0, &color0,
 			 &x1, &y1, &color1,
@@ -3121,6 +3155,11 @@ void Gfx::gouraudFillTriangle(double x0, double y0, GfxColor *color0,
 void Gfx::doPatchMeshShFill(GfxPatchMeshShading *shading) {
   int start, i;
 
+  if (out->useShadedFills() &&
+      out->patchMeshShadedFill(state, shading)) {
+    return;
+  }
+
   if (shading->getNPatches() > 128) {
     start = 3;
   } else if (shading->getNPatches() > 64) {
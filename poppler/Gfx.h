@@ -44,6 +44,7 @@ class XRef;
 class Array;
 class Stream;
 class Parser;
+class GooArena;
 class Dict;
 class Function;
 class OutputDev;
@@ -98,6 +99,14 @@ struct Operator {
   void (Gfx::*func)(Object args[], int numArgs);
 };
 
+// Number of entries in the operator cache (must be a power of 2).
+#define gfxOpCacheSize 256
+
+struct GfxOpCacheEntry {
+  int atomID;			// atom ID of the operator name, or -1
+  Operator *op;			// operator, or NULL if unknown
+};
+
 //------------------------------------------------------------------------
 
 class GfxResources {
@@ -211,6 +220,8 @@ private:
   MarkedContentStack *mcStack;	// current BMC/EMC stack
 
   Parser *parser;		// parser for page content stream(s)
+  GooArena *arena;		// arena for objects parsed from the
+				//   content stream(s), freed with the Gfx
  
 #ifdef USE_CMS
   PopplerCache iccColorSpaceCache;
@@ -221,6 +232,8 @@ private:
   void *abortCheckCbkData;
 
   static Operator opTab[];	// table of operators
+  GfxOpCacheEntry		// operators, looked up by atom ID
+    opCache[gfxOpCacheSize];
 
   void go(GBool topLevel);
   void execOp(Object *cmd, Object args[], int numArgs);
@@ -47,6 +47,14 @@
 #include "GlobalParams.h"
 #include "PopplerCache.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2_COLOR_LINES 1
+#else
+#define USE_SSE2_COLOR_LINES 0
+#endif
+
 //------------------------------------------------------------------------
 
 GBool Matrix::invertTo(Matrix *other)
@@ -254,6 +262,59 @@ void GfxColorSpace::getDefaultRanges(double *decodeLow, double *decodeRange,
   }
 }
 
+void GfxColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+				    int length) {
+  GfxColor color;
+  GfxGray gray;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (i = 0; i < length; ++i, in += nComps) {
+    for (j = 0; j < nComps; ++j) {
+      color.c[j] = in[j];
+    }
+    getGray(&color, &gray);
+    *out++ = colToByte(gray);
+  }
+}
+
+void GfxColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+				   int length) {
+  GfxColor color;
+  GfxRGB rgb;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (i = 0; i < length; ++i, in += nComps) {
+    for (j = 0; j < nComps; ++j) {
+      color.c[j] = in[j];
+    }
+    getRGB(&color, &rgb);
+    *out++ = colToByte(rgb.r);
+    *out++ = colToByte(rgb.g);
+    *out++ = colToByte(rgb.b);
+  }
+}
+
+void GfxColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+				    int length) {
+  GfxColor color;
+  GfxCMYK cmyk;
+  int nComps, i, j;
+
+  nComps = getNComps();
+  for (i = 0; i < length; ++i, in += nComps) {
+    for (j = 0; j < nComps; ++j) {
+      color.c[j] = in[j];
+    }
+    getCMYK(&color, &cmyk);
+    *out++ = colToByte(cmyk.c);
+    *out++ = colToByte(cmyk.m);
+    *out++ = colToByte(cmyk.y);
+    *out++ = colToByte(cmyk.k);
+  }
+}
+
 int GfxColorSpace::getNumColorSpaceModes() {
   return nGfxColorSpaceModes;
 }
@@ -787,6 +848,49 @@ void GfxDeviceRGBColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+void GfxDeviceRGBColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+					     int length) {
+  int i;
+
+  for (i = 0; i < length; ++i, in += 3) {
+    out[i] = colToByte(clip01((GfxColorComp)(0.3 * in[0] +
+					     0.59 * in[1] +
+					     0.11 * in[2] + 0.5)));
+  }
+}
+
+void GfxDeviceRGBColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					    int length) {
+  int i;
+
+  for (i = 0; i < 3 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
+void GfxDeviceRGBColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					     int length) {
+  GfxColorComp c, m, y, k;
+  int i;
+
+  for (i = 0; i < length; ++i, in += 3, out += 4) {
+    c = clip01(gfxColorComp1 - in[0]);
+    m = clip01(gfxColorComp1 - in[1]);
+    y = clip01(gfxColorComp1 - in[2]);
+    k = c;
+    if (m < k) {
+      k = m;
+    }
+    if (y < k) {
+      k = y;
+    }
+    out[0] = colToByte(c - k);
+    out[1] = colToByte(m - k);
+    out[2] = colToByte(y - k);
+    out[3] = colToByte(k);
+  }
+}
+
 void GfxDeviceRGBColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   color->c[1] = 0;
@@ -1060,6 +1164,160 @@ void GfxDeviceCMYKColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = clip01(color->c[3]);
 }
 
+void GfxDeviceCMYKColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+					      int length) {
+  int i;
+
+  for (i = 0; i < length; ++i, in += 4) {
+    out[i] = colToByte(clip01((GfxColorComp)(gfxColorComp1 - in[3]
+					     - 0.3  * in[0]
+					     - 0.59 * in[1]
+					     - 0.11 * in[2] + 0.5)));
+  }
+}
+
+#if USE_SSE2_COLOR_LINES
+
+// cmykToRGBMatrixMultiplication() for two colors at once.  This does
+// the same operations in the same order, so the results are the same.
+// The products of c, m, and y (or 1 - c, ...) are shared between the
+// corners: c1 * m1 * y1 * k1 is ((c1 * m1) * y1) * k1.
+static inline void cmykToRGBMatrixMultiplicationSSE2(__m128d c, __m128d m,
+						     __m128d y, __m128d k,
+						     __m128d *r, __m128d *g,
+						     __m128d *b) {
+  __m128d one, c1, m1, y1, k1, cm[4], cmy[8], x, rr, gg, bb;
+  int i;
+
+  one = _mm_set1_pd(1);
+  c1 = _mm_sub_pd(one, c);
+  m1 = _mm_sub_pd(one, m);
+  y1 = _mm_sub_pd(one, y);
+  k1 = _mm_sub_pd(one, k);
+  cm[0] = _mm_mul_pd(c1, m1);
+  cm[1] = _mm_mul_pd(c1, m);
+  cm[2] = _mm_mul_pd(c, m1);
+  cm[3] = _mm_mul_pd(c, m);
+  for (i = 0; i < 4; ++i) {
+    cmy[2*i] = _mm_mul_pd(cm[i], y1);
+    cmy[2*i+1] = _mm_mul_pd(cm[i], y);
+  }
+
+#define cmykAdd(acc, w) acc = _mm_add_pd(acc, _mm_mul_pd(_mm_set1_pd(w), x))
+  x = _mm_mul_pd(cmy[0], k1); // 0 0 0 0
+  rr = gg = bb = x;
+  x = _mm_mul_pd(cmy[0], k);  // 0 0 0 1
+  cmykAdd(rr, 0.1373);
+  cmykAdd(gg, 0.1216);
+  cmykAdd(bb, 0.1255);
+  x = _mm_mul_pd(cmy[1], k1); // 0 0 1 0
+  rr = _mm_add_pd(rr, x);
+  cmykAdd(gg, 0.9490);
+  x = _mm_mul_pd(cmy[1], k);  // 0 0 1 1
+  cmykAdd(rr, 0.1098);
+  cmykAdd(gg, 0.1020);
+  x = _mm_mul_pd(cmy[2], k1); // 0 1 0 0
+  cmykAdd(rr, 0.9255);
+  cmykAdd(bb, 0.5490);
+  x = _mm_mul_pd(cmy[2], k);  // 0 1 0 1
+  cmykAdd(rr, 0.1412);
+  x = _mm_mul_pd(cmy[3], k1); // 0 1 1 0
+  cmykAdd(rr, 0.9294);
+  cmykAdd(gg, 0.1098);
+  cmykAdd(bb, 0.1412);
+  x = _mm_mul_pd(cmy[3], k);  // 0 1 1 1
+  cmykAdd(rr, 0.1333);
+  x = _mm_mul_pd(cmy[4], k1); // 1 0 0 0
+  cmykAdd(gg, 0.6784);
+  cmykAdd(bb, 0.9373);
+  x = _mm_mul_pd(cmy[4], k);  // 1 0 0 1
+  cmykAdd(gg, 0.0588);
+  cmykAdd(bb, 0.1412);
+  x = _mm_mul_pd(cmy[5], k1); // 1 0 1 0
+  cmykAdd(gg, 0.6510);
+  cmykAdd(bb, 0.3137);
+  x = _mm_mul_pd(cmy[5], k);  // 1 0 1 1
+  cmykAdd(gg, 0.0745);
+  x = _mm_mul_pd(cmy[6], k1); // 1 1 0 0
+  cmykAdd(rr, 0.1804);
+  cmykAdd(gg, 0.1922);
+  cmykAdd(bb, 0.5725);
+  x = _mm_mul_pd(cmy[6], k);  // 1 1 0 1
+  cmykAdd(bb, 0.0078);
+  x = _mm_mul_pd(cmy[7], k1); // 1 1 1 0
+  cmykAdd(rr, 0.2118);
+  cmykAdd(gg, 0.2119);
+  cmykAdd(bb, 0.2235);
+#undef cmykAdd
+
+  *r = rr;
+  *g = gg;
+  *b = bb;
+}
+
+// Store dblToCol() of both colors in <out>.
+static inline void dblToColSSE2(__m128d x, GfxColorComp *out) {
+  __m128i i;
+
+  i = _mm_cvttpd_epi32(_mm_mul_pd(x, _mm_set1_pd(gfxColorComp1)));
+  out[0] = _mm_cvtsi128_si32(i);
+  out[1] = _mm_cvtsi128_si32(_mm_srli_si128(i, 4));
+}
+
+#endif // USE_SSE2_COLOR_LINES
+
+void GfxDeviceCMYKColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					     int length) {
+  double c, m, y, k, c1, m1, y1, k1, r, g, b;
+  int i;
+
+  i = 0;
+#if USE_SSE2_COLOR_LINES
+  __m128d cc, mm, yy, kk, rr, gg, bb;
+  GfxColorComp rc[2], gc[2], bc[2];
+
+  for (; i + 1 < length; i += 2, in += 8, out += 6) {
+    cc = _mm_set_pd(colToDbl(in[4]), colToDbl(in[0]));
+    mm = _mm_set_pd(colToDbl(in[5]), colToDbl(in[1]));
+    yy = _mm_set_pd(colToDbl(in[6]), colToDbl(in[2]));
+    kk = _mm_set_pd(colToDbl(in[7]), colToDbl(in[3]));
+    cmykToRGBMatrixMultiplicationSSE2(cc, mm, yy, kk, &rr, &gg, &bb);
+    dblToColSSE2(rr, rc);
+    dblToColSSE2(gg, gc);
+    dblToColSSE2(bb, bc);
+    out[0] = colToByte(clip01(rc[0]));
+    out[1] = colToByte(clip01(gc[0]));
+    out[2] = colToByte(clip01(bc[0]));
+    out[3] = colToByte(clip01(rc[1]));
+    out[4] = colToByte(clip01(gc[1]));
+    out[5] = colToByte(clip01(bc[1]));
+  }
+#endif
+  for (; i < length; ++i, in += 4, out += 3) {
+    c = colToDbl(in[0]);
+    m = colToDbl(in[1]);
+    y = colToDbl(in[2]);
+    k = colToDbl(in[3]);
+    c1 = 1 - c;
+    m1 = 1 - m;
+    y1 = 1 - y;
+    k1 = 1 - k;
+    cmykToRGBMatrixMultiplication(c, m, y, k, c1, m1, y1, k1, r, g, b);
+    out[0] = colToByte(clip01(dblToCol(r)));
+    out[1] = colToByte(clip01(dblToCol(g)));
+    out[2] = colToByte(clip01(dblToCol(b)));
+  }
+}
+
+void GfxDeviceCMYKColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					      int length) {
+  int i;
+
+  for (i = 0; i < 4 * length; ++i) {
+    out[i] = colToByte(clip01(in[i]));
+  }
+}
+
 void GfxDeviceCMYKColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   color->c[1] = 0;
@@ -1286,6 +1544,85 @@ void GfxLabColorSpace::getCMYK(GfxColor *color, GfxCMYK *cmyk) {
   cmyk->k = k;
 }
 
+GBool GfxLabColorSpace::useByteLines() {
+#ifdef USE_CMS
+  return XYZ2DisplayTransform == NULL;
+#else
+  return gTrue;
+#endif
+}
+
+// This does what getRGB does, except that the gamma correction uses
+// sqrt(x) instead of pow(x, 0.5), which can differ in the last bit.
+void GfxLabColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+				      int length) {
+  GfxColor color;
+  double X, Y, Z;
+  double r, g, b;
+  int i;
+
+#ifdef USE_CMS
+  if (XYZ2DisplayTransform != NULL) {
+    GfxColorSpace::getRGBByteLine(in, out, length);
+    return;
+  }
+#endif
+  i = 0;
+#if USE_SSE2_COLOR_LINES
+  __m128d xx, yy, zz, rr, gg, bb, zero, one;
+  GfxColorComp rc[2], gc[2], bc[2];
+  double X2, Y2, Z2;
+
+  zero = _mm_setzero_pd();
+  one = _mm_set1_pd(1);
+  for (; i + 1 < length; i += 2, in += 6, out += 6) {
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    getXYZ(&color, &X, &Y, &Z);
+    color.c[0] = in[3];
+    color.c[1] = in[4];
+    color.c[2] = in[5];
+    getXYZ(&color, &X2, &Y2, &Z2);
+    xx = _mm_mul_pd(_mm_set_pd(X2, X), _mm_set1_pd(whiteX));
+    yy = _mm_mul_pd(_mm_set_pd(Y2, Y), _mm_set1_pd(whiteY));
+    zz = _mm_mul_pd(_mm_set_pd(Z2, Z), _mm_set1_pd(whiteZ));
+#define labMatrixRow(row)						\
+    _mm_add_pd(_mm_add_pd(_mm_mul_pd(_mm_set1_pd(xyzrgb[row][0]), xx),	\
+			  _mm_mul_pd(_mm_set1_pd(xyzrgb[row][1]), yy)),	\
+	       _mm_mul_pd(_mm_set1_pd(xyzrgb[row][2]), zz))
+    rr = _mm_mul_pd(labMatrixRow(0), _mm_set1_pd(kr));
+    gg = _mm_mul_pd(labMatrixRow(1), _mm_set1_pd(kg));
+    bb = _mm_mul_pd(labMatrixRow(2), _mm_set1_pd(kb));
+#undef labMatrixRow
+    dblToColSSE2(_mm_sqrt_pd(_mm_min_pd(_mm_max_pd(rr, zero), one)), rc);
+    dblToColSSE2(_mm_sqrt_pd(_mm_min_pd(_mm_max_pd(gg, zero), one)), gc);
+    dblToColSSE2(_mm_sqrt_pd(_mm_min_pd(_mm_max_pd(bb, zero), one)), bc);
+    out[0] = colToByte(rc[0]);
+    out[1] = colToByte(gc[0]);
+    out[2] = colToByte(bc[0]);
+    out[3] = colToByte(rc[1]);
+    out[4] = colToByte(gc[1]);
+    out[5] = colToByte(bc[1]);
+  }
+#endif
+  for (; i < length; ++i, in += 3, out += 3) {
+    color.c[0] = in[0];
+    color.c[1] = in[1];
+    color.c[2] = in[2];
+    getXYZ(&color, &X, &Y, &Z);
+    X *= whiteX;
+    Y *= whiteY;
+    Z *= whiteZ;
+    r = xyzrgb[0][0] * X + xyzrgb[0][1] * Y + xyzrgb[0][2] * Z;
+    g = xyzrgb[1][0] * X + xyzrgb[1][1] * Y + xyzrgb[1][2] * Z;
+    b = xyzrgb[2][0] * X + xyzrgb[2][1] * Y + xyzrgb[2][2] * Z;
+    out[0] = colToByte(dblToCol(sqrt(clip01(r * kr))));
+    out[1] = colToByte(dblToCol(sqrt(clip01(g * kg))));
+    out[2] = colToByte(dblToCol(sqrt(clip01(b * kb))));
+  }
+}
+
 void GfxLabColorSpace::getDefaultColor(GfxColor *color) {
   color->c[0] = 0;
   if (aMin > 0) {
@@ -1653,6 +1990,42 @@ GBool GfxICCBasedColorSpace::useGetRGBLine() {
 #endif
 }
 
+// Without a color management system, the alternate color space is used.
+GBool GfxICCBasedColorSpace::useByteLines() {
+#ifdef USE_CMS
+  return gFalse;
+#else
+  return alt->useByteLines();
+#endif
+}
+
+void GfxICCBasedColorSpace::getGrayByteLine(GfxColorComp *in, Guchar *out,
+					    int length) {
+#ifdef USE_CMS
+  GfxColorSpace::getGrayByteLine(in, out, length);
+#else
+  alt->getGrayByteLine(in, out, length);
+#endif
+}
+
+void GfxICCBasedColorSpace::getRGBByteLine(GfxColorComp *in, Guchar *out,
+					   int length) {
+#ifdef USE_CMS
+  GfxColorSpace::getRGBByteLine(in, out, length);
+#else
+  alt->getRGBByteLine(in, out, length);
+#endif
+}
+
+void GfxICCBasedColorSpace::getCMYKByteLine(GfxColorComp *in, Guchar *out,
+					    int length) {
+#ifdef USE_CMS
+  GfxColorSpace::getCMYKByteLine(in, out, length);
+#else
+  alt->getCMYKByteLine(in, out, length);
+#endif
+}
+
 void GfxICCBasedColorSpace::getDefaultColor(GfxColor *color) {
   int i;
 
@@ -2380,6 +2753,251 @@ GfxPattern *GfxShadingPattern::copy() {
   return new GfxShadingPattern(shading->copy(), matrix);
 }
 
+//------------------------------------------------------------------------
+// GfxShadingLUT
+//------------------------------------------------------------------------
+
+GfxShadingLUT::GfxShadingLUT(Function **funcsA, int nFuncsA,
+			     GfxColorSpace *colorSpaceA,
+			     double t0A, double t1A) {
+  GfxColor color;
+  GfxColorComp *c0, *c1;
+  int i, j;
+
+  funcs = funcsA;
+  nFuncs = nFuncsA;
+  colorSpace = colorSpaceA;
+  nComps = colorSpace->getNComps();
+  t0 = t0A;
+  t1 = t1A;
+  scale = t1 > t0 ? (gfxShadingLUTSize - 1) / (t1 - t0) : 0;
+  grays = rgbs = cmyks = NULL;
+
+  colors = (GfxColorComp *)gmallocn(gfxShadingLUTSize * nComps,
+				    sizeof(GfxColorComp));
+  for (i = 0; i < gfxShadingLUTSize; ++i) {
+    evalColor(scale > 0 ? t0 + i / scale : t0, &color);
+    for (j = 0; j < nComps; ++j) {
+      colors[i * nComps + j] = color.c[j];
+    }
+  }
+
+  // check the middle of each interval: if it is off by more than half
+  // an 8-bit step, the interval is evaluated directly
+  exact = (Guchar *)gmalloc(gfxShadingLUTSize - 1);
+  for (i = 0; i < gfxShadingLUTSize - 1; ++i) {
+    exact[i] = 0;
+    if (scale == 0) {
+      continue;
+    }
+    evalColor(t0 + (i + 0.5) / scale, &color);
+    c0 = &colors[i * nComps];
+    c1 = c0 + nComps;
+    for (j = 0; j < nComps; ++j) {
+      if (abs(color.c[j] - (c0[j] + c1[j]) / 2) > gfxColorComp1 / 512) {
+	exact[i] = 1;
+	break;
+      }
+    }
+  }
+}
+
+GfxShadingLUT::GfxShadingLUT(GfxShadingLUT *lut, Function **funcsA,
+			     GfxColorSpace *colorSpaceA) {
+  funcs = funcsA;
+  nFuncs = lut->nFuncs;
+  colorSpace = colorSpaceA;
+  nComps = lut->nComps;
+  t0 = lut->t0;
+  t1 = lut->t1;
+  scale = lut->scale;
+  colors = (GfxColorComp *)gmallocn(gfxShadingLUTSize * nComps,
+				    sizeof(GfxColorComp));
+  memcpy(colors, lut->colors,
+	 gfxShadingLUTSize * nComps * sizeof(GfxColorComp));
+  grays = rgbs = cmyks = NULL;
+  if (lut->grays) {
+    grays = (GfxColorComp *)gmallocn(gfxShadingLUTSize, sizeof(GfxColorComp));
+    memcpy(grays, lut->grays, gfxShadingLUTSize * sizeof(GfxColorComp));
+  }
+  if (lut->rgbs) {
+    rgbs = (GfxColorComp *)gmallocn(gfxShadingLUTSize * 3,
+				    sizeof(GfxColorComp));
+    memcpy(rgbs, lut->rgbs, gfxShadingLUTSize * 3 * sizeof(GfxColorComp));
+  }
+  if (lut->cmyks) {
+    cmyks = (GfxColorComp *)gmallocn(gfxShadingLUTSize * 4,
+				     sizeof(GfxColorComp));
+    memcpy(cmyks, lut->cmyks, gfxShadingLUTSize * 4 * sizeof(GfxColorComp));
+  }
+  exact = (Guchar *)gmalloc(gfxShadingLUTSize - 1);
+  memcpy(exact, lut->exact, gfxShadingLUTSize - 1);
+}
+
+GfxShadingLUT::~GfxShadingLUT() {
+  gfree(colors);
+  gfree(grays);
+  gfree(rgbs);
+  gfree(cmyks);
+  gfree(exact);
+}
+
+void GfxShadingLUT::evalColor(double t, GfxColor *color) {
+  double out[gfxColorMaxComps];
+  int i;
+
+  // NB: there can be one function with n outputs or n functions with
+  // one output each (where n = number of color components)
+  for (i = 0; i < gfxColorMaxComps; ++i) {
+    out[i] = 0;
+  }
+  for (i = 0; i < nFuncs; ++i) {
+    funcs[i]->transform(&t, &out[i]);
+  }
+  for (i = 0; i < gfxColorMaxComps; ++i) {
+    color->c[i] = dblToCol(out[i]);
+  }
+}
+
+void GfxShadingLUT::getEntry(int i, GfxColor *color) {
+  int j;
+
+  for (j = 0; j < nComps; ++j) {
+    color->c[j] = colors[i * nComps + j];
+  }
+  for (; j < gfxColorMaxComps; ++j) {
+    color->c[j] = 0;
+  }
+}
+
+// Find the entry <i> and the position <frac> in [0, 1] between entries
+// i and i + 1 for <t>.  Returns false if <t> must be evaluated
+// directly.
+GBool GfxShadingLUT::lookup(double t, int *i, double *frac) {
+  double x;
+
+  if (t0 == t1) {
+    *i = 0;
+    *frac = 0;
+    return gTrue;
+  }
+  if (t < t0 || t > t1) {
+    // outside the table (the functions may have a larger domain)
+    return gFalse;
+  }
+  x = (t - t0) * scale;
+  *i = (int)x;
+  if (*i >= gfxShadingLUTSize - 1) {
+    *i = gfxShadingLUTSize - 2;
+  }
+  *frac = x - *i;
+  return !exact[*i];
+}
+
+void GfxShadingLUT::interpolate(GfxColorComp *table, int n, int i,
+				double frac, GfxColorComp *out) {
+  GfxColorComp *c0, *c1;
+  int j;
+
+  c0 = &table[i * n];
+  c1 = c0 + n;
+  for (j = 0; j < n; ++j) {
+    out[j] = c0[j] + (GfxColorComp)(frac * (c1[j] - c0[j]));
+  }
+}
+
+void GfxShadingLUT::getColor(double t, GfxColor *color) {
+  double frac;
+  int i, j;
+
+  if (!lookup(t, &i, &frac)) {
+    evalColor(t, color);
+    return;
+  }
+  interpolate(colors, nComps, i, frac, color->c);
+  for (j = nComps; j < gfxColorMaxComps; ++j) {
+    color->c[j] = 0;
+  }
+}
+
+void GfxShadingLUT::getGray(double t, GfxGray *gray) {
+  GfxColor color;
+  double frac;
+  int i;
+
+  if (!grays) {
+    grays = (GfxColorComp *)gmallocn(gfxShadingLUTSize, sizeof(GfxColorComp));
+    for (i = 0; i < gfxShadingLUTSize; ++i) {
+      getEntry(i, &color);
+      colorSpace->getGray(&color, &grays[i]);
+    }
+  }
+  if (lookup(t, &i, &frac)) {
+    interpolate(grays, 1, i, frac, gray);
+  } else {
+    evalColor(t, &color);
+    colorSpace->getGray(&color, gray);
+  }
+}
+
+void GfxShadingLUT::getRGB(double t, GfxRGB *rgb) {
+  GfxColor color;
+  GfxColorComp c[3];
+  double frac;
+  int i;
+
+  if (!rgbs) {
+    rgbs = (GfxColorComp *)gmallocn(gfxShadingLUTSize * 3,
+				    sizeof(GfxColorComp));
+    for (i = 0; i < gfxShadingLUTSize; ++i) {
+      getEntry(i, &color);
+      colorSpace->getRGB(&color, rgb);
+      rgbs[i * 3] = rgb->r;
+      rgbs[i * 3 + 1] = rgb->g;
+      rgbs[i * 3 + 2] = rgb->b;
+    }
+  }
+  if (!lookup(t, &i, &frac)) {
+    evalColor(t, &color);
+    colorSpace->getRGB(&color, rgb);
+    return;
+  }
+  interpolate(rgbs, 3, i, frac, c);
+  rgb->r = c[0];
+  rgb->g = c[1];
+  rgb->b = c[2];
+}
+
+void GfxShadingLUT::getCMYK(double t, GfxCMYK *cmyk) {
+  GfxColor color;
+  GfxColorComp c[4];
+  double frac;
+  int i;
+
+  if (!cmyks) {
+    cmyks = (GfxColorComp *)gmallocn(gfxShadingLUTSize * 4,
+				     sizeof(GfxColorComp));
+    for (i = 0; i < gfxShadingLUTSize; ++i) {
+      getEntry(i, &color);
+      colorSpace->getCMYK(&color, cmyk);
+      cmyks[i * 4] = cmyk->c;
+      cmyks[i * 4 + 1] = cmyk->m;
+      cmyks[i * 4 + 2] = cmyk->y;
+      cmyks[i * 4 + 3] = cmyk->k;
+    }
+  }
+  if (!lookup(t, &i, &frac)) {
+    evalColor(t, &color);
+    colorSpace->getCMYK(&color, cmyk);
+    return;
+  }
+  interpolate(cmyks, 4, i, frac, c);
+  cmyk->c = c[0];
+  cmyk->m = c[1];
+  cmyk->y = c[2];
+  cmyk->k = c[3];
+}
+
 //------------------------------------------------------------------------
 // GfxShading
 //------------------------------------------------------------------------
@@ -2717,6 +3335,7 @@ GfxAxialShading::GfxAxialShading(double x0A, double y0A,
   }
   extend0 = extend0A;
   extend1 = extend1A;
+  lut = NULL;
 }
 
 GfxAxialShading::GfxAxialShading(GfxAxialShading *shading):
@@ -2736,11 +3355,14 @@ GfxAxialShading::GfxAxialShading(GfxAxialShading *shading):
   }
   extend0 = shading->extend0;
   extend1 = shading->extend1;
+  lut = shading->lut ? new GfxShadingLUT(shading->lut, funcs, colorSpace)
+                     : (GfxShadingLUT *)NULL;
 }
 
 GfxAxialShading::~GfxAxialShading() {
   int i;
 
+  delete lut;
   for (i = 0; i < nFuncs; ++i) {
     delete funcs[i];
   }
@@ -2836,20 +3458,14 @@ GfxShading *GfxAxialShading::copy() {
 }
 
 void GfxAxialShading::getColor(double t, GfxColor *color) {
-  double out[gfxColorMaxComps];
-  int i;
+  getLUT()->getColor(t, color);
+}
 
-  // NB: there can be one function with n outputs or n functions with
-  // one output each (where n = number of color components)
-  for (i = 0; i < gfxColorMaxComps; ++i) {
-    out[i] = 0;
-  }
-  for (i = 0; i < nFuncs; ++i) {
-    funcs[i]->transform(&t, &out[i]);
-  }
-  for (i = 0; i < gfxColorMaxComps; ++i) {
-    color->c[i] = dblToCol(out[i]);
+GfxShadingLUT *GfxAxialShading::getLUT() {
+  if (!lut) {
+    lut = new GfxShadingLUT(funcs, nFuncs, colorSpace, t0, t1);
   }
+  return lut;
 }
 
 //------------------------------------------------------------------------
@@ -2879,6 +3495,7 @@ GfxRadialShading::GfxRadialShading(double x0A, double y0A, double r0A,
   }
   extend0 = extend0A;
   extend1 = extend1A;
+  lut = NULL;
 }
 
 GfxRadialShading::GfxRadialShading(GfxRadialShading *shading):
@@ -2900,11 +3517,14 @@ GfxRadialShading::GfxRadialShading(GfxRadialShading *shading):
   }
   extend0 = shading->extend0;
   extend1 = shading->extend1;
+  lut = shading->lut ? new GfxShadingLUT(shading->lut, funcs, colorSpace)
+                     : (GfxShadingLUT *)NULL;
 }
 
 GfxRadialShading::~GfxRadialShading() {
   int i;
 
+  delete lut;
   for (i = 0; i < nFuncs; ++i) {
     delete funcs[i];
   }
@@ -3004,20 +3624,14 @@ GfxShading *GfxRadialShading::copy() {
 }
 
 void GfxRadialShading::getColor(double t, GfxColor *color) {
-  double out[gfxColorMaxComps];
-  int i;
+  getLUT()->getColor(t, color);
+}
 
-  // NB: there can be one function with n outputs or n functions with
-  // one output each (where n = number of color components)
-  for (i = 0; i < gfxColorMaxComps; ++i) {
-    out[i] = 0;
-  }
-  for (i = 0; i < nFuncs; ++i) {
-    funcs[i]->transform(&t, &out[i]);
-  }
-  for (i = 0; i < gfxColorMaxComps; ++i) {
-    color->c[i] = dblToCol(out[i]);
+GfxShadingLUT *GfxRadialShading::getLUT() {
+  if (!lut) {
+    lut = new GfxShadingLUT(funcs, nFuncs, colorSpace, t0, t1);
   }
+  return lut;
 }
 
 //------------------------------------------------------------------------
@@ -3423,6 +4037,7 @@ GfxPatchMeshShading::GfxPatchMeshShading(int typeA,
   for (i = 0; i < nFuncs; ++i) {
     funcs[i] = funcsA[i];
   }
+  lut = NULL;
 }
 
 GfxPatchMeshShading::GfxPatchMeshShading(GfxPatchMeshShading *shading):
@@ -3437,12 +4052,15 @@ GfxPatchMeshShading::GfxPatchMeshShading(GfxPatchMeshShading *shading):
   for (i = 0; i < nFuncs; ++i) {
     funcs[i] = shading->funcs[i]->copy();
   }
+  lut = shading->lut ? new GfxShadingLUT(shading->lut, funcs, colorSpace)
+                     : (GfxShadingLUT *)NULL;
 }
 
 GfxPatchMeshShading::~GfxPatchMeshShading() {
   int i;
 
   gfree(patches);
+  delete lut;
   for (i = 0; i < nFuncs; ++i) {
     delete funcs[i];
   }
@@ -3962,6 +4580,19 @@ GfxPatchMeshShading *GfxPatchMeshShading::parse(int typeA, Dict *dict,
   return NULL;
 }
 
+void GfxPatchMeshShading::getParameterizedColor(double t, GfxColor *color) {
+  getLUT()->getColor(t, color);
+}
+
+GfxShadingLUT *GfxPatchMeshShading::getLUT() {
+  if (!lut) {
+    lut = new GfxShadingLUT(funcs, nFuncs, colorSpace,
+			    funcs[0]->getDomainMin(0),
+			    funcs[0]->getDomainMax(0));
+  }
+  return lut;
+}
+
 GfxShading *GfxPatchMeshShading::copy() {
   return new GfxPatchMeshShading(this);
 }
@@ -4002,6 +4633,12 @@ GfxImageColorMap::GfxImageColorMap(int bitsA, Object *decode,
     lookup[k] = NULL;
   }
   byte_lookup = NULL;
+  for (k = 0; k < 3; ++k) {
+    byteLineLookup[k] = NULL;
+    byteLineKeys[k] = NULL;
+  }
+  compLine = NULL;
+  compLineSize = 0;
 
   // get decode map
   if (decode->isNull()) {
@@ -4138,6 +4775,12 @@ GfxImageColorMap::GfxImageColorMap(GfxImageColorMap *colorMap) {
   for (k = 0; k < gfxColorMaxComps; ++k) {
     lookup[k] = NULL;
   }
+  for (k = 0; k < 3; ++k) {
+    byteLineLookup[k] = NULL;
+    byteLineKeys[k] = NULL;
+  }
+  compLine = NULL;
+  compLineSize = 0;
   n = 1 << bits;
   if (colorSpace->getMode() == csIndexed) {
     colorSpace2 = ((GfxIndexedColorSpace *)colorSpace)->getBase();
@@ -4178,6 +4821,11 @@ GfxImageColorMap::~GfxImageColorMap() {
     gfree(lookup[i]);
   }
   gfree(byte_lookup);
+  for (i = 0; i < 3; ++i) {
+    gfree(byteLineLookup[i]);
+    gfree(byteLineKeys[i]);
+  }
+  gfree(compLine);
 }
 
 void GfxImageColorMap::getGray(Guchar *x, GfxGray *gray) {
@@ -4329,6 +4977,175 @@ void GfxImageColorMap::getColor(Guchar *x, GfxColor *color) {
   }
 }
 
+// getByteLine modes
+#define gfxByteLineGray 0
+#define gfxByteLineRGB  1
+#define gfxByteLineCMYK 2
+
+static const int gfxByteLineComps[3] = { 1, 3, 4 };
+
+// Size of the cache of converted pixels used by getByteLine for color
+// spaces without a line conversion of their own (DeviceN, CalRGB,
+// ...): 1 << gfxByteLineCacheBits entries.
+#define gfxByteLineCacheBits 10
+
+void GfxImageColorMap::getGrayByteLine(Guchar *in, Guchar *out, int length) {
+  getByteLine(in, out, length, gfxByteLineGray);
+}
+
+void GfxImageColorMap::getRGBByteLine(Guchar *in, Guchar *out, int length) {
+  getByteLine(in, out, length, gfxByteLineRGB);
+}
+
+void GfxImageColorMap::getCMYKByteLine(Guchar *in, Guchar *out, int length) {
+  getByteLine(in, out, length, gfxByteLineCMYK);
+}
+
+void GfxImageColorMap::getByteLine(Guchar *in, Guchar *out, int length,
+				   int mode) {
+  GfxColorComp *comp;
+  Guchar *table, *p, *val;
+  Guint *keys;
+  Guint key, h;
+  Guchar pix, zero[4];
+  int nOut, n, i, k;
+
+  nOut = gfxByteLineComps[mode];
+
+  //----- single-component images (gray, Indexed, Separation, ...):
+  //----- look up each pixel value in a table
+  if (nComps == 1) {
+    if (!(table = byteLineLookup[mode])) {
+      // (16-bit components are reduced to 8 bits by ImageStream)
+      n = (bits > 8) ? 256 : 1 << bits;
+      table = byteLineLookup[mode] = (Guchar *)gmallocn(n, nOut);
+      for (i = 0; i < n; ++i) {
+	pix = (Guchar)i;
+	getPixelBytes(&pix, mode, table + i * nOut);
+      }
+    }
+    switch (nOut) {
+    case 1:
+      for (i = 0; i < length; ++i) {
+	out[i] = table[in[i]];
+      }
+      break;
+    case 3:
+      for (i = 0; i < length; ++i, out += 3) {
+	val = &table[3 * in[i]];
+	out[0] = val[0];
+	out[1] = val[1];
+	out[2] = val[2];
+      }
+      break;
+    case 4:
+      for (i = 0; i < length; ++i, out += 4) {
+	val = &table[4 * in[i]];
+	out[0] = val[0];
+	out[1] = val[1];
+	out[2] = val[2];
+	out[3] = val[3];
+      }
+      break;
+    }
+    return;
+  }
+
+  //----- color spaces with a line conversion of their own: decode the
+  //----- components and convert the whole line
+  if (colorSpace->useByteLines()) {
+    n = length * nComps;
+    if (n > compLineSize) {
+      compLine = (GfxColorComp *)greallocn(compLine, n, sizeof(GfxColorComp));
+      compLineSize = n;
+    }
+    for (i = 0, p = in, comp = compLine; i < length; ++i) {
+      for (k = 0; k < nComps; ++k) {
+	*comp++ = lookup[k][*p++];
+      }
+    }
+    switch (mode) {
+    case gfxByteLineGray:
+      colorSpace->getGrayByteLine(compLine, out, length);
+      break;
+    case gfxByteLineRGB:
+      colorSpace->getRGBByteLine(compLine, out, length);
+      break;
+    case gfxByteLineCMYK:
+      colorSpace->getCMYKByteLine(compLine, out, length);
+      break;
+    }
+    return;
+  }
+
+  //----- other color spaces: convert each pixel, skipping repeated
+  //----- pixels
+  if (nComps > 4) {
+    for (i = 0, p = in; i < length; ++i, p += nComps, out += nOut) {
+      if (i > 0 && !memcmp(p, p - nComps, nComps)) {
+	memcpy(out, out - nOut, nOut);
+      } else {
+	getPixelBytes(p, mode, out);
+      }
+    }
+    return;
+  }
+
+  // with up to four components, keep a cache of converted pixels;
+  // it's initialized with the conversion of the all-zero pixel
+  if (!(keys = byteLineKeys[mode])) {
+    n = 1 << gfxByteLineCacheBits;
+    keys = byteLineKeys[mode] = (Guint *)gmallocn(n, sizeof(Guint));
+    table = byteLineLookup[mode] = (Guchar *)gmallocn(n, nOut);
+    memset(keys, 0, n * sizeof(Guint));
+    memset(zero, 0, sizeof(zero));
+    getPixelBytes(zero, mode, table);
+    for (i = 1; i < n; ++i) {
+      memcpy(table + i * nOut, table, nOut);
+    }
+  }
+  table = byteLineLookup[mode];
+  for (i = 0, p = in; i < length; ++i, p += nComps, out += nOut) {
+    key = 0;
+    for (k = 0; k < nComps; ++k) {
+      key = (key << 8) | p[k];
+    }
+    h = (Guint)(key * 2654435761u) >> (32 - gfxByteLineCacheBits);
+    val = &table[h * nOut];
+    if (keys[h] != key) {
+      getPixelBytes(p, mode, val);
+      keys[h] = key;
+    }
+    memcpy(out, val, nOut);
+  }
+}
+
+void GfxImageColorMap::getPixelBytes(Guchar *x, int mode, Guchar *out) {
+  GfxGray gray;
+  GfxRGB rgb;
+  GfxCMYK cmyk;
+
+  switch (mode) {
+  case gfxByteLineGray:
+    getGray(x, &gray);
+    out[0] = colToByte(gray);
+    break;
+  case gfxByteLineRGB:
+    getRGB(x, &rgb);
+    out[0] = colToByte(rgb.r);
+    out[1] = colToByte(rgb.g);
+    out[2] = colToByte(rgb.b);
+    break;
+  case gfxByteLineCMYK:
+    getCMYK(x, &cmyk);
+    out[0] = colToByte(cmyk.c);
+    out[1] = colToByte(cmyk.m);
+    out[2] = colToByte(cmyk.y);
+    out[3] = colToByte(cmyk.k);
+    break;
+  }
+}
+
 //------------------------------------------------------------------------
 // GfxSubpath and GfxPath
 //------------------------------------------------------------------------
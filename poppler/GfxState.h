@@ -193,6 +193,18 @@ public:
   // Does this ColorSpace use getGrayLine?
   virtual GBool useGetGrayLine() { return gFalse; }
 
+  // Convert a line of <length> colors, getNComps() components each,
+  // to 8-bit gray (one byte per color), RGB (three bytes), or CMYK
+  // (four bytes).  These give the same results as getGray, getRGB, and
+  // getCMYK followed by colToByte, which is what the default versions
+  // do.
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
+
+  // Are the *ByteLine functions faster than converting each color?
+  virtual GBool useByteLines() { return gFalse; }
+
   // Return the number of color components.
   virtual int getNComps() = 0;
 
@@ -310,9 +322,13 @@ public:
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
   virtual void getGrayLine(Guchar *in, Guchar *out, int length);
   virtual void getRGBLine(Guchar *in, unsigned int *out, int length);
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual GBool useGetRGBLine() { return gTrue; }
   virtual GBool useGetGrayLine() { return gTrue; }
+  virtual GBool useByteLines() { return gTrue; }
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -379,6 +395,11 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
+
+  virtual GBool useByteLines() { return gTrue; }
 
   virtual int getNComps() { return 4; }
   virtual void getDefaultColor(GfxColor *color);
@@ -404,6 +425,9 @@ public:
   virtual void getGray(GfxColor *color, GfxGray *gray);
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+
+  virtual GBool useByteLines();
 
   virtual int getNComps() { return 3; }
   virtual void getDefaultColor(GfxColor *color);
@@ -452,8 +476,12 @@ public:
   virtual void getRGB(GfxColor *color, GfxRGB *rgb);
   virtual void getCMYK(GfxColor *color, GfxCMYK *cmyk);
   virtual void getRGBLine(Guchar *in, unsigned int *out, int length);
+  virtual void getGrayByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getRGBByteLine(GfxColorComp *in, Guchar *out, int length);
+  virtual void getCMYKByteLine(GfxColorComp *in, Guchar *out, int length);
 
   virtual GBool useGetRGBLine();
+  virtual GBool useByteLines();
 
   virtual int getNComps() { return nComps; }
   virtual void getDefaultColor(GfxColor *color);
@@ -707,6 +735,62 @@ private:
   double matrix[6];
 };
 
+//------------------------------------------------------------------------
+// GfxShadingLUT
+//------------------------------------------------------------------------
+
+#define gfxShadingLUTSize 1024
+
+// Lookup table for the colors of a shading which depends on a single
+// parameter t (axial, radial, and parameterized patch mesh shadings).
+// The shading's Functions are evaluated once at gfxShadingLUTSize
+// evenly spaced values of t, and colors are interpolated linearly in
+// between.  Intervals where that isn't accurate (e.g., a sharp edge
+// between two stitched functions) are evaluated directly.  The
+// conversions to gray, RGB, and CMYK are tabulated on first use.
+class GfxShadingLUT {
+public:
+
+  // <funcsA> and <colorSpaceA> belong to the shading, and must live
+  // as long as the table.
+  GfxShadingLUT(Function **funcsA, int nFuncsA, GfxColorSpace *colorSpaceA,
+		double t0A, double t1A);
+
+  // Copy <lut>, for a copy of its shading with functions <funcsA> and
+  // color space <colorSpaceA>.
+  GfxShadingLUT(GfxShadingLUT *lut, Function **funcsA,
+		GfxColorSpace *colorSpaceA);
+
+  ~GfxShadingLUT();
+
+  void getColor(double t, GfxColor *color);
+  void getGray(double t, GfxGray *gray);
+  void getRGB(double t, GfxRGB *rgb);
+  void getCMYK(double t, GfxCMYK *cmyk);
+
+private:
+
+  GBool lookup(double t, int *i, double *frac);
+  void evalColor(double t, GfxColor *color);
+  void getEntry(int i, GfxColor *color);
+  void interpolate(GfxColorComp *table, int n, int i, double frac,
+		   GfxColorComp *out);
+
+  Function **funcs;
+  int nFuncs;
+  GfxColorSpace *colorSpace;
+  int nComps;
+  double t0, t1;
+  double scale;			// (gfxShadingLUTSize - 1) / (t1 - t0)
+  GfxColorComp *colors;		// [gfxShadingLUTSize * nComps]
+  GfxColorComp *grays;		// [gfxShadingLUTSize], or NULL
+  GfxColorComp *rgbs;		// [gfxShadingLUTSize * 3], or NULL
+  GfxColorComp *cmyks;		// [gfxShadingLUTSize * 4], or NULL
+  Guchar *exact;		// [gfxShadingLUTSize - 1]: set if the
+				//   interval after entry i must be
+				//   evaluated directly
+};
+
 //------------------------------------------------------------------------
 // GfxShading
 //------------------------------------------------------------------------
@@ -804,6 +888,9 @@ public:
   Function *getFunc(int i) { return funcs[i]; }
   void getColor(double t, GfxColor *color);
 
+  // Get the color lookup table, building it on first use.
+  GfxShadingLUT *getLUT();
+
 private:
 
   double x0, y0, x1, y1;
@@ -811,6 +898,7 @@ private:
   Function *funcs[gfxColorMaxComps];
   int nFuncs;
   GBool extend0, extend1;
+  GfxShadingLUT *lut;
 };
 
 //------------------------------------------------------------------------
@@ -843,6 +931,9 @@ public:
   Function *getFunc(int i) { return funcs[i]; }
   void getColor(double t, GfxColor *color);
 
+  // Get the color lookup table, building it on first use.
+  GfxShadingLUT *getLUT();
+
 private:
 
   double x0, y0, r0, x1, y1, r1;
@@ -850,6 +941,7 @@ private:
   Function *funcs[gfxColorMaxComps];
   int nFuncs;
   GBool extend0, extend1;
+  GfxShadingLUT *lut;
 };
 
 //------------------------------------------------------------------------
@@ -915,12 +1007,22 @@ public:
   int getNPatches() { return nPatches; }
   GfxPatch *getPatch(int i) { return &patches[i]; }
 
+  // If the shading has a Function, the patch colors hold a single
+  // parametric value t, which is mapped to a color here.
+  GBool isParameterized() { return nFuncs > 0; }
+  void getParameterizedColor(double t, GfxColor *color);
+
+  // Get the color lookup table of a parameterized shading, building
+  // it on first use.
+  GfxShadingLUT *getLUT();
+
 private:
 
   GfxPatch *patches;
   int nPatches;
   Function *funcs[gfxColorMaxComps];
   int nFuncs;
+  GfxShadingLUT *lut;
 };
 
 //------------------------------------------------------------------------
@@ -961,9 +1063,20 @@ public:
   void getCMYK(Guchar *x, GfxCMYK *cmyk);
   void getColor(Guchar *x, GfxColor *color);
 
+  // Convert a line of <length> image pixels to 8-bit gray (one byte
+  // per pixel), RGB (three bytes), or CMYK (four bytes), with the
+  // same results as getGray, getRGB, and getCMYK followed by
+  // colToByte.  Unlike getRGBLine and getGrayLine, these don't modify
+  // <in>.
+  void getGrayByteLine(Guchar *in, Guchar *out, int length);
+  void getRGBByteLine(Guchar *in, Guchar *out, int length);
+  void getCMYKByteLine(Guchar *in, Guchar *out, int length);
+
 private:
 
   GfxImageColorMap(GfxImageColorMap *colorMap);
+  void getByteLine(Guchar *in, Guchar *out, int length, int mode);
+  void getPixelBytes(Guchar *x, int mode, Guchar *out);
 
   GfxColorSpace *colorSpace;	// the image color space
   int bits;			// bits per component
@@ -973,6 +1086,13 @@ private:
   GfxColorComp *		// lookup table
     lookup[gfxColorMaxComps];
   Guchar *byte_lookup;
+  Guchar *			// for getByteLine, for each mode (gray,
+    byteLineLookup[3];		//   RGB, CMYK): the bytes for each pixel
+				//   value (single-component images), or
+				//   a cache of converted pixels
+  Guint *byteLineKeys[3];	// pixels in the byteLineLookup caches
+  GfxColorComp *compLine;	// decoded pixel components for a line
+  int compLineSize;
   double			// minimum values for each component
     decodeLow[gfxColorMaxComps];
   double			// max - min value for each component
@@ -687,6 +687,8 @@ GlobalParams::GlobalParams(const char *customPopplerDataDir)
   screenGamma = 1.0;
   screenBlackThreshold = 0.0;
   screenWhiteThreshold = 1.0;
+  glyphCacheSize = 8 * 1024 * 1024;
+  mapFiles = gFalse;
   mapNumericCharNames = gTrue;
   mapUnknownCharNames = gFalse;
   printCommands = gFalse;
@@ -1531,6 +1533,24 @@ double GlobalParams::getScreenWhiteThreshold() {
   return thresh;
 }
 
+int GlobalParams::getGlyphCacheSize() {
+  int size;
+
+  lockGlobalParams;
+  size = glyphCacheSize;
+  unlockGlobalParams;
+  return size;
+}
+
+GBool GlobalParams::getMapFiles() {
+  GBool map;
+
+  lockGlobalParams;
+  map = mapFiles;
+  unlockGlobalParams;
+  return map;
+}
+
 GBool GlobalParams::getMapNumericCharNames() {
   GBool map;
 
@@ -1648,6 +1668,7 @@ GooList *GlobalParams::getEncodingNames()
   GooHashIter *iter;
   GooString *key;
   void *val;
+  lockGlobalParams;
   residentUnicodeMaps->startIter(&iter);
   while (residentUnicodeMaps->getNext(&iter, &key, &val)) {
     result->append(key);
@@ -1658,6 +1679,7 @@ GooList *GlobalParams::getEncodingNames()
     result->append(key);
   }
   unicodeMaps->killIter(&iter);
+  unlockGlobalParams;
   return result;
 }
 
@@ -1849,6 +1871,20 @@ void GlobalParams::setScreenWhiteThreshold(double whiteThreshold)
   unlockGlobalParams;
 }
 
+void GlobalParams::setGlyphCacheSize(int size)
+{
+  lockGlobalParams;
+  glyphCacheSize = size;
+  unlockGlobalParams;
+}
+
+void GlobalParams::setMapFiles(GBool map)
+{
+  lockGlobalParams;
+  mapFiles = map;
+  unlockGlobalParams;
+}
+
 void GlobalParams::setMapNumericCharNames(GBool map) {
   lockGlobalParams;
   mapNumericCharNames = map;
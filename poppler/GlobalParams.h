@@ -214,6 +214,8 @@ public:
   double getScreenGamma();
   double getScreenBlackThreshold();
   double getScreenWhiteThreshold();
+  int getGlyphCacheSize();
+  GBool getMapFiles();
   GBool getMapNumericCharNames();
   GBool getMapUnknownCharNames();
   GBool getPrintCommands();
@@ -258,6 +260,8 @@ public:
   void setScreenGamma(double gamma);
   void setScreenBlackThreshold(double blackThreshold);
   void setScreenWhiteThreshold(double whiteThreshold);
+  void setGlyphCacheSize(int size);
+  void setMapFiles(GBool map);
   void setMapNumericCharNames(GBool map);
   void setMapUnknownCharNames(GBool map);
   void setPrintCommands(GBool printCommandsA);
@@ -342,6 +346,8 @@ private:
   double screenGamma;		// screen gamma correction
   double screenBlackThreshold;	// screen black clamping threshold
   double screenWhiteThreshold;	// screen white clamping threshold
+  int glyphCacheSize;		// glyph bitmap cache size, in bytes
+  GBool mapFiles;		// memory map PDF files (see MmapStream)?
   GBool mapNumericCharNames;	// map numeric char names (from font subsets)?
   GBool mapUnknownCharNames;	// map unknown char names?
   GBool printCommands;		// print the drawing commands
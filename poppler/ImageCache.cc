@@ -0,0 +1,323 @@
+//========================================================================
+//
+// ImageCache.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <limits.h>
+#include <string.h>
+#include "goo/gmem.h"
+#include "Object.h"
+#include "Stream.h"
+#include "ImageCache.h"
+
+//------------------------------------------------------------------------
+// ImageCacheEntry
+//------------------------------------------------------------------------
+
+struct ImageCacheEntry {
+  Ref ref;			// image XObject
+  int width, height;		// image parameters
+  int nComps, nBits;
+  Guchar *data;			// pixels, one byte per component
+  int size;			// size of <data>
+  int refCnt;			// number of ImageCacheStreams reading
+				//   <data>
+  GBool inCache;		// false once evicted
+  ImageCacheEntry *prev, *next;	// LRU list
+};
+
+//------------------------------------------------------------------------
+// ImageCacheStream
+//------------------------------------------------------------------------
+
+// Reads the pixels of a cache entry, holding a reference to it and to
+// the cache.
+class ImageCacheStream: public MemStream {
+public:
+
+  ImageCacheStream(ImageCache *cacheA, ImageCacheEntry *entryA, Object *dictA):
+    MemStream((char *)entryA->data, 0, entryA->size, dictA)
+    { cache = cacheA; entry = entryA; cache->incRef(); }
+  virtual ~ImageCacheStream();
+
+private:
+
+  ImageCache *cache;
+  ImageCacheEntry *entry;
+};
+
+ImageCacheStream::~ImageCacheStream() {
+  cache->releaseEntry(entry);
+  if (!cache->decRef()) {
+    delete cache;
+  }
+}
+
+//------------------------------------------------------------------------
+// ImageCache
+//------------------------------------------------------------------------
+
+ImageCache::ImageCache(int maxBytesA) {
+  first = last = NULL;
+  maxBytes = maxBytesA;
+  bytes = 0;
+  refCnt = 1;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
+}
+
+ImageCache::~ImageCache() {
+  clear();
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+int ImageCache::incRef() {
+  int n;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  n = ++refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return n;
+}
+
+int ImageCache::decRef() {
+  int n;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  n = --refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return n;
+}
+
+Stream *ImageCache::getPixelStream(Object *ref, Stream *str,
+				   int width, int height,
+				   int nComps, int nBits) {
+  ImageCacheEntry *entry, *e;
+  ImageStream *imgStr;
+  Object obj;
+  int rowSize, size, y;
+
+  if (!ref || !ref->isRef()) {
+    return NULL;
+  }
+
+  // only the expensive decoders are worth it -- for the others,
+  // copying the pixels in and out of the cache costs about as much as
+  // decoding them again
+  switch (str->getKind()) {
+  case strDCT:
+  case strJPX:
+  case strJBIG2:
+    break;
+  default:
+    return NULL;
+  }
+
+  if (width <= 0 || height <= 0 || nComps <= 0 ||
+      width > INT_MAX / nComps || height > INT_MAX / (width * nComps)) {
+    return NULL;
+  }
+  rowSize = width * nComps;
+  size = rowSize * height;
+
+  // look for the image in the cache -- but don't let a single image
+  // push out everything else
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  if (size > maxBytes / 4) {
+#if MULTITHREADED
+    gUnlockMutex(&mutex);
+#endif
+    return NULL;
+  }
+  for (entry = first; entry; entry = entry->next) {
+    if (entry->ref.num == ref->getRefNum() &&
+	entry->ref.gen == ref->getRefGen() &&
+	entry->width == width && entry->height == height &&
+	entry->nComps == nComps && entry->nBits == nBits) {
+      break;
+    }
+  }
+  if (entry) {
+    if (entry != first) {
+      entry->prev->next = entry->next;
+      if (entry->next) {
+	entry->next->prev = entry->prev;
+      } else {
+	last = entry->prev;
+      }
+      entry->prev = NULL;
+      entry->next = first;
+      first->prev = entry;
+      first = entry;
+    }
+    ++entry->refCnt;
+  }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (entry) {
+    obj.initNull();
+    return new ImageCacheStream(this, entry, &obj);
+  }
+
+  // decode the image -- this is done without holding the lock, so
+  // that other threads can use the cache meanwhile
+  entry = new ImageCacheEntry;
+  entry->ref = ref->getRef();
+  entry->width = width;
+  entry->height = height;
+  entry->nComps = nComps;
+  entry->nBits = nBits;
+  entry->data = (Guchar *)gmalloc(size);
+  entry->size = size;
+  entry->refCnt = 1;
+  entry->prev = NULL;
+  imgStr = new ImageStream(str, width, nComps, nBits);
+  imgStr->reset();
+  for (y = 0; y < height; ++y) {
+    memcpy(entry->data + y * rowSize, imgStr->getLine(), rowSize);
+  }
+  delete imgStr;
+
+  // add it, unless another thread got there first
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  for (e = first; e; e = e->next) {
+    if (e->ref.num == entry->ref.num && e->ref.gen == entry->ref.gen &&
+	e->width == width && e->height == height &&
+	e->nComps == nComps && e->nBits == nBits) {
+      break;
+    }
+  }
+  if (e || size > maxBytes / 4) {
+    entry->inCache = gFalse;
+    entry->next = NULL;
+  } else {
+    entry->inCache = gTrue;
+    entry->next = first;
+    if (first) {
+      first->prev = entry;
+    } else {
+      last = entry;
+    }
+    first = entry;
+    bytes += size;
+    evict(maxBytes);
+  }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+
+  obj.initNull();
+  return new ImageCacheStream(this, entry, &obj);
+}
+
+void ImageCache::setMaxBytes(int maxBytesA) {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  maxBytes = maxBytesA;
+  evict(maxBytes);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void ImageCache::removeImage(Ref ref) {
+  ImageCacheEntry *entry, *next;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  for (entry = first; entry; entry = next) {
+    next = entry->next;
+    if (entry->ref.num == ref.num && entry->ref.gen == ref.gen) {
+      removeEntry(entry);
+    }
+  }
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void ImageCache::clear() {
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  evict(0);
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+}
+
+void ImageCache::releaseEntry(ImageCacheEntry *entry) {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  done = --entry->refCnt == 0 && !entry->inCache;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  if (done) {
+    freeEntry(entry);
+  }
+}
+
+// Drop least recently used entries until the cache holds no more than
+// <limit> bytes.  Entries which are still being read are freed by
+// releaseEntry().  Called with the mutex held.
+void ImageCache::evict(int limit) {
+  while (bytes > limit && last) {
+    removeEntry(last);
+  }
+}
+
+// Take <entry> out of the cache, freeing it unless it is still being
+// read.  Called with the mutex held.
+void ImageCache::removeEntry(ImageCacheEntry *entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    first = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    last = entry->prev;
+  }
+  bytes -= entry->size;
+  entry->inCache = gFalse;
+  if (entry->refCnt == 0) {
+    freeEntry(entry);
+  }
+}
+
+void ImageCache::freeEntry(ImageCacheEntry *entry) {
+  gfree(entry->data);
+  delete entry;
+}
@@ -0,0 +1,104 @@
+//========================================================================
+//
+// ImageCache.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef IMAGECACHE_H
+#define IMAGECACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "poppler-config.h"
+#include "goo/gtypes.h"
+#include "Object.h"
+
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
+class Stream;
+class ImageCacheStream;
+struct ImageCacheEntry;
+
+// default size of a document's image cache, in bytes
+#define imageCacheDefaultSize (64 * 1024 * 1024)
+
+//------------------------------------------------------------------------
+// ImageCache
+//
+// Byte-budgeted LRU cache of decoded image XObjects, keyed by the
+// image's Ref.  Each entry holds the image's pixels as returned by
+// ImageStream::getLine(), i.e., one byte per component, so that logos
+// and watermarks which appear on every page are only run through the
+// DCT/JPX/JBIG2 decoder once.  Color conversion is left to the output
+// device, since it depends on the rendering mode.
+//
+// The cache is reference counted: the streams it returns hold a
+// reference, so that they stay usable after the PDFDoc which created
+// the cache is gone.
+//------------------------------------------------------------------------
+
+class ImageCache {
+public:
+
+  // Create a cache which holds up to <maxBytesA> bytes of pixel data.
+  // The reference count starts at 1.
+  ImageCache(int maxBytesA);
+
+  ~ImageCache();
+
+  // Reference counting.  The owner deletes the cache when decRef()
+  // returns 0.
+  int incRef();
+  int decRef();
+
+  // Return a stream which reads the pixels of the image XObject <ref>,
+  // one byte per component, so that it can be read with an 8-bit
+  // ImageStream in place of <str>.  If the image is not in the cache,
+  // it is decoded from <str> (which is reset but not closed) and
+  // added.  Returns NULL, without touching <str>, if the image is not
+  // worth caching: inline images (<ref> is not a Ref), cheap filters,
+  // or images too large for the cache.  The caller deletes the
+  // returned stream; it stays valid if the entry is evicted meanwhile.
+  // This may be called from several threads at once.
+  Stream *getPixelStream(Object *ref, Stream *str, int width, int height,
+			 int nComps, int nBits);
+
+  // Change the size limit, evicting entries as needed.  A size of 0
+  // disables the cache.
+  void setMaxBytes(int maxBytesA);
+  int getMaxBytes() { return maxBytes; }
+
+  // Remove the entries for the image XObject <ref>, e.g., because the
+  // object was changed.  Streams already reading them are not
+  // affected.
+  void removeImage(Ref ref);
+
+  // Remove all entries.
+  void clear();
+
+private:
+
+  friend class ImageCacheStream;
+
+  void releaseEntry(ImageCacheEntry *entry);
+  void evict(int limit);
+  void removeEntry(ImageCacheEntry *entry);
+  void freeEntry(ImageCacheEntry *entry);
+
+  ImageCacheEntry *first;	// most recently used entry
+  ImageCacheEntry *last;	// least recently used entry
+  int maxBytes;			// size limit
+  int bytes;			// pixel bytes held by the cache
+  int refCnt;			// reference count
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+#endif
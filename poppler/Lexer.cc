@@ -70,6 +70,7 @@ Lexer::Lexer(XRef *xrefA, Stream *str) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  arena = NULL;
 
   curStr.initStream(str);
   streams = new Array(xref);
@@ -77,6 +78,7 @@ Lexer::Lexer(XRef *xrefA, Stream *str) {
   strPtr = 0;
   freeArray = gTrue;
   curStr.streamReset();
+  curBuf = new BufStream(curStr.getStream());
 }
 
 Lexer::Lexer(XRef *xrefA, Object *obj) {
@@ -84,6 +86,7 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
 
   lookCharLastValueCached = LOOK_VALUE_NOT_CACHED;
   xref = xrefA;
+  arena = NULL;
 
   if (obj->isStream()) {
     streams = new Array(xref);
@@ -94,14 +97,17 @@ Lexer::Lexer(XRef *xrefA, Object *obj) {
     freeArray = gFalse;
   }
   strPtr = 0;
+  curBuf = NULL;
   if (streams->getLength() > 0) {
     streams->get(strPtr, &curStr);
     curStr.streamReset();
+    curBuf = new BufStream(curStr.getStream());
   }
 }
 
 Lexer::~Lexer() {
   if (!curStr.isNone()) {
+    delete curBuf;
     curStr.streamClose();
     curStr.free();
   }
@@ -120,16 +126,19 @@ int Lexer::getChar(GBool comesFromLook) {
   }
 
   c = EOF;
-  while (!curStr.isNone() && (c = curStr.streamGetChar()) == EOF) {
+  while (!curStr.isNone() && (c = curBuf->getByte()) == EOF) {
     if (comesFromLook == gTrue) {
       return EOF;
     } else {
+      delete curBuf;
+      curBuf = NULL;
       curStr.streamClose();
       curStr.free();
       ++strPtr;
       if (strPtr < streams->getLength()) {
         streams->get(strPtr, &curStr);
         curStr.streamReset();
+        curBuf = new BufStream(curStr.getStream());
       }
     }
   }
@@ -354,7 +363,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
 	  // we are growing see if the document is not malformed and we are growing too much
 	  if (objNum > 0 && xref != NULL)
 	  {
-	    int newObjNum = xref->getNumEntry(curStr.streamGetPos());
+	    int newObjNum = xref->getNumEntry(curBuf->getPos());
 	    if (newObjNum != objNum)
 	    {
 	      error(getPos(), "Unterminated string");
@@ -370,7 +379,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
     } while (!done);
     if (n >= 0) {
       if (!s)
-        s = new GooString(tokBuf, n);
+        s = GooString::create(arena, tokBuf, n);
       else
         s->append(tokBuf, n);
       obj->initString(s);
@@ -442,7 +451,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
   case ']':
     tokBuf[0] = c;
     tokBuf[1] = '\0';
-    obj->initCmd(tokBuf);
+    obj->initCmd(tokBuf, 1);
     break;
 
   // hex string or dict punctuation
@@ -454,7 +463,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
       getChar();
       tokBuf[0] = tokBuf[1] = '<';
       tokBuf[2] = '\0';
-      obj->initCmd(tokBuf);
+      obj->initCmd(tokBuf, 2);
 
     // hex string
     } else {
@@ -496,7 +505,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
 	}
       }
       if (!s)
-	s = new GooString(tokBuf, n);
+	s = GooString::create(arena, tokBuf, n);
       else
 	s->append(tokBuf, n);
       if (m == 1)
@@ -512,7 +521,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
       getChar();
       tokBuf[0] = tokBuf[1] = '>';
       tokBuf[2] = '\0';
-      obj->initCmd(tokBuf);
+      obj->initCmd(tokBuf, 2);
     } else {
       error(getPos(), "Illegal character '>'");
       obj->initError();
@@ -548,7 +557,7 @@ Object *Lexer::getObj(Object *obj, int objNum) {
     } else if (tokBuf[0] == 'n' && !strcmp(tokBuf, "null")) {
       obj->initNull();
     } else {
-      obj->initCmd(tokBuf);
+      obj->initCmd(tokBuf, p - tokBuf);
     }
     break;
   }
@@ -32,6 +32,7 @@
 #include "Stream.h"
 
 class XRef;
+class GooArena;
 
 #define tokBufSize 128		// size of token buffer
 
@@ -62,18 +63,26 @@ public:
   // Skip over one character.
   void skipChar() { getChar(); }
 
-  // Get stream.
+  // Get stream.  This is the lexer's read-ahead buffer on top of the
+  // current stream, so reading from it continues exactly where the
+  // lexer stopped.
   Stream *getStream()
-    { return curStr.isNone() ? (Stream *)NULL : curStr.getStream(); }
+    { return curStr.isNone() ? (Stream *)NULL : curBuf; }
 
   // Get current position in file.  This is only used for error
   // messages, so it returns an int instead of a Guint.
   int getPos()
-    { return curStr.isNone() ? -1 : (int)curStr.streamGetPos(); }
+    { return curStr.isNone() ? -1 : curBuf->getPos(); }
 
   // Set position in file.
   void setPos(Guint pos, int dir = 0)
-    { if (!curStr.isNone()) curStr.streamSetPos(pos, dir); }
+    { if (!curStr.isNone()) curBuf->setPos(pos, dir); }
+
+  // Allocate strings (and, in the Parser, arrays and dictionaries)
+  // from <arenaA> instead of the heap.  Objects returned by getObj
+  // must then not be used after the arena is deleted.
+  void setArena(GooArena *arenaA) { arena = arenaA; }
+  GooArena *getArena() { return arena; }
 
   // Returns true if <c> is a whitespace character.
   static GBool isSpace(int c);
@@ -96,8 +105,10 @@ private:
   Array *streams;		// array of input streams
   int strPtr;			// index of current stream
   Object curStr;		// current stream
+  BufStream *curBuf;		// read-ahead buffer for curStr
   GBool freeArray;		// should lexer free the streams array?
   char tokBuf[tokBufSize];	// temporary token buffer
+  GooArena *arena;		// arena for strings, or NULL
 
   XRef *xref;
 };
@@ -0,0 +1,127 @@
+//========================================================================
+//
+// Linearization.cc
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include "Object.h"
+#include "Stream.h"
+#include "Lexer.h"
+#include "Parser.h"
+#include "Linearization.h"
+
+// how far into the file to look for the end of the linearization
+// dictionary
+#define linSearchSize 4096
+
+//------------------------------------------------------------------------
+// Linearization
+//------------------------------------------------------------------------
+
+Linearization::Linearization(BaseStream *str) {
+  Parser *parser;
+  Stream *subStr;
+  Object obj1, obj2, obj3, obj4, obj5;
+  int c, i, n;
+
+  ok = gFalse;
+  length = 0;
+  objectNumberFirst = 0;
+  endFirst = 0;
+  numPages = 0;
+  mainXRefEntriesOffset = 0;
+  pageFirst = 0;
+  firstXRefPos = 0;
+
+  obj1.initNull();
+  parser = new Parser(NULL,
+	     new Lexer(NULL,
+	       str->makeSubStream(str->getStart(), gFalse, 0, &obj1)),
+	     gTrue);
+  parser->getObj(&obj1);
+  parser->getObj(&obj2);
+  parser->getObj(&obj3);
+  parser->getObj(&obj4);
+  if (obj1.isInt() && obj2.isInt() && obj3.isCmd("obj") &&
+      obj4.isDict()) {
+    obj4.dictLookup("Linearized", &obj5);
+    if (obj5.isNum() && obj5.getNum() > 0) {
+      ok = gTrue;
+    }
+    obj5.free();
+    if (ok) {
+      if (obj4.dictLookup("L", &obj5)->isInt() && obj5.getInt() > 0) {
+	length = (Guint)obj5.getInt();
+      }
+      obj5.free();
+      if (obj4.dictLookup("O", &obj5)->isInt() && obj5.getInt() > 0) {
+	objectNumberFirst = obj5.getInt();
+      }
+      obj5.free();
+      if (obj4.dictLookup("E", &obj5)->isInt() && obj5.getInt() > 0) {
+	endFirst = (Guint)obj5.getInt();
+      }
+      obj5.free();
+      if (obj4.dictLookup("N", &obj5)->isInt() && obj5.getInt() > 0) {
+	numPages = obj5.getInt();
+      }
+      obj5.free();
+      if (obj4.dictLookup("T", &obj5)->isInt() && obj5.getInt() > 0) {
+	mainXRefEntriesOffset = (Guint)obj5.getInt();
+      }
+      obj5.free();
+      if (obj4.dictLookup("P", &obj5)->isInt() && obj5.getInt() >= 0) {
+	pageFirst = obj5.getInt();
+      }
+      obj5.free();
+    }
+  }
+  obj4.free();
+  obj3.free();
+  obj2.free();
+  obj1.free();
+  delete parser;
+
+  if (!ok) {
+    return;
+  }
+
+  // the first-page xref section follows the dictionary's 'endobj' --
+  // the parser reads ahead, so look for it in the raw bytes
+  obj1.initNull();
+  subStr = str->makeSubStream(str->getStart(), gFalse, 0, &obj1);
+  subStr->reset();
+  i = 0;
+  for (n = 0; n < linSearchSize; ++n) {
+    if ((c = subStr->getChar()) == EOF) {
+      break;
+    }
+    if (c == "endobj"[i]) {
+      if (++i == 6) {
+	break;
+      }
+    } else {
+      i = (c == 'e') ? 1 : 0;
+    }
+  }
+  if (i == 6) {
+    while ((c = subStr->lookChar()) != EOF && Lexer::isSpace(c)) {
+      subStr->getChar();
+    }
+    if (c != EOF) {
+      firstXRefPos = (Guint)subStr->getPos() - str->getStart();
+    }
+  }
+  delete subStr;
+}
+
+Linearization::~Linearization() {
+}
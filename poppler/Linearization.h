@@ -0,0 +1,77 @@
+//========================================================================
+//
+// Linearization.h
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#ifndef LINEARIZATION_H
+#define LINEARIZATION_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "Object.h"
+
+class BaseStream;
+
+//------------------------------------------------------------------------
+// Linearization
+//
+// The linearization parameter dictionary of a linearized ("fast web
+// view") PDF file, which is the first object in the file.  It gives
+// the first page's page object and the number of pages, and is
+// followed directly by the first-page xref section, which covers the
+// objects needed to show the first page; the rest of the xref table is
+// at the end of the file.
+//------------------------------------------------------------------------
+
+class Linearization {
+public:
+
+  // Read the linearization dictionary at the start of <str>.
+  Linearization(BaseStream *str);
+
+  ~Linearization();
+
+  // Is the file linearized?
+  GBool isOk() { return ok; }
+
+  // Length of the file, /L.
+  Guint getLength() { return length; }
+
+  // Object number of the first page's page object, /O.
+  int getObjectNumberFirst() { return objectNumberFirst; }
+
+  // Offset of the end of the first page, /E.
+  Guint getEndFirst() { return endFirst; }
+
+  // Number of pages, /N.
+  int getNumPages() { return numPages; }
+
+  // Offset of the first entry in the main xref table, /T.
+  Guint getMainXRefEntriesOffset() { return mainXRefEntriesOffset; }
+
+  // Page number of the first page, /P.
+  int getPageFirst() { return pageFirst; }
+
+  // Offset of the first-page xref section (relative to the start of
+  // the file, as for the xref entries), or 0 if it couldn't be found.
+  Guint getFirstXRefPos() { return firstXRefPos; }
+
+private:
+
+  GBool ok;
+  Guint length;
+  int objectNumberFirst;
+  Guint endFirst;
+  int numPages;
+  Guint mainXRefEntriesOffset;
+  int pageFirst;
+  Guint firstXRefPos;
+};
+
+#endif
@@ -60,15 +60,15 @@ int Object::numAlloc[numObjTypes] =
   {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
 #endif
 
-Object *Object::initArray(XRef *xref) {
+Object *Object::initArray(XRef *xref, GooArena *arena) {
   initObj(objArray);
-  array = new Array(xref);
+  array = Array::create(xref, arena);
   return this;
 }
 
-Object *Object::initDict(XRef *xref) {
+Object *Object::initDict(XRef *xref, GooArena *arena) {
   initObj(objDict);
-  dict = new Dict(xref);
+  dict = Dict::create(xref, arena);
   return this;
 }
 
@@ -92,19 +92,29 @@ Object *Object::copy(Object *obj) {
     obj->string = string->copy();
     break;
   case objName:
-    obj->name = copyString(name);
+    obj->name = AtomTable::copy(name);
     break;
+  // arena objects don't outlive the arena's owner, so they are
+  // copied to the heap rather than shared
   case objArray:
-    array->incRef();
+    if (array->isInArena()) {
+      obj->array = new Array(array);
+    } else {
+      array->incRef();
+    }
     break;
   case objDict:
-    dict->incRef();
+    if (dict->isInArena()) {
+      obj->dict = new Dict(dict);
+    } else {
+      dict->incRef();
+    }
     break;
   case objStream:
     stream->incRef();
     break;
   case objCmd:
-    obj->cmd = copyString(cmd);
+    obj->cmd = AtomTable::copy(cmd);
     break;
   default:
     break;
@@ -123,19 +133,19 @@ Object *Object::fetch(XRef *xref, Object *obj) {
 void Object::free() {
   switch (type) {
   case objString:
-    delete string;
+    GooString::destroy(string);
     break;
   case objName:
-    gfree(name);
+    AtomTable::free(name);
     break;
   case objArray:
     if (!array->decRef()) {
-      delete array;
+      Array::destroy(array);
     }
     break;
   case objDict:
     if (!dict->decRef()) {
-      delete dict;
+      Dict::destroy(dict);
     }
     break;
   case objStream:
@@ -144,7 +154,7 @@ void Object::free() {
     }
     break;
   case objCmd:
-    gfree(cmd);
+    AtomTable::free(cmd);
     break;
   default:
     break;
@@ -35,6 +35,7 @@
 #include "goo/gtypes.h"
 #include "goo/gmem.h"
 #include "goo/GooString.h"
+#include "AtomTable.h"
 #include "Error.h"
 
 #if defined(__GNUC__) && (__GNUC__ > 2) && defined(__OPTIMIZE__)
@@ -60,6 +61,7 @@
     }
 
 class XRef;
+class GooArena;
 class Array;
 class Dict;
 class Stream;
@@ -130,17 +132,19 @@ public:
   Object *initString(GooString *stringA)
     { initObj(objString); string = stringA; return this; }
   Object *initName(char *nameA)
-    { initObj(objName); name = copyString(nameA); return this; }
+    { initObj(objName); name = AtomTable::intern(nameA); return this; }
   Object *initNull()
     { initObj(objNull); return this; }
-  Object *initArray(XRef *xref);
-  Object *initDict(XRef *xref);
+  Object *initArray(XRef *xref, GooArena *arena = NULL);
+  Object *initDict(XRef *xref, GooArena *arena = NULL);
   Object *initDict(Dict *dictA);
   Object *initStream(Stream *streamA);
   Object *initRef(int numA, int genA)
     { initObj(objRef); ref.num = numA; ref.gen = genA; return this; }
   Object *initCmd(char *cmdA)
-    { initObj(objCmd); cmd = copyString(cmdA); return this; }
+    { initObj(objCmd); cmd = AtomTable::intern(cmdA); return this; }
+  Object *initCmd(char *cmdA, int len)
+    { initObj(objCmd); cmd = AtomTable::intern(cmdA, len); return this; }
   Object *initError()
     { initObj(objError); return this; }
   Object *initEOF()
@@ -201,6 +205,10 @@ public:
   int getRefGen() { OBJECT_TYPE_CHECK(objRef); return ref.gen; }
   char *getCmd() { OBJECT_TYPE_CHECK(objCmd); return cmd; }
 
+  // Atom IDs of names and commands (see AtomTable).
+  int getNameID() { OBJECT_TYPE_CHECK(objName); return AtomTable::getID(name); }
+  int getCmdID() { OBJECT_TYPE_CHECK(objCmd); return AtomTable::getID(cmd); }
+
   // Array accessors.
   int arrayGetLength();
   void arrayAdd(Object *elem);
@@ -244,12 +252,12 @@ private:
     int intg;			//   integer
     double real;		//   real
     GooString *string;		//   string
-    char *name;			//   name
+    char *name;			//   name (atom)
     Array *array;		//   array
     Dict *dict;			//   dictionary
     Stream *stream;		//   stream
     Ref ref;			//   indirect reference
-    char *cmd;			//   command
+    char *cmd;			//   command (atom)
   };
 
 #ifdef DEBUG_MEM
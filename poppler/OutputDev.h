@@ -48,6 +48,8 @@ class GfxImageColorMap;
 class GfxFunctionShading;
 class GfxAxialShading;
 class GfxRadialShading;
+class GfxGouraudTriangleShading;
+class GfxPatchMeshShading;
 class Stream;
 class Links;
 class Link;
@@ -82,9 +84,11 @@ public:
   // operations.
   virtual GBool useTilingPatternFill() { return gFalse; }
 
-  // Does this device use functionShadedFill(), axialShadedFill(), and
-  // radialShadedFill()?  If this returns false, these shaded fills
-  // will be reduced to a series of other drawing operations.
+  // Does this device use functionShadedFill(), axialShadedFill(),
+  // radialShadedFill(), gouraudTriangleShadedFill(), and
+  // patchMeshShadedFill()?  If this returns false, or if the
+  // function returns false, these shaded fills will be reduced to a
+  // series of other drawing operations.
   virtual GBool useShadedFills() { return gFalse; }
 
   // Does this device use FillColorStop()?
@@ -208,6 +212,12 @@ public:
     { return gFalse; }
   virtual GBool radialShadedSupportExtend(GfxState * /*state*/, GfxRadialShading * /*shading*/)
     { return gFalse; }
+  virtual GBool gouraudTriangleShadedFill(GfxState * /*state*/,
+					  GfxGouraudTriangleShading * /*shading*/)
+    { return gFalse; }
+  virtual GBool patchMeshShadedFill(GfxState * /*state*/,
+				    GfxPatchMeshShading * /*shading*/)
+    { return gFalse; }
 
   //----- path clipping
   virtual void clip(GfxState * /*state*/) {}
@@ -59,6 +59,8 @@
 #include "Parser.h"
 #include "SecurityHandler.h"
 #include "Decrypt.h"
+#include "ImageCache.h"
+#include "Linearization.h"
 #ifndef DISABLE_OUTLINE
 #include "Outline.h"
 #endif
@@ -69,14 +71,32 @@
 #define headerSearchSize 1024	// read this many bytes at beginning of
 				//   file to look for '%PDF'
 
+// Create the base stream for an opened file: if enabled (see
+// GlobalParams::setMapFiles), regular files are memory mapped;
+// anything else (or a file that can't be mapped) is read through
+// stdio.
+static BaseStream *makeFileStream(FILE *file) {
+  MmapStream *mmapStr;
+  Object obj;
+
+  if (globalParams->getMapFiles()) {
+    obj.initNull();
+    mmapStr = new MmapStream(file, &obj);
+    if (mmapStr->isOk()) {
+      return mmapStr;
+    }
+    delete mmapStr;
+  }
+  obj.initNull();
+  return new FileStream(file, 0, gFalse, 0, &obj);
+}
+
 //------------------------------------------------------------------------
 // PDFDoc
 //------------------------------------------------------------------------
 
 PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
 	       GooString *userPassword, void *guiDataA) {
-  Object obj;
-
   ok = gFalse;
   errCode = errNone;
 
@@ -86,9 +106,13 @@ PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
   str = NULL;
   xref = NULL;
   catalog = NULL;
+  imageCache = NULL;
 #ifndef DISABLE_OUTLINE
   outline = NULL;
 #endif
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 
   fileName = fileNameA;
 
@@ -110,8 +134,7 @@ PDFDoc::PDFDoc(GooString *fileNameA, GooString *ownerPassword,
   }
 
   // create stream
-  obj.initNull();
-  str = new FileStream(file, 0, gFalse, 0, &obj);
+  str = makeFileStream(file);
 
   ok = setup(ownerPassword, userPassword);
 }
@@ -121,7 +144,6 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, GooString *ownerPassword,
 	       GooString *userPassword, void *guiDataA) {
   OSVERSIONINFO version;
   wchar_t fileName2[_MAX_PATH + 1];
-  Object obj;
   int i;
 
   ok = gFalse;
@@ -133,9 +155,13 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, GooString *ownerPassword,
   str = NULL;
   xref = NULL;
   catalog = NULL;
+  imageCache = NULL;
 #ifndef DISABLE_OUTLINE
   outline = NULL;
 #endif
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 
   //~ file name should be stored in Unicode (?)
   fileName = new GooString();
@@ -165,8 +191,7 @@ PDFDoc::PDFDoc(wchar_t *fileNameA, int fileNameLen, GooString *ownerPassword,
   }
 
   // create stream
-  obj.initNull();
-  str = new FileStream(file, 0, gFalse, 0, &obj);
+  str = makeFileStream(file);
 
   ok = setup(ownerPassword, userPassword);
 }
@@ -186,13 +211,19 @@ PDFDoc::PDFDoc(BaseStream *strA, GooString *ownerPassword,
   str = strA;
   xref = NULL;
   catalog = NULL;
+  imageCache = NULL;
 #ifndef DISABLE_OUTLINE
   outline = NULL;
+#endif
+#if MULTITHREADED
+  gInitMutex(&mutex);
 #endif
   ok = setup(ownerPassword, userPassword);
 }
 
 GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
+  Guint missing;
+
   str->setPos(0, -1);
   if (str->getPos() < 0)
   {
@@ -201,6 +232,7 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
   }
 
   str->reset();
+  missing = str->getMissingCount();
 
   // check footer
   // Adobe does not seem to enforce %%EOF, so we do the same
@@ -212,8 +244,10 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
   // read xref table
   xref = new XRef(str);
   if (!xref->isOk()) {
-    error(-1, "Couldn't read xref table");
     errCode = xref->getErrorCode();
+    if (errCode != errDataNotAvailable) {
+      error(-1, "Couldn't read xref table");
+    }
     return gFalse;
   }
 
@@ -222,20 +256,28 @@ GBool PDFDoc::setup(GooString *ownerPassword, GooString *userPassword) {
     errCode = errEncrypted;
     return gFalse;
   }
+  if (str->getMissingCount() != missing) {
+    // the encryption dictionary hasn't arrived yet
+    errCode = errDataNotAvailable;
+    return gFalse;
+  }
+
+  // set up the decoded image cache
+  imageCache = new ImageCache(imageCacheDefaultSize);
+  xref->setImageCache(imageCache);
 
   // read catalog
   catalog = new Catalog(xref);
   if (!catalog->isOk()) {
-    error(-1, "Couldn't read page catalog");
-    errCode = errBadCatalog;
+    if (str->getMissingCount() != missing) {
+      errCode = errDataNotAvailable;
+    } else {
+      error(-1, "Couldn't read page catalog");
+      errCode = errBadCatalog;
+    }
     return gFalse;
   }
 
-#ifndef DISABLE_OUTLINE
-  // read outline
-  outline = new Outline(catalog->getOutline(), xref);
-#endif
-
   // done
   return gTrue;
 }
@@ -252,6 +294,10 @@ PDFDoc::~PDFDoc() {
   if (xref) {
     delete xref;
   }
+  // (image streams which are still around keep the cache alive)
+  if (imageCache && !imageCache->decRef()) {
+    delete imageCache;
+  }
   if (str) {
     delete str;
   }
@@ -261,6 +307,9 @@ PDFDoc::~PDFDoc() {
   if (fileName) {
     delete fileName;
   }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
 }
 
 
@@ -366,6 +415,36 @@ GBool PDFDoc::checkEncryption(GooString *ownerPassword, GooString *userPassword)
   return ret;
 }
 
+double PDFDoc::getPageMediaWidth(int page) {
+  Page *p;
+
+  return (p = catalog->getPage(page)) ? p->getMediaWidth() : 0;
+}
+
+double PDFDoc::getPageMediaHeight(int page) {
+  Page *p;
+
+  return (p = catalog->getPage(page)) ? p->getMediaHeight() : 0;
+}
+
+double PDFDoc::getPageCropWidth(int page) {
+  Page *p;
+
+  return (p = catalog->getPage(page)) ? p->getCropWidth() : 0;
+}
+
+double PDFDoc::getPageCropHeight(int page) {
+  Page *p;
+
+  return (p = catalog->getPage(page)) ? p->getCropHeight() : 0;
+}
+
+int PDFDoc::getPageRotate(int page) {
+  Page *p;
+
+  return (p = catalog->getPage(page)) ? p->getRotate() : 0;
+}
+
 void PDFDoc::displayPage(OutputDev *out, int page,
 			 double hDPI, double vDPI, int rotate,
 			 GBool useMediaBox, GBool crop, GBool printing,
@@ -373,13 +452,21 @@ void PDFDoc::displayPage(OutputDev *out, int page,
 			 void *abortCheckCbkData,
                          GBool (*annotDisplayDecideCbk)(Annot *annot, void *user_data),
                          void *annotDisplayDecideCbkData) {
+  Page *p;
+
   if (globalParams->getPrintCommands()) {
     printf("***** page %d *****\n", page);
   }
-  catalog->getPage(page)->display(out, hDPI, vDPI,
-				  rotate, useMediaBox, crop, printing, catalog,
-				  abortCheckCbk, abortCheckCbkData,
-				  annotDisplayDecideCbk, annotDisplayDecideCbkData);
+  // (the page tree can turn out to have fewer pages than its top-level
+  // count claimed)
+  if (!(p = catalog->getPage(page))) {
+    error(-1, "Page %d is missing from the page tree", page);
+    return;
+  }
+  p->display(out, hDPI, vDPI,
+	     rotate, useMediaBox, crop, printing, catalog,
+	     abortCheckCbk, abortCheckCbkData,
+	     annotDisplayDecideCbk, annotDisplayDecideCbkData);
 }
 
 void PDFDoc::displayPages(OutputDev *out, int firstPage, int lastPage,
@@ -406,51 +493,75 @@ void PDFDoc::displayPageSlice(OutputDev *out, int page,
 			      void *abortCheckCbkData,
                               GBool (*annotDisplayDecideCbk)(Annot *annot, void *user_data),
                               void *annotDisplayDecideCbkData) {
-  catalog->getPage(page)->displaySlice(out, hDPI, vDPI,
-				       rotate, useMediaBox, crop,
-				       sliceX, sliceY, sliceW, sliceH,
-				       printing, catalog,
-				       abortCheckCbk, abortCheckCbkData,
-				       annotDisplayDecideCbk, annotDisplayDecideCbkData);
+  Page *p;
+
+  if (!(p = catalog->getPage(page))) {
+    error(-1, "Page %d is missing from the page tree", page);
+    return;
+  }
+  p->displaySlice(out, hDPI, vDPI,
+		  rotate, useMediaBox, crop,
+		  sliceX, sliceY, sliceW, sliceH,
+		  printing, catalog,
+		  abortCheckCbk, abortCheckCbkData,
+		  annotDisplayDecideCbk, annotDisplayDecideCbkData);
 }
 
 Links *PDFDoc::getLinks(int page) {
-  return catalog->getPage(page)->getLinks(catalog);
+  Page *p;
+  Object obj;
+
+  if (!(p = catalog->getPage(page))) {
+    obj.initNull();
+    return new Links(&obj, NULL);
+  }
+  return p->getLinks(catalog);
 }
   
+#ifndef DISABLE_OUTLINE
+Outline *PDFDoc::getOutline() {
+  Outline *outlineA;
+  Guint missing;
+
+#if MULTITHREADED
+  gLockMutex(&mutex);
+#endif
+  if (!outline && catalog) {
+    missing = str->getMissingCount();
+    outline = new Outline(catalog->getOutline(), xref);
+    if (str->getMissingCount() != missing) {
+      // try again next time
+      delete outline;
+      outline = NULL;
+    }
+  }
+  outlineA = outline;
+#if MULTITHREADED
+  gUnlockMutex(&mutex);
+#endif
+  return outlineA;
+}
+#endif
+
 void PDFDoc::processLinks(OutputDev *out, int page) {
-  catalog->getPage(page)->processLinks(out, catalog);
+  Page *p;
+
+  if ((p = catalog->getPage(page))) {
+    p->processLinks(out, catalog);
+  }
 }
 
 GBool PDFDoc::isLinearized() {
-  Parser *parser;
-  Object obj1, obj2, obj3, obj4, obj5;
-  GBool lin;
-
-  lin = gFalse;
-  obj1.initNull();
-  parser = new Parser(xref,
-	     new Lexer(xref,
-	       str->makeSubStream(str->getStart(), gFalse, 0, &obj1)),
-	     gTrue);
-  parser->getObj(&obj1);
-  parser->getObj(&obj2);
-  parser->getObj(&obj3);
-  parser->getObj(&obj4);
-  if (obj1.isInt() && obj2.isInt() && obj3.isCmd("obj") &&
-      obj4.isDict()) {
-    obj4.dictLookup("Linearized", &obj5);
-    if (obj5.isNum() && obj5.getNum() > 0) {
-      lin = gTrue;
-    }
-    obj5.free();
+  Linearization *lin;
+  GBool ok;
+
+  if (xref->getLinearization()) {
+    return gTrue;
   }
-  obj4.free();
-  obj3.free();
-  obj2.free();
-  obj1.free();
-  delete parser;
-  return lin;
+  lin = new Linearization(str);
+  ok = lin->isOk();
+  delete lin;
+  return ok;
 }
 
 int PDFDoc::saveAs(GooString *name, PDFWriteMode mode) {
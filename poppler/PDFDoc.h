@@ -40,6 +40,10 @@
 #include "Annot.h"
 #include "OptionalContent.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class GooString;
 class BaseStream;
 class OutputDev;
@@ -47,6 +51,7 @@ class Links;
 class LinkAction;
 class LinkDest;
 class Outline;
+class ImageCache;
 
 enum PDFWriteMode {
   writeStandard,
@@ -89,6 +94,9 @@ public:
   // Get the xref table.
   XRef *getXRef() { return xref; }
 
+  // Get the cache of decoded images.
+  ImageCache *getImageCache() { return imageCache; }
+
   // Get catalog.
   Catalog *getCatalog() { return catalog; }
 
@@ -98,17 +106,13 @@ public:
   // Get base stream.
   BaseStream *getBaseStream() { return str; }
 
-  // Get page parameters.
-  double getPageMediaWidth(int page)
-    { return catalog->getPage(page)->getMediaWidth(); }
-  double getPageMediaHeight(int page)
-    { return catalog->getPage(page)->getMediaHeight(); }
-  double getPageCropWidth(int page)
-    { return catalog->getPage(page)->getCropWidth(); }
-  double getPageCropHeight(int page)
-    { return catalog->getPage(page)->getCropHeight(); }
-  int getPageRotate(int page)
-    { return catalog->getPage(page)->getRotate(); }
+  // Get page parameters.  A page missing from the page tree is
+  // reported as empty.
+  double getPageMediaWidth(int page);
+  double getPageMediaHeight(int page);
+  double getPageCropWidth(int page);
+  double getPageCropHeight(int page);
+  int getPageRotate(int page);
 
   // Get number of pages.
   int getNumPages() { return catalog->getNumPages(); }
@@ -166,8 +170,9 @@ public:
 
 
 #ifndef DISABLE_OUTLINE
-  // Return the outline object.
-  Outline *getOutline() { return outline; }
+  // Return the outline object.  It is read the first time it's asked
+  // for.  Returns NULL if the outline hasn't arrived yet.
+  Outline *getOutline();
 #endif
 
   // Is the file encrypted?
@@ -240,9 +245,13 @@ private:
   int pdfMinorVersion;
   XRef *xref;
   Catalog *catalog;
+  ImageCache *imageCache;
 #ifndef DISABLE_OUTLINE
   Outline *outline;
 #endif
+#if MULTITHREADED
+  GooMutex mutex;		// protects <outline>
+#endif
 
   GBool ok;
   int errCode;
@@ -75,7 +75,7 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
   // array
   if (buf1.isCmd("[")) {
     shift();
-    obj->initArray(xref);
+    obj->initArray(xref, lexer->getArena());
     while (!buf1.isCmd("]") && !buf1.isEOF())
       obj->arrayAdd(getObj(&obj2, fileKey, encAlgorithm, keyLength,
 			   objNum, objGen));
@@ -86,20 +86,20 @@ Object *Parser::getObj(Object *obj, Guchar *fileKey,
   // dictionary or stream
   } else if (buf1.isCmd("<<")) {
     shift(objNum);
-    obj->initDict(xref);
+    obj->initDict(xref, lexer->getArena());
     while (!buf1.isCmd(">>") && !buf1.isEOF()) {
       if (!buf1.isName()) {
 	error(getPos(), "Dictionary key must be a name object");
 	shift();
       } else {
 	// buf1 might go away in shift(), so construct the key
-	key = copyString(buf1.getName());
+	key = AtomTable::copy(buf1.getName());
 	shift();
 	if (buf1.isEOF() || buf1.isError()) {
-	  gfree(key);
+	  AtomTable::free(key);
 	  break;
 	}
-	obj->dictAdd(key, getObj(&obj2, fileKey, encAlgorithm, keyLength, objNum, objGen));
+	obj->getDict()->addAtom(key, getObj(&obj2, fileKey, encAlgorithm, keyLength, objNum, objGen));
       }
     }
     if (buf1.isEOF())
@@ -166,14 +166,27 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   Object obj;
   BaseStream *baseStr;
   Stream *str;
-  Guint pos, endPos, length;
+  Guint pos, endPos, length, missing;
 
   // get stream start position
   lexer->skipToNextLine();
   pos = lexer->getPos();
 
+  // in badly damaged PDF files, we can run off the end of the input
+  // stream immediately after the "stream" token
+  if (!lexer->getStream()) {
+    return NULL;
+  }
+  baseStr = lexer->getStream()->getBaseStream();
+  missing = baseStr->getMissingCount();
+
   // get length
   dict->dictLookup("Length", &obj);
+  if (baseStr->getMissingCount() != missing) {
+    // the Length object hasn't arrived yet
+    obj.free();
+    return NULL;
+  }
   if (obj.isInt()) {
     length = (Guint)obj.getInt();
     obj.free();
@@ -188,13 +201,6 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
     length = endPos - pos;
   }
 
-  // in badly damaged PDF files, we can run off the end of the input
-  // stream immediately after the "stream" token
-  if (!lexer->getStream()) {
-    return NULL;
-  }
-  baseStr = lexer->getStream()->getBaseStream();
-
   // skip over stream data
   if (Lexer::LOOK_VALUE_NOT_CACHED != lexer->lookCharLastValueCached) {
       // take into account the fact that we've cached one value
@@ -206,6 +212,11 @@ Stream *Parser::makeStream(Object *dict, Guchar *fileKey,
   // refill token buffers and check for 'endstream'
   shift();  // kill '>>'
   shift();  // kill 'stream'
+  if (baseStr->getMissingCount() != missing) {
+    // the end of the stream hasn't arrived yet -- don't go looking
+    // for it as if the file was damaged
+    return NULL;
+  }
   if (buf1.isCmd("endstream")) {
     shift();
   } else {
@@ -45,12 +45,15 @@
 #include "Link.h"
 #include "CharCodeToUnicode.h"
 #include "FontEncodingTables.h"
+#include "XRef.h"
+#include "ImageCache.h"
 #include "fofi/FoFiTrueType.h"
 #include "splash/SplashBitmap.h"
 #include "splash/SplashGlyphBitmap.h"
 #include "splash/SplashPattern.h"
 #include "splash/SplashScreen.h"
 #include "splash/SplashPath.h"
+#include "splash/SplashClip.h"
 #include "splash/SplashState.h"
 #include "splash/SplashErrorCodes.h"
 #include "splash/SplashFontEngine.h"
@@ -658,6 +661,529 @@ static const SplashBlendFunc splashOutBlendFuncs[] = {
   &splashOutBlendLuminosity
 };
 
+//------------------------------------------------------------------------
+// Shading patterns
+//------------------------------------------------------------------------
+
+// Size, in device pixels, of the cells into which the patches of a
+// patch mesh shading are cut, and the maximum number of cells along
+// each side of a patch.
+#define splashOutPatchCellSize 6
+#define splashOutMaxPatchCells 64
+
+// Convert <src>, a color in <colorSpace>, to the device color mode.
+static void splashOutConvertColor(GfxColorSpace *colorSpace, GfxColor *src,
+				  SplashColorMode colorMode,
+				  GBool reverseVideo, SplashColorPtr dest) {
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+
+  switch (colorMode) {
+  case splashModeMono1:
+  case splashModeMono8:
+    colorSpace->getGray(src, &gray);
+    if (reverseVideo) {
+      gray = gfxColorComp1 - gray;
+    }
+    dest[0] = colToByte(gray);
+    break;
+  case splashModeXBGR8:
+    dest[3] = 255;
+  case splashModeRGB8:
+  case splashModeBGR8:
+    colorSpace->getRGB(src, &rgb);
+    if (reverseVideo) {
+      rgb.r = gfxColorComp1 - rgb.r;
+      rgb.g = gfxColorComp1 - rgb.g;
+      rgb.b = gfxColorComp1 - rgb.b;
+    }
+    dest[0] = colToByte(rgb.r);
+    dest[1] = colToByte(rgb.g);
+    dest[2] = colToByte(rgb.b);
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    colorSpace->getCMYK(src, &cmyk);
+    dest[0] = colToByte(cmyk.c);
+    dest[1] = colToByte(cmyk.m);
+    dest[2] = colToByte(cmyk.y);
+    dest[3] = colToByte(cmyk.k);
+    break;
+#endif
+  }
+}
+
+// Get the device color for parameter <t> from a shading's lookup
+// table.
+static void splashOutLUTColor(GfxShadingLUT *lut, double t,
+			      SplashColorMode colorMode,
+			      GBool reverseVideo, SplashColorPtr dest) {
+  GfxGray gray;
+  GfxRGB rgb;
+#if SPLASH_CMYK
+  GfxCMYK cmyk;
+#endif
+
+  switch (colorMode) {
+  case splashModeMono1:
+  case splashModeMono8:
+    lut->getGray(t, &gray);
+    if (reverseVideo) {
+      gray = gfxColorComp1 - gray;
+    }
+    dest[0] = colToByte(gray);
+    break;
+  case splashModeXBGR8:
+    dest[3] = 255;
+  case splashModeRGB8:
+  case splashModeBGR8:
+    lut->getRGB(t, &rgb);
+    if (reverseVideo) {
+      rgb.r = gfxColorComp1 - rgb.r;
+      rgb.g = gfxColorComp1 - rgb.g;
+      rgb.b = gfxColorComp1 - rgb.b;
+    }
+    dest[0] = colToByte(rgb.r);
+    dest[1] = colToByte(rgb.g);
+    dest[2] = colToByte(rgb.b);
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    lut->getCMYK(t, &cmyk);
+    dest[0] = colToByte(cmyk.c);
+    dest[1] = colToByte(cmyk.m);
+    dest[2] = colToByte(cmyk.y);
+    dest[3] = colToByte(cmyk.k);
+    break;
+#endif
+  }
+}
+
+// Base class for the function-based, axial, and radial shading
+// patterns.  These evaluate the shading at the center of each pixel.
+// Each pattern owns a copy of the shading: the copies made for the
+// rasterizing threads (see Splash::setDeferredThreads) must not share
+// the Functions.
+class SplashOutShadingPattern: public SplashPattern {
+public:
+
+  SplashOutShadingPattern(GfxShading *shadingA, double *ictmA,
+			  SplashColorMode colorModeA, GBool reverseVideoA);
+  virtual ~SplashOutShadingPattern();
+
+  virtual GBool isStatic() { return gFalse; }
+
+protected:
+
+  // Map the center of device pixel (<x>, <y>) to user space.
+  void deviceToUser(int x, int y, double *ux, double *uy) {
+    double px = x + 0.5, py = y + 0.5;
+    *ux = ictm[0] * px + ictm[2] * py + ictm[4];
+    *uy = ictm[1] * px + ictm[3] * py + ictm[5];
+  }
+
+  void convertColor(GfxColor *src, SplashColorPtr dest)
+    { splashOutConvertColor(shading->getColorSpace(), src,
+			    colorMode, reverseVideo, dest); }
+
+  GfxShading *shading;
+  double ictm[6];		// device space -> user space
+  SplashColorMode colorMode;
+  GBool reverseVideo;
+};
+
+SplashOutShadingPattern::SplashOutShadingPattern(GfxShading *shadingA,
+						 double *ictmA,
+						 SplashColorMode colorModeA,
+						 GBool reverseVideoA) {
+  shading = shadingA;
+  memcpy(ictm, ictmA, 6 * sizeof(double));
+  colorMode = colorModeA;
+  reverseVideo = reverseVideoA;
+}
+
+SplashOutShadingPattern::~SplashOutShadingPattern() {
+  delete shading;
+}
+
+//----- function-based shading
+
+class SplashOutFunctionPattern: public SplashOutShadingPattern {
+public:
+
+  // <shadingA> becomes owned by the pattern.  Returns NULL if the
+  // shading matrix is singular.
+  static SplashOutFunctionPattern *make(GfxFunctionShading *shadingA,
+					double *ictmA,
+					SplashColorMode colorModeA,
+					GBool reverseVideoA);
+
+  virtual SplashPattern *copy();
+
+  virtual GBool getColor(int x, int y, SplashColorPtr c);
+
+private:
+
+  SplashOutFunctionPattern(GfxFunctionShading *shadingA, double *ictmA,
+			   SplashColorMode colorModeA, GBool reverseVideoA,
+			   double *smatA);
+
+  double smat[6];		// user space -> shading space
+  double xMin, yMin, xMax, yMax;// shading domain
+};
+
+SplashOutFunctionPattern *SplashOutFunctionPattern::make(
+			      GfxFunctionShading *shadingA, double *ictmA,
+			      SplashColorMode colorModeA,
+			      GBool reverseVideoA) {
+  double *mat;
+  double smatA[6];
+  double det;
+
+  mat = shadingA->getMatrix();
+  det = mat[0] * mat[3] - mat[1] * mat[2];
+  if (fabs(det) < 1e-12) {
+    delete shadingA;
+    return NULL;
+  }
+  det = 1 / det;
+  smatA[0] = mat[3] * det;
+  smatA[1] = -mat[1] * det;
+  smatA[2] = -mat[2] * det;
+  smatA[3] = mat[0] * det;
+  smatA[4] = (mat[2] * mat[5] - mat[3] * mat[4]) * det;
+  smatA[5] = (mat[1] * mat[4] - mat[0] * mat[5]) * det;
+  return new SplashOutFunctionPattern(shadingA, ictmA, colorModeA,
+				      reverseVideoA, smatA);
+}
+
+SplashOutFunctionPattern::SplashOutFunctionPattern(
+			      GfxFunctionShading *shadingA, double *ictmA,
+			      SplashColorMode colorModeA, GBool reverseVideoA,
+			      double *smatA):
+  SplashOutShadingPattern(shadingA, ictmA, colorModeA, reverseVideoA)
+{
+  memcpy(smat, smatA, 6 * sizeof(double));
+  shadingA->getDomain(&xMin, &yMin, &xMax, &yMax);
+}
+
+SplashPattern *SplashOutFunctionPattern::copy() {
+  return new SplashOutFunctionPattern(
+		 (GfxFunctionShading *)shading->copy(), ictm,
+		 colorMode, reverseVideo, smat);
+}
+
+GBool SplashOutFunctionPattern::getColor(int x, int y, SplashColorPtr c) {
+  GfxColor color;
+  double ux, uy, sx, sy;
+
+  deviceToUser(x, y, &ux, &uy);
+  sx = smat[0] * ux + smat[2] * uy + smat[4];
+  sy = smat[1] * ux + smat[3] * uy + smat[5];
+  if (sx < xMin || sx > xMax || sy < yMin || sy > yMax) {
+    return gFalse;
+  }
+  ((GfxFunctionShading *)shading)->getColor(sx, sy, &color);
+  convertColor(&color, c);
+  return gTrue;
+}
+
+//----- axial and radial shadings
+
+// The axial and radial shadings map each pixel to a position s along
+// the shading (0 at the starting point/circle, 1 at the ending one),
+// and s to the color through the shading's lookup table.  Neighboring
+// pixels often get the same s (e.g., along the rows of a vertical
+// gradient), so the last color is kept.
+class SplashOutUnivariatePattern: public SplashOutShadingPattern {
+public:
+
+  SplashOutUnivariatePattern(GfxShading *shadingA, GfxShadingLUT *lutA,
+			     double *ictmA,
+			     SplashColorMode colorModeA,
+			     GBool reverseVideoA,
+			     double t0A, double t1A,
+			     GBool extend0A, GBool extend1A);
+
+  virtual GBool getColor(int x, int y, SplashColorPtr c);
+
+protected:
+
+  // Get the position <s> of pixel (<x>, <y>), before clipping to
+  // [0, 1] for the Extend flags.  Returns false if no point of the
+  // shading covers the pixel.
+  virtual GBool getPosition(int x, int y, double *s) = 0;
+
+  double t0, t1;		// shading domain
+  GBool extend0, extend1;
+
+private:
+
+  GfxShadingLUT *lut;		// the shading's lookup table
+
+  GBool lastValid;		// set if lastS/lastColor are valid
+  double lastS;
+  SplashColor lastColor;
+};
+
+SplashOutUnivariatePattern::SplashOutUnivariatePattern(
+			        GfxShading *shadingA, GfxShadingLUT *lutA,
+				double *ictmA,
+				SplashColorMode colorModeA,
+				GBool reverseVideoA,
+				double t0A, double t1A,
+				GBool extend0A, GBool extend1A):
+  SplashOutShadingPattern(shadingA, ictmA, colorModeA, reverseVideoA)
+{
+  lut = lutA;
+  t0 = t0A;
+  t1 = t1A;
+  extend0 = extend0A;
+  extend1 = extend1A;
+
+  // this also builds the device color table, before the pattern (and
+  // the table) is copied for the rasterizing threads
+  splashOutLUTColor(lut, t0, colorMode, reverseVideo, lastColor);
+  lastS = 0;
+  lastValid = gTrue;
+}
+
+GBool SplashOutUnivariatePattern::getColor(int x, int y, SplashColorPtr c) {
+  double s;
+
+  if (!getPosition(x, y, &s)) {
+    return gFalse;
+  }
+  if (s < 0) {
+    if (!extend0) {
+      return gFalse;
+    }
+    s = 0;
+  } else if (s > 1) {
+    if (!extend1) {
+      return gFalse;
+    }
+    s = 1;
+  }
+  if (!lastValid || s != lastS) {
+    splashOutLUTColor(lut, t0 + s * (t1 - t0), colorMode, reverseVideo,
+		      lastColor);
+    lastS = s;
+    lastValid = gTrue;
+  }
+  splashColorCopy(c, lastColor);
+  return gTrue;
+}
+
+class SplashOutAxialPattern: public SplashOutUnivariatePattern {
+public:
+
+  // <shadingA> becomes owned by the pattern.
+  SplashOutAxialPattern(GfxAxialShading *shadingA, double *ictmA,
+			SplashColorMode colorModeA, GBool reverseVideoA);
+
+  virtual SplashPattern *copy();
+
+protected:
+
+  virtual GBool getPosition(int x, int y, double *s);
+
+private:
+
+  // s is a linear function of the pixel center:
+  // s = sx * x + sy * y + s0
+  double sx, sy, s0;
+};
+
+SplashOutAxialPattern::SplashOutAxialPattern(GfxAxialShading *shadingA,
+					     double *ictmA,
+					     SplashColorMode colorModeA,
+					     GBool reverseVideoA):
+  SplashOutUnivariatePattern(shadingA, shadingA->getLUT(), ictmA,
+			     colorModeA, reverseVideoA,
+			     shadingA->getDomain0(), shadingA->getDomain1(),
+			     shadingA->getExtend0(), shadingA->getExtend1())
+{
+  double x0, y0, x1, y1, dx, dy, mul;
+
+  shadingA->getCoords(&x0, &y0, &x1, &y1);
+  dx = x1 - x0;
+  dy = y1 - y0;
+  if (fabs(dx) < 0.01 && fabs(dy) < 0.01) {
+    // degenerate axis: paint the starting color everywhere, as
+    // Gfx::doAxialShFill does
+    sx = sy = s0 = 0;
+  } else {
+    mul = 1 / (dx * dx + dy * dy);
+    sx = (ictm[0] * dx + ictm[1] * dy) * mul;
+    sy = (ictm[2] * dx + ictm[3] * dy) * mul;
+    s0 = ((ictm[4] - x0) * dx + (ictm[5] - y0) * dy) * mul;
+  }
+}
+
+SplashPattern *SplashOutAxialPattern::copy() {
+  return new SplashOutAxialPattern((GfxAxialShading *)shading->copy(),
+				   ictm, colorMode, reverseVideo);
+}
+
+GBool SplashOutAxialPattern::getPosition(int x, int y, double *s) {
+  *s = sx * (x + 0.5) + sy * (y + 0.5) + s0;
+  return gTrue;
+}
+
+class SplashOutRadialPattern: public SplashOutUnivariatePattern {
+public:
+
+  // <shadingA> becomes owned by the pattern.
+  SplashOutRadialPattern(GfxRadialShading *shadingA, double *ictmA,
+			 SplashColorMode colorModeA, GBool reverseVideoA);
+
+  virtual SplashPattern *copy();
+
+protected:
+
+  virtual GBool getPosition(int x, int y, double *s);
+
+private:
+
+  GBool validS(double s)
+    { return r0 + s * dr >= 0 && (s >= 0 || extend0) && (s <= 1 || extend1); }
+
+  double x0, y0, r0;		// starting circle
+  double cdx, cdy, dr;		// ending circle - starting circle
+  double a;			// cdx^2 + cdy^2 - dr^2
+};
+
+SplashOutRadialPattern::SplashOutRadialPattern(GfxRadialShading *shadingA,
+					       double *ictmA,
+					       SplashColorMode colorModeA,
+					       GBool reverseVideoA):
+  SplashOutUnivariatePattern(shadingA, shadingA->getLUT(), ictmA,
+			     colorModeA, reverseVideoA,
+			     shadingA->getDomain0(), shadingA->getDomain1(),
+			     shadingA->getExtend0(), shadingA->getExtend1())
+{
+  double x1, y1, r1;
+
+  shadingA->getCoords(&x0, &y0, &r0, &x1, &y1, &r1);
+  cdx = x1 - x0;
+  cdy = y1 - y0;
+  dr = r1 - r0;
+  a = cdx * cdx + cdy * cdy - dr * dr;
+}
+
+SplashPattern *SplashOutRadialPattern::copy() {
+  return new SplashOutRadialPattern((GfxRadialShading *)shading->copy(),
+				    ictm, colorMode, reverseVideo);
+}
+
+GBool SplashOutRadialPattern::getPosition(int x, int y, double *s) {
+  double ux, uy, pdx, pdy, b, cc, d, sA, sB;
+
+  // find the largest s for which the pixel center lies on the circle
+  // with center (x0, y0) + s * (cdx, cdy) and radius r0 + s * dr,
+  // i.e., solve a * s^2 - 2 * b * s + cc = 0
+  deviceToUser(x, y, &ux, &uy);
+  pdx = ux - x0;
+  pdy = uy - y0;
+  b = pdx * cdx + pdy * cdy + r0 * dr;
+  cc = pdx * pdx + pdy * pdy - r0 * r0;
+  if (fabs(a) < 1e-9) {
+    if (b == 0) {
+      return gFalse;
+    }
+    *s = cc / (2 * b);
+    return validS(*s);
+  }
+  d = b * b - a * cc;
+  if (d < 0) {
+    return gFalse;
+  }
+  d = sqrt(d);
+  sA = (b + d) / a;
+  sB = (b - d) / a;
+  if (sA < sB) {
+    *s = sA;
+    sA = sB;
+    sB = *s;
+  }
+  if (validS(sA)) {
+    *s = sA;
+  } else if (validS(sB)) {
+    *s = sB;
+  } else {
+    return gFalse;
+  }
+  return gTrue;
+}
+
+//----- Gouraud-shaded triangle
+
+// One triangle of a triangle mesh (or of a cut up patch), with the
+// device colors of its vertices interpolated linearly over the
+// triangle.  Pixels just outside the triangle (which the non-AA
+// rasterizer touches) get the extrapolated color, clipped to range.
+class SplashOutGouraudPattern: public SplashPattern {
+public:
+
+  // The vertices are in device space.
+  SplashOutGouraudPattern(SplashColorMode colorMode,
+			  double x0, double y0, SplashColorPtr color0,
+			  double x1, double y1, SplashColorPtr color1,
+			  double x2, double y2, SplashColorPtr color2);
+
+  virtual SplashPattern *copy() { return new SplashOutGouraudPattern(*this); }
+
+  virtual GBool getColor(int x, int y, SplashColorPtr c);
+
+  virtual GBool isStatic() { return gFalse; }
+
+private:
+
+  int nComps;
+  // component i = coef[i][0] * x + coef[i][1] * y + coef[i][2]
+  double coef[splashMaxColorComps][3];
+};
+
+SplashOutGouraudPattern::SplashOutGouraudPattern(
+			     SplashColorMode colorMode,
+			     double x0, double y0, SplashColorPtr color0,
+			     double x1, double y1, SplashColorPtr color1,
+			     double x2, double y2, SplashColorPtr color2) {
+  double det, d1, d2;
+  int i;
+
+  nComps = splashColorModeNComps[colorMode];
+  det = (x1 - x0) * (y2 - y0) - (x2 - x0) * (y1 - y0);
+  for (i = 0; i < nComps; ++i) {
+    if (fabs(det) < 1e-6) {
+      coef[i][0] = coef[i][1] = 0;
+    } else {
+      d1 = color1[i] - color0[i];
+      d2 = color2[i] - color0[i];
+      coef[i][0] = (d1 * (y2 - y0) - d2 * (y1 - y0)) / det;
+      coef[i][1] = (d2 * (x1 - x0) - d1 * (x2 - x0)) / det;
+    }
+    coef[i][2] = color0[i] - coef[i][0] * x0 - coef[i][1] * y0;
+  }
+}
+
+GBool SplashOutGouraudPattern::getColor(int x, int y, SplashColorPtr c) {
+  double px, py, v;
+  int i;
+
+  px = x + 0.5;
+  py = y + 0.5;
+  for (i = 0; i < nComps; ++i) {
+    v = coef[i][0] * px + coef[i][1] * py + coef[i][2];
+    c[i] = v <= 0 ? 0 : v >= 255 ? 255 : (Guchar)(v + 0.5);
+  }
+  return gTrue;
+}
+
 //------------------------------------------------------------------------
 // SplashOutFontFileID
 //------------------------------------------------------------------------
@@ -830,6 +1356,7 @@ SplashOutputDev::SplashOutputDev(SplashColorMode colorModeA,
 		      globalParams->getVectorAntialias() &&
 		      colorMode != splashModeMono1;
   enableFreeTypeHinting = gFalse;
+  bandThreads = 1;
   setupScreenParams(72.0, 72.0);
   reverseVideo = reverseVideoA;
   if (paperColorA != NULL) {
@@ -943,7 +1470,8 @@ void SplashOutputDev::startDoc(XRef *xrefA) {
 #endif
 				    allowAntialias &&
 				      globalParams->getAntialias() &&
-				      colorMode != splashModeMono1);
+				      colorMode != splashModeMono1,
+				    globalParams->getGlyphCacheSize());
   for (i = 0; i < nT3Fonts; ++i) {
     delete t3FontCache[i];
   }
@@ -980,6 +1508,7 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
 			      colorMode != splashModeMono1, bitmapTopDown);
   }
   splash = new Splash(bitmap, vectorAntialias, &screenParams);
+  splash->setDeferredThreads(bandThreads);
   if (state) {
     ctm = state->getCTM();
     mat[0] = (SplashCoord)ctm[0];
@@ -1021,6 +1550,7 @@ void SplashOutputDev::startPage(int pageNum, GfxState *state) {
 }
 
 void SplashOutputDev::endPage() {
+  splash->flushDeferred();
   if (colorMode != splashModeMono1 && !keepAlphaChannel) {
     splash->compositeBackground(paperColor);
   }
@@ -1547,6 +2077,294 @@ void SplashOutputDev::clipToStrokePath(GfxState *state) {
   delete path2;
 }
 
+GBool SplashOutputDev::getInverseCTM(GfxState *state, double *ictm) {
+  double *ctm;
+  double det;
+
+  ctm = state->getCTM();
+  det = ctm[0] * ctm[3] - ctm[1] * ctm[2];
+  if (fabs(det) < 1e-12) {
+    return gFalse;
+  }
+  det = 1 / det;
+  ictm[0] = ctm[3] * det;
+  ictm[1] = -ctm[1] * det;
+  ictm[2] = -ctm[2] * det;
+  ictm[3] = ctm[0] * det;
+  ictm[4] = (ctm[2] * ctm[5] - ctm[3] * ctm[4]) * det;
+  ictm[5] = (ctm[1] * ctm[4] - ctm[0] * ctm[5]) * det;
+  return gTrue;
+}
+
+// Fill the bounding box of the clip region with <pattern>, which
+// becomes the fill pattern.  The pixels the pattern doesn't cover are
+// left alone.
+void SplashOutputDev::fillClipWithPattern(GfxState *state,
+					  SplashPattern *pattern) {
+  SplashClip *clip;
+  SplashPath *path;
+  double ictm[6];
+  double x[4], y[4], ux, uy;
+  int i;
+
+  clip = splash->getClip();
+  if (clip->getXMinI() > clip->getXMaxI() ||
+      clip->getYMinI() > clip->getYMaxI() ||
+      !getInverseCTM(state, ictm)) {
+    delete pattern;
+    return;
+  }
+  x[0] = x[3] = clip->getXMinI();
+  x[1] = x[2] = clip->getXMaxI() + 1;
+  y[0] = y[1] = clip->getYMinI();
+  y[2] = y[3] = clip->getYMaxI() + 1;
+
+  // the path is in user space
+  path = new SplashPath();
+  for (i = 0; i < 4; ++i) {
+    ux = ictm[0] * x[i] + ictm[2] * y[i] + ictm[4];
+    uy = ictm[1] * x[i] + ictm[3] * y[i] + ictm[5];
+    if (i == 0) {
+      path->moveTo((SplashCoord)ux, (SplashCoord)uy);
+    } else {
+      path->lineTo((SplashCoord)ux, (SplashCoord)uy);
+    }
+  }
+  path->close();
+  splash->setFillPattern(pattern);
+  splash->fill(path, gFalse);
+  delete path;
+}
+
+GBool SplashOutputDev::functionShadedFill(GfxState *state,
+					  GfxFunctionShading *shading) {
+  SplashOutFunctionPattern *pattern;
+  double ictm[6];
+
+  if (!getInverseCTM(state, ictm) ||
+      !(pattern = SplashOutFunctionPattern::make(
+			  (GfxFunctionShading *)shading->copy(), ictm,
+			  colorMode, reverseVideo))) {
+    return gFalse;
+  }
+  fillClipWithPattern(state, pattern);
+  return gTrue;
+}
+
+GBool SplashOutputDev::axialShadedFill(GfxState *state,
+				       GfxAxialShading *shading,
+				       double /*tMin*/, double /*tMax*/) {
+  double ictm[6];
+
+  if (!getInverseCTM(state, ictm)) {
+    return gFalse;
+  }
+  fillClipWithPattern(state,
+		      new SplashOutAxialPattern(
+			      (GfxAxialShading *)shading->copy(), ictm,
+			      colorMode, reverseVideo));
+  return gTrue;
+}
+
+GBool SplashOutputDev::radialShadedFill(GfxState *state,
+					GfxRadialShading *shading,
+					double /*sMin*/, double /*sMax*/) {
+  double ictm[6];
+
+  if (!getInverseCTM(state, ictm)) {
+    return gFalse;
+  }
+  fillClipWithPattern(state,
+		      new SplashOutRadialPattern(
+			      (GfxRadialShading *)shading->copy(), ictm,
+			      colorMode, reverseVideo));
+  return gTrue;
+}
+
+GBool SplashOutputDev::gouraudTriangleShadedFill(
+			   GfxState *state,
+			   GfxGouraudTriangleShading *shading) {
+  GfxColorSpace *colorSpace;
+  double x0, y0, x1, y1, x2, y2;
+  GfxColor color0, color1, color2;
+  SplashColor sColor0, sColor1, sColor2;
+  int i;
+
+  //~ if the shading has a Function, this should interpolate on the
+  //~ function parameter, not on the color components
+  colorSpace = shading->getColorSpace();
+  for (i = 0; i < shading->getNTriangles(); ++i) {
+    shading->getTriangle(i, &x0, &y0, &color0,
+			 &x1, &y1, &color1,
+			 &x2, &y2, &color2);
+    splashOutConvertColor(colorSpace, &color0, colorMode, reverseVideo,
+			  sColor0);
+    splashOutConvertColor(colorSpace, &color1, colorMode, reverseVideo,
+			  sColor1);
+    splashOutConvertColor(colorSpace, &color2, colorMode, reverseVideo,
+			  sColor2);
+    gouraudFillTriangle(state, x0, y0, sColor0, x1, y1, sColor1,
+			x2, y2, sColor2);
+  }
+  return gTrue;
+}
+
+GBool SplashOutputDev::patchMeshShadedFill(GfxState *state,
+					   GfxPatchMeshShading *shading) {
+  GfxColorSpace *colorSpace;
+  GfxPatch *patch;
+  GfxColor color;
+  SplashColor *nodeColors;
+  double *nodeX, *nodeY;
+  double bu[4], bv[4];
+  double dx, dy, dxMin, dyMin, dxMax, dyMax, u, v, t, w[2][2];
+  int nComps, nCells, n, i, j, k, ii, jj, p;
+
+  colorSpace = shading->getColorSpace();
+  nComps = colorSpace->getNComps();
+  nodeX = nodeY = NULL;
+  nodeColors = NULL;
+  for (p = 0; p < shading->getNPatches(); ++p) {
+    patch = shading->getPatch(p);
+
+    // cut the patch into (roughly) splashOutPatchCellSize pixel cells,
+    // based on the device space bbox of its control points
+    dxMin = dyMin = dxMax = dyMax = 0; // make gcc happy
+    for (i = 0; i < 4; ++i) {
+      for (j = 0; j < 4; ++j) {
+	state->transform(patch->x[i][j], patch->y[i][j], &dx, &dy);
+	if ((i == 0 && j == 0) || dx < dxMin) {
+	  dxMin = dx;
+	}
+	if ((i == 0 && j == 0) || dx > dxMax) {
+	  dxMax = dx;
+	}
+	if ((i == 0 && j == 0) || dy < dyMin) {
+	  dyMin = dy;
+	}
+	if ((i == 0 && j == 0) || dy > dyMax) {
+	  dyMax = dy;
+	}
+      }
+    }
+    t = dxMax - dxMin > dyMax - dyMin ? dxMax - dxMin : dyMax - dyMin;
+    nCells = (int)ceil(t / splashOutPatchCellSize);
+    if (nCells < 1) {
+      nCells = 1;
+    } else if (nCells > splashOutMaxPatchCells) {
+      nCells = splashOutMaxPatchCells;
+    }
+    n = nCells + 1;
+    nodeX = (double *)greallocn(nodeX, n * n, sizeof(double));
+    nodeY = (double *)greallocn(nodeY, n * n, sizeof(double));
+    nodeColors = (SplashColor *)greallocn(nodeColors, n * n,
+					  sizeof(SplashColor));
+
+    // evaluate the (tensor product) patch surface and the bilinearly
+    // interpolated color at each node
+    for (i = 0; i < n; ++i) {
+      u = (double)i / nCells;
+      bu[0] = (1 - u) * (1 - u) * (1 - u);
+      bu[1] = 3 * u * (1 - u) * (1 - u);
+      bu[2] = 3 * u * u * (1 - u);
+      bu[3] = u * u * u;
+      for (j = 0; j < n; ++j) {
+	v = (double)j / nCells;
+	bv[0] = (1 - v) * (1 - v) * (1 - v);
+	bv[1] = 3 * v * (1 - v) * (1 - v);
+	bv[2] = 3 * v * v * (1 - v);
+	bv[3] = v * v * v;
+	k = i * n + j;
+	nodeX[k] = nodeY[k] = 0;
+	for (ii = 0; ii < 4; ++ii) {
+	  for (jj = 0; jj < 4; ++jj) {
+	    nodeX[k] += bu[ii] * bv[jj] * patch->x[ii][jj];
+	    nodeY[k] += bu[ii] * bv[jj] * patch->y[ii][jj];
+	  }
+	}
+	w[0][0] = (1 - u) * (1 - v);
+	w[0][1] = (1 - u) * v;
+	w[1][0] = u * (1 - v);
+	w[1][1] = u * v;
+	if (shading->isParameterized()) {
+	  t = 0;
+	  for (ii = 0; ii < 2; ++ii) {
+	    for (jj = 0; jj < 2; ++jj) {
+	      t += w[ii][jj] * colToDbl(patch->color[ii][jj].c[0]);
+	    }
+	  }
+	  splashOutLUTColor(shading->getLUT(), t, colorMode, reverseVideo,
+			    nodeColors[k]);
+	} else {
+	  for (ii = 0; ii < nComps; ++ii) {
+	    color.c[ii] = (GfxColorComp)
+	        (w[0][0] * patch->color[0][0].c[ii] +
+		 w[0][1] * patch->color[0][1].c[ii] +
+		 w[1][0] * patch->color[1][0].c[ii] +
+		 w[1][1] * patch->color[1][1].c[ii]);
+	  }
+	  splashOutConvertColor(colorSpace, &color, colorMode, reverseVideo,
+				nodeColors[k]);
+	}
+      }
+    }
+
+    // fill each cell as two triangles
+    for (i = 0; i < nCells; ++i) {
+      for (j = 0; j < nCells; ++j) {
+	k = i * n + j;
+	gouraudFillTriangle(state,
+			    nodeX[k], nodeY[k], nodeColors[k],
+			    nodeX[k + 1], nodeY[k + 1], nodeColors[k + 1],
+			    nodeX[k + n], nodeY[k + n], nodeColors[k + n]);
+	gouraudFillTriangle(state,
+			    nodeX[k + 1], nodeY[k + 1], nodeColors[k + 1],
+			    nodeX[k + n + 1], nodeY[k + n + 1],
+			      nodeColors[k + n + 1],
+			    nodeX[k + n], nodeY[k + n], nodeColors[k + n]);
+      }
+    }
+  }
+  gfree(nodeX);
+  gfree(nodeY);
+  gfree(nodeColors);
+  return gTrue;
+}
+
+// Fill a triangle, given in user space, with the vertex colors
+// interpolated over it.
+void SplashOutputDev::gouraudFillTriangle(GfxState *state,
+					  double x0, double y0,
+					  SplashColorPtr color0,
+					  double x1, double y1,
+					  SplashColorPtr color1,
+					  double x2, double y2,
+					  SplashColorPtr color2) {
+  SplashPath *path;
+  double dx0, dy0, dx1, dy1, dx2, dy2;
+  int nComps;
+
+  nComps = splashColorModeNComps[colorMode];
+  if (!memcmp(color0, color1, nComps) && !memcmp(color0, color2, nComps)) {
+    splash->setFillPattern(new SplashSolidColor(color0));
+  } else {
+    state->transform(x0, y0, &dx0, &dy0);
+    state->transform(x1, y1, &dx1, &dy1);
+    state->transform(x2, y2, &dx2, &dy2);
+    splash->setFillPattern(new SplashOutGouraudPattern(colorMode,
+						       dx0, dy0, color0,
+						       dx1, dy1, color1,
+						       dx2, dy2, color2));
+  }
+  path = new SplashPath();
+  path->moveTo((SplashCoord)x0, (SplashCoord)y0);
+  path->lineTo((SplashCoord)x1, (SplashCoord)y1);
+  path->lineTo((SplashCoord)x2, (SplashCoord)y2);
+  path->close();
+  splash->fill(path, gFalse);
+  delete path;
+}
+
 SplashPath *SplashOutputDev::convertPath(GfxState * /*state*/, GfxPath *path) {
   SplashPath *sPath;
   GfxSubpath *subpath;
@@ -1971,12 +2789,34 @@ void SplashOutputDev::endMaskClip(GfxState * state) {
 	splash->setSoftMask(NULL);
 }
 
+// Create the ImageStream for the pixels of an image.  If the image is
+// an XObject in the document's image cache (or one worth adding), the
+// pixels are read from there, and <*pixStr> is set to the stream which
+// has to be deleted after the ImageStream; otherwise <*pixStr> is set
+// to NULL and the ImageStream reads <str>.  Either way, <str> is to be
+// closed as usual.
+ImageStream *SplashOutputDev::makeImageStream(Object *ref, Stream *str,
+					      int width, int height,
+					      int nComps, int nBits,
+					      Stream **pixStr) {
+  *pixStr = NULL;
+  if (xref && xref->getImageCache()) {
+    *pixStr = xref->getImageCache()->getPixelStream(ref, str, width, height,
+						    nComps, nBits);
+  }
+  if (*pixStr) {
+    return new ImageStream(*pixStr, width, nComps, 8);
+  }
+  return new ImageStream(str, width, nComps, nBits);
+}
+
 void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
 				    int width, int height, GBool invert,
 				    GBool interpolate, GBool inlineImg) {
   double *ctm;
   SplashCoord mat[6];
   SplashOutImageMaskData imgMaskData;
+  Stream *pixStr;
 
   if (state->getFillColorSpace()->isNonMarking()) {
     return;
@@ -1993,7 +2833,8 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
-  imgMaskData.imgStr = new ImageStream(str, width, 1, 1);
+  imgMaskData.imgStr = makeImageStream(ref, str, width, height, 1, 1,
+				       &pixStr);
   imgMaskData.imgStr->reset();
   imgMaskData.invert = invert ? 0 : 1;
   imgMaskData.width = width;
@@ -2018,129 +2859,72 @@ void SplashOutputDev::drawImageMask(GfxState *state, Object *ref, Stream *str,
     splash->fillImageMask(&imageMaskSrc, &imgMaskData, width, height, mat, t3GlyphStack != NULL);
     if (inlineImg) {
       while (imgMaskData.y < height) {
-        imgMaskData.imgStr->getLine();
+        imgMaskData.imgStr->skipLine();
         ++imgMaskData.y;
       }
     }
   }
 
   delete imgMaskData.imgStr;
+  delete pixStr;
   str->close();
 }
 
 struct SplashOutImageData {
   ImageStream *imgStr;
   GfxImageColorMap *colorMap;
-  SplashColorPtr lookup;
   int *maskColors;
   SplashColorMode colorMode;
   int width, height, y;
 };
 
-GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
-				Guchar * /*alphaLine*/) {
-  SplashOutImageData *imgData = (SplashOutImageData *)data;
-  Guchar *p;
-  SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  int nComps, x;
-
-  if (imgData->y == imgData->height) {
-    return gFalse;
-  }
-
-  nComps = imgData->colorMap->getNumPixelComps();
+// Convert a line of image pixels to <colorMode>.
+static void splashOutConvertImageLine(GfxImageColorMap *colorMap,
+				      Guchar *in, SplashColorPtr out,
+				      int width, SplashColorMode colorMode) {
+  SplashColorPtr p, q;
+  int x;
 
-  if (imgData->lookup) {
-    switch (imgData->colorMode) {
+  switch (colorMode) {
   case splashModeMono1:
   case splashModeMono8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	*q++ = imgData->lookup[*p];
-      }
+    colorMap->getGrayByteLine(in, out, width);
     break;
   case splashModeRGB8:
   case splashModeBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	col = &imgData->lookup[3 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-      }
+    colorMap->getRGBByteLine(in, out, width);
     break;
   case splashModeXBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-      }
-      break;
+    // spread the RGB bytes out to four bytes per pixel, from the end
+    colorMap->getRGBByteLine(in, out, width);
+    for (x = width - 1; x >= 0; --x) {
+      p = out + 3 * x;
+      q = out + 4 * x;
+      q[3] = 255;
+      q[2] = p[2];
+      q[1] = p[1];
+      q[0] = p[0];
+    }
+    break;
 #if SPLASH_CMYK
-    case splashModeCMYK8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, ++p) {
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-      }
-      break;
+  case splashModeCMYK8:
+    colorMap->getCMYKByteLine(in, out, width);
+    break;
 #endif
   }
-  } else {
-    switch (imgData->colorMode) {
-    case splashModeMono1:
-    case splashModeMono8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-      }
-	break;
-	case splashModeXBGR8:
-    case splashModeRGB8:
-    case splashModeBGR8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	if (imgData->colorMode == splashModeXBGR8) *q++ = 255;
-      }
-      break;
-#if SPLASH_CMYK
-    case splashModeCMYK8:
-      for (x = 0, p = imgData->imgStr->getLine(), q = colorLine;
-	   x < imgData->width;
-	   ++x, p += nComps) {
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-      }
-      break;
-#endif
-    }
+}
+
+GBool SplashOutputDev::imageSrc(void *data, SplashColorPtr colorLine,
+				Guchar * /*alphaLine*/) {
+  SplashOutImageData *imgData = (SplashOutImageData *)data;
+
+  if (imgData->y == imgData->height) {
+    return gFalse;
   }
 
+  splashOutConvertImageLine(imgData->colorMap, imgData->imgStr->getLine(),
+			    colorLine, imgData->width, imgData->colorMode);
+
   ++imgData->y;
   return gTrue;
 }
@@ -2149,12 +2933,6 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 				     Guchar *alphaLine) {
   SplashOutImageData *imgData = (SplashOutImageData *)data;
   Guchar *p, *aq;
-  SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
   Guchar alpha;
   int nComps, x, i;
 
@@ -2164,9 +2942,10 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 
   nComps = imgData->colorMap->getNumPixelComps();
 
-  for (x = 0, p = imgData->imgStr->getLine(), q = colorLine, aq = alphaLine;
-       x < imgData->width;
-       ++x, p += nComps) {
+  p = imgData->imgStr->getLine();
+  splashOutConvertImageLine(imgData->colorMap, p, colorLine,
+			    imgData->width, imgData->colorMode);
+  for (x = 0, aq = alphaLine; x < imgData->width; ++x, p += nComps) {
     alpha = 0;
     for (i = 0; i < nComps; ++i) {
       if (p[i] < imgData->maskColors[2*i] ||
@@ -2175,70 +2954,7 @@ GBool SplashOutputDev::alphaImageSrc(void *data, SplashColorPtr colorLine,
 	break;
       }
     }
-    if (imgData->lookup) {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	*q++ = imgData->lookup[*p];
-	*aq++ = alpha;
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	col = &imgData->lookup[3 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    } else {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	if (imgData->colorMode == splashModeXBGR8) *q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    }
+    *aq++ = alpha;
   }
 
   ++imgData->y;
@@ -2255,13 +2971,8 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   SplashOutImageData imgData;
   SplashColorMode srcMode;
   SplashImageSource src;
-  GfxGray gray;
-  GfxRGB rgb;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  Guchar pix;
-  int n, i;
+  Stream *pixStr;
+  int i;
 
   ctm = state->getCTM();
   for (i = 0; i < 6; ++i) {
@@ -2274,9 +2985,9 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   mat[4] = ctm[2] + ctm[4];
   mat[5] = ctm[3] + ctm[5];
 
-  imgData.imgStr = new ImageStream(str, width,
+  imgData.imgStr = makeImageStream(ref, str, width, height,
 				   colorMap->getNumPixelComps(),
-				   colorMap->getBits());
+				   colorMap->getBits(), &pixStr);
   imgData.imgStr->reset();
   imgData.colorMap = colorMap;
   imgData.maskColors = maskColors;
@@ -2285,60 +2996,6 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
   imgData.height = height;
   imgData.y = 0;
 
-  // special case for one-channel (monochrome/gray/separation) images:
-  // build a lookup table here
-  imgData.lookup = NULL;
-  if (colorMap->getNumPixelComps() == 1) {
-    n = 1 << colorMap->getBits();
-    switch (colorMode) {
-    case splashModeMono1:
-    case splashModeMono8:
-      imgData.lookup = (SplashColorPtr)gmalloc(n);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getGray(&pix, &gray);
-	imgData.lookup[i] = colToByte(gray);
-      }
-      break;
-    case splashModeRGB8:
-    case splashModeBGR8:
-      imgData.lookup = (SplashColorPtr)gmallocn(n, 3);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getRGB(&pix, &rgb);
-	imgData.lookup[3*i] = colToByte(rgb.r);
-	imgData.lookup[3*i+1] = colToByte(rgb.g);
-	imgData.lookup[3*i+2] = colToByte(rgb.b);
-      }
-      break;
-    case splashModeXBGR8:
-      imgData.lookup = (SplashColorPtr)gmallocn(n, 4);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getRGB(&pix, &rgb);
-	imgData.lookup[4*i] = colToByte(rgb.r);
-	imgData.lookup[4*i+1] = colToByte(rgb.g);
-	imgData.lookup[4*i+2] = colToByte(rgb.b);
-	imgData.lookup[4*i+3] = 255;
-      }
-      break;
-#if SPLASH_CMYK
-    case splashModeCMYK8:
-      imgData.lookup = (SplashColorPtr)gmallocn(n, 4);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getCMYK(&pix, &cmyk);
-	imgData.lookup[4*i] = colToByte(cmyk.c);
-	imgData.lookup[4*i+1] = colToByte(cmyk.m);
-	imgData.lookup[4*i+2] = colToByte(cmyk.y);
-	imgData.lookup[4*i+3] = colToByte(cmyk.k);
-      }
-      break;
-#endif
-      break;
-    }
-  }
-
   if (colorMode == splashModeMono1) {
     srcMode = splashModeMono8;
   } else {
@@ -2349,13 +3006,13 @@ void SplashOutputDev::drawImage(GfxState *state, Object *ref, Stream *str,
 		    width, height, mat);
   if (inlineImg) {
     while (imgData.y < height) {
-      imgData.imgStr->getLine();
+      imgData.imgStr->skipLine();
       ++imgData.y;
     }
   }
 
-  gfree(imgData.lookup);
   delete imgData.imgStr;
+  delete pixStr;
   str->close();
 }
 
@@ -2363,7 +3020,6 @@ struct SplashOutMaskedImageData {
   ImageStream *imgStr;
   GfxImageColorMap *colorMap;
   SplashBitmap *mask;
-  SplashColorPtr lookup;
   SplashColorMode colorMode;
   int width, height, y;
 };
@@ -2371,92 +3027,19 @@ struct SplashOutMaskedImageData {
 GBool SplashOutputDev::maskedImageSrc(void *data, SplashColorPtr colorLine,
 				      Guchar *alphaLine) {
   SplashOutMaskedImageData *imgData = (SplashOutMaskedImageData *)data;
-  Guchar *p, *aq;
+  Guchar *aq;
   SplashColor maskColor;
-  SplashColorPtr q, col;
-  GfxRGB rgb;
-  GfxGray gray;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  Guchar alpha;
-  int nComps, x;
+  int x;
 
   if (imgData->y == imgData->height) {
     return gFalse;
   }
 
-  nComps = imgData->colorMap->getNumPixelComps();
-
-  for (x = 0, p = imgData->imgStr->getLine(), q = colorLine, aq = alphaLine;
-       x < imgData->width;
-       ++x, p += nComps) {
+  splashOutConvertImageLine(imgData->colorMap, imgData->imgStr->getLine(),
+			    colorLine, imgData->width, imgData->colorMode);
+  for (x = 0, aq = alphaLine; x < imgData->width; ++x) {
     imgData->mask->getPixel(x, imgData->y, maskColor);
-    alpha = maskColor[0] ? 0xff : 0x00;
-    if (imgData->lookup) {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	*q++ = imgData->lookup[*p];
-	*aq++ = alpha;
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	col = &imgData->lookup[3 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	col = &imgData->lookup[4 * *p];
-	*q++ = col[0];
-	*q++ = col[1];
-	*q++ = col[2];
-	*q++ = col[3];
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    } else {
-      switch (imgData->colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData->colorMap->getGray(p, &gray);
-	*q++ = colToByte(gray);
-	*aq++ = alpha;
-	break;
-      case splashModeXBGR8:
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData->colorMap->getRGB(p, &rgb);
-	*q++ = colToByte(rgb.r);
-	*q++ = colToByte(rgb.g);
-	*q++ = colToByte(rgb.b);
-	if (imgData->colorMode == splashModeXBGR8) *q++ = 255;
-	*aq++ = alpha;
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData->colorMap->getCMYK(p, &cmyk);
-	*q++ = colToByte(cmyk.c);
-	*q++ = colToByte(cmyk.m);
-	*q++ = colToByte(cmyk.y);
-	*q++ = colToByte(cmyk.k);
-	*aq++ = alpha;
-	break;
-#endif
-      }
-    }
+    *aq++ = maskColor[0] ? 0xff : 0x00;
   }
 
   ++imgData->y;
@@ -2480,13 +3063,8 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
   SplashBitmap *maskBitmap;
   Splash *maskSplash;
   SplashColor maskColor;
-  GfxGray gray;
-  GfxRGB rgb;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  Guchar pix;
-  int n, i;
+  Stream *pixStr;
+  int i;
 
   // If the mask is higher resolution than the image, use
   // drawSoftMaskedImage() instead.
@@ -2547,9 +3125,9 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
     mat[4] = ctm[2] + ctm[4];
     mat[5] = ctm[3] + ctm[5];
 
-    imgData.imgStr = new ImageStream(str, width,
+    imgData.imgStr = makeImageStream(ref, str, width, height,
 				     colorMap->getNumPixelComps(),
-				     colorMap->getBits());
+				     colorMap->getBits(), &pixStr);
     imgData.imgStr->reset();
     imgData.colorMap = colorMap;
     imgData.mask = maskBitmap;
@@ -2558,59 +3136,6 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
     imgData.height = height;
     imgData.y = 0;
 
-    // special case for one-channel (monochrome/gray/separation) images:
-    // build a lookup table here
-    imgData.lookup = NULL;
-    if (colorMap->getNumPixelComps() == 1) {
-      n = 1 << colorMap->getBits();
-      switch (colorMode) {
-      case splashModeMono1:
-      case splashModeMono8:
-	imgData.lookup = (SplashColorPtr)gmalloc(n);
-	for (i = 0; i < n; ++i) {
-	  pix = (Guchar)i;
-	  colorMap->getGray(&pix, &gray);
-	  imgData.lookup[i] = colToByte(gray);
-	}
-	break;
-      case splashModeRGB8:
-      case splashModeBGR8:
-	imgData.lookup = (SplashColorPtr)gmallocn(n, 3);
-	for (i = 0; i < n; ++i) {
-	  pix = (Guchar)i;
-	  colorMap->getRGB(&pix, &rgb);
-	  imgData.lookup[3*i] = colToByte(rgb.r);
-	  imgData.lookup[3*i+1] = colToByte(rgb.g);
-	  imgData.lookup[3*i+2] = colToByte(rgb.b);
-	}
-	break;
-      case splashModeXBGR8:
-	imgData.lookup = (SplashColorPtr)gmallocn(n, 4);
-	for (i = 0; i < n; ++i) {
-	  pix = (Guchar)i;
-	  colorMap->getRGB(&pix, &rgb);
-	  imgData.lookup[4*i] = colToByte(rgb.r);
-	  imgData.lookup[4*i+1] = colToByte(rgb.g);
-	  imgData.lookup[4*i+2] = colToByte(rgb.b);
-	  imgData.lookup[4*i+3] = 255;
-	}
-	break;
-#if SPLASH_CMYK
-      case splashModeCMYK8:
-	imgData.lookup = (SplashColorPtr)gmallocn(n, 4);
-	for (i = 0; i < n; ++i) {
-	  pix = (Guchar)i;
-	  colorMap->getCMYK(&pix, &cmyk);
-	  imgData.lookup[4*i] = colToByte(cmyk.c);
-	  imgData.lookup[4*i+1] = colToByte(cmyk.m);
-	  imgData.lookup[4*i+2] = colToByte(cmyk.y);
-	  imgData.lookup[4*i+3] = colToByte(cmyk.k);
-	}
-	break;
-#endif
-      }
-    }
-
     if (colorMode == splashModeMono1) {
       srcMode = splashModeMono8;
     } else {
@@ -2620,8 +3145,8 @@ void SplashOutputDev::drawMaskedImage(GfxState *state, Object *ref,
 		      width, height, mat);
 
     delete maskBitmap;
-    gfree(imgData.lookup);
     delete imgData.imgStr;
+    delete pixStr;
     str->close();
   }
 }
@@ -2642,13 +3167,8 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   SplashBitmap *maskBitmap;
   Splash *maskSplash;
   SplashColor maskColor;
-  GfxGray gray;
-  GfxRGB rgb;
-#if SPLASH_CMYK
-  GfxCMYK cmyk;
-#endif
-  Guchar pix;
-  int n, i;
+  Stream *pixStr;
+  int i;
 
   ctm = state->getCTM();
   for (i = 0; i < 6; ++i) {
@@ -2673,13 +3193,6 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   imgMaskData.width = maskWidth;
   imgMaskData.height = maskHeight;
   imgMaskData.y = 0;
-  n = 1 << maskColorMap->getBits();
-  imgMaskData.lookup = (SplashColorPtr)gmalloc(n);
-  for (i = 0; i < n; ++i) {
-    pix = (Guchar)i;
-    maskColorMap->getGray(&pix, &gray);
-    imgMaskData.lookup[i] = colToByte(gray);
-  }
   maskBitmap = new SplashBitmap(bitmap->getWidth(), bitmap->getHeight(),
 				1, splashModeMono8, gFalse);
   maskSplash = new Splash(maskBitmap, vectorAntialias);
@@ -2689,15 +3202,14 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
 			maskWidth, maskHeight, mat);
   delete imgMaskData.imgStr;
   maskStr->close();
-  gfree(imgMaskData.lookup);
   delete maskSplash;
   splash->setSoftMask(maskBitmap);
 
   //----- draw the source image
 
-  imgData.imgStr = new ImageStream(str, width,
+  imgData.imgStr = makeImageStream(ref, str, width, height,
 				   colorMap->getNumPixelComps(),
-				   colorMap->getBits());
+				   colorMap->getBits(), &pixStr);
   imgData.imgStr->reset();
   imgData.colorMap = colorMap;
   imgData.maskColors = NULL;
@@ -2706,59 +3218,6 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   imgData.height = height;
   imgData.y = 0;
 
-  // special case for one-channel (monochrome/gray/separation) images:
-  // build a lookup table here
-  imgData.lookup = NULL;
-  if (colorMap->getNumPixelComps() == 1) {
-    n = 1 << colorMap->getBits();
-    switch (colorMode) {
-    case splashModeMono1:
-    case splashModeMono8:
-      imgData.lookup = (SplashColorPtr)gmalloc(n);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getGray(&pix, &gray);
-	imgData.lookup[i] = colToByte(gray);
-      }
-      break;
-    case splashModeRGB8:
-    case splashModeBGR8:
-      imgData.lookup = (SplashColorPtr)gmallocn(n, 3);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getRGB(&pix, &rgb);
-	imgData.lookup[3*i] = colToByte(rgb.r);
-	imgData.lookup[3*i+1] = colToByte(rgb.g);
-	imgData.lookup[3*i+2] = colToByte(rgb.b);
-      }
-      break;
-    case splashModeXBGR8:
-      imgData.lookup = (SplashColorPtr)gmallocn(n, 4);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getRGB(&pix, &rgb);
-	imgData.lookup[4*i] = colToByte(rgb.r);
-	imgData.lookup[4*i+1] = colToByte(rgb.g);
-	imgData.lookup[4*i+2] = colToByte(rgb.b);
-	imgData.lookup[4*i+3] = 255;
-      }
-      break;
-#if SPLASH_CMYK
-    case splashModeCMYK8:
-      imgData.lookup = (SplashColorPtr)gmallocn(n, 4);
-      for (i = 0; i < n; ++i) {
-	pix = (Guchar)i;
-	colorMap->getCMYK(&pix, &cmyk);
-	imgData.lookup[4*i] = colToByte(cmyk.c);
-	imgData.lookup[4*i+1] = colToByte(cmyk.m);
-	imgData.lookup[4*i+2] = colToByte(cmyk.y);
-	imgData.lookup[4*i+3] = colToByte(cmyk.k);
-      }
-      break;
-#endif
-    }
-  }
-
   if (colorMode == splashModeMono1) {
     srcMode = splashModeMono8;
   } else {
@@ -2767,8 +3226,8 @@ void SplashOutputDev::drawSoftMaskedImage(GfxState *state, Object *ref,
   splash->drawImage(&imageSrc, &imgData, srcMode, gFalse, width, height, mat);
 
   splash->setSoftMask(NULL);
-  gfree(imgData.lookup);
   delete imgData.imgStr;
+  delete pixStr;
   str->close();
 }
 
@@ -2888,6 +3347,7 @@ void SplashOutputDev::beginTransparencyGroup(GfxState *state, double *bbox,
     }
     splash->clear(color, 0);
   } else {
+    transpGroup->origSplash->flushDeferred();
     splash->blitTransparent(transpGroup->origBitmap, tx, ty, 0, 0, w, h);
     splash->setInNonIsolatedGroup(transpGroup->origBitmap, tx, ty);
   }
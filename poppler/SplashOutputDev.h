@@ -43,6 +43,7 @@ class SplashPattern;
 class SplashFontEngine;
 class SplashFont;
 class T3FontCache;
+class ImageStream;
 struct T3FontCacheTag;
 struct T3GlyphStack;
 struct SplashTransparencyGroup;
@@ -85,6 +86,10 @@ public:
   virtual GBool supportTextCSPattern(GfxState *state)
   	{ return state->getFillColorSpace()->getMode() == csPattern; }
 
+  // Smooth shadings are rasterized directly, evaluating the shading
+  // at each pixel, rather than reduced to many small flat fills.
+  virtual GBool useShadedFills() { return gTrue; }
+
   //----- initialization and control
 
   // Start a page.
@@ -123,6 +128,18 @@ public:
   virtual void fill(GfxState *state);
   virtual void eoFill(GfxState *state);
 
+  //----- shaded fills
+  virtual GBool functionShadedFill(GfxState *state,
+				   GfxFunctionShading *shading);
+  virtual GBool axialShadedFill(GfxState *state, GfxAxialShading *shading,
+				double tMin, double tMax);
+  virtual GBool radialShadedFill(GfxState *state, GfxRadialShading *shading,
+				 double sMin, double sMax);
+  virtual GBool gouraudTriangleShadedFill(GfxState *state,
+					  GfxGouraudTriangleShading *shading);
+  virtual GBool patchMeshShadedFill(GfxState *state,
+				    GfxPatchMeshShading *shading);
+
   //----- path clipping
   virtual void clip(GfxState *state);
   virtual void eoClip(GfxState *state);
@@ -218,6 +235,8 @@ public:
 
   SplashFont *getCurrentFont() { return font; }
 
+  SplashFontEngine *getFontEngine() { return fontEngine; }
+
 #if 1 //~tmp: turn off anti-aliasing temporarily
   virtual GBool getVectorAntialias();
   virtual void setVectorAntialias(GBool vaa);
@@ -225,6 +244,12 @@ public:
 
   void setFreeTypeHinting(GBool enable);
 
+  // Rasterize each page in horizontal bands on <bandThreadsA> threads
+  // (see Splash::setDeferredThreads).  Takes effect at the next
+  // startPage().
+  void setBandThreads(int bandThreadsA) { bandThreads = bandThreadsA; }
+  int getBandThreads() { return bandThreads; }
+
 private:
 
   void setupScreenParams(double hDPI, double vDPI);
@@ -234,9 +259,18 @@ private:
   SplashPattern *getColor(GfxGray gray, GfxRGB *rgb);
 #endif
   SplashPath *convertPath(GfxState *state, GfxPath *path);
+  GBool getInverseCTM(GfxState *state, double *ictm);
+  void fillClipWithPattern(GfxState *state, SplashPattern *pattern);
+  void gouraudFillTriangle(GfxState *state,
+			   double x0, double y0, SplashColorPtr color0,
+			   double x1, double y1, SplashColorPtr color1,
+			   double x2, double y2, SplashColorPtr color2);
   void doUpdateFont(GfxState *state);
   void drawType3Glyph(T3FontCache *t3Font,
 		      T3FontCacheTag *tag, Guchar *data);
+  ImageStream *makeImageStream(Object *ref, Stream *str,
+			       int width, int height, int nComps, int nBits,
+			       Stream **pixStr);
   static GBool imageMaskSrc(void *data, SplashColorPtr line);
   static GBool imageSrc(void *data, SplashColorPtr colorLine,
 			Guchar *alphaLine);
@@ -256,6 +290,7 @@ private:
   GBool allowAntialias;
   GBool vectorAntialias;
   GBool enableFreeTypeHinting;
+  int bandThreads;		// threads rasterizing the page
   GBool reverseVideo;		// reverse video mode
   SplashColor paperColor;	// paper color
   SplashScreenParams screenParams;
@@ -65,10 +65,41 @@
 #include "JPXStream.h"
 #endif
 
+#if defined(_WIN32)
+#include <windows.h>
+#include <io.h>
+#elif HAVE_SYS_MMAN_H && HAVE_SYS_STAT_H
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define HAVE_MMAP_STREAM 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define USE_SSE2_PREDICTOR 1
+#else
+#define USE_SSE2_PREDICTOR 0
+#endif
+
 #ifdef __DJGPP__
 static GBool setDJSYSFLAGS = gFalse;
 #endif
 
+#if MULTITHREADED
+#  ifdef _WIN32
+#    define lockFileStream(f)   _lock_file(f)
+#    define unlockFileStream(f) _unlock_file(f)
+#  else
+#    define lockFileStream(f)   flockfile(f)
+#    define unlockFileStream(f) funlockfile(f)
+#  endif
+#else
+#  define lockFileStream(f)
+#  define unlockFileStream(f)
+#endif
+
 #ifdef VMS
 #ifdef __GNUC__
 #define SEEK_SET 0
@@ -77,6 +108,26 @@ static GBool setDJSYSFLAGS = gFalse;
 #endif
 #endif
 
+static int fileStreamSeek(FILE *f, Guint offset, int whence) {
+#if HAVE_FSEEKO
+  return fseeko(f, offset, whence);
+#elif HAVE_FSEEK64
+  return fseek64(f, offset, whence);
+#else
+  return fseek(f, offset, whence);
+#endif
+}
+
+static Guint fileStreamTell(FILE *f) {
+#if HAVE_FSEEKO
+  return (Guint)ftello(f);
+#elif HAVE_FSEEK64
+  return (Guint)ftell64(f);
+#else
+  return (Guint)ftell(f);
+#endif
+}
+
 //------------------------------------------------------------------------
 // Stream (base class)
 //------------------------------------------------------------------------
@@ -96,6 +147,30 @@ int Stream::getRawChar() {
   return EOF;
 }
 
+int Stream::getRawChars(int nChars, Guchar *buffer) {
+  int n, c;
+
+  for (n = 0; n < nChars; ++n) {
+    if ((c = getRawChar()) == EOF) {
+      break;
+    }
+    buffer[n] = (Guchar)c;
+  }
+  return n;
+}
+
+int Stream::getChars(int nChars, Guchar *buffer) {
+  int n, c;
+
+  for (n = 0; n < nChars; ++n) {
+    if ((c = getChar()) == EOF) {
+      break;
+    }
+    buffer[n] = (Guchar)c;
+  }
+  return n;
+}
+
 char *Stream::getLine(char *buf, int size) {
   int i;
   int c;
@@ -438,15 +513,22 @@ GBool ImageStream::getPixel(Guchar *pix) {
   return gTrue;
 }
 
+// The packed line is read with a single getChars() call.  If the
+// stream ends early, the missing bytes are set to 0xff -- the same
+// value the per-char loop used to get out of (Guchar)EOF.
 Guchar *ImageStream::getLine() {
   Gulong buf, bitMask;
   int bits;
   int c;
-  int i;
+  int i, n;
+  Guchar *p;
 
   if (nBits == 1) {
+    n = (nVals + 7) >> 3;
+    p = imgLine + nVals - n;
+    readLine(p, n);
     for (i = 0; i < nVals; i += 8) {
-      c = str->getChar();
+      c = *p++;
       imgLine[i+0] = (Guchar)((c >> 7) & 1);
       imgLine[i+1] = (Guchar)((c >> 6) & 1);
       imgLine[i+2] = (Guchar)((c >> 5) & 1);
@@ -457,18 +539,36 @@ Guchar *ImageStream::getLine() {
       imgLine[i+7] = (Guchar)(c & 1);
     }
   } else if (nBits == 8) {
-    Guchar *line = imgLine;
-    for (i = 0; i < nVals; ++i) {
-      *line++ = str->getChar();
-    }
+    readLine(imgLine, nVals);
   } else if (nBits == 16) {
     // this is a hack to support 16 bits images, everywhere
     // we assume a component fits in 8 bits, with this hack
     // we treat 16 bit images as 8 bit ones until it's fixed correctly.
     // The hack has another part on GfxImageColorMap::GfxImageColorMap
+    for (i = 0; i < nVals; i += n) {
+      n = nVals - i < imageStreamBufSize / 2 ? nVals - i
+	                                     : imageStreamBufSize / 2;
+      readLine(lineBuf, 2 * n);
+      for (c = 0; c < n; ++c) {
+	imgLine[i + c] = lineBuf[2 * c];
+      }
+    }
+  } else if (nBits < 8) {
+    // the packed line is shorter than the unpacked one, so it is read
+    // into the tail of imgLine and unpacked from front to back
+    n = (nVals * nBits + 7) >> 3;
+    p = imgLine + nVals - n;
+    readLine(p, n);
+    bitMask = (1 << nBits) - 1;
+    buf = 0;
+    bits = 0;
     for (i = 0; i < nVals; ++i) {
-      imgLine[i] = str->getChar();
-      str->getChar();
+      if (bits < nBits) {
+	buf = (buf << 8) | *p++;
+	bits += 8;
+      }
+      imgLine[i] = (Guchar)((buf >> (bits - nBits)) & bitMask);
+      bits -= nBits;
     }
   } else {
     bitMask = (1 << nBits) - 1;
@@ -487,11 +587,185 @@ Guchar *ImageStream::getLine() {
 }
 
 void ImageStream::skipLine() {
-  int n, i;
+  int n, m;
 
   n = (nVals * nBits + 7) >> 3;
-  for (i = 0; i < n; ++i) {
-    str->getChar();
+  while (n > 0) {
+    m = n < imageStreamBufSize ? n : imageStreamBufSize;
+    if (str->getChars(m, lineBuf) < m) {
+      break;
+    }
+    n -= m;
+  }
+}
+
+void ImageStream::readLine(Guchar *line, int n) {
+  int m;
+
+  m = str->getChars(n, line);
+  if (m < n) {
+    memset(line + m, 0xff, n - m);
+  }
+}
+
+//------------------------------------------------------------------------
+// PNG row filters
+//
+// Each of these undoes one PNG filter type on a row of <n> bytes, in
+// place.  <line> and <prev> (the previous, already decoded row) are
+// both preceded by <bpp> zero bytes, which stand in for the pixel left
+// of the first one.  With SSE2, pixels of 3 and 4 bytes are done one
+// whole pixel at a time (the filters depend on the decoded pixel to
+// the left, so there is no parallelism across pixels), and the Up
+// filter 16 bytes at a time.
+//------------------------------------------------------------------------
+
+#if USE_SSE2_PREDICTOR
+
+static inline __m128i pngLoadPixel(Guchar *p, int bpp) {
+  int x;
+
+  if (bpp == 4) {
+    memcpy(&x, p, 4);
+  } else {
+    x = p[0] | (p[1] << 8) | (p[2] << 16);
+  }
+  return _mm_cvtsi32_si128(x);
+}
+
+static inline void pngStorePixel(Guchar *p, __m128i v, int bpp) {
+  int x;
+
+  x = _mm_cvtsi128_si32(v);
+  if (bpp == 4) {
+    memcpy(p, &x, 4);
+  } else {
+    p[0] = (Guchar)x;
+    p[1] = (Guchar)(x >> 8);
+    p[2] = (Guchar)(x >> 16);
+  }
+}
+
+static inline __m128i pngAbs16(__m128i x) {
+  return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+#endif
+
+static void pngUnfilterSub(Guchar *line, int bpp, int n) {
+  int i;
+
+  i = 0;
+#if USE_SSE2_PREDICTOR
+  if (bpp == 3 || bpp == 4) {
+    __m128i a;
+
+    a = _mm_setzero_si128();
+    for (; i + bpp <= n; i += bpp) {
+      a = _mm_add_epi8(a, pngLoadPixel(line + i, bpp));
+      pngStorePixel(line + i, a, bpp);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    line[i] += line[i - bpp];
+  }
+}
+
+static void pngUnfilterUp(Guchar *line, Guchar *prev, int n) {
+  int i;
+
+  i = 0;
+#if USE_SSE2_PREDICTOR
+  for (; i + 16 <= n; i += 16) {
+    _mm_storeu_si128((__m128i *)(line + i),
+		     _mm_add_epi8(_mm_loadu_si128((__m128i *)(line + i)),
+				  _mm_loadu_si128((__m128i *)(prev + i))));
+  }
+#endif
+  for (; i < n; ++i) {
+    line[i] += prev[i];
+  }
+}
+
+static void pngUnfilterAvg(Guchar *line, Guchar *prev, int bpp, int n) {
+  int i;
+
+  i = 0;
+#if USE_SSE2_PREDICTOR
+  if (bpp == 3 || bpp == 4) {
+    __m128i a, b, avg, ones;
+
+    // _mm_avg_epu8 rounds up, PNG rounds down
+    ones = _mm_set1_epi8(1);
+    a = _mm_setzero_si128();
+    for (; i + bpp <= n; i += bpp) {
+      b = pngLoadPixel(prev + i, bpp);
+      avg = _mm_sub_epi8(_mm_avg_epu8(a, b),
+			 _mm_and_si128(_mm_xor_si128(a, b), ones));
+      a = _mm_add_epi8(avg, pngLoadPixel(line + i, bpp));
+      pngStorePixel(line + i, a, bpp);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    line[i] += (line[i - bpp] + prev[i]) >> 1;
+  }
+}
+
+static void pngUnfilterPaeth(Guchar *line, Guchar *prev, int bpp, int n) {
+  int left, up, upLeft, p, pa, pb, pc;
+  int i;
+
+  i = 0;
+#if USE_SSE2_PREDICTOR
+  if (bpp == 3 || bpp == 4) {
+    __m128i zero, a, b, c, pa16, pb16, pc16, smallest, nearest, mask;
+
+    // a = left, b = up, c = up-left, all widened to 16 bits;
+    // pa = |b - c|, pb = |a - c|, pc = |a + b - 2c|
+    zero = _mm_setzero_si128();
+    a = c = zero;
+    for (; i + bpp <= n; i += bpp) {
+      b = _mm_unpacklo_epi8(pngLoadPixel(prev + i, bpp), zero);
+      pa16 = _mm_sub_epi16(b, c);
+      pb16 = _mm_sub_epi16(a, c);
+      pc16 = pngAbs16(_mm_add_epi16(pa16, pb16));
+      pa16 = pngAbs16(pa16);
+      pb16 = pngAbs16(pb16);
+      smallest = _mm_min_epi16(pc16, _mm_min_epi16(pa16, pb16));
+      // nearest = pa == smallest ? a : pb == smallest ? b : c
+      mask = _mm_cmpeq_epi16(pb16, smallest);
+      nearest = _mm_or_si128(_mm_and_si128(mask, b),
+			     _mm_andnot_si128(mask, c));
+      mask = _mm_cmpeq_epi16(pa16, smallest);
+      nearest = _mm_or_si128(_mm_and_si128(mask, a),
+			     _mm_andnot_si128(mask, nearest));
+      a = _mm_add_epi8(_mm_packus_epi16(nearest, zero),
+		       pngLoadPixel(line + i, bpp));
+      pngStorePixel(line + i, a, bpp);
+      a = _mm_unpacklo_epi8(a, zero);
+      c = b;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    left = line[i - bpp];
+    up = prev[i];
+    upLeft = prev[i - bpp];
+    p = left + up - upLeft;
+    if ((pa = p - left) < 0)
+      pa = -pa;
+    if ((pb = p - up) < 0)
+      pb = -pb;
+    if ((pc = p - upLeft) < 0)
+      pc = -pc;
+    if (pa <= pb && pa <= pc)
+      line[i] += left;
+    else if (pb <= pc)
+      line[i] += up;
+    else
+      line[i] += upLeft;
   }
 }
 
@@ -507,6 +781,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   nComps = nCompsA;
   nBits = nBitsA;
   predLine = NULL;
+  rawLine = NULL;
   ok = gFalse;
 
   nVals = width * nComps;
@@ -521,6 +796,8 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
   }
   predLine = (Guchar *)gmalloc(rowBytes);
   memset(predLine, 0, rowBytes);
+  rawLine = (Guchar *)gmalloc(rowBytes);
+  memset(rawLine, 0, rowBytes);
   predIdx = rowBytes;
 
   ok = gTrue;
@@ -528,6 +805,7 @@ StreamPredictor::StreamPredictor(Stream *strA, int predictorA,
 
 StreamPredictor::~StreamPredictor() {
   gfree(predLine);
+  gfree(rawLine);
 }
 
 int StreamPredictor::lookChar() {
@@ -548,14 +826,34 @@ int StreamPredictor::getChar() {
   return predLine[predIdx++];
 }
 
+int StreamPredictor::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (predIdx >= rowBytes) {
+      if (!getNextLine()) {
+	break;
+      }
+    }
+    m = rowBytes - predIdx;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, predLine + predIdx, m);
+    predIdx += m;
+    n += m;
+  }
+  return n;
+}
+
 GBool StreamPredictor::getNextLine() {
   int curPred;
   Guchar upLeftBuf[gfxColorMaxComps * 2 + 1];
-  int left, up, upLeft, p, pa, pb, pc;
-  int c;
+  Guchar *line;
   Gulong inBuf, outBuf, bitMask;
   int inBits, outBits;
-  int i, j, k, kk;
+  int i, j, k, kk, n;
 
   // get PNG optimum predictor number
   if (predictor >= 10) {
@@ -567,57 +865,42 @@ GBool StreamPredictor::getNextLine() {
     curPred = predictor;
   }
 
-  // read the raw line, apply PNG (byte) predictor
-  memset(upLeftBuf, 0, pixBytes + 1);
-  for (i = pixBytes; i < rowBytes; ++i) {
-    for (j = pixBytes; j > 0; --j) {
-      upLeftBuf[j] = upLeftBuf[j-1];
-    }
-    upLeftBuf[0] = predLine[i];
-    if ((c = str->getRawChar()) == EOF) {
-      if (i > pixBytes) {
-	// this ought to return false, but some (broken) PDF files
-	// contain truncated image data, and Adobe apparently reads the
-	// last partial line
-	break;
-      }
-      return gFalse;
-    }
-    switch (curPred) {
-    case 11:			// PNG sub
-      predLine[i] = predLine[i - pixBytes] + (Guchar)c;
-      break;
-    case 12:			// PNG up
-      predLine[i] = predLine[i] + (Guchar)c;
-      break;
-    case 13:			// PNG average
-      predLine[i] = ((predLine[i - pixBytes] + predLine[i]) >> 1) +
-	            (Guchar)c;
-      break;
-    case 14:			// PNG Paeth
-      left = predLine[i - pixBytes];
-      up = predLine[i];
-      upLeft = upLeftBuf[pixBytes];
-      p = left + up - upLeft;
-      if ((pa = p - left) < 0)
-	pa = -pa;
-      if ((pb = p - up) < 0)
-	pb = -pb;
-      if ((pc = p - upLeft) < 0)
-	pc = -pc;
-      if (pa <= pb && pa <= pc)
-	predLine[i] = left + (Guchar)c;
-      else if (pb <= pc)
-	predLine[i] = up + (Guchar)c;
-      else
-	predLine[i] = upLeft + (Guchar)c;
-      break;
-    case 10:			// PNG none
-    default:			// no predictor or TIFF predictor
-      predLine[i] = (Guchar)c;
-      break;
-    }
+  // read the raw line
+  n = str->getRawChars(rowBytes - pixBytes, rawLine + pixBytes);
+  if (n == 0) {
+    return gFalse;
   }
+  // if n is short, this ought to return false, but some (broken) PDF
+  // files contain truncated image data, and Adobe apparently reads
+  // the last partial line
+
+  // apply PNG (byte) predictor -- the line is decoded in place in
+  // rawLine, with the previous line in predLine, and then the two
+  // buffers are swapped
+  line = rawLine + pixBytes;
+  switch (curPred) {
+  case 11:			// PNG sub
+    pngUnfilterSub(line, pixBytes, n);
+    break;
+  case 12:			// PNG up
+    pngUnfilterUp(line, predLine + pixBytes, n);
+    break;
+  case 13:			// PNG average
+    pngUnfilterAvg(line, predLine + pixBytes, pixBytes, n);
+    break;
+  case 14:			// PNG Paeth
+    pngUnfilterPaeth(line, predLine + pixBytes, pixBytes, n);
+    break;
+  case 10:			// PNG none
+  default:			// no predictor or TIFF predictor
+    break;
+  }
+  // a truncated line keeps the previous line's data at the end
+  if (n < rowBytes - pixBytes) {
+    memcpy(line + n, predLine + pixBytes + n, rowBytes - pixBytes - n);
+  }
+  rawLine = predLine;
+  predLine = line - pixBytes;
 
   // apply TIFF (component) predictor
   if (predictor == 2) {
@@ -629,9 +912,7 @@ GBool StreamPredictor::getNextLine() {
 	predLine[i] ^= inBuf >> nComps;
       }
     } else if (nBits == 8) {
-      for (i = pixBytes; i < rowBytes; ++i) {
-	predLine[i] += predLine[i - nComps];
-      }
+      pngUnfilterSub(predLine + pixBytes, nComps, rowBytes - pixBytes);
     } else {
       memset(upLeftBuf, 0, nComps + 1);
       bitMask = (1 << nBits) - 1;
@@ -681,12 +962,9 @@ FileStream::FileStream(FILE *fA, Guint startA, GBool limitedA,
   length = lengthA;
   bufPtr = bufEnd = buf;
   bufPos = start;
-  savePos = 0;
-  saved = gFalse;
 }
 
 FileStream::~FileStream() {
-  close();
 }
 
 Stream *FileStream::makeSubStream(Guint startA, GBool limitedA,
@@ -695,34 +973,15 @@ Stream *FileStream::makeSubStream(Guint startA, GBool limitedA,
 }
 
 void FileStream::reset() {
-#if HAVE_FSEEKO
-  savePos = (Guint)ftello(f);
-  fseeko(f, start, SEEK_SET);
-#elif HAVE_FSEEK64
-  savePos = (Guint)ftell64(f);
-  fseek64(f, start, SEEK_SET);
-#else
-  savePos = (Guint)ftell(f);
-  fseek(f, start, SEEK_SET);
-#endif
-  saved = gTrue;
   bufPtr = bufEnd = buf;
   bufPos = start;
 }
 
-void FileStream::close() {
-  if (saved) {
-#if HAVE_FSEEKO
-    fseeko(f, savePos, SEEK_SET);
-#elif HAVE_FSEEK64
-    fseek64(f, savePos, SEEK_SET);
-#else
-    fseek(f, savePos, SEEK_SET);
-#endif
-    saved = gFalse;
-  }
-}
-
+// All the FileStreams of a document share one FILE, so each of them
+// keeps its own position and seeks to it before reading.  The FILE
+// is locked around the seek + read pair so that streams being read
+// from different threads don't move the file position under each
+// other.
 GBool FileStream::fillBuf() {
   int n;
 
@@ -736,7 +995,13 @@ GBool FileStream::fillBuf() {
   } else {
     n = fileStreamBufSize;
   }
-  n = fread(buf, 1, n, f);
+  lockFileStream(f);
+  if (fileStreamSeek(f, bufPos, SEEK_SET) == 0) {
+    n = fread(buf, 1, n, f);
+  } else {
+    n = 0;
+  }
+  unlockFileStream(f);
   bufEnd = buf + n;
   if (bufPtr >= bufEnd) {
     return gFalse;
@@ -744,45 +1009,38 @@ GBool FileStream::fillBuf() {
   return gTrue;
 }
 
+int FileStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
 void FileStream::setPos(Guint pos, int dir) {
   Guint size;
 
   if (dir >= 0) {
-#if HAVE_FSEEKO
-    fseeko(f, pos, SEEK_SET);
-#elif HAVE_FSEEK64
-    fseek64(f, pos, SEEK_SET);
-#else
-    fseek(f, pos, SEEK_SET);
-#endif
     bufPos = pos;
   } else {
-#if HAVE_FSEEKO
-    fseeko(f, 0, SEEK_END);
-    size = (Guint)ftello(f);
-#elif HAVE_FSEEK64
-    fseek64(f, 0, SEEK_END);
-    size = (Guint)ftell64(f);
-#else
-    fseek(f, 0, SEEK_END);
-    size = (Guint)ftell(f);
-#endif
+    lockFileStream(f);
+    fileStreamSeek(f, 0, SEEK_END);
+    size = fileStreamTell(f);
+    unlockFileStream(f);
     if (pos > size)
       pos = (Guint)size;
-#ifdef __CYGWIN32__
-    //~ work around a bug in cygwin's implementation of fseek
-    rewind(f);
-#endif
-#if HAVE_FSEEKO
-    fseeko(f, -(int)pos, SEEK_END);
-    bufPos = (Guint)ftello(f);
-#elif HAVE_FSEEK64
-    fseek64(f, -(int)pos, SEEK_END);
-    bufPos = (Guint)ftell64(f);
-#else
-    fseek(f, -(int)pos, SEEK_END);
-    bufPos = (Guint)ftell(f);
-#endif
+    bufPos = size - pos;
   }
   bufPtr = bufEnd = buf;
 }
@@ -834,6 +1092,22 @@ void MemStream::reset() {
 void MemStream::close() {
 }
 
+int MemStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
 void MemStream::setPos(Guint pos, int dir) {
   Guint i;
 
@@ -856,6 +1130,427 @@ void MemStream::moveStart(int delta) {
   bufPtr = buf + start;
 }
 
+//------------------------------------------------------------------------
+// MmapStream
+//------------------------------------------------------------------------
+
+struct MmapStreamMapping {
+  char *data;
+  Guint size;
+  int refCnt;
+#ifdef _WIN32
+  HANDLE mapHandle;
+#endif
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+};
+
+MmapStream::MmapStream(FILE *fA, Object *dictA):
+    BaseStream(dictA) {
+  char *data;
+  Guint size;
+#if defined(_WIN32)
+  HANDLE fileHandle, mapHandle;
+  DWORD sizeHi;
+#elif HAVE_MMAP_STREAM
+  struct stat st;
+  void *p;
+#endif
+
+  mapping = NULL;
+  buf = bufEnd = bufPtr = NULL;
+  start = length = 0;
+
+#if defined(_WIN32)
+  fileHandle = (HANDLE)_get_osfhandle(_fileno(fA));
+  if (fileHandle == INVALID_HANDLE_VALUE ||
+      GetFileType(fileHandle) != FILE_TYPE_DISK) {
+    return;
+  }
+  size = GetFileSize(fileHandle, &sizeHi);
+  if (size == 0 || size == INVALID_FILE_SIZE || sizeHi != 0) {
+    return;
+  }
+  if (!(mapHandle = CreateFileMapping(fileHandle, NULL, PAGE_READONLY,
+				      0, 0, NULL))) {
+    return;
+  }
+  if (!(data = (char *)MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0))) {
+    CloseHandle(mapHandle);
+    return;
+  }
+#elif HAVE_MMAP_STREAM
+  if (fstat(fileno(fA), &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_size <= 0 || (unsigned long long)st.st_size > 0xffffffffULL) {
+    return;
+  }
+  size = (Guint)st.st_size;
+  p = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(fA), 0);
+  if (p == MAP_FAILED) {
+    return;
+  }
+  data = (char *)p;
+#else
+  return;
+#endif
+
+  mapping = new MmapStreamMapping;
+  mapping->data = data;
+  mapping->size = size;
+  mapping->refCnt = 1;
+#ifdef _WIN32
+  mapping->mapHandle = mapHandle;
+#endif
+#if MULTITHREADED
+  gInitMutex(&mapping->mutex);
+#endif
+  buf = data;
+  length = size;
+  bufPtr = buf;
+  bufEnd = buf + length;
+}
+
+MmapStream::MmapStream(MmapStreamMapping *mappingA, Guint startA,
+		       Guint lengthA, Object *dictA):
+    BaseStream(dictA) {
+  mapping = mappingA;
+#if MULTITHREADED
+  gLockMutex(&mapping->mutex);
+#endif
+  ++mapping->refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&mapping->mutex);
+#endif
+  buf = mapping->data;
+  start = startA;
+  length = lengthA;
+  bufPtr = buf + start;
+  bufEnd = buf + start + length;
+}
+
+MmapStream::~MmapStream() {
+  GBool done;
+
+  if (!mapping) {
+    return;
+  }
+#if MULTITHREADED
+  gLockMutex(&mapping->mutex);
+#endif
+  done = --mapping->refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&mapping->mutex);
+#endif
+  if (done) {
+#if defined(_WIN32)
+    UnmapViewOfFile(mapping->data);
+    CloseHandle(mapping->mapHandle);
+#elif HAVE_MMAP_STREAM
+    munmap(mapping->data, mapping->size);
+#endif
+#if MULTITHREADED
+    gDestroyMutex(&mapping->mutex);
+#endif
+    delete mapping;
+  }
+}
+
+Stream *MmapStream::makeSubStream(Guint startA, GBool limitedA,
+				  Guint lengthA, Object *dictA) {
+  Guint newLength;
+
+  if (startA > mapping->size) {
+    startA = mapping->size;
+  }
+  if (!limitedA || lengthA > mapping->size - startA) {
+    newLength = mapping->size - startA;
+  } else {
+    newLength = lengthA;
+  }
+  return new MmapStream(mapping, startA, newLength, dictA);
+}
+
+void MmapStream::reset() {
+  bufPtr = buf + start;
+}
+
+int MmapStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (bufEnd - bufPtr < nChars) {
+    n = (int)(bufEnd - bufPtr);
+  } else {
+    n = nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr += n;
+  return n;
+}
+
+void MmapStream::setPos(Guint pos, int dir) {
+  Guint i;
+
+  if (dir >= 0) {
+    i = pos;
+  } else {
+    i = (pos > start + length) ? 0 : start + length - pos;
+  }
+  if (i < start) {
+    i = start;
+  } else if (i > start + length) {
+    i = start + length;
+  }
+  bufPtr = buf + i;
+}
+
+void MmapStream::moveStart(int delta) {
+  start += delta;
+  length -= delta;
+  bufPtr = buf + start;
+}
+
+//------------------------------------------------------------------------
+// ByteRangeStream
+//------------------------------------------------------------------------
+
+#if MULTITHREADED
+#ifdef _WIN32
+typedef DWORD ByteRangeThreadID;
+#define byteRangeCurrentThread() GetCurrentThreadId()
+#define byteRangeSameThread(a, b) ((a) == (b))
+#else
+typedef pthread_t ByteRangeThreadID;
+#define byteRangeCurrentThread() pthread_self()
+#define byteRangeSameThread(a, b) pthread_equal(a, b)
+#endif
+
+struct ByteRangeMissingCount {
+  ByteRangeThreadID thread;
+  Guint count;
+};
+#endif
+
+struct ByteRangeStreamFile {
+  ByteRangeProvider *provider;
+  Guint size;			// length of the file
+  int refCnt;
+#if MULTITHREADED
+  ByteRangeMissingCount *missingCounts;	// reads which ran into
+					//   missing data, for each
+					//   thread which had any
+  int nMissingCounts;
+  int missingCountsSize;
+  GooMutex mutex;
+#else
+  Guint missingCount;		// reads which ran into missing data
+#endif
+};
+
+#if MULTITHREADED
+// Return the calling thread's missing data count entry, adding one if
+// <add> is set (else returning NULL if there isn't one).  The file's
+// mutex must be held.
+static ByteRangeMissingCount *getThreadMissingCount(ByteRangeStreamFile *file,
+						    GBool add) {
+  ByteRangeThreadID thread;
+  int i;
+
+  thread = byteRangeCurrentThread();
+  for (i = 0; i < file->nMissingCounts; ++i) {
+    if (byteRangeSameThread(file->missingCounts[i].thread, thread)) {
+      return &file->missingCounts[i];
+    }
+  }
+  if (!add) {
+    return NULL;
+  }
+  if (file->nMissingCounts == file->missingCountsSize) {
+    file->missingCountsSize += 8;
+    file->missingCounts = (ByteRangeMissingCount *)
+        greallocn(file->missingCounts, file->missingCountsSize,
+		  sizeof(ByteRangeMissingCount));
+  }
+  file->missingCounts[file->nMissingCounts].thread = thread;
+  file->missingCounts[file->nMissingCounts].count = 0;
+  return &file->missingCounts[file->nMissingCounts++];
+}
+#endif
+
+ByteRangeStream::ByteRangeStream(ByteRangeProvider *providerA,
+				 Object *dictA):
+    BaseStream(dictA) {
+  file = new ByteRangeStreamFile;
+  file->provider = providerA;
+  file->size = providerA->getLength();
+  file->refCnt = 1;
+#if MULTITHREADED
+  file->missingCounts = NULL;
+  file->nMissingCounts = file->missingCountsSize = 0;
+  gInitMutex(&file->mutex);
+#else
+  file->missingCount = 0;
+#endif
+  start = 0;
+  length = file->size;
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+}
+
+ByteRangeStream::ByteRangeStream(ByteRangeStreamFile *fileA, Guint startA,
+				 Guint lengthA, Object *dictA):
+    BaseStream(dictA) {
+  file = fileA;
+#if MULTITHREADED
+  gLockMutex(&file->mutex);
+#endif
+  ++file->refCnt;
+#if MULTITHREADED
+  gUnlockMutex(&file->mutex);
+#endif
+  start = startA;
+  length = lengthA;
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+}
+
+ByteRangeStream::~ByteRangeStream() {
+  GBool done;
+
+#if MULTITHREADED
+  gLockMutex(&file->mutex);
+#endif
+  done = --file->refCnt == 0;
+#if MULTITHREADED
+  gUnlockMutex(&file->mutex);
+#endif
+  if (done) {
+#if MULTITHREADED
+    gfree(file->missingCounts);
+    gDestroyMutex(&file->mutex);
+#endif
+    delete file;
+  }
+}
+
+Stream *ByteRangeStream::makeSubStream(Guint startA, GBool limitedA,
+				       Guint lengthA, Object *dictA) {
+  Guint newLength;
+
+  if (startA > file->size) {
+    startA = file->size;
+  }
+  if (!limitedA || lengthA > file->size - startA) {
+    newLength = file->size - startA;
+  } else {
+    newLength = lengthA;
+  }
+  return new ByteRangeStream(file, startA, newLength, dictA);
+}
+
+void ByteRangeStream::reset() {
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+}
+
+GBool ByteRangeStream::fillBuf() {
+  Guint n, reqStart, reqLength;
+
+  bufPos += bufEnd - buf;
+  bufPtr = bufEnd = buf;
+  if (bufPos >= start + length) {
+    return gFalse;
+  }
+  if (bufPos + byteRangeStreamBufSize > start + length) {
+    n = start + length - bufPos;
+  } else {
+    n = byteRangeStreamBufSize;
+  }
+  if (!file->provider->hasRange(bufPos, n)) {
+#if MULTITHREADED
+    gLockMutex(&file->mutex);
+    ++getThreadMissingCount(file, gTrue)->count;
+    gUnlockMutex(&file->mutex);
+#else
+    ++file->missingCount;
+#endif
+    // ask for a bit more than is needed right now, to cut down on the
+    // number of round trips
+    reqStart = bufPos - bufPos % byteRangeStreamBufSize;
+    if (file->size - reqStart > byteRangeStreamRequestSize) {
+      reqLength = byteRangeStreamRequestSize;
+    } else {
+      reqLength = file->size - reqStart;
+    }
+    file->provider->requestRange(reqStart, reqLength);
+    return gFalse;
+  }
+  file->provider->readRange(bufPos, n, buf);
+  bufEnd = buf + n;
+  return gTrue;
+}
+
+int ByteRangeStream::getChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    if (bufPtr >= bufEnd && !fillBuf()) {
+      break;
+    }
+    m = (int)(bufEnd - bufPtr);
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, bufPtr, m);
+    bufPtr += m;
+    n += m;
+  }
+  return n;
+}
+
+void ByteRangeStream::setPos(Guint pos, int dir) {
+  if (dir >= 0) {
+    bufPos = pos;
+  } else {
+    if (pos > file->size) {
+      pos = file->size;
+    }
+    bufPos = file->size - pos;
+  }
+  if (bufPos < start) {
+    bufPos = start;
+  } else if (bufPos > start + length) {
+    bufPos = start + length;
+  }
+  bufPtr = bufEnd = buf;
+}
+
+void ByteRangeStream::moveStart(int delta) {
+  start += delta;
+  length -= delta;
+  bufPtr = bufEnd = buf;
+  bufPos = start;
+}
+
+Guint ByteRangeStream::getMissingCount() {
+#if MULTITHREADED
+  ByteRangeMissingCount *mc;
+  Guint count;
+
+  gLockMutex(&file->mutex);
+  mc = getThreadMissingCount(file, gFalse);
+  count = mc ? mc->count : 0;
+  gUnlockMutex(&file->mutex);
+  return count;
+#else
+  return file->missingCount;
+#endif
+}
+
 //------------------------------------------------------------------------
 // EmbedStream
 //------------------------------------------------------------------------
@@ -892,6 +1587,22 @@ int EmbedStream::lookChar() {
   return str->lookChar();
 }
 
+int EmbedStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  if (limited && length < (Guint)nChars) {
+    nChars = (int)length;
+  }
+  n = str->getChars(nChars, buffer);
+  if (limited) {
+    length -= n;
+  }
+  return n;
+}
+
 void EmbedStream::setPos(Guint pos, int dir) {
   error(-1, "Internal: called setPos() on EmbedStream");
 }
@@ -905,6 +1616,65 @@ void EmbedStream::moveStart(int delta) {
   error(-1, "Internal: called moveStart() on EmbedStream");
 }
 
+//------------------------------------------------------------------------
+// BufStream
+//------------------------------------------------------------------------
+
+BufStream::BufStream(Stream *strA):
+    FilterStream(strA) {
+  bufPtr = bufEnd = buf;
+}
+
+// The underlying stream belongs to whoever made the BufStream.
+BufStream::~BufStream() {
+}
+
+void BufStream::reset() {
+  str->reset();
+  bufPtr = bufEnd = buf;
+}
+
+int BufStream::getChars(int nChars, Guchar *buffer) {
+  int n;
+
+  if (nChars <= 0) {
+    return 0;
+  }
+  n = (int)(bufEnd - bufPtr);
+  if (n >= nChars) {
+    memcpy(buffer, bufPtr, nChars);
+    bufPtr += nChars;
+    return nChars;
+  }
+  memcpy(buffer, bufPtr, n);
+  bufPtr = bufEnd = buf;
+  return n + str->getChars(nChars - n, buffer + n);
+}
+
+// Positions in a filtered stream are positions in the underlying file
+// (and only used for error messages), so the read-ahead is only taken
+// out for base streams.
+int BufStream::getPos() {
+  if ((Stream *)str->getBaseStream() != str) {
+    return str->getPos();
+  }
+  return str->getPos() - (int)(bufEnd - bufPtr);
+}
+
+void BufStream::setPos(Guint pos, int dir) {
+  str->setPos(pos, dir);
+  bufPtr = bufEnd = buf;
+}
+
+GBool BufStream::fillBuf() {
+  int n;
+
+  n = str->getChars(bufStreamSize, buf);
+  bufPtr = buf;
+  bufEnd = buf + n;
+  return n > 0;
+}
+
 //------------------------------------------------------------------------
 // ASCIIHexStream
 //------------------------------------------------------------------------
@@ -1135,6 +1905,37 @@ int LZWStream::lookChar() {
   return seqBuf[seqIndex];
 }
 
+int LZWStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int LZWStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  if (eof) {
+    return 0;
+  }
+  n = 0;
+  while (n < nChars) {
+    if (seqIndex >= seqLength) {
+      if (!processNextCode()) {
+	break;
+      }
+    }
+    m = seqLength - seqIndex;
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, seqBuf + seqIndex, m);
+    seqIndex += m;
+    n += m;
+  }
+  return n;
+}
+
 int LZWStream::getRawChar() {
   if (eof) {
     return EOF;
@@ -4160,6 +4961,40 @@ int FlateStream::lookChar() {
   return c;
 }
 
+int FlateStream::getChars(int nChars, Guchar *buffer) {
+  if (pred) {
+    return pred->getChars(nChars, buffer);
+  }
+  return getRawChars(nChars, buffer);
+}
+
+int FlateStream::getRawChars(int nChars, Guchar *buffer) {
+  int n, m;
+
+  n = 0;
+  while (n < nChars) {
+    while (remain == 0) {
+      if (endOfBlock && eof) {
+	return n;
+      }
+      readSome();
+    }
+    // the output buffer is circular: copy up to its end at most
+    m = remain;
+    if (m > flateWindow - index) {
+      m = flateWindow - index;
+    }
+    if (m > nChars - n) {
+      m = nChars - n;
+    }
+    memcpy(buffer + n, buf + index, m);
+    index = (index + m) & flateMask;
+    remain -= m;
+    n += m;
+  }
+  return n;
+}
+
 int FlateStream::getRawChar() {
   int c;
 
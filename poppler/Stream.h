@@ -31,9 +31,14 @@
 #endif
 
 #include <stdio.h>
+#include "poppler-config.h"
 #include "goo/gtypes.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class BaseStream;
 
 //------------------------------------------------------------------------
@@ -82,8 +87,13 @@ public:
   virtual ~Stream();
 
   // Reference counting.
+#if MULTITHREADED
+  int incRef() { return gAtomicIncrement(&ref); }
+  int decRef() { return gAtomicDecrement(&ref); }
+#else
   int incRef() { return ++ref; }
   int decRef() { return --ref; }
+#endif
 
   // Get kind of stream.
   virtual StreamKind getKind() = 0;
@@ -100,10 +110,26 @@ public:
   // Peek at next char in stream.
   virtual int lookChar() = 0;
 
+  // Get the next <nChars> chars from the stream into <buffer>.
+  // Returns the number of chars read, which is less than <nChars>
+  // only at the end of the stream.  The default implementation calls
+  // getChar() for each char; streams which can hand out whole blocks
+  // override it.
+  virtual int getChars(int nChars, Guchar *buffer);
+
   // Get next char from stream without using the predictor.
   // This is only used by StreamPredictor.
   virtual int getRawChar();
 
+  // Get the next <nChars> chars from stream without using the
+  // predictor.  This is only used by StreamPredictor.
+  virtual int getRawChars(int nChars, Guchar *buffer);
+
+  // Returns false if the data following this stream belongs to
+  // someone else (an inline image in a content stream), in which case
+  // filters must not read ahead of the data they have decoded.
+  virtual GBool canReadAhead() { return gTrue; }
+
   // Get next char directly from stream source, without filtering it
   virtual int getUnfilteredChar () = 0;
 
@@ -157,7 +183,11 @@ private:
 
   Stream *makeFilter(char *name, Stream *str, Object *params);
 
+#if MULTITHREADED
+  GooAtomicCounter ref;		// reference count
+#else
   int ref;			// reference count
+#endif
 };
 
 
@@ -243,6 +273,15 @@ public:
   virtual Guint getStart() = 0;
   virtual void moveStart(int delta) = 0;
 
+  // Number of times a read by the calling thread from this file
+  // (through any of its streams) has run into data which hasn't
+  // arrived yet, in which case the read returned EOF early.  Only a
+  // ByteRangeStream's data can be missing; callers compare the count
+  // before and after an operation to tell "not loaded yet" from
+  // "damaged".  The count is per thread so that other threads' reads
+  // don't make a complete operation look incomplete.
+  virtual Guint getMissingCount() { return 0; }
+
 private:
 
   Object dict;
@@ -266,6 +305,7 @@ public:
   virtual Stream *getUndecodedStream() { return str->getUndecodedStream(); }
   virtual Dict *getDict() { return str->getDict(); }
   virtual Stream *getNextStream() { return str; }
+  virtual GBool canReadAhead() { return str->canReadAhead(); }
 
   virtual int getUnfilteredChar () { return str->getUnfilteredChar(); }
   virtual void unfilteredReset () { str->unfilteredReset(); }
@@ -279,6 +319,8 @@ protected:
 // ImageStream
 //------------------------------------------------------------------------
 
+#define imageStreamBufSize 1024
+
 class ImageStream {
 public:
 
@@ -308,6 +350,8 @@ public:
 
 private:
 
+  void readLine(Guchar *line, int n);
+
   Stream *str;			// base stream
   int width;			// pixels per line
   int nComps;			// components per pixel
@@ -315,6 +359,8 @@ private:
   int nVals;			// components per line
   Guchar *imgLine;		// line buffer
   int imgIdx;			// current index in imgLine
+  Guchar lineBuf[imageStreamBufSize]; // packed data for 16-bit lines
+				//   and skipLine()
 };
 
 //------------------------------------------------------------------------
@@ -335,6 +381,7 @@ public:
 
   int lookChar();
   int getChar();
+  int getChars(int nChars, Guchar *buffer);
 
 private:
 
@@ -349,6 +396,7 @@ private:
   int pixBytes;			// bytes per pixel
   int rowBytes;			// bytes per line
   Guchar *predLine;		// line buffer
+  Guchar *rawLine;		// undecoded line, from getRawChars()
   int predIdx;			// current index in predLine
   GBool ok;
 };
@@ -369,11 +417,11 @@ public:
 				Guint lengthA, Object *dictA);
   virtual StreamKind getKind() { return strFile; }
   virtual void reset();
-  virtual void close();
   virtual int getChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
   virtual int lookChar()
     { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getPos() { return bufPos + (bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -394,8 +442,6 @@ private:
   char *bufPtr;
   char *bufEnd;
   Guint bufPos;
-  int savePos;
-  GBool saved;
 };
 
 //------------------------------------------------------------------------
@@ -416,6 +462,7 @@ public:
     { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
   virtual int lookChar()
     { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getPos() { return (int)(bufPtr - buf); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart() { return start; }
@@ -438,6 +485,141 @@ private:
   GBool needFree;
 };
 
+//------------------------------------------------------------------------
+// MmapStream
+//
+// Reads a file through a read-only memory mapping.  All the streams
+// made by makeSubStream share the mapping (which is reference
+// counted), so creating a sub-stream and seeking in it are free.
+// Reading a part of the mapping which is past the end of the file
+// because the file was truncated after it was mapped raises SIGBUS,
+// so this is only used for files which won't change while they are
+// open (PDFDoc only uses it if GlobalParams::setMapFiles is on).
+//------------------------------------------------------------------------
+
+struct MmapStreamMapping;
+
+class MmapStream: public BaseStream {
+public:
+
+  // Map the whole of <fA>, which must be a regular file.  Check
+  // isOk() -- if the file can't be mapped, use a FileStream instead.
+  MmapStream(FILE *fA, Object *dictA);
+  virtual ~MmapStream();
+  GBool isOk() { return mapping != NULL; }
+  virtual Stream *makeSubStream(Guint startA, GBool limitedA,
+				Guint lengthA, Object *dictA);
+  virtual StreamKind getKind() { return strFile; }
+  virtual void reset();
+  virtual int getChar()
+    { return (bufPtr < bufEnd) ? (*bufPtr++ & 0xff) : EOF; }
+  virtual int lookChar()
+    { return (bufPtr < bufEnd) ? (*bufPtr & 0xff) : EOF; }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getPos() { return (int)(bufPtr - buf); }
+  virtual void setPos(Guint pos, int dir = 0);
+  virtual Guint getStart() { return start; }
+  virtual void moveStart(int delta);
+
+  virtual int getUnfilteredChar () { return getChar(); }
+  virtual void unfilteredReset () { reset(); }
+
+private:
+
+  MmapStream(MmapStreamMapping *mappingA, Guint startA, Guint lengthA,
+	     Object *dictA);
+
+  MmapStreamMapping *mapping;	// shared mapping
+  char *buf;			// start of the mapping
+  Guint start;
+  Guint length;
+  char *bufEnd;
+  char *bufPtr;
+};
+
+//------------------------------------------------------------------------
+// ByteRangeProvider
+//
+// Supplies the bytes of a file which may not have arrived completely,
+// e.g., because it is still being downloaded, for a ByteRangeStream.
+// The methods may be called from several threads at once.
+//------------------------------------------------------------------------
+
+class ByteRangeProvider {
+public:
+
+  virtual ~ByteRangeProvider() {}
+
+  // Length of the whole file.
+  virtual Guint getLength() = 0;
+
+  // Have the <length> bytes at <start> arrived?
+  virtual GBool hasRange(Guint start, Guint length) = 0;
+
+  // Ask for the <length> bytes at <start>.  This must not wait for
+  // them to arrive.
+  virtual void requestRange(Guint start, Guint length) = 0;
+
+  // Copy the <length> bytes at <start>, which have arrived, to <buf>.
+  virtual void readRange(Guint start, Guint length, char *buf) = 0;
+};
+
+//------------------------------------------------------------------------
+// ByteRangeStream
+//
+// Reads a file through a ByteRangeProvider.  A read which runs into
+// data that hasn't arrived yet asks the provider for it and returns
+// EOF; getMissingCount() lets XRef, Parser and Catalog (and the
+// caller) tell this from a damaged file, so that the operation can be
+// retried once the data is there.  The streams made by makeSubStream
+// share the provider, which is not owned.
+//------------------------------------------------------------------------
+
+#define byteRangeStreamBufSize 4096
+
+// the smallest range asked for at once
+#define byteRangeStreamRequestSize 65536
+
+struct ByteRangeStreamFile;
+
+class ByteRangeStream: public BaseStream {
+public:
+
+  ByteRangeStream(ByteRangeProvider *providerA, Object *dictA);
+  virtual ~ByteRangeStream();
+  virtual Stream *makeSubStream(Guint startA, GBool limitedA,
+				Guint lengthA, Object *dictA);
+  virtual StreamKind getKind() { return strFile; }
+  virtual void reset();
+  virtual int getChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr++ & 0xff); }
+  virtual int lookChar()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : (*bufPtr & 0xff); }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getPos() { return bufPos + (bufPtr - buf); }
+  virtual void setPos(Guint pos, int dir = 0);
+  virtual Guint getStart() { return start; }
+  virtual void moveStart(int delta);
+  virtual Guint getMissingCount();
+
+  virtual int getUnfilteredChar () { return getChar(); }
+  virtual void unfilteredReset () { reset(); }
+
+private:
+
+  ByteRangeStream(ByteRangeStreamFile *fileA, Guint startA,
+		  Guint lengthA, Object *dictA);
+  GBool fillBuf();
+
+  ByteRangeStreamFile *file;	// shared by all the sub-streams
+  Guint start;
+  Guint length;
+  char buf[byteRangeStreamBufSize];
+  char *bufPtr;
+  char *bufEnd;
+  Guint bufPos;
+};
+
 //------------------------------------------------------------------------
 // EmbedStream
 //
@@ -459,10 +641,12 @@ public:
   virtual void reset() {}
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getPos() { return str->getPos(); }
   virtual void setPos(Guint pos, int dir = 0);
   virtual Guint getStart();
   virtual void moveStart(int delta);
+  virtual GBool canReadAhead() { return limited; }
 
   virtual int getUnfilteredChar () { return str->getUnfilteredChar(); }
   virtual void unfilteredReset () { str->unfilteredReset(); }
@@ -475,6 +659,50 @@ private:
   Guint length;
 };
 
+//------------------------------------------------------------------------
+// BufStream
+//
+// Reads the underlying stream in blocks with getChars() and hands out
+// the chars from its own buffer.  getByte() and lookByte() are inline
+// and non-virtual, for callers (like the Lexer) which read one char at
+// a time.  The buffer runs ahead of the underlying stream, so anything
+// that wants to continue where the reader left off (e.g., an
+// EmbedStream for an inline image) has to read from the BufStream, not
+// from the underlying stream.
+//------------------------------------------------------------------------
+
+#define bufStreamSize 4096
+
+class BufStream: public FilterStream {
+public:
+
+  BufStream(Stream *strA);
+  virtual ~BufStream();
+  virtual StreamKind getKind() { return str->getKind(); }
+  virtual void reset();
+  virtual int getChar() { return getByte(); }
+  virtual int lookChar() { return lookByte(); }
+  virtual int getChars(int nChars, Guchar *buffer);
+  virtual int getPos();
+  virtual void setPos(Guint pos, int dir = 0);
+  virtual GooString *getPSFilter(int psLevel, char *indent)
+    { return str->getPSFilter(psLevel, indent); }
+  virtual GBool isBinary(GBool last = gTrue) { return str->isBinary(last); }
+
+  int getByte()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : *bufPtr++; }
+  int lookByte()
+    { return (bufPtr >= bufEnd && !fillBuf()) ? EOF : *bufPtr; }
+
+private:
+
+  GBool fillBuf();
+
+  Guchar buf[bufStreamSize];
+  Guchar *bufPtr;
+  Guchar *bufEnd;
+};
+
 //------------------------------------------------------------------------
 // ASCIIHexStream
 //------------------------------------------------------------------------
@@ -537,7 +765,9 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getRawChar();
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
 
@@ -796,7 +1026,9 @@ public:
   virtual void reset();
   virtual int getChar();
   virtual int lookChar();
+  virtual int getChars(int nChars, Guchar *buffer);
   virtual int getRawChar();
+  virtual int getRawChars(int nChars, Guchar *buffer);
   virtual GooString *getPSFilter(int psLevel, char *indent);
   virtual GBool isBinary(GBool last = gTrue);
   virtual void unfilteredReset ();
@@ -44,6 +44,8 @@
 #include "Dict.h"
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "Linearization.h"
+#include "ImageCache.h"
 #include "XRef.h"
 
 //------------------------------------------------------------------------
@@ -51,6 +53,13 @@
 #define xrefSearchSize 1024	// read this many bytes at end of file
 				//   to look for 'startxref'
 
+// Initial number of parsed object cache buckets (must be a power of 2).
+#define xrefObjCacheInitialTabSize 256
+
+// Objects larger than this fraction of the parsed object cache size
+// aren't cached.
+#define xrefObjCacheMaxObjFraction 8
+
 //------------------------------------------------------------------------
 // Permission bits
 // Note that the PDF spec uses 1 base (eg bit 3 is 1<<2)
@@ -66,10 +75,18 @@
 #define permHighResPrint  (1<<11) // bit 12
 #define defPermFlags 0xfffc
 
+#if MULTITHREADED
+#  define xrefLocker()   MutexLocker locker(&mutex)
+#else
+#  define xrefLocker()
+#endif
+
 //------------------------------------------------------------------------
 // ObjectStream
 //------------------------------------------------------------------------
 
+static int xrefObjCost(Object *obj);
+
 class ObjectStream {
 public:
 
@@ -84,6 +101,9 @@ public:
   // Return the object number of this object stream.
   int getObjStrNum() { return objStrNum; }
 
+  // Estimated memory used by the parsed objects, in bytes.
+  int getCost() { return cost; }
+
   // Get the <objIdx>th object from this stream, which should be
   // object number <objNum>, generation 0.
   Object *getObject(int objIdx, int objNum, Object *obj);
@@ -94,6 +114,7 @@ private:
   int nObjects;			// number of objects in the stream
   Object *objs;			// the objects (length = nObjects)
   int *objNums;			// the object numbers (length = nObjects)
+  int cost;			// see getCost()
   GBool ok;
 };
 
@@ -108,6 +129,7 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
   nObjects = 0;
   objs = NULL;
   objNums = NULL;
+  cost = (int)sizeof(ObjectStream);
   ok = gFalse;
 
   if (!xref->fetch(objStrNum, 0, &objStr)->isStream()) {
@@ -194,6 +216,7 @@ ObjectStream::ObjectStream(XRef *xref, int objStrNumA) {
     parser->getObj(&objs[i]);
     while (str->getChar() != EOF) ;
     delete parser;
+    cost += (int)sizeof(int) + xrefObjCost(&objs[i]);
   }
 
   gfree(offsets);
@@ -222,6 +245,50 @@ Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
   return objs[objIdx].copy(obj);
 }
 
+//------------------------------------------------------------------------
+// XRefCacheEntry
+//------------------------------------------------------------------------
+
+struct XRefCacheEntry {
+  int num, gen;			// object number and generation
+  Object obj;			// the parsed object
+  int cost;			// estimated size of <obj>, in bytes
+  XRefCacheEntry *next;		// next entry in the same bucket
+  XRefCacheEntry *prev;		// previous entry in LRU order
+  XRefCacheEntry *lruNext;	// next entry in LRU order
+};
+
+// Rough estimate of the memory used by a parsed object.  Indirect
+// references are not followed.
+static int xrefObjCost(Object *obj) {
+  Object obj1;
+  int cost, i;
+
+  cost = (int)sizeof(Object);
+  switch (obj->getType()) {
+  case objString:
+    cost += (int)sizeof(GooString) + obj->getString()->getLength();
+    break;
+  case objArray:
+    cost += (int)sizeof(Array);
+    for (i = 0; i < obj->arrayGetLength(); ++i) {
+      cost += xrefObjCost(obj->arrayGetNF(i, &obj1));
+      obj1.free();
+    }
+    break;
+  case objDict:
+    cost += (int)sizeof(Dict);
+    for (i = 0; i < obj->dictGetLength(); ++i) {
+      cost += (int)sizeof(char *) + xrefObjCost(obj->dictGetValNF(i, &obj1));
+      obj1.free();
+    }
+    break;
+  default:
+    break;
+  }
+  return cost;
+}
+
 //------------------------------------------------------------------------
 // XRef
 //------------------------------------------------------------------------
@@ -229,15 +296,24 @@ Object *ObjectStream::getObject(int objIdx, int objNum, Object *obj) {
 XRef::XRef() {
   ok = gTrue;
   errCode = errNone;
+  str = NULL;
   entries = NULL;
   size = 0;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStr = NULL;
+  initObjStrCache();
+  initObjCache();
+  imageCache = NULL;
+  linearization = NULL;
+  mainXRefPending = gFalse;
+  mainXRefPos = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 }
 
 XRef::XRef(BaseStream *strA) {
-  Guint pos;
+  Guint pos, missing;
   Object obj;
 
   ok = gTrue;
@@ -246,7 +322,15 @@ XRef::XRef(BaseStream *strA) {
   entries = NULL;
   streamEnds = NULL;
   streamEndsLen = 0;
-  objStr = NULL;
+  initObjStrCache();
+  initObjCache();
+  imageCache = NULL;
+  linearization = NULL;
+  mainXRefPending = gFalse;
+  mainXRefPos = 0;
+#if MULTITHREADED
+  gInitMutex(&mutex);
+#endif
 
   encrypted = gFalse;
   permFlags = defPermFlags;
@@ -255,23 +339,47 @@ XRef::XRef(BaseStream *strA) {
   // read the trailer
   str = strA;
   start = str->getStart();
-  pos = getStartXref();
+  missing = str->getMissingCount();
+  linearization = new Linearization(str);
+  if (!linearization->isOk()) {
+    delete linearization;
+    linearization = NULL;
+  }
+
+  // for a linearized file, the first-page xref section is enough for
+  // now
+  if (readFirstPageXRef()) {
+    pos = lastXRefPos;
+  } else {
+    if (linearization) {
+      delete linearization;
+      linearization = NULL;
+    }
+    pos = getStartXref();
+  }
 
   // if there was a problem with the 'startxref' position, try to
-  // reconstruct the xref table
+  // reconstruct the xref table -- unless the data just hasn't arrived
+  // yet
   if (pos == 0) {
+    if (dataMissing(missing)) {
+      return;
+    }
     if (!(ok = constructXRef())) {
       errCode = errDamaged;
       return;
     }
 
   // read the xref table
-  } else {
+  } else if (!mainXRefPending) {
     while (readXRef(&pos)) ;
 
     // if there was a problem with the xref table,
     // try to reconstruct it
     if (!ok) {
+      if (dataMissing(missing)) {
+	return;
+      }
       if (!(ok = constructXRef())) {
 	errCode = errDamaged;
 	return;
@@ -287,6 +395,9 @@ XRef::XRef(BaseStream *strA) {
     obj.free();
   } else {
     obj.free();
+    if (dataMissing(missing)) {
+      return;
+    }
     if (!(ok = constructXRef())) {
       errCode = errDamaged;
       return;
@@ -299,7 +410,9 @@ XRef::XRef(BaseStream *strA) {
 }
 
 XRef::~XRef() {
-  for(int i=0; i<size; i++) {
+  int i;
+
+  for(i=0; i<size; i++) {
       entries[i].obj.free ();
   }
   gfree(entries);
@@ -308,9 +421,121 @@ XRef::~XRef() {
   if (streamEnds) {
     gfree(streamEnds);
   }
-  if (objStr) {
-    delete objStr;
+  evictObjStrCache(0);
+  gfree(objStrs);
+  evictObjCache(0);
+  gfree(objCacheTab);
+  if (linearization) {
+    delete linearization;
   }
+#if MULTITHREADED
+  gDestroyMutex(&mutex);
+#endif
+}
+
+// Read the first-page xref section of a linearized file, leaving the
+// main xref table for later.  Returns false (with nothing read) if
+// the file isn't linearized, or has been updated since it was
+// linearized, in which case the last xref section isn't the first-page
+// one.
+GBool XRef::readFirstPageXRef() {
+  Object obj;
+  Guint pos;
+  int fileLength, newSize, i;
+
+  if (!linearization ||
+      !linearization->getFirstXRefPos() ||
+      !linearization->getObjectNumberFirst() ||
+      !linearization->getNumPages()) {
+    return gFalse;
+  }
+  str->setPos(0, -1);
+  fileLength = str->getPos();
+  if (fileLength < 0 ||
+      (Guint)fileLength - start != linearization->getLength()) {
+    return gFalse;
+  }
+
+  pos = linearization->getFirstXRefPos();
+  if (!readXRef(&pos) || !ok) {
+    // no /Prev pointer, or the section is broken: read the whole table
+    // the normal way
+    goto err;
+  }
+  mainXRefPos = pos;
+  mainXRefPending = gTrue;
+
+  // the first-page trailer's /Size covers the whole file, so that the
+  // table won't need to grow again
+  trailerDict.dictLookupNF("Size", &obj);
+  if (obj.isInt() && obj.getInt() > size &&
+      obj.getInt() < INT_MAX / (int)sizeof(XRefEntry)) {
+    newSize = obj.getInt();
+    entries = (XRefEntry *)greallocn(entries, newSize, sizeof(XRefEntry));
+    for (i = size; i < newSize; ++i) {
+      entries[i].offset = 0xffffffff;
+      entries[i].type = xrefEntryFree;
+      entries[i].obj.initNull ();
+      entries[i].updated = false;
+      entries[i].gen = 0;
+    }
+    size = newSize;
+  }
+  obj.free();
+
+  lastXRefPos = linearization->getFirstXRefPos();
+  return gTrue;
+
+ err:
+  for (i = 0; i < size; ++i) {
+    entries[i].obj.free();
+  }
+  gfree(entries);
+  entries = NULL;
+  size = 0;
+  trailerDict.free();
+  mainXRefPending = gFalse;
+  ok = gTrue;
+  return gFalse;
+}
+
+// Read the rest of a linearized file's xref table.  If it hasn't
+// arrived yet, leave it for next time.
+void XRef::readMainXRef() {
+  Guint pos, missing;
+
+  xrefLocker();
+  if (!mainXRefPending) {
+    return;
+  }
+  mainXRefPending = gFalse;
+  pos = mainXRefPos;
+  missing = str->getMissingCount();
+  // the main table may override the first-page section's entries
+  evictObjCache(0);
+  while (readXRef(&pos)) ;
+  if (str->getMissingCount() != missing) {
+    mainXRefPending = gTrue;
+    ok = gTrue;
+    return;
+  }
+  if (!ok) {
+    if (!(ok = constructXRef())) {
+      errCode = errDamaged;
+    }
+  }
+}
+
+// If a read has run into data which hasn't arrived yet since the
+// missing data count was <missing>, mark the xref as unusable for now
+// and return true.
+GBool XRef::dataMissing(Guint missing) {
+  if (str->getMissingCount() == missing) {
+    return gFalse;
+  }
+  ok = gFalse;
+  errCode = errDataNotAvailable;
+  return gTrue;
 }
 
 // Read the 'startxref' position.
@@ -864,6 +1089,10 @@ void XRef::setEncryption(int permFlagsA, GBool ownerPasswordOkA,
 			 CryptAlgorithm encAlgorithmA) {
   int i;
 
+  xrefLocker();
+  // objects fetched so far (e.g., the Encrypt dictionary) were not
+  // decrypted
+  evictObjCache(0);
   encrypted = gTrue;
   permFlags = permFlagsA;
   ownerPasswordOk = ownerPasswordOkA;
@@ -925,8 +1154,16 @@ GBool XRef::okToAssemble(GBool ignoreOwnerPW) {
 Object *XRef::fetch(int num, int gen, Object *obj) {
   XRefEntry *e;
   Parser *parser;
+  ObjectStream *objStr;
   Object obj1, obj2, obj3;
+  Guint missing;
 
+  xrefLocker();
+  missing = str->getMissingCount();
+  if (mainXRefPending &&
+      (num < 0 || num >= size || entries[num].offset == 0xffffffff)) {
+    readMainXRef();
+  }
   // check for bogus ref - this can happen in corrupted PDF files
   if (num < 0 || num >= size) {
     goto err;
@@ -943,6 +1180,9 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     if (e->gen != gen) {
       goto err;
     }
+    if (objCacheMaxBytes > 0 && lookupObjCache(num, gen, obj)) {
+      return obj;
+    }
     obj1.initNull();
     parser = new Parser(this,
 	       new Lexer(this,
@@ -990,24 +1230,28 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
     obj2.free();
     obj3.free();
     delete parser;
+    if (str->getMissingCount() != missing) {
+      // only part of the object has arrived
+      obj->free();
+      goto err;
+    }
+    // streams can't be shared: they keep their read position
+    if (objCacheMaxBytes > 0 && !obj->isStream()) {
+      ++objCacheMisses;
+      addToObjCache(num, gen, obj);
+    }
     break;
 
   case xrefEntryCompressed:
     if (gen != 0) {
       goto err;
     }
-    if (!objStr || objStr->getObjStrNum() != (int)e->offset) {
-      if (objStr) {
-	delete objStr;
-      }
-      objStr = new ObjectStream(this, e->offset);
-      if (!objStr->isOk()) {
-	delete objStr;
-	objStr = NULL;
-	goto err;
-      }
+    if (!(objStr = getObjectStream(e->offset, missing))) {
+      goto err;
     }
-    objStr->getObject(e->gen, num, obj);
+    // (creating the ObjectStream may have read the main xref table,
+    // moving the entries)
+    objStr->getObject(entries[num].gen, num, obj);
     break;
 
   default:
@@ -1020,6 +1264,222 @@ Object *XRef::fetch(int num, int gen, Object *obj) {
   return obj->initNull();
 }
 
+// Return the parsed object stream <objStrNum>, from the cache if
+// possible.  Returns NULL if the object stream is damaged or hasn't
+// completely arrived yet.
+ObjectStream *XRef::getObjectStream(int objStrNum, Guint missing) {
+  ObjectStream *objStr;
+  int i;
+
+  for (i = 0; i < nObjStrs; ++i) {
+    if (objStrs[i]->getObjStrNum() == objStrNum) {
+      objStr = objStrs[i];
+      for (; i > 0; --i) {
+	objStrs[i] = objStrs[i-1];
+      }
+      objStrs[0] = objStr;
+      ++objStrHits;
+      return objStr;
+    }
+  }
+
+  // parsing the object stream may fetch other objects (e.g., its
+  // length), and so change the cache
+  objStr = new ObjectStream(this, objStrNum);
+  ++objStrRebuilds;
+  if (!objStr->isOk() || str->getMissingCount() != missing) {
+    delete objStr;
+    return NULL;
+  }
+  // the caller uses the new object stream, so it is kept even if it
+  // doesn't fit
+  evictObjStrCache(objStrMaxBytes - objStr->getCost());
+  if (nObjStrs == objStrsSize) {
+    objStrsSize = objStrsSize ? 2 * objStrsSize : 16;
+    objStrs = (ObjectStream **)greallocn(objStrs, objStrsSize,
+					 sizeof(ObjectStream *));
+  }
+  for (i = nObjStrs; i > 0; --i) {
+    objStrs[i] = objStrs[i-1];
+  }
+  objStrs[0] = objStr;
+  ++nObjStrs;
+  objStrBytes += objStr->getCost();
+  return objStr;
+}
+
+void XRef::initObjStrCache() {
+  objStrs = NULL;
+  nObjStrs = objStrsSize = 0;
+  objStrBytes = 0;
+  objStrMaxBytes = xrefObjStrCacheDefaultSize;
+  objStrHits = objStrRebuilds = 0;
+}
+
+void XRef::setObjStrCacheSize(int maxBytes) {
+  xrefLocker();
+  objStrMaxBytes = maxBytes > 0 ? maxBytes : 0;
+  evictObjStrCache(objStrMaxBytes);
+}
+
+// Evict the least recently used object streams until the cache holds
+// no more than <limit> bytes.
+void XRef::evictObjStrCache(int limit) {
+  while (nObjStrs > 0 && objStrBytes > limit) {
+    --nObjStrs;
+    objStrBytes -= objStrs[nObjStrs]->getCost();
+    delete objStrs[nObjStrs];
+  }
+}
+
+void XRef::initObjCache() {
+  objCacheTab = NULL;
+  objCacheTabSize = 0;
+  objCacheFirst = objCacheLast = NULL;
+  objCacheLength = 0;
+  objCacheBytes = 0;
+  objCacheMaxBytes = xrefObjCacheDefaultSize;
+  objCacheHits = objCacheMisses = 0;
+}
+
+void XRef::setObjCacheSize(int maxBytes) {
+  xrefLocker();
+  objCacheMaxBytes = maxBytes > 0 ? maxBytes : 0;
+  evictObjCache(objCacheMaxBytes);
+}
+
+// Look up object <num> in the parsed object cache.  On a hit, copy it
+// to <obj> and make it the most recently used object.
+GBool XRef::lookupObjCache(int num, int gen, Object *obj) {
+  XRefCacheEntry *entry;
+
+  if (!objCacheTabSize) {
+    return gFalse;
+  }
+  for (entry = objCacheTab[num & (objCacheTabSize - 1)];
+       entry;
+       entry = entry->next) {
+    if (entry->num == num) {
+      break;
+    }
+  }
+  if (!entry || entry->gen != gen) {
+    return gFalse;
+  }
+  if (entry != objCacheFirst) {
+    entry->prev->lruNext = entry->lruNext;
+    if (entry->lruNext) {
+      entry->lruNext->prev = entry->prev;
+    } else {
+      objCacheLast = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->lruNext = objCacheFirst;
+    objCacheFirst->prev = entry;
+    objCacheFirst = entry;
+  }
+  ++objCacheHits;
+  entry->obj.copy(obj);
+  return gTrue;
+}
+
+// Add the freshly parsed object <num> to the parsed object cache,
+// evicting the least recently used objects to make room.
+void XRef::addToObjCache(int num, int gen, Object *obj) {
+  XRefCacheEntry **oldTab;
+  XRefCacheEntry *entry, *next;
+  int oldSize, cost, h, i;
+
+  cost = (int)sizeof(XRefCacheEntry) + xrefObjCost(obj);
+  if (cost > objCacheMaxBytes / xrefObjCacheMaxObjFraction) {
+    return;
+  }
+  // parsing may have fetched (and cached) other objects, but never
+  // this one
+  removeFromObjCache(num);
+  evictObjCache(objCacheMaxBytes - cost);
+
+  if (objCacheLength >= objCacheTabSize) {
+    oldSize = objCacheTabSize;
+    oldTab = objCacheTab;
+    objCacheTabSize = oldSize ? 2 * oldSize : xrefObjCacheInitialTabSize;
+    objCacheTab = (XRefCacheEntry **)gmallocn(objCacheTabSize,
+					      sizeof(XRefCacheEntry *));
+    for (i = 0; i < objCacheTabSize; ++i) {
+      objCacheTab[i] = NULL;
+    }
+    for (i = 0; i < oldSize; ++i) {
+      for (entry = oldTab[i]; entry; entry = next) {
+	next = entry->next;
+	h = entry->num & (objCacheTabSize - 1);
+	entry->next = objCacheTab[h];
+	objCacheTab[h] = entry;
+      }
+    }
+    gfree(oldTab);
+  }
+
+  entry = new XRefCacheEntry;
+  entry->num = num;
+  entry->gen = gen;
+  obj->copy(&entry->obj);
+  entry->cost = cost;
+  h = num & (objCacheTabSize - 1);
+  entry->next = objCacheTab[h];
+  objCacheTab[h] = entry;
+  entry->prev = NULL;
+  entry->lruNext = objCacheFirst;
+  if (objCacheFirst) {
+    objCacheFirst->prev = entry;
+  } else {
+    objCacheLast = entry;
+  }
+  objCacheFirst = entry;
+  ++objCacheLength;
+  objCacheBytes += cost;
+}
+
+// Drop object <num> from the parsed object cache, if it's there.
+void XRef::removeFromObjCache(int num) {
+  XRefCacheEntry **p;
+  XRefCacheEntry *entry;
+
+  if (!objCacheTabSize) {
+    return;
+  }
+  for (p = &objCacheTab[num & (objCacheTabSize - 1)]; *p; p = &(*p)->next) {
+    if ((*p)->num == num) {
+      break;
+    }
+  }
+  if (!(entry = *p)) {
+    return;
+  }
+  *p = entry->next;
+  if (entry->prev) {
+    entry->prev->lruNext = entry->lruNext;
+  } else {
+    objCacheFirst = entry->lruNext;
+  }
+  if (entry->lruNext) {
+    entry->lruNext->prev = entry->prev;
+  } else {
+    objCacheLast = entry->prev;
+  }
+  --objCacheLength;
+  objCacheBytes -= entry->cost;
+  entry->obj.free();
+  delete entry;
+}
+
+// Evict the least recently used objects until the cache holds no
+// more than <limit> bytes.
+void XRef::evictObjCache(int limit) {
+  while (objCacheLast && objCacheBytes > limit) {
+    removeFromObjCache(objCacheLast->num);
+  }
+}
+
 Object *XRef::getDocInfo(Object *obj) {
   return trailerDict.dictLookup("Info", obj);
 }
@@ -1054,6 +1514,9 @@ GBool XRef::getStreamEnd(Guint streamStart, Guint *streamEnd) {
 
 int XRef::getNumEntry(Guint offset) const
 {
+  // reading the rest of a linearized file's table doesn't change what
+  // the xref describes
+  const_cast<XRef *>(this)->loadMainXRef();
   if (size > 0)
   {
     int res = 0;
@@ -1097,6 +1560,7 @@ void XRef::add(int num, int gen, Guint offs, GBool used) {
     }
     size = num + 1;
   }
+  removeFromObjCache(num);
   XRefEntry *e = &entries[num];
   e->gen = gen;
   e->obj.initNull ();
@@ -1111,16 +1575,24 @@ void XRef::add(int num, int gen, Guint offs, GBool used) {
 }
 
 void XRef::setModifiedObject (Object* o, Ref r) {
+  xrefLocker();
+  loadMainXRef();
   if (r.num < 0 || r.num >= size) {
     error(-1,"XRef::setModifiedObject on unknown ref: %i, %i\n", r.num, r.gen);
     return;
   }
+  removeFromObjCache(r.num);
+  if (imageCache) {
+    imageCache->removeImage(r);
+  }
   entries[r.num].obj.free();
   o->copy(&entries[r.num].obj);
   entries[r.num].updated = true;
 }
 
 Ref XRef::addIndirectObject (Object* o) {
+  xrefLocker();
+  loadMainXRef();
   int entryIndexToUse = -1;
   for (int i = 1; entryIndexToUse == -1 && i < size; ++i) {
     if (entries[i].type == xrefEntryFree) entryIndexToUse = i;
@@ -1150,6 +1622,7 @@ Ref XRef::addIndirectObject (Object* o) {
 }
 
 void XRef::writeToFile(OutStream* outStr, GBool writeAllEntries) {
+  loadMainXRef();
   //create free entries linked-list
   if (entries[0].gen != 65535) {
     error(-1, "XRef::writeToFile, entry 0 of the XRef is invalid (gen != 65535)\n");
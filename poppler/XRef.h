@@ -30,13 +30,27 @@
 #pragma interface
 #endif
 
+#include "poppler-config.h"
 #include "goo/gtypes.h"
 #include "Object.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 class Dict;
 class Stream;
 class Parser;
 class ObjectStream;
+class ImageCache;
+class Linearization;
+struct XRefCacheEntry;
+
+// Default size of the parsed object stream cache, in bytes.
+#define xrefObjStrCacheDefaultSize (4 * 1024 * 1024)
+
+// Default size of the parsed object cache, in bytes.
+#define xrefObjCacheDefaultSize (1024 * 1024)
 
 //------------------------------------------------------------------------
 // XRef
@@ -95,15 +109,52 @@ public:
   // Get catalog object.
   Object *getCatalog(Object *obj) { return fetch(rootNum, rootGen, obj); }
 
-  // Fetch an indirect reference.
+  // Fetch an indirect reference.  This may be called from several
+  // threads at once.
   Object *fetch(int num, int gen, Object *obj);
 
+  // Number of reads by the calling thread which have run into data
+  // that hasn't arrived yet, see BaseStream::getMissingCount().  A fetch which runs into
+  // missing data returns a null object.
+  Guint getMissingCount() { return str ? str->getMissingCount() : 0; }
+
+  // Change the size limit of the object stream cache, evicting
+  // object streams as needed.  Parsed object streams are kept, up to
+  // roughly <maxBytes> bytes of memory, plus the one used last.
+  void setObjStrCacheSize(int maxBytes);
+  int getObjStrCacheSize() { return objStrMaxBytes; }
+
+  // Object stream cache statistics: the number of compressed object
+  // fetches which found their object stream already parsed, the
+  // number of times an object stream had to be parsed, and the number
+  // and estimated size of the cached object streams.
+  Guint getObjStrHits() { return objStrHits; }
+  Guint getObjStrRebuilds() { return objStrRebuilds; }
+  int getObjStrCacheLength() { return nObjStrs; }
+  int getObjStrCacheBytes() { return objStrBytes; }
+
+  // Change the size limit of the parsed object cache, evicting
+  // objects as needed.  Non-stream objects read from the file are kept
+  // there after they are parsed, up to roughly <maxBytes> bytes of
+  // memory.  A size of 0 disables the cache.
+  void setObjCacheSize(int maxBytes);
+  int getObjCacheSize() { return objCacheMaxBytes; }
+
+  // Parsed object cache statistics: the number of uncompressed object
+  // fetches which were answered from the cache, the number which had
+  // to be parsed, and the number and estimated size of the cached
+  // objects.
+  Guint getObjCacheHits() { return objCacheHits; }
+  Guint getObjCacheMisses() { return objCacheMisses; }
+  int getObjCacheLength() { return objCacheLength; }
+  int getObjCacheBytes() { return objCacheBytes; }
+
   // Return the document's Info dictionary (if any).
   Object *getDocInfo(Object *obj);
   Object *getDocInfoNF(Object *obj);
 
   // Return the number of objects in the xref table.
-  int getNumObjects() { return size; }
+  int getNumObjects() { loadMainXRef(); return size; }
 
   // Return the offset of the last xref table.
   Guint getLastXRefPos() { return lastXRefPos; }
@@ -119,9 +170,22 @@ public:
   // Retuns the entry that belongs to the offset
   int getNumEntry(Guint offset) const;
 
+  // The linearization parameters, or NULL if the file isn't
+  // linearized (or has been updated since it was linearized).  For a
+  // linearized file only the first-page xref section is read when the
+  // file is opened; the main xref table is read the first time an
+  // object which isn't in the first-page section is fetched.
+  Linearization *getLinearization() { return linearization; }
+
+  // The decoded image cache of the document this xref belongs to, for
+  // the output devices, which only get to see the xref.  The cache is
+  // owned by the PDFDoc.  May be NULL.
+  ImageCache *getImageCache() { return imageCache; }
+  void setImageCache(ImageCache *imageCacheA) { imageCache = imageCacheA; }
+
   // Direct access.
-  int getSize() { return size; }
-  XRefEntry *getEntry(int i) { return &entries[i]; }
+  int getSize() { loadMainXRef(); return size; }
+  XRefEntry *getEntry(int i) { loadMainXRef(); return &entries[i]; }
   Object *getTrailerDict() { return &trailerDict; }
 
   // Write access
@@ -145,7 +209,23 @@ private:
   Guint *streamEnds;		// 'endstream' positions - only used in
 				//   damaged files
   int streamEndsLen;		// number of valid entries in streamEnds
-  ObjectStream *objStr;		// cached object stream
+  ObjectStream **objStrs;	// cached object streams, most recently
+				//   used first
+  int nObjStrs;			// number of cached object streams
+  int objStrsSize;		// size of the objStrs array
+  int objStrBytes;		// estimated size of the cached streams
+  int objStrMaxBytes;		// size limit
+  Guint objStrHits;		// object stream cache statistics
+  Guint objStrRebuilds;
+  XRefCacheEntry **objCacheTab;	// parsed object cache: hash table
+  int objCacheTabSize;		//   (number of buckets, a power of 2)
+  XRefCacheEntry *objCacheFirst; // most recently used cached object
+  XRefCacheEntry *objCacheLast;	// least recently used cached object
+  int objCacheLength;		// number of cached objects
+  int objCacheBytes;		// estimated size of the cached objects
+  int objCacheMaxBytes;		// size limit (0 = no cache)
+  Guint objCacheHits;		// parsed object cache statistics
+  Guint objCacheMisses;
   GBool encrypted;		// true if file is encrypted
   int encRevision;		
   int encVersion;		// encryption algorithm
@@ -154,8 +234,29 @@ private:
   int permFlags;		// permission bits
   Guchar fileKey[16];		// file decryption key
   GBool ownerPasswordOk;	// true if owner password is correct
+  ImageCache *imageCache;	// decoded image cache (not owned)
+  Linearization *linearization;	// linearization parameters
+  GBool mainXRefPending;	// set if the main xref table of a
+				//   linearized file hasn't been read yet
+  Guint mainXRefPos;		// offset of the main xref table
+#if MULTITHREADED
+  GooMutex mutex;		// protects the entries and the caches
+#endif
 
+  GBool dataMissing(Guint missing);
+  ObjectStream *getObjectStream(int objStrNum, Guint missing);
+  void initObjStrCache();
+  void evictObjStrCache(int limit);
+  void initObjCache();
+  GBool lookupObjCache(int num, int gen, Object *obj);
+  void addToObjCache(int num, int gen, Object *obj);
+  void removeFromObjCache(int num);
+  void evictObjCache(int limit);
   Guint getStartXref();
+  GBool readFirstPageXRef();
+  void loadMainXRef()
+    { if (mainXRefPending) readMainXRef(); }
+  void readMainXRef();
   GBool readXRef(Guint *pos);
   GBool readXRefTable(Parser *parser, Guint *pos);
   GBool readXRefStreamSection(Stream *xrefStr, int *w, int first, int n);
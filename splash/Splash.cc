@@ -42,6 +42,10 @@
 #include "SplashGlyphBitmap.h"
 #include "Splash.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#endif
+
 //------------------------------------------------------------------------
 
 // distance of Bezier control point from center for circle approximation
@@ -94,8 +98,173 @@ struct SplashPipe {
 
   // non-isolated group correction
   int nonIsolatedGroup;
+
+  // the run function
+  void (Splash::*run)(SplashPipe *pipe);
+};
+
+//------------------------------------------------------------------------
+// SplashDeferredOp
+//------------------------------------------------------------------------
+
+// number of bands per thread -- the work isn't spread evenly over the
+// page, so the threads take bands from a queue
+#define splashBandsPerThread 4
+
+// images larger than this (in bytes) are drawn directly rather than
+// kept in memory until the bands are rasterized
+#define splashMaxDeferredImage (64 * 1024 * 1024)
+
+enum SplashDeferredOpKind {
+  splashDeferredSaveState,
+  splashDeferredRestoreState,
+  splashDeferredClipResetToRect,
+  splashDeferredClipToRect,
+  splashDeferredClipToPath,
+  splashDeferredFill,
+  splashDeferredStrokeNarrow,
+  splashDeferredGlyph,
+  splashDeferredImageMask,
+  splashDeferredImage
+};
+
+struct SplashDeferredOp {
+  SplashDeferredOpKind kind;
+  int yMin, yMax;		// rows which a drawing operation may touch
+
+  // drawing parameters
+  SplashPattern *pattern;
+  SplashCoord alpha;
+  SplashBlendFunc blendFunc;
+
+  // clip rectangle
+  SplashCoord x0, y0, x1, y1;
+
+  // clip path (<path>, <matrix>, <flatness>, <eo>), fill (<xPath>,
+  // <eo>), narrow stroke (<xPath>)
+  SplashPath *path;
+  SplashXPath *xPath;
+  SplashCoord matrix[6];
+  SplashCoord flatness;
+  GBool eo;
+
+  // glyph
+  SplashGlyphBitmap glyph;
+  int glyphX, glyphY;
+  GBool noClip;
+
+  // image mask / image (<matrix>, and <eo> is the glyphMode or
+  // srcAlpha flag)
+  Guchar *data;
+  Guchar *alphaData;
+  int w, h, rowSize;
+  SplashColorMode srcMode;
+
+  SplashDeferredOp *next;
 };
 
+// Reads the rows of a recorded image or image mask.
+struct SplashDeferredImageSrc {
+  SplashDeferredOp *op;
+  int y;
+};
+
+static GBool deferredImageMaskSrc(void *data, SplashColorPtr line) {
+  SplashDeferredImageSrc *src = (SplashDeferredImageSrc *)data;
+  SplashDeferredOp *op = src->op;
+
+  if (src->y >= op->h) {
+    return gFalse;
+  }
+  memcpy(line, op->data + src->y * op->rowSize, op->rowSize);
+  ++src->y;
+  return gTrue;
+}
+
+static GBool deferredImageSrc(void *data, SplashColorPtr colorLine,
+			      Guchar *alphaLine) {
+  SplashDeferredImageSrc *src = (SplashDeferredImageSrc *)data;
+  SplashDeferredOp *op = src->op;
+
+  if (src->y >= op->h) {
+    return gFalse;
+  }
+  memcpy(colorLine, op->data + src->y * op->rowSize, op->rowSize);
+  if (alphaLine && op->alphaData) {
+    memcpy(alphaLine, op->alphaData + src->y * op->w, op->w);
+  }
+  ++src->y;
+  return gTrue;
+}
+
+//------------------------------------------------------------------------
+// SplashBandQueue
+//------------------------------------------------------------------------
+
+// The bands of a flushDeferred() call, which are taken by the threads
+// one at a time.
+struct SplashBandQueue {
+  Splash *splash;
+  int nBands;
+  int bandHeight;
+  int nextBand;
+#if MULTITHREADED
+  GooMutex mutex;
+#endif
+
+  void run();
+};
+
+void SplashBandQueue::run() {
+  Splash *bandSplash;
+  int band, yMin, yMax;
+
+  while (1) {
+#if MULTITHREADED
+    gLockMutex(&mutex);
+#endif
+    band = nextBand++;
+#if MULTITHREADED
+    gUnlockMutex(&mutex);
+#endif
+    if (band >= nBands) {
+      break;
+    }
+    yMin = band * bandHeight;
+    yMax = yMin + bandHeight - 1;
+    if (yMax >= splash->bitmap->getHeight()) {
+      yMax = splash->bitmap->getHeight() - 1;
+    }
+    bandSplash = splash->rasterizeBand(yMin, yMax);
+    if (bandSplash->modXMin <= bandSplash->modXMax) {
+#if MULTITHREADED
+      gLockMutex(&mutex);
+#endif
+      splash->updateModX(bandSplash->modXMin);
+      splash->updateModX(bandSplash->modXMax);
+      splash->updateModY(bandSplash->modYMin);
+      splash->updateModY(bandSplash->modYMax);
+#if MULTITHREADED
+      gUnlockMutex(&mutex);
+#endif
+    }
+    delete bandSplash;
+  }
+}
+
+#if MULTITHREADED
+#ifdef _WIN32
+static DWORD WINAPI splashBandThread(LPVOID arg) {
+#else
+static void *splashBandThread(void *arg) {
+#endif
+  ((SplashBandQueue *)arg)->run();
+  return 0;
+}
+#endif
+
+//------------------------------------------------------------------------
+
 SplashPipeResultColorCtrl Splash::pipeResultColorNoAlphaBlend[] = {
   splashPipeResultColorNoAlphaBlendMono,
   splashPipeResultColorNoAlphaBlendMono,
@@ -112,7 +281,7 @@ SplashPipeResultColorCtrl Splash::pipeResultColorAlphaNoBlend[] = {
   splashPipeResultColorAlphaNoBlendMono,
   splashPipeResultColorAlphaNoBlendMono,
   splashPipeResultColorAlphaNoBlendRGB,
-  splashPipeResultColorNoAlphaBlendRGB,
+  splashPipeResultColorAlphaNoBlendRGB,
   splashPipeResultColorAlphaNoBlendRGB
 #if SPLASH_CMYK
   ,
@@ -124,7 +293,7 @@ SplashPipeResultColorCtrl Splash::pipeResultColorAlphaBlend[] = {
   splashPipeResultColorAlphaBlendMono,
   splashPipeResultColorAlphaBlendMono,
   splashPipeResultColorAlphaBlendRGB,
-  splashPipeResultColorNoAlphaBlendRGB,
+  splashPipeResultColorAlphaBlendRGB,
   splashPipeResultColorAlphaBlendRGB
 #if SPLASH_CMYK
   ,
@@ -132,6 +301,49 @@ SplashPipeResultColorCtrl Splash::pipeResultColorAlphaBlend[] = {
 #endif
 };
 
+//------------------------------------------------------------------------
+// anti-aliased coverage
+//------------------------------------------------------------------------
+
+#if splashAASize == 4
+
+static int bitCount4[16] = { 0, 1, 1, 2, 1, 2, 2, 3,
+			     1, 2, 2, 3, 2, 3, 3, 4 };
+
+// Count the set bits of each 4x4 block in the four rows of <aaBuf>,
+// for the (up to) 32 pixels in bytes <i>..<n>-1 of the rows (i.e.,
+// pixels 2*i, 2*i+1, ...), writing the count for pixel 2*i+j to
+// <t>[j].  Returns false, without necessarily setting <t>, if all of
+// the counts are zero.
+static GBool aaCoverage(SplashColorPtr aaBuf, int rowSize,
+			int i, int n, Guchar *t) {
+  SplashColorPtr p0, p1, p2, p3;
+  GBool nonZero;
+
+  if (n > i + 16) {
+    n = i + 16;
+  }
+  p0 = aaBuf;
+  p1 = p0 + rowSize;
+  p2 = p1 + rowSize;
+  p3 = p2 + rowSize;
+  nonZero = gFalse;
+  for (; i < n; ++i, t += 2) {
+    if (!(p0[i] | p1[i] | p2[i] | p3[i])) {
+      t[0] = t[1] = 0;
+      continue;
+    }
+    t[0] = bitCount4[p0[i] >> 4] + bitCount4[p1[i] >> 4] +
+           bitCount4[p2[i] >> 4] + bitCount4[p3[i] >> 4];
+    t[1] = bitCount4[p0[i] & 0x0f] + bitCount4[p1[i] & 0x0f] +
+           bitCount4[p2[i] & 0x0f] + bitCount4[p3[i] & 0x0f];
+    nonZero = gTrue;
+  }
+  return nonZero;
+}
+
+#endif // splashAASize == 4
+
 //------------------------------------------------------------------------
 
 static void blendXor(SplashColorPtr src, SplashColorPtr dest,
@@ -230,6 +442,86 @@ inline void Splash::pipeInit(SplashPipe *pipe, int x, int y,
   } else {
     pipe->nonIsolatedGroup = 0;
   }
+
+  // select the run function -- the common cases (opaque fills, and
+  // shape-only antialiasing or glyphs with no blend function, soft mask
+  // or group) get kernels specialized for the bitmap mode; everything
+  // else goes through the generic pipeRun
+  pipe->run = &Splash::pipeRun;
+  if (!pipe->pattern && pipe->noTransparency && !state->blendFunc) {
+    switch (bitmap->mode) {
+    case splashModeMono1:
+      pipe->run = &Splash::pipeRunSimple<splashModeMono1>;
+      break;
+    case splashModeMono8:
+      pipe->run = &Splash::pipeRunSimple<splashModeMono8>;
+      break;
+    case splashModeRGB8:
+      pipe->run = &Splash::pipeRunSimple<splashModeRGB8>;
+      break;
+    case splashModeXBGR8:
+      pipe->run = &Splash::pipeRunSimple<splashModeXBGR8>;
+      break;
+    case splashModeBGR8:
+      pipe->run = &Splash::pipeRunSimple<splashModeBGR8>;
+      break;
+#if SPLASH_CMYK
+    case splashModeCMYK8:
+      pipe->run = &Splash::pipeRunSimple<splashModeCMYK8>;
+      break;
+#endif
+    }
+  } else if (!pipe->pattern && !pipe->noTransparency && !state->softMask &&
+	     usesShape && !pipe->alpha0Ptr && !state->blendFunc &&
+	     !pipe->nonIsolatedGroup) {
+    if (pipe->destAlphaPtr) {
+      switch (bitmap->mode) {
+      case splashModeMono1:
+	pipe->run = &Splash::pipeRunAA<splashModeMono1, gTrue>;
+	break;
+      case splashModeMono8:
+	pipe->run = &Splash::pipeRunAA<splashModeMono8, gTrue>;
+	break;
+      case splashModeRGB8:
+	pipe->run = &Splash::pipeRunAA<splashModeRGB8, gTrue>;
+	break;
+      case splashModeXBGR8:
+	pipe->run = &Splash::pipeRunAA<splashModeXBGR8, gTrue>;
+	break;
+      case splashModeBGR8:
+	pipe->run = &Splash::pipeRunAA<splashModeBGR8, gTrue>;
+	break;
+#if SPLASH_CMYK
+      case splashModeCMYK8:
+	pipe->run = &Splash::pipeRunAA<splashModeCMYK8, gTrue>;
+	break;
+#endif
+      }
+    } else {
+      switch (bitmap->mode) {
+      case splashModeMono1:
+	pipe->run = &Splash::pipeRunAA<splashModeMono1, gFalse>;
+	break;
+      case splashModeMono8:
+	pipe->run = &Splash::pipeRunAA<splashModeMono8, gFalse>;
+	break;
+      case splashModeRGB8:
+	pipe->run = &Splash::pipeRunAA<splashModeRGB8, gFalse>;
+	break;
+      case splashModeXBGR8:
+	pipe->run = &Splash::pipeRunAA<splashModeXBGR8, gFalse>;
+	break;
+      case splashModeBGR8:
+	pipe->run = &Splash::pipeRunAA<splashModeBGR8, gFalse>;
+	break;
+#if SPLASH_CMYK
+      case splashModeCMYK8:
+	pipe->run = &Splash::pipeRunAA<splashModeCMYK8, gFalse>;
+	break;
+#endif
+      }
+    }
+  }
 }
 
 inline void Splash::pipeRun(SplashPipe *pipe) {
@@ -244,7 +536,10 @@ inline void Splash::pipeRun(SplashPipe *pipe) {
 
   // dynamic pattern
   if (pipe->pattern) {
-    pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal);
+    if (!pipe->pattern->getColor(pipe->x, pipe->y, pipe->cSrcVal)) {
+      pipeIncX(pipe);
+      return;
+    }
   }
 
   if (pipe->noTransparency && !state->blendFunc) {
@@ -567,6 +862,183 @@ inline void Splash::pipeRun(SplashPipe *pipe) {
   ++pipe->x;
 }
 
+// Opaque source with a fixed color (or a static pattern), no blend
+// function: the source color is written to the bitmap unchanged.
+template <SplashColorMode mode>
+void Splash::pipeRunSimple(SplashPipe *pipe) {
+  switch (mode) {
+  case splashModeMono1:
+    if (state->screen->test(pipe->x, pipe->y, pipe->cSrc[0])) {
+      *pipe->destColorPtr |= pipe->destColorMask;
+    } else {
+      *pipe->destColorPtr &= ~pipe->destColorMask;
+    }
+    if (!(pipe->destColorMask >>= 1)) {
+      pipe->destColorMask = 0x80;
+      ++pipe->destColorPtr;
+    }
+    break;
+  case splashModeMono8:
+    *pipe->destColorPtr++ = pipe->cSrc[0];
+    break;
+  case splashModeRGB8:
+    pipe->destColorPtr[0] = pipe->cSrc[0];
+    pipe->destColorPtr[1] = pipe->cSrc[1];
+    pipe->destColorPtr[2] = pipe->cSrc[2];
+    pipe->destColorPtr += 3;
+    break;
+  case splashModeXBGR8:
+    pipe->destColorPtr[0] = pipe->cSrc[2];
+    pipe->destColorPtr[1] = pipe->cSrc[1];
+    pipe->destColorPtr[2] = pipe->cSrc[0];
+    pipe->destColorPtr[3] = 255;
+    pipe->destColorPtr += 4;
+    break;
+  case splashModeBGR8:
+    pipe->destColorPtr[0] = pipe->cSrc[2];
+    pipe->destColorPtr[1] = pipe->cSrc[1];
+    pipe->destColorPtr[2] = pipe->cSrc[0];
+    pipe->destColorPtr += 3;
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    pipe->destColorPtr[0] = pipe->cSrc[0];
+    pipe->destColorPtr[1] = pipe->cSrc[1];
+    pipe->destColorPtr[2] = pipe->cSrc[2];
+    pipe->destColorPtr[3] = pipe->cSrc[3];
+    pipe->destColorPtr += 4;
+    break;
+#endif
+  }
+  if (pipe->destAlphaPtr) {
+    *pipe->destAlphaPtr++ = 255;
+  }
+
+  ++pipe->x;
+}
+
+// Fixed source color with shape (antialiasing coverage or glyph alpha),
+// no soft mask, blend function or group.  If <destAlpha> is false, the
+// bitmap has no alpha channel, so the destination is opaque and the
+// result alpha is always 255.
+template <SplashColorMode mode, GBool destAlpha>
+void Splash::pipeRunAA(SplashPipe *pipe) {
+  Guchar aSrc, aDest, alpha2;
+  SplashColor cDest;
+  Guchar cResult0, cResult1, cResult2, cResult3;
+  int nComps;
+
+  //----- source alpha
+
+  // pipe->aInput is premultiplied by 255 in pipeInit
+  aSrc = (Guchar)splashRound(pipe->aInput * pipe->shape);
+
+  //----- read destination pixel
+
+  switch (mode) {
+  case splashModeMono1:
+    cDest[0] = (*pipe->destColorPtr & pipe->destColorMask) ? 0xff : 0x00;
+    break;
+  case splashModeMono8:
+    cDest[0] = *pipe->destColorPtr;
+    break;
+  case splashModeRGB8:
+    cDest[0] = pipe->destColorPtr[0];
+    cDest[1] = pipe->destColorPtr[1];
+    cDest[2] = pipe->destColorPtr[2];
+    break;
+  case splashModeXBGR8:
+  case splashModeBGR8:
+    cDest[0] = pipe->destColorPtr[2];
+    cDest[1] = pipe->destColorPtr[1];
+    cDest[2] = pipe->destColorPtr[0];
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    cDest[0] = pipe->destColorPtr[0];
+    cDest[1] = pipe->destColorPtr[1];
+    cDest[2] = pipe->destColorPtr[2];
+    cDest[3] = pipe->destColorPtr[3];
+    break;
+#endif
+  }
+
+  //----- result alpha and color
+
+  nComps = splashColorModeNComps[mode];
+  cResult0 = cResult1 = cResult2 = cResult3 = 0; // make gcc happy
+  if (destAlpha) {
+    aDest = *pipe->destAlphaPtr;
+    alpha2 = aSrc + aDest - div255(aSrc * aDest);
+    *pipe->destAlphaPtr++ = alpha2;
+  } else {
+    alpha2 = 255;
+  }
+  if (alpha2 != 0) {
+    cResult0 = (Guchar)(((alpha2 - aSrc) * cDest[0] +
+			 aSrc * pipe->cSrc[0]) / alpha2);
+    if (nComps >= 3) {
+      cResult1 = (Guchar)(((alpha2 - aSrc) * cDest[1] +
+			   aSrc * pipe->cSrc[1]) / alpha2);
+      cResult2 = (Guchar)(((alpha2 - aSrc) * cDest[2] +
+			   aSrc * pipe->cSrc[2]) / alpha2);
+    }
+    if (nComps == 4) {
+      cResult3 = (Guchar)(((alpha2 - aSrc) * cDest[3] +
+			   aSrc * pipe->cSrc[3]) / alpha2);
+    }
+  }
+
+  //----- write destination pixel
+
+  switch (mode) {
+  case splashModeMono1:
+    if (state->screen->test(pipe->x, pipe->y, cResult0)) {
+      *pipe->destColorPtr |= pipe->destColorMask;
+    } else {
+      *pipe->destColorPtr &= ~pipe->destColorMask;
+    }
+    if (!(pipe->destColorMask >>= 1)) {
+      pipe->destColorMask = 0x80;
+      ++pipe->destColorPtr;
+    }
+    break;
+  case splashModeMono8:
+    *pipe->destColorPtr++ = cResult0;
+    break;
+  case splashModeRGB8:
+    pipe->destColorPtr[0] = cResult0;
+    pipe->destColorPtr[1] = cResult1;
+    pipe->destColorPtr[2] = cResult2;
+    pipe->destColorPtr += 3;
+    break;
+  case splashModeXBGR8:
+    pipe->destColorPtr[0] = cResult2;
+    pipe->destColorPtr[1] = cResult1;
+    pipe->destColorPtr[2] = cResult0;
+    pipe->destColorPtr[3] = 255;
+    pipe->destColorPtr += 4;
+    break;
+  case splashModeBGR8:
+    pipe->destColorPtr[0] = cResult2;
+    pipe->destColorPtr[1] = cResult1;
+    pipe->destColorPtr[2] = cResult0;
+    pipe->destColorPtr += 3;
+    break;
+#if SPLASH_CMYK
+  case splashModeCMYK8:
+    pipe->destColorPtr[0] = cResult0;
+    pipe->destColorPtr[1] = cResult1;
+    pipe->destColorPtr[2] = cResult2;
+    pipe->destColorPtr[3] = cResult3;
+    pipe->destColorPtr += 4;
+    break;
+#endif
+  }
+
+  ++pipe->x;
+}
+
 inline void Splash::pipeSetXY(SplashPipe *pipe, int x, int y) {
   pipe->x = x;
   pipe->y = y;
@@ -646,9 +1118,12 @@ inline void Splash::pipeIncX(SplashPipe *pipe) {
 }
 
 inline void Splash::drawPixel(SplashPipe *pipe, int x, int y, GBool noClip) {
+  if (y < bandYMin || y > bandYMax) {
+    return;
+  }
   if (noClip || state->clip->test(x, y)) {
     pipeSetXY(pipe, x, y);
-    pipeRun(pipe);
+    (this->*pipe->run)(pipe);
     updateModX(x);
     updateModY(y);
   }
@@ -660,8 +1135,6 @@ inline void Splash::drawAAPixelInit() {
 
 inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y) {
 #if splashAASize == 4
-  static int bitCount4[16] = { 0, 1, 1, 2, 1, 2, 2, 3,
-			       1, 2, 2, 3, 2, 3, 3, 4 };
   int w;
 #else
   int xx, yy;
@@ -670,7 +1143,8 @@ inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y) {
   int x0, x1, t;
 
   if (x < 0 || x >= bitmap->width ||
-      y < state->clip->getYMinI() || y > state->clip->getYMaxI()) {
+      y < state->clip->getYMinI() || y > state->clip->getYMaxI() ||
+      y < bandYMin || y > bandYMax) {
     return;
   }
 
@@ -710,7 +1184,7 @@ inline void Splash::drawAAPixel(SplashPipe *pipe, int x, int y) {
   if (t != 0) {
     pipeSetXY(pipe, x, y);
     pipe->shape *= aaGamma[t];
-    pipeRun(pipe);
+    (this->*pipe->run)(pipe);
     updateModX(x);
     updateModY(y);
   }
@@ -720,10 +1194,13 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 			     GBool noClip) {
   int x;
 
+  if (y < bandYMin || y > bandYMax) {
+    return;
+  }
   pipeSetXY(pipe, x0, y);
   if (noClip) {
     for (x = x0; x <= x1; ++x) {
-      pipeRun(pipe);
+      (this->*pipe->run)(pipe);
     }
     updateModX(x0);
     updateModX(x1);
@@ -731,7 +1208,7 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
   } else {
     for (x = x0; x <= x1; ++x) {
       if (state->clip->test(x, y)) {
-	pipeRun(pipe);
+	(this->*pipe->run)(pipe);
 	updateModX(x);
 	updateModY(y);
       } else {
@@ -743,10 +1220,8 @@ inline void Splash::drawSpan(SplashPipe *pipe, int x0, int x1, int y,
 
 inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
 #if splashAASize == 4
-  static int bitCount4[16] = { 0, 1, 1, 2, 1, 2, 2, 3,
-			       1, 2, 2, 3, 2, 3, 3, 4 };
-  SplashColorPtr p0, p1, p2, p3;
-  int t;
+  Guchar t[32];
+  int i, n, xBlock, xEnd;
 #else
   SplashColorPtr p;
   int xx, yy, t;
@@ -754,25 +1229,41 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
   int x;
 
 #if splashAASize == 4
-  p0 = aaBuf->getDataPtr() + (x0 >> 1);
-  p1 = p0 + aaBuf->getRowSize();
-  p2 = p1 + aaBuf->getRowSize();
-  p3 = p2 + aaBuf->getRowSize();
-#endif
+  // the coverage is computed 32 pixels (16 bytes of each aaBuf row)
+  // at a time, and blocks with no coverage are skipped -- the spans of
+  // a thin curved path can be far apart, with nothing to draw in
+  // between
+  n = (x1 >> 1) + 1;
+  for (i = x0 >> 1; i < n; i += 16) {
+    if (!aaCoverage(aaBuf->getDataPtr(), aaBuf->getRowSize(), i, n, t)) {
+      continue;
+    }
+    xBlock = 2 * i;
+    x = xBlock < x0 ? x0 : xBlock;
+    xEnd = xBlock + 31 > x1 ? x1 : xBlock + 31;
+    while (1) {
+      while (x <= xEnd && t[x - xBlock] == 0) {
+	++x;
+      }
+      if (x > xEnd) {
+	break;
+      }
+      updateModX(x);
+      updateModY(y);
+      pipeSetXY(pipe, x, y);
+      do {
+	pipe->shape = aaGamma[t[x - xBlock]];
+	(this->*pipe->run)(pipe);
+	++x;
+      } while (x <= xEnd && t[x - xBlock] != 0);
+      updateModX(x - 1);
+    }
+  }
+#else
   pipeSetXY(pipe, x0, y);
   for (x = x0; x <= x1; ++x) {
 
     // compute the shape value
-#if splashAASize == 4
-    if (x & 1) {
-      t = bitCount4[*p0 & 0x0f] + bitCount4[*p1 & 0x0f] +
-	  bitCount4[*p2 & 0x0f] + bitCount4[*p3 & 0x0f];
-      ++p0; ++p1; ++p2; ++p3;
-    } else {
-      t = bitCount4[*p0 >> 4] + bitCount4[*p1 >> 4] +
-	  bitCount4[*p2 >> 4] + bitCount4[*p3 >> 4];
-    }
-#else
     t = 0;
     for (yy = 0; yy < splashAASize; ++yy) {
       for (xx = 0; xx < splashAASize; ++xx) {
@@ -781,17 +1272,17 @@ inline void Splash::drawAALine(SplashPipe *pipe, int x0, int x1, int y) {
 	t += (*p >> (7 - ((x * splashAASize + xx) & 7))) & 1;
       }
     }
-#endif
 
     if (t != 0) {
       pipe->shape = aaGamma[t];
-      pipeRun(pipe);
+      (this->*pipe->run)(pipe);
       updateModX(x);
       updateModY(y);
     } else {
       pipeIncX(pipe);
     }
   }
+#endif
 }
 
 //------------------------------------------------------------------------
@@ -832,6 +1323,11 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   }
   clearModRegion();
   debugMode = gFalse;
+  deferredThreads = 1;
+  deferredOps = lastDeferredOp = NULL;
+  deferredState = NULL;
+  bandYMin = 0;
+  bandYMax = bitmap->height - 1;
 }
 
 Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
@@ -855,9 +1351,15 @@ Splash::Splash(SplashBitmap *bitmapA, GBool vectorAntialiasA,
   }
   clearModRegion();
   debugMode = gFalse;
+  deferredThreads = 1;
+  deferredOps = lastDeferredOp = NULL;
+  deferredState = NULL;
+  bandYMin = 0;
+  bandYMax = bitmap->height - 1;
 }
 
 Splash::~Splash() {
+  deleteDeferredOps();
   while (state->next) {
     restoreState();
   }
@@ -960,6 +1462,8 @@ void Splash::setFillPattern(SplashPattern *fillPattern) {
 }
 
 void Splash::setScreen(SplashScreen *screen) {
+  // the recorded operations use the screen of the copied state
+  flushDeferred();
   state->setScreen(screen);
 }
 
@@ -1010,24 +1514,49 @@ void Splash::setStrokeAdjust(GBool strokeAdjust) {
 
 void Splash::clipResetToRect(SplashCoord x0, SplashCoord y0,
 			     SplashCoord x1, SplashCoord y1) {
+  SplashDeferredOp *op;
+
+  if (deferredOps) {
+    op = newDeferredOp(splashDeferredClipResetToRect);
+    op->x0 = x0;  op->y0 = y0;
+    op->x1 = x1;  op->y1 = y1;
+  }
   state->clip->resetToRect(x0, y0, x1, y1);
 }
 
 SplashError Splash::clipToRect(SplashCoord x0, SplashCoord y0,
 			       SplashCoord x1, SplashCoord y1) {
+  SplashDeferredOp *op;
+
+  if (deferredOps) {
+    op = newDeferredOp(splashDeferredClipToRect);
+    op->x0 = x0;  op->y0 = y0;
+    op->x1 = x1;  op->y1 = y1;
+  }
   return state->clip->clipToRect(x0, y0, x1, y1);
 }
 
 SplashError Splash::clipToPath(SplashPath *path, GBool eo) {
+  SplashDeferredOp *op;
+
+  if (deferredOps) {
+    op = newDeferredOp(splashDeferredClipToPath);
+    op->path = path->copy();
+    memcpy(op->matrix, state->matrix, 6 * sizeof(SplashCoord));
+    op->flatness = state->flatness;
+    op->eo = eo;
+  }
   return state->clip->clipToPath(path, state->matrix, state->flatness, eo);
 }
 
 void Splash::setSoftMask(SplashBitmap *softMask) {
+  flushDeferred();
   state->setSoftMask(softMask);
 }
 
 void Splash::setInNonIsolatedGroup(SplashBitmap *alpha0BitmapA,
 				   int alpha0XA, int alpha0YA) {
+  flushDeferred();
   alpha0Bitmap = alpha0BitmapA;
   alpha0X = alpha0XA;
   alpha0Y = alpha0YA;
@@ -1041,6 +1570,9 @@ void Splash::setInNonIsolatedGroup(SplashBitmap *alpha0BitmapA,
 void Splash::saveState() {
   SplashState *newState;
 
+  if (deferredOps) {
+    newDeferredOp(splashDeferredSaveState);
+  }
   newState = state->copy();
   newState->next = state;
   state = newState;
@@ -1052,6 +1584,9 @@ SplashError Splash::restoreState() {
   if (!state->next) {
     return splashErrNoSave;
   }
+  if (deferredOps) {
+    newDeferredOp(splashDeferredRestoreState);
+  }
   oldState = state;
   state = state->next;
   delete oldState;
@@ -1067,6 +1602,8 @@ void Splash::clear(SplashColorPtr color, Guchar alpha) {
   Guchar mono;
   int x, y;
 
+  flushDeferred();
+
   switch (bitmap->mode) {
   case splashModeMono1:
     mono = (color[0] & 0x80) ? 0xff : 0x00;
@@ -1213,8 +1750,49 @@ SplashError Splash::stroke(SplashPath *path) {
 }
 
 void Splash::strokeNarrow(SplashPath *path) {
-  SplashPipe pipe;
   SplashXPath *xPath;
+  SplashDeferredOp *op;
+  int yMinA, yMaxA, y0, y1, i;
+
+  xPath = new SplashXPath(path, state->matrix, state->flatness, gFalse);
+
+  if (deferOp()) {
+    if (xPath->length == 0) {
+      delete xPath;
+      return;
+    }
+    yMinA = yMaxA = splashFloor(xPath->segs[0].y0);
+    for (i = 0; i < xPath->length; ++i) {
+      y0 = splashFloor(xPath->segs[i].y0);
+      y1 = splashFloor(xPath->segs[i].y1);
+      if (y0 < yMinA) {
+	yMinA = y0;
+      } else if (y0 > yMaxA) {
+	yMaxA = y0;
+      }
+      if (y1 < yMinA) {
+	yMinA = y1;
+      } else if (y1 > yMaxA) {
+	yMaxA = y1;
+      }
+    }
+    op = newDeferredOp(splashDeferredStrokeNarrow);
+    op->yMin = yMinA;
+    op->yMax = yMaxA;
+    op->xPath = xPath;
+    op->pattern = state->strokePattern->copy();
+    op->alpha = state->strokeAlpha;
+    op->blendFunc = state->blendFunc;
+    return;
+  }
+
+  strokeNarrowXPath(xPath, state->strokePattern, state->strokeAlpha);
+  delete xPath;
+}
+
+void Splash::strokeNarrowXPath(SplashXPath *xPath, SplashPattern *pattern,
+			       SplashCoord alpha) {
+  SplashPipe pipe;
   SplashXPathSeg *seg;
   int x0, x1, x2, x3, y0, y1, x, y, t;
   SplashCoord dx, dy, dxdy;
@@ -1224,10 +1802,7 @@ void Splash::strokeNarrow(SplashPath *path) {
 
   nClipRes[0] = nClipRes[1] = nClipRes[2] = 0;
 
-  xPath = new SplashXPath(path, state->matrix, state->flatness, gFalse);
-
-  pipeInit(&pipe, 0, 0, state->strokePattern, NULL, state->strokeAlpha,
-	   gFalse, gFalse);
+  pipeInit(&pipe, 0, 0, pattern, NULL, alpha, gFalse, gFalse);
 
   for (i = 0, seg = xPath->segs; i < xPath->length; ++i, ++seg) {
 
@@ -1317,8 +1892,6 @@ void Splash::strokeNarrow(SplashPath *path) {
   } else {
     opClipRes = splashClipAllOutside;
   }
-
-  delete xPath;
 }
 
 void Splash::strokeWide(SplashPath *path) {
@@ -1552,11 +2125,10 @@ SplashError Splash::fill(SplashPath *path, GBool eo) {
 SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
 				    SplashPattern *pattern,
 				    SplashCoord alpha) {
-  SplashPipe pipe;
   SplashXPath *xPath;
   SplashXPathScanner *scanner;
-  int xMinI, yMinI, xMaxI, yMaxI, x0, x1, y;
-  SplashClipResult clipRes, clipRes2;
+  SplashDeferredOp *op;
+  int xMinI, yMinI, xMaxI, yMaxI;
 
   if (path->length == 0) {
     return splashErrEmptyPath;
@@ -1566,6 +2138,45 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
     xPath->aaScale();
   }
   xPath->sort();
+
+  if (deferOp()) {
+    scanner = new SplashXPathScanner(xPath, eo);
+    if (vectorAntialias) {
+      scanner->getBBoxAA(&xMinI, &yMinI, &xMaxI, &yMaxI);
+    } else {
+      scanner->getBBox(&xMinI, &yMinI, &xMaxI, &yMaxI);
+    }
+    delete scanner;
+    opClipRes = state->clip->testRect(xMinI, yMinI, xMaxI, yMaxI);
+    if (opClipRes == splashClipAllOutside) {
+      delete xPath;
+      return splashOk;
+    }
+    op = newDeferredOp(splashDeferredFill);
+    op->yMin = yMinI;
+    op->yMax = yMaxI;
+    op->xPath = xPath;
+    op->eo = eo;
+    op->pattern = pattern->copy();
+    op->alpha = alpha;
+    op->blendFunc = state->blendFunc;
+    return splashOk;
+  }
+
+  fillXPath(xPath, eo, pattern, alpha);
+  delete xPath;
+  return splashOk;
+}
+
+// Fill a flattened, sorted (and, with vector antialiasing, scaled)
+// path.
+void Splash::fillXPath(SplashXPath *xPath, GBool eo,
+		       SplashPattern *pattern, SplashCoord alpha) {
+  SplashPipe pipe;
+  SplashXPathScanner *scanner;
+  int xMinI, yMinI, xMaxI, yMaxI, x0, x1, y;
+  SplashClipResult clipRes, clipRes2;
+
   scanner = new SplashXPathScanner(xPath, eo);
 
   // get the min and max x and y values
@@ -1586,6 +2197,12 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
     if (yMaxI > state->clip->getYMaxI()) {
       yMaxI = state->clip->getYMaxI();
     }
+    if (yMinI < bandYMin) {
+      yMinI = bandYMin;
+    }
+    if (yMaxI > bandYMax) {
+      yMaxI = bandYMax;
+    }
 
     pipeInit(&pipe, 0, yMinI, pattern, NULL, alpha, vectorAntialias, gFalse);
 
@@ -1621,8 +2238,6 @@ SplashError Splash::fillWithPattern(SplashPath *path, GBool eo,
   opClipRes = clipRes;
 
   delete scanner;
-  delete xPath;
-  return splashOk;
 }
 
 SplashError Splash::xorFill(SplashPath *path, GBool eo) {
@@ -1636,6 +2251,7 @@ SplashError Splash::xorFill(SplashPath *path, GBool eo) {
   if (path->length == 0) {
     return splashErrEmptyPath;
   }
+  flushDeferred();
   xPath = new SplashXPath(path, state->matrix, state->flatness, gTrue);
   xPath->sort();
   scanner = new SplashXPathScanner(xPath, eo);
@@ -1706,7 +2322,11 @@ SplashError Splash::fillChar(SplashCoord x, SplashCoord y,
     return splashErrNoGlyph;
   }
   if (clipRes != splashClipAllOutside) {
-    fillGlyph2(x0, y0, &glyph, clipRes == splashClipAllInside);
+    if (deferOp()) {
+      deferGlyph(x0, y0, &glyph, clipRes == splashClipAllInside);
+    } else {
+      fillGlyph2(x0, y0, &glyph, clipRes == splashClipAllInside);
+    }
   }
   opClipRes = clipRes;
   if (glyph.freeData) {
@@ -1728,7 +2348,11 @@ void Splash::fillGlyph(SplashCoord x, SplashCoord y,
                              x0 - glyph->x + glyph->w - 1,
                              y0 - glyph->y + glyph->h - 1);
   if (clipRes != splashClipAllOutside) {
-    fillGlyph2(x0, y0, glyph, clipRes == splashClipAllInside);
+    if (deferOp()) {
+      deferGlyph(x0, y0, glyph, clipRes == splashClipAllInside);
+    } else {
+      fillGlyph2(x0, y0, glyph, clipRes == splashClipAllInside);
+    }
   }
   opClipRes = clipRes;
 }
@@ -1762,6 +2386,16 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
   if (xxLimit + xStart >= bitmap->width) xxLimit = bitmap->width - xStart;
   if (yyLimit + yStart >= bitmap->height) yyLimit = bitmap->height - yStart;
 
+  // only draw the rows of this band
+  if (yStart < bandYMin)
+  {
+    p += (bandYMin - yStart) * (glyph->aa ? glyph->w
+				          : splashCeil(glyph->w / 8.0));
+    yyLimit -= bandYMin - yStart;
+    yStart = bandYMin;
+  }
+  if (yyLimit + yStart > bandYMax + 1) yyLimit = bandYMax + 1 - yStart;
+
   if (noClip) {
     if (glyph->aa) {
       pipeInit(&pipe, xStart, yStart,
@@ -1772,7 +2406,7 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
           alpha = p[xx];
           if (alpha != 0) {
             pipe.shape = (SplashCoord)(alpha / 255.0);
-            pipeRun(&pipe);
+            (this->*pipe.run)(&pipe);
             updateModX(x1);
             updateModY(y1);
           } else {
@@ -1792,7 +2426,7 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
           alpha0 = p[xx / 8];
           for (xx1 = 0; xx1 < 8 && xx + xx1 < xxLimit; ++xx1, ++x1) {
             if (alpha0 & 0x80) {
-              pipeRun(&pipe);
+              (this->*pipe.run)(&pipe);
               updateModX(x1);
               updateModY(y1);
             } else {
@@ -1815,7 +2449,7 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
             alpha = p[xx];
             if (alpha != 0) {
               pipe.shape = (SplashCoord)(alpha / 255.0);
-              pipeRun(&pipe);
+              (this->*pipe.run)(&pipe);
               updateModX(x1);
               updateModY(y1);
             } else {
@@ -1839,7 +2473,7 @@ void Splash::fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip)
           for (xx1 = 0; xx1 < 8 && xx + xx1 < xxLimit; ++xx1, ++x1) {
             if (state->clip->test(x1, y1)) {
               if (alpha0 & 0x80) {
-                pipeRun(&pipe);
+                (this->*pipe.run)(&pipe);
                 updateModX(x1);
                 updateModY(y1);
               } else {
@@ -1995,6 +2629,17 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
   clipRes = state->clip->testRect(xMin, yMin, xMax, yMax);
   opClipRes = clipRes;
 
+  if (deferOp()) {
+    if (clipRes == splashClipAllOutside) {
+      return splashOk;
+    }
+    if (w > 0 && h > 0 && h <= splashMaxDeferredImage / w) {
+      return deferImageMask(src, srcData, w, h, mat, glyphMode,
+			    yMin - 2, yMax + 2);
+    }
+    flushDeferred();
+  }
+
   // compute Bresenham parameters for x and y scaling
   yp = h / scaledHeight;
   yq = h % scaledHeight;
@@ -2039,6 +2684,12 @@ SplashError Splash::fillImageMask(SplashImageMaskSource src, void *srcData,
     }
     lastYStep = yStep;
 
+    // skip the rows outside this band
+    if (!rot && yShear == 0 &&
+	(ty + ySign * y < bandYMin || ty + ySign * y > bandYMax)) {
+      continue;
+    }
+
     // loop-invariant constants
     k1 = splashRound(xShear * ySign * y);
 
@@ -2298,6 +2949,15 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
     return splashOk;
   }
 
+  if (deferOp()) {
+    if (w > 0 && h > 0 && w <= splashMaxDeferredImage / (nComps + 1) &&
+	h <= splashMaxDeferredImage / (w * (nComps + (srcAlpha ? 1 : 0)))) {
+      return deferImage(src, srcData, srcMode, srcAlpha, w, h, nComps, mat,
+			yMin - 2, yMax + 2);
+    }
+    flushDeferred();
+  }
+
   // compute Bresenham parameters for x and y scaling
   yp = h / scaledHeight;
   yq = h % scaledHeight;
@@ -2357,6 +3017,12 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
       }
       lastYStep = yStep;
 
+      // skip the rows outside this band
+      if (!rot && yShear == 0 &&
+	  (ty + ySign * y < bandYMin || ty + ySign * y > bandYMax)) {
+	continue;
+      }
+
       // loop-invariant constants
       k1 = splashRound(xShear * ySign * y);
   
@@ -2703,6 +3369,12 @@ SplashError Splash::drawImage(SplashImageSource src, void *srcData,
       }
       lastYStep = yStep;
 
+      // skip the rows outside this band
+      if (!rot && yShear == 0 &&
+	  (ty + ySign * y < bandYMin || ty + ySign * y > bandYMax)) {
+	continue;
+      }
+
       // loop-invariant constants
       k1 = splashRound(xShear * ySign * y);
 
@@ -3010,6 +3682,7 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
   if (src->mode != bitmap->mode) {
     return splashErrModeMismatch;
   }
+  flushDeferred();
 
   if (src->alpha) {
     pipeInit(&pipe, xDest, yDest, NULL, pixel, state->fillAlpha,
@@ -3024,7 +3697,7 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
 	  // this uses shape instead of alpha, which isn't technically
 	  // correct, but works out the same
 	  pipe.shape = (SplashCoord)(alpha / 255.0);
-	  pipeRun(&pipe);
+	  (this->*pipe.run)(&pipe);
 	  updateModX(xDest + x);
 	  updateModY(yDest + y);
 	} else {
@@ -3040,7 +3713,7 @@ SplashError Splash::composite(SplashBitmap *src, int xSrc, int ySrc,
       for (x = 0; x < w; ++x) {
 	src->getPixel(xSrc + x, ySrc + y, pixel);
 	if (noClip || state->clip->test(xDest + x, yDest + y)) {
-	  pipeRun(&pipe);
+	  (this->*pipe.run)(&pipe);
 	  updateModX(xDest + x);
 	  updateModY(yDest + y);
 	} else {
@@ -3062,6 +3735,8 @@ void Splash::compositeBackground(SplashColorPtr color) {
 #endif
   int x, y, mask;
 
+  flushDeferred();
+
   switch (bitmap->mode) {
   case splashModeMono1:
     color0 = color[0];
@@ -3170,6 +3845,7 @@ SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
   if (src->mode != bitmap->mode) {
     return splashErrModeMismatch;
   }
+  flushDeferred();
 
   switch (bitmap->mode) {
   case splashModeMono1:
@@ -3251,6 +3927,327 @@ SplashError Splash::blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
   return splashOk;
 }
 
+//------------------------------------------------------------------------
+// deferred rasterization
+//------------------------------------------------------------------------
+
+void Splash::setDeferredThreads(int nThreadsA) {
+  flushDeferred();
+  deferredThreads = nThreadsA < 1 ? 1 : nThreadsA;
+}
+
+// Returns true if the current drawing operation is to be recorded.
+GBool Splash::deferOp() {
+  if (deferredThreads <= 1) {
+    return gFalse;
+  }
+  if (state->softMask || state->inNonIsolatedGroup) {
+    flushDeferred();
+    return gFalse;
+  }
+  return gTrue;
+}
+
+// Append an operation to the list.  The first one takes a copy of the
+// state stack, which the bands start from.
+SplashDeferredOp *Splash::newDeferredOp(int kind) {
+  SplashDeferredOp *op;
+
+  op = new SplashDeferredOp;
+  op->kind = (SplashDeferredOpKind)kind;
+  op->yMin = 0;
+  op->yMax = bitmap->height - 1;
+  op->pattern = NULL;
+  op->alpha = 1;
+  op->blendFunc = NULL;
+  op->path = NULL;
+  op->xPath = NULL;
+  op->eo = gFalse;
+  op->glyph.data = NULL;
+  op->glyph.freeData = gFalse;
+  op->noClip = gFalse;
+  op->data = NULL;
+  op->alphaData = NULL;
+  op->w = op->h = op->rowSize = 0;
+  op->next = NULL;
+  if (!deferredOps) {
+    deferredState = copyStateStack(state);
+    deferredOps = op;
+  } else {
+    lastDeferredOp->next = op;
+  }
+  lastDeferredOp = op;
+  return op;
+}
+
+void Splash::deferGlyph(int x0, int y0, SplashGlyphBitmap *glyph,
+			GBool noClip) {
+  SplashDeferredOp *op;
+  int size;
+
+  op = newDeferredOp(splashDeferredGlyph);
+  op->glyph = *glyph;
+  if (glyph->freeData) {
+    // take over the caller's copy
+    glyph->freeData = gFalse;
+  } else {
+    size = glyph->aa ? glyph->w * glyph->h
+                     : ((glyph->w + 7) >> 3) * glyph->h;
+    op->glyph.data = (Guchar *)gmalloc(size);
+    memcpy(op->glyph.data, glyph->data, size);
+  }
+  op->glyph.freeData = gTrue;
+  op->glyphX = x0;
+  op->glyphY = y0;
+  op->noClip = noClip;
+  op->yMin = y0 - glyph->y;
+  op->yMax = op->yMin + glyph->h - 1;
+  op->pattern = state->fillPattern->copy();
+  op->alpha = state->fillAlpha;
+  op->blendFunc = state->blendFunc;
+}
+
+SplashError Splash::deferImageMask(SplashImageMaskSource src, void *srcData,
+				   int w, int h, SplashCoord *mat,
+				   GBool glyphMode, int yMinA, int yMaxA) {
+  SplashDeferredOp *op;
+  int y;
+
+  op = newDeferredOp(splashDeferredImageMask);
+  op->w = w;
+  op->h = h;
+  op->rowSize = w;
+  op->data = (Guchar *)gmallocn(h, w);
+  for (y = 0; y < h; ++y) {
+    (*src)(srcData, op->data + y * op->rowSize);
+  }
+  memcpy(op->matrix, mat, 6 * sizeof(SplashCoord));
+  op->eo = glyphMode;
+  op->yMin = yMinA;
+  op->yMax = yMaxA;
+  op->pattern = state->fillPattern->copy();
+  op->alpha = state->fillAlpha;
+  op->blendFunc = state->blendFunc;
+  return splashOk;
+}
+
+SplashError Splash::deferImage(SplashImageSource src, void *srcData,
+			       SplashColorMode srcMode, GBool srcAlpha,
+			       int w, int h, int nComps, SplashCoord *mat,
+			       int yMinA, int yMaxA) {
+  SplashDeferredOp *op;
+  int y;
+
+  op = newDeferredOp(splashDeferredImage);
+  op->w = w;
+  op->h = h;
+  op->rowSize = w * nComps;
+  op->srcMode = srcMode;
+  op->data = (Guchar *)gmallocn(h, op->rowSize);
+  if (srcAlpha) {
+    op->alphaData = (Guchar *)gmallocn(h, w);
+  }
+  for (y = 0; y < h; ++y) {
+    (*src)(srcData, op->data + y * op->rowSize,
+	   srcAlpha ? op->alphaData + y * w : (Guchar *)NULL);
+  }
+  memcpy(op->matrix, mat, 6 * sizeof(SplashCoord));
+  op->eo = srcAlpha;
+  op->yMin = yMinA;
+  op->yMax = yMaxA;
+  op->alpha = state->fillAlpha;
+  op->blendFunc = state->blendFunc;
+  return splashOk;
+}
+
+void Splash::flushDeferred() {
+  SplashBandQueue queue;
+#if MULTITHREADED
+#ifdef _WIN32
+  HANDLE *threads;
+#else
+  pthread_t *threads;
+#endif
+  int nThreads, nStarted, i;
+#endif
+
+  if (!deferredOps) {
+    return;
+  }
+
+  // use a few bands per thread, so that a band with a lot of
+  // drawing doesn't hold up the others at the end
+  queue.splash = this;
+  queue.nBands = deferredThreads * splashBandsPerThread;
+  if (queue.nBands > bitmap->height) {
+    queue.nBands = bitmap->height;
+  }
+  queue.bandHeight = (bitmap->height + queue.nBands - 1) / queue.nBands;
+  queue.nBands = (bitmap->height + queue.bandHeight - 1) / queue.bandHeight;
+  queue.nextBand = 0;
+
+#if MULTITHREADED
+  nThreads = deferredThreads - 1;
+  if (nThreads > queue.nBands - 1) {
+    nThreads = queue.nBands - 1;
+  }
+  gInitMutex(&queue.mutex);
+  // if a thread can't be started, the ones that could (and this one)
+  // take its bands
+#ifdef _WIN32
+  threads = (HANDLE *)gmallocn(nThreads, sizeof(HANDLE));
+  for (nStarted = 0; nStarted < nThreads; ++nStarted) {
+    if (!(threads[nStarted] = CreateThread(NULL, 0, &splashBandThread,
+					   &queue, 0, NULL))) {
+      break;
+    }
+  }
+#else
+  threads = (pthread_t *)gmallocn(nThreads, sizeof(pthread_t));
+  for (nStarted = 0; nStarted < nThreads; ++nStarted) {
+    if (pthread_create(&threads[nStarted], NULL, &splashBandThread,
+		       &queue)) {
+      break;
+    }
+  }
+#endif
+  queue.run();
+  for (i = 0; i < nStarted; ++i) {
+#ifdef _WIN32
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], NULL);
+#endif
+  }
+  gfree(threads);
+  gDestroyMutex(&queue.mutex);
+#else
+  queue.run();
+#endif
+
+  deleteDeferredOps();
+}
+
+// Replay the recorded operations into rows <yMin>..<yMax> of the
+// bitmap.  Returns the band's Splash object, for its modified region;
+// the caller deletes it.
+Splash *Splash::rasterizeBand(int yMin, int yMax) {
+  Splash *band;
+
+  band = new Splash(bitmap, vectorAntialias, deferredState->screen);
+  delete band->state;
+  band->state = copyStateStack(deferredState);
+  band->bandYMin = yMin;
+  band->bandYMax = yMax;
+  band->replayDeferred(deferredOps);
+  return band;
+}
+
+void Splash::replayDeferred(SplashDeferredOp *ops) {
+  SplashDeferredOp *op;
+  SplashDeferredImageSrc imgSrc;
+
+  for (op = ops; op; op = op->next) {
+    switch (op->kind) {
+    case splashDeferredSaveState:
+      saveState();
+      continue;
+    case splashDeferredRestoreState:
+      restoreState();
+      continue;
+    case splashDeferredClipResetToRect:
+      state->clip->resetToRect(op->x0, op->y0, op->x1, op->y1);
+      continue;
+    case splashDeferredClipToRect:
+      state->clip->clipToRect(op->x0, op->y0, op->x1, op->y1);
+      continue;
+    case splashDeferredClipToPath:
+      state->clip->clipToPath(op->path, op->matrix, op->flatness, op->eo);
+      continue;
+    default:
+      break;
+    }
+
+    if (op->yMax < bandYMin || op->yMin > bandYMax) {
+      continue;
+    }
+    if (op->pattern) {
+      state->setFillPattern(op->pattern->copy());
+    }
+    state->fillAlpha = op->alpha;
+    state->blendFunc = op->blendFunc;
+    switch (op->kind) {
+    case splashDeferredFill:
+      fillXPath(op->xPath, op->eo, state->fillPattern, op->alpha);
+      break;
+    case splashDeferredStrokeNarrow:
+      strokeNarrowXPath(op->xPath, state->fillPattern, op->alpha);
+      break;
+    case splashDeferredGlyph:
+      fillGlyph2(op->glyphX, op->glyphY, &op->glyph, op->noClip);
+      break;
+    case splashDeferredImageMask:
+      imgSrc.op = op;
+      imgSrc.y = 0;
+      fillImageMask(&deferredImageMaskSrc, &imgSrc, op->w, op->h,
+		    op->matrix, op->eo);
+      break;
+    case splashDeferredImage:
+      imgSrc.op = op;
+      imgSrc.y = 0;
+      drawImage(&deferredImageSrc, &imgSrc, op->srcMode, op->eo,
+		op->w, op->h, op->matrix);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void Splash::deleteDeferredOps() {
+  SplashDeferredOp *op;
+  SplashState *s;
+
+  while (deferredOps) {
+    op = deferredOps;
+    deferredOps = op->next;
+    delete op->pattern;
+    delete op->path;
+    delete op->xPath;
+    gfree(op->data);
+    gfree(op->alphaData);
+    if (op->glyph.freeData) {
+      gfree(op->glyph.data);
+    }
+    delete op;
+  }
+  lastDeferredOp = NULL;
+  while (deferredState) {
+    s = deferredState;
+    deferredState = s->next;
+    delete s;
+  }
+}
+
+SplashState *Splash::copyStateStack(SplashState *stateA) {
+  SplashState *first, *last, *s, *copy;
+
+  first = last = NULL;
+  for (s = stateA; s; s = s->next) {
+    copy = s->copy();
+    if (last) {
+      last->next = copy;
+    } else {
+      first = copy;
+    }
+    last = copy;
+  }
+  return first;
+}
+
+//------------------------------------------------------------------------
+
 SplashPath *Splash::makeStrokePath(SplashPath *path, GBool flatten) {
   SplashPath *pathIn, *pathOut;
   SplashCoord w, d, dx, dy, wdx, wdy, dxNext, dyNext, wdxNext, wdyNext;
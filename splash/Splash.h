@@ -39,6 +39,8 @@ class SplashPath;
 class SplashXPath;
 class SplashFont;
 struct SplashPipe;
+struct SplashDeferredOp;
+struct SplashBandQueue;
 
 //------------------------------------------------------------------------
 
@@ -219,6 +221,27 @@ public:
   SplashError blitTransparent(SplashBitmap *src, int xSrc, int ySrc,
 			      int xDest, int yDest, int w, int h);
 
+  //----- deferred rasterization
+
+  // Record the drawing operations instead of executing them, and
+  // rasterize them in horizontal bands on <nThreadsA> threads when
+  // flushDeferred() is called.  Each band replays all of the
+  // operations which touch it, under the same clip, but only writes
+  // its own rows, so the result is identical to drawing directly.
+  // Paths are flattened, glyphs rasterized and images decoded when
+  // the operation is recorded.  Operations which read the bitmap, or
+  // which use a soft mask or a non-isolated group, flush the recorded
+  // ones and are executed directly.  The bitmap isn't up to date
+  // until flushDeferred() is called (operations which are still
+  // recorded when the Splash object is deleted are dropped), and
+  // getClipRes() isn't set by recorded narrow strokes.  A value of 1
+  // (the default) turns this off.
+  void setDeferredThreads(int nThreadsA);
+  int getDeferredThreads() { return deferredThreads; }
+
+  // Rasterize the recorded drawing operations, if any.
+  void flushDeferred();
+
   //----- misc
 
   // Construct a path for a stroke, given the path to be stroked, and
@@ -246,7 +269,8 @@ public:
 
 #if 1 //~tmp: turn off anti-aliasing temporarily
   GBool getVectorAntialias() { return vectorAntialias; }
-  void setVectorAntialias(GBool vaa) { vectorAntialias = vaa; }
+  void setVectorAntialias(GBool vaa)
+    { flushDeferred(); vectorAntialias = vaa; }
 #endif
 
 private:
@@ -256,6 +280,10 @@ private:
 		SplashCoord aInput, GBool usesShape,
 		GBool nonIsolatedGroup);
   void pipeRun(SplashPipe *pipe);
+  template <SplashColorMode mode>
+  void pipeRunSimple(SplashPipe *pipe);
+  template <SplashColorMode mode, GBool destAlpha>
+  void pipeRunAA(SplashPipe *pipe);
   void pipeSetXY(SplashPipe *pipe, int x, int y);
   void pipeIncX(SplashPipe *pipe);
   void drawPixel(SplashPipe *pipe, int x, int y, GBool noClip);
@@ -268,6 +296,8 @@ private:
   void updateModX(int x);
   void updateModY(int y);
   void strokeNarrow(SplashPath *path);
+  void strokeNarrowXPath(SplashXPath *xPath, SplashPattern *pattern,
+			 SplashCoord alpha);
   void strokeWide(SplashPath *path);
   SplashPath *flattenPath(SplashPath *path, SplashCoord *matrix,
 			  SplashCoord flatness);
@@ -280,7 +310,23 @@ private:
   SplashPath *makeDashedPath(SplashPath *xPath);
   SplashError fillWithPattern(SplashPath *path, GBool eo,
 			      SplashPattern *pattern, SplashCoord alpha);
+  void fillXPath(SplashXPath *xPath, GBool eo,
+		 SplashPattern *pattern, SplashCoord alpha);
   void fillGlyph2(int x0, int y0, SplashGlyphBitmap *glyph, GBool noclip);
+  GBool deferOp();
+  SplashDeferredOp *newDeferredOp(int kind);
+  void deferGlyph(int x0, int y0, SplashGlyphBitmap *glyph, GBool noClip);
+  SplashError deferImageMask(SplashImageMaskSource src, void *srcData,
+			     int w, int h, SplashCoord *mat,
+			     GBool glyphMode, int yMinA, int yMaxA);
+  SplashError deferImage(SplashImageSource src, void *srcData,
+			 SplashColorMode srcMode, GBool srcAlpha,
+			 int w, int h, int nComps, SplashCoord *mat,
+			 int yMinA, int yMaxA);
+  Splash *rasterizeBand(int yMin, int yMax);
+  void replayDeferred(SplashDeferredOp *ops);
+  void deleteDeferredOps();
+  static SplashState *copyStateStack(SplashState *stateA);
   void dumpPath(SplashPath *path);
   void dumpXPath(SplashXPath *path);
 
@@ -301,6 +347,16 @@ private:
   SplashClipResult opClipRes;
   GBool vectorAntialias;
   GBool debugMode;
+
+  int deferredThreads;		// number of threads rasterizing the
+				//   recorded operations
+  SplashDeferredOp *deferredOps;	// recorded operations
+  SplashDeferredOp *lastDeferredOp;
+  SplashState *deferredState;	// copy of the state stack at the
+				//   first recorded operation
+  int bandYMin, bandYMax;	// rows this object may write to
+
+  friend struct SplashBandQueue;
 };
 
 #endif
@@ -130,34 +130,38 @@ SplashError SplashBitmap::writePNMFile(char *fileName) {
 }
 
 
+// The rows are written with one fwrite call each: the writer may be
+// running next to rendering threads, in which case every stdio call
+// takes the FILE lock.
 SplashError SplashBitmap::writePNMFile(FILE *f) {
   SplashColorPtr row, p;
+  Guchar *line, *q;
   int x, y;
 
   switch (mode) {
 
   case splashModeMono1:
     fprintf(f, "P4\n%d %d\n", width, height);
+    line = (Guchar *)gmalloc((width + 7) >> 3);
     row = data;
     for (y = 0; y < height; ++y) {
       p = row;
+      q = line;
       for (x = 0; x < width; x += 8) {
-	fputc(*p ^ 0xff, f);
+	*q++ = *p ^ 0xff;
 	++p;
       }
+      fwrite(line, 1, q - line, f);
       row += rowSize;
     }
+    gfree(line);
     break;
 
   case splashModeMono8:
     fprintf(f, "P5\n%d %d\n255\n", width, height);
     row = data;
     for (y = 0; y < height; ++y) {
-      p = row;
-      for (x = 0; x < width; ++x) {
-	fputc(*p, f);
-	++p;
-      }
+      fwrite(row, 1, width, f);
       row += rowSize;
     }
     break;
@@ -166,46 +170,48 @@ SplashError SplashBitmap::writePNMFile(FILE *f) {
     fprintf(f, "P6\n%d %d\n255\n", width, height);
     row = data;
     for (y = 0; y < height; ++y) {
-      p = row;
-      for (x = 0; x < width; ++x) {
-	fputc(splashRGB8R(p), f);
-	fputc(splashRGB8G(p), f);
-	fputc(splashRGB8B(p), f);
-	p += 3;
-      }
+      fwrite(row, 1, 3 * width, f);
       row += rowSize;
     }
     break;
 
   case splashModeXBGR8:
     fprintf(f, "P6\n%d %d\n255\n", width, height);
+    line = (Guchar *)gmallocn(width, 3);
     row = data;
     for (y = 0; y < height; ++y) {
       p = row;
+      q = line;
       for (x = 0; x < width; ++x) {
-	fputc(splashBGR8R(p), f);
-	fputc(splashBGR8G(p), f);
-	fputc(splashBGR8B(p), f);
+	*q++ = splashBGR8R(p);
+	*q++ = splashBGR8G(p);
+	*q++ = splashBGR8B(p);
 	p += 4;
       }
+      fwrite(line, 1, 3 * width, f);
       row += rowSize;
     }
+    gfree(line);
     break;
 
 
   case splashModeBGR8:
     fprintf(f, "P6\n%d %d\n255\n", width, height);
+    line = (Guchar *)gmallocn(width, 3);
     row = data;
     for (y = 0; y < height; ++y) {
       p = row;
+      q = line;
       for (x = 0; x < width; ++x) {
-	fputc(splashBGR8R(p), f);
-	fputc(splashBGR8G(p), f);
-	fputc(splashBGR8B(p), f);
+	*q++ = splashBGR8R(p);
+	*q++ = splashBGR8G(p);
+	*q++ = splashBGR8B(p);
 	p += 3;
       }
+      fwrite(line, 1, 3 * width, f);
       row += rowSize;
     }
+    gfree(line);
     break;
 
 #if SPLASH_CMYK
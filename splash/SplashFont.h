@@ -30,7 +30,7 @@
 #include "SplashClip.h"
 
 struct SplashGlyphBitmap;
-struct SplashFontCacheTag;
+class SplashGlyphCache;
 class SplashFontFile;
 class SplashPath;
 
@@ -57,6 +57,11 @@ public:
   // constructor has a chance to compute the bbox.
   void initCache();
 
+  // Set the glyph cache used by getGlyph.  Fonts without a cache
+  // render every glyph.
+  void setGlyphCache(SplashGlyphCache *glyphCacheA)
+    { glyphCache = glyphCacheA; }
+
   virtual ~SplashFont();
 
   SplashFontFile *getFontFile() { return fontFile; }
@@ -100,6 +105,10 @@ public:
   void getBBox(int *xMinA, int *yMinA, int *xMaxA, int *yMaxA)
     { *xMinA = xMin; *yMinA = yMin; *xMaxA = xMax; *yMaxA = yMax; }
 
+  // Return a hash of the font file, matrices, and AA flag, for the
+  // glyph cache.
+  Guint getGlyphCacheHash() { return glyphCacheHash; }
+
 protected:
 
   SplashFontFile *fontFile;
@@ -109,13 +118,12 @@ protected:
 				//   (text space -> user space)
   GBool aa;			// anti-aliasing
   int xMin, yMin, xMax, yMax;	// glyph bounding box
-  Guchar *cache;		// glyph bitmap cache
-  SplashFontCacheTag *		// cache tags
-    cacheTags;
-  int glyphW, glyphH;		// size of glyph bitmaps
-  int glyphSize;		// size of glyph bitmaps, in bytes
-  int cacheSets;		// number of sets in cache
-  int cacheAssoc;		// cache associativity (glyphs per set)
+  int glyphW, glyphH;		// max size of glyph bitmaps
+  SplashGlyphCache *glyphCache;	// glyph bitmap cache (owned by the
+				//   font engine)
+  Guint glyphCacheHash;		// hash of the glyph cache key
+
+  friend class SplashGlyphCache;
 };
 
 #endif
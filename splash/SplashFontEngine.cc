@@ -44,6 +44,7 @@
 #include "SplashFontFile.h"
 #include "SplashFontFileID.h"
 #include "SplashFont.h"
+#include "SplashGlyphCache.h"
 #include "SplashFontEngine.h"
 
 #ifdef VMS
@@ -70,12 +71,13 @@ SplashFontEngine::SplashFontEngine(
 				   GBool enableFreeType,
 				   GBool enableFreeTypeHinting,
 #endif
-				   GBool aa) {
+				   GBool aa, int glyphCacheSize) {
   int i;
 
   for (i = 0; i < splashFontCacheSize; ++i) {
     fontCache[i] = NULL;
   }
+  glyphCache = new SplashGlyphCache(glyphCacheSize);
 
 #if HAVE_T1LIB_H
   if (enableT1lib) {
@@ -101,6 +103,9 @@ SplashFontEngine::~SplashFontEngine() {
       delete fontCache[i];
     }
   }
+  // the cached glyphs hold references to font files, which have to be
+  // released before the font engines are shut down
+  delete glyphCache;
 
 #if HAVE_T1LIB_H
   if (t1Engine) {
@@ -126,7 +131,7 @@ SplashFontFile *SplashFontEngine::getFontFile(SplashFontFileID *id) {
       }
     }
   }
-  return NULL;
+  return glyphCache->findFontFile(id);
 }
 
 SplashFontFile *SplashFontEngine::loadType1Font(SplashFontFileID *idA,
@@ -316,6 +321,7 @@ SplashFont *SplashFontEngine::getFont(SplashFontFile *fontFile,
     }
   }
   font = fontFile->makeFont(mat, textMat);
+  font->setGlyphCache(glyphCache);
   if (fontCache[splashFontCacheSize - 1]) {
     delete fontCache[splashFontCacheSize - 1];
   }
@@ -37,6 +37,7 @@ class SplashFontFile;
 class SplashFontFileID;
 class SplashFont;
 class SplashFontSrc;
+class SplashGlyphCache;
 
 //------------------------------------------------------------------------
 
@@ -49,7 +50,8 @@ class SplashFontSrc;
 class SplashFontEngine {
 public:
 
-  // Create a font engine.
+  // Create a font engine.  Rendered glyphs are cached for all fonts
+  // together, using at most <glyphCacheSize> bytes.
   SplashFontEngine(
 #if HAVE_T1LIB_H
 		   GBool enableT1lib,
@@ -58,7 +60,7 @@ public:
 		   GBool enableFreeType,
 		   GBool enableFreeTypeHinting,
 #endif
-		   GBool aa);
+		   GBool aa, int glyphCacheSize);
 
   ~SplashFontEngine();
 
@@ -86,9 +88,13 @@ public:
   SplashFont *getFont(SplashFontFile *fontFile,
 		      SplashCoord *textMat, SplashCoord *ctm);
 
+  // Get the glyph bitmap cache shared by all fonts.
+  SplashGlyphCache *getGlyphCache() { return glyphCache; }
+
 private:
 
   SplashFont *fontCache[splashFontCacheSize];
+  SplashGlyphCache *glyphCache;
 
 #if HAVE_T1LIB_H
   SplashT1FontEngine *t1Engine;
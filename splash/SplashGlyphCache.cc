@@ -0,0 +1,313 @@
+//========================================================================
+//
+// SplashGlyphCache.cc
+//
+//========================================================================
+
+#include <config.h>
+
+#ifdef USE_GCC_PRAGMAS
+#pragma implementation
+#endif
+
+#include <string.h>
+#include "goo/gmem.h"
+#include "SplashGlyphBitmap.h"
+#include "SplashFontFile.h"
+#include "SplashFontFileID.h"
+#include "SplashFont.h"
+#include "SplashGlyphCache.h"
+
+//------------------------------------------------------------------------
+
+// Initial number of hash table buckets (must be a power of 2).
+#define splashGlyphCacheInitialSize 256
+
+// Glyphs taking more than this fraction of the budget aren't cached.
+#define splashGlyphCacheMaxGlyphFraction 8
+
+struct SplashGlyphCacheFontFile {
+  SplashFontFile *fontFile;
+  int nGlyphs;			// number of cached glyphs using this file
+  SplashGlyphCacheFontFile *next;
+};
+
+struct SplashGlyphCacheEntry {
+  SplashGlyphCacheFontFile *file;
+  SplashFontFile *fontFile;	// key: font file, matrices, and AA of
+  SplashCoord mat[4];		//   the SplashFont ...
+  SplashCoord textMat[4];
+  GBool aa;
+  int c;			// ... plus character code and
+  short xFrac, yFrac;		//   fractional position
+  Guint hash;
+  int x, y, w, h;		// offset and size of glyph
+  int dataSize;			// size of glyph bitmap, in bytes
+  SplashGlyphCacheEntry *next;	// next entry in hash bucket
+  SplashGlyphCacheEntry *prev;	// more recently used entry
+  SplashGlyphCacheEntry *lruNext; // less recently used entry
+  // bitmap data follows
+};
+
+static inline Guchar *splashGlyphCacheData(SplashGlyphCacheEntry *entry) {
+  return (Guchar *)(entry + 1);
+}
+
+static inline Guint splashGlyphCacheHash(SplashFont *font, int c,
+					 int xFrac, int yFrac) {
+  Guint h;
+
+  h = (font->getGlyphCacheHash() ^ (Guint)c) * 2654435761u;
+  h ^= (Guint)((xFrac << splashFontFractionBits) | yFrac);
+  return h ^ (h >> 15);
+}
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+SplashGlyphCache::SplashGlyphCache(int maxBytesA) {
+  int i;
+
+  maxBytes = maxBytesA;
+  size = splashGlyphCacheInitialSize;
+  tab = (SplashGlyphCacheEntry **)gmallocn(size,
+					   sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < size; ++i) {
+    tab[i] = NULL;
+  }
+  mru = lru = NULL;
+  fontFiles = NULL;
+  bytes = 0;
+  nGlyphs = 0;
+  hits = misses = 0;
+}
+
+SplashGlyphCache::~SplashGlyphCache() {
+  clear();
+  gfree(tab);
+}
+
+GBool SplashGlyphCache::lookup(SplashFont *font, int c, int xFrac, int yFrac,
+			       SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry;
+  Guint h;
+
+  h = splashGlyphCacheHash(font, c, xFrac, yFrac);
+  for (entry = tab[h & (size - 1)]; entry; entry = entry->next) {
+    if (entry->hash == h &&
+	entry->c == c &&
+	entry->xFrac == xFrac &&
+	entry->yFrac == yFrac &&
+	entry->fontFile == font->fontFile &&
+	entry->aa == font->aa &&
+	entry->mat[0] == font->mat[0] && entry->mat[1] == font->mat[1] &&
+	entry->mat[2] == font->mat[2] && entry->mat[3] == font->mat[3] &&
+	entry->textMat[0] == font->textMat[0] &&
+	entry->textMat[1] == font->textMat[1] &&
+	entry->textMat[2] == font->textMat[2] &&
+	entry->textMat[3] == font->textMat[3]) {
+      break;
+    }
+  }
+  if (!entry) {
+    ++misses;
+    return gFalse;
+  }
+  ++hits;
+
+  // move to the front of the LRU list
+  if (entry != mru) {
+    unlink(entry);
+    entry->prev = NULL;
+    entry->lruNext = mru;
+    mru->prev = entry;
+    mru = entry;
+  }
+
+  bitmap->x = entry->x;
+  bitmap->y = entry->y;
+  bitmap->w = entry->w;
+  bitmap->h = entry->h;
+  bitmap->aa = entry->aa;
+  bitmap->data = splashGlyphCacheData(entry);
+  bitmap->freeData = gFalse;
+  return gTrue;
+}
+
+Guchar *SplashGlyphCache::add(SplashFont *font, int c, int xFrac, int yFrac,
+			      SplashGlyphBitmap *bitmap) {
+  SplashGlyphCacheEntry *entry;
+  int dataSize, cost, i;
+  Guint h;
+
+  if (!bitmap->data) {
+    return NULL;
+  }
+  if (bitmap->aa) {
+    dataSize = bitmap->w * bitmap->h;
+  } else {
+    dataSize = ((bitmap->w + 7) >> 3) * bitmap->h;
+  }
+  cost = (int)sizeof(SplashGlyphCacheEntry) + dataSize;
+  if (dataSize < 0 || cost > maxBytes / splashGlyphCacheMaxGlyphFraction) {
+    return NULL;
+  }
+
+  // drop the least recently used glyphs
+  while (bytes + cost > maxBytes && lru) {
+    entry = lru;
+    unlink(entry);
+    freeEntry(entry);
+  }
+
+  h = splashGlyphCacheHash(font, c, xFrac, yFrac);
+  entry = (SplashGlyphCacheEntry *)gmalloc(cost);
+  entry->file = getFontFile(font->fontFile);
+  ++entry->file->nGlyphs;
+  entry->fontFile = font->fontFile;
+  for (i = 0; i < 4; ++i) {
+    entry->mat[i] = font->mat[i];
+    entry->textMat[i] = font->textMat[i];
+  }
+  entry->aa = font->aa;
+  entry->c = c;
+  entry->xFrac = (short)xFrac;
+  entry->yFrac = (short)yFrac;
+  entry->hash = h;
+  entry->x = bitmap->x;
+  entry->y = bitmap->y;
+  entry->w = bitmap->w;
+  entry->h = bitmap->h;
+  entry->dataSize = dataSize;
+  memcpy(splashGlyphCacheData(entry), bitmap->data, dataSize);
+
+  if (nGlyphs >= size) {
+    expandTable();
+  }
+  entry->next = tab[h & (size - 1)];
+  tab[h & (size - 1)] = entry;
+  entry->prev = NULL;
+  entry->lruNext = mru;
+  if (mru) {
+    mru->prev = entry;
+  } else {
+    lru = entry;
+  }
+  mru = entry;
+  bytes += cost;
+  ++nGlyphs;
+
+  return splashGlyphCacheData(entry);
+}
+
+void SplashGlyphCache::clear() {
+  SplashGlyphCacheEntry *entry, *next;
+  SplashGlyphCacheFontFile *file, *nextFile;
+  int i;
+
+  for (entry = mru; entry; entry = next) {
+    next = entry->lruNext;
+    gfree(entry);
+  }
+  for (i = 0; i < size; ++i) {
+    tab[i] = NULL;
+  }
+  for (file = fontFiles; file; file = nextFile) {
+    nextFile = file->next;
+    file->fontFile->decRefCnt();
+    gfree(file);
+  }
+  mru = lru = NULL;
+  fontFiles = NULL;
+  bytes = 0;
+  nGlyphs = 0;
+}
+
+SplashFontFile *SplashGlyphCache::findFontFile(SplashFontFileID *id) {
+  SplashGlyphCacheFontFile *file;
+
+  for (file = fontFiles; file; file = file->next) {
+    if (file->fontFile->getID()->matches(id)) {
+      return file->fontFile;
+    }
+  }
+  return NULL;
+}
+
+// Find or create the font file record for <fontFile>.
+SplashGlyphCacheFontFile *SplashGlyphCache::getFontFile(
+					     SplashFontFile *fontFile) {
+  SplashGlyphCacheFontFile *file;
+
+  for (file = fontFiles; file; file = file->next) {
+    if (file->fontFile == fontFile) {
+      return file;
+    }
+  }
+  file = (SplashGlyphCacheFontFile *)gmalloc(sizeof(SplashGlyphCacheFontFile));
+  file->fontFile = fontFile;
+  file->fontFile->incRefCnt();
+  file->nGlyphs = 0;
+  file->next = fontFiles;
+  fontFiles = file;
+  return file;
+}
+
+// Remove <entry> from the LRU list.
+void SplashGlyphCache::unlink(SplashGlyphCacheEntry *entry) {
+  if (entry->prev) {
+    entry->prev->lruNext = entry->lruNext;
+  } else {
+    mru = entry->lruNext;
+  }
+  if (entry->lruNext) {
+    entry->lruNext->prev = entry->prev;
+  } else {
+    lru = entry->prev;
+  }
+}
+
+// Remove <entry>, which has already been unlinked from the LRU list,
+// from the hash table and free it.  The font file is released along
+// with its last glyph.
+void SplashGlyphCache::freeEntry(SplashGlyphCacheEntry *entry) {
+  SplashGlyphCacheEntry **p;
+  SplashGlyphCacheFontFile **q, *file;
+
+  for (p = &tab[entry->hash & (size - 1)]; *p != entry; p = &(*p)->next) ;
+  *p = entry->next;
+  bytes -= (int)sizeof(SplashGlyphCacheEntry) + entry->dataSize;
+  --nGlyphs;
+  file = entry->file;
+  if (--file->nGlyphs == 0) {
+    for (q = &fontFiles; *q != file; q = &(*q)->next) ;
+    *q = file->next;
+    file->fontFile->decRefCnt();
+    gfree(file);
+  }
+  gfree(entry);
+}
+
+void SplashGlyphCache::expandTable() {
+  SplashGlyphCacheEntry **oldTab;
+  SplashGlyphCacheEntry *entry, *next;
+  int oldSize, i;
+
+  oldSize = size;
+  oldTab = tab;
+  size *= 2;
+  tab = (SplashGlyphCacheEntry **)gmallocn(size,
+					   sizeof(SplashGlyphCacheEntry *));
+  for (i = 0; i < size; ++i) {
+    tab[i] = NULL;
+  }
+  for (i = 0; i < oldSize; ++i) {
+    for (entry = oldTab[i]; entry; entry = next) {
+      next = entry->next;
+      entry->next = tab[entry->hash & (size - 1)];
+      tab[entry->hash & (size - 1)] = entry;
+    }
+  }
+  gfree(oldTab);
+}
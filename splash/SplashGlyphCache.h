@@ -0,0 +1,87 @@
+//========================================================================
+//
+// SplashGlyphCache.h
+//
+//========================================================================
+
+#ifndef SPLASHGLYPHCACHE_H
+#define SPLASHGLYPHCACHE_H
+
+#ifdef USE_GCC_PRAGMAS
+#pragma interface
+#endif
+
+#include "goo/gtypes.h"
+#include "SplashTypes.h"
+
+struct SplashGlyphBitmap;
+struct SplashGlyphCacheEntry;
+struct SplashGlyphCacheFontFile;
+class SplashFont;
+class SplashFontFile;
+class SplashFontFileID;
+
+//------------------------------------------------------------------------
+// SplashGlyphCache
+//------------------------------------------------------------------------
+
+// Cache of rendered glyph bitmaps, shared by all the fonts of a
+// SplashFontEngine.  Glyphs are keyed by font file, font and text
+// matrices, anti-aliasing, character code, and fractional position.
+// The least recently used glyphs are dropped when the bitmaps exceed
+// the byte budget.  The cache holds a reference to each font file it
+// has glyphs for, so glyphs survive their SplashFont (or font file)
+// being dropped from the engine's font cache.
+class SplashGlyphCache {
+public:
+
+  // Create a cache holding at most <maxBytesA> bytes of glyph
+  // bitmaps.  A size of zero disables the cache.
+  SplashGlyphCache(int maxBytesA);
+
+  ~SplashGlyphCache();
+
+  // Look up a glyph.  If it is cached, fill in <bitmap> (pointing at
+  // the cached data, which stays valid until the next call to add)
+  // and return true.
+  GBool lookup(SplashFont *font, int c, int xFrac, int yFrac,
+	       SplashGlyphBitmap *bitmap);
+
+  // Add a copy of <bitmap> to the cache, dropping old glyphs as
+  // needed.  Returns a pointer to the cached data, or NULL if the
+  // glyph is too big to be cached.
+  Guchar *add(SplashFont *font, int c, int xFrac, int yFrac,
+	      SplashGlyphBitmap *bitmap);
+
+  // Drop all cached glyphs.
+  void clear();
+
+  // Return a font file with cached glyphs that matches <id>, or NULL.
+  SplashFontFile *findFontFile(SplashFontFileID *id);
+
+  int getMaxBytes() { return maxBytes; }
+  int getBytes() { return bytes; }
+  int getNumGlyphs() { return nGlyphs; }
+  Guint getHits() { return hits; }
+  Guint getMisses() { return misses; }
+
+private:
+
+  SplashGlyphCacheFontFile *getFontFile(SplashFontFile *fontFile);
+  void freeEntry(SplashGlyphCacheEntry *entry);
+  void unlink(SplashGlyphCacheEntry *entry);
+  void expandTable();
+
+  SplashGlyphCacheEntry **tab;	// hash table
+  int size;			// number of buckets (a power of 2)
+  SplashGlyphCacheEntry *mru;	// most recently used glyph
+  SplashGlyphCacheEntry *lru;	// least recently used glyph
+  SplashGlyphCacheFontFile *	// font files with cached glyphs
+    fontFiles;
+  int maxBytes;			// byte budget
+  int bytes;			// bytes currently in use
+  int nGlyphs;			// number of cached glyphs
+  Guint hits, misses;		// lookup statistics
+};
+
+#endif
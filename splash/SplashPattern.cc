@@ -35,6 +35,7 @@ SplashSolidColor::SplashSolidColor(SplashColorPtr colorA) {
 SplashSolidColor::~SplashSolidColor() {
 }
 
-void SplashSolidColor::getColor(int x, int y, SplashColorPtr c) {
+GBool SplashSolidColor::getColor(int x, int y, SplashColorPtr c) {
   splashColorCopy(c, color);
+  return gTrue;
 }
@@ -28,8 +28,10 @@ public:
 
   virtual ~SplashPattern();
 
-  // Return the color value for a specific pixel.
-  virtual void getColor(int x, int y, SplashColorPtr c) = 0;
+  // Return the color value for a specific pixel.  Returns false if
+  // the pattern doesn't cover this pixel, in which case it is left
+  // unpainted.
+  virtual GBool getColor(int x, int y, SplashColorPtr c) = 0;
 
   // Returns true if this pattern object will return the same color
   // value for all pixels.
@@ -51,7 +53,7 @@ public:
 
   virtual ~SplashSolidColor();
 
-  virtual void getColor(int x, int y, SplashColorPtr c);
+  virtual GBool getColor(int x, int y, SplashColorPtr c);
 
   virtual GBool isStatic() { return gTrue; }
 
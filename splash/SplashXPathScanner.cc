@@ -39,6 +39,20 @@ struct SplashIntersect {
   int count;			// EO/NZWN counter increment
 };
 
+// An element of the active segment list.
+struct SplashActiveSeg {
+  int idx;			// index of the segment in the SplashXPath
+  int nextY;			// row whose top edge intersection is <xNext>
+  SplashCoord xNext;		// intersection with the top edge of row
+				//   <nextY>
+};
+
+// A span set by renderAALine.
+struct SplashAASpan {
+  int yy;			// row in the aaBuf
+  int x0, x1;			// [x0, x1) is inside the path
+};
+
 static int cmpIntersect(const void *p0, const void *p1) {
   return ((SplashIntersect *)p0)->x0 - ((SplashIntersect *)p1)->x0;
 }
@@ -104,13 +118,19 @@ SplashXPathScanner::SplashXPathScanner(SplashXPath *xPathA, GBool eoA) {
   }
 
   interY = yMin - 1;
-  xPathIdx = 0;
   inter = NULL;
   interLen = interSize = 0;
+  active = NULL;
+  activeLen = activeSize = 0;
+  nextSeg = 0;
+  aaSpans = NULL;
+  aaSpansLen = aaSpansSize = 0;
 }
 
 SplashXPathScanner::~SplashXPathScanner() {
   gfree(inter);
+  gfree(active);
+  gfree(aaSpans);
 }
 
 void SplashXPathScanner::getBBoxAA(int *xMinA, int *yMinA,
@@ -209,24 +229,37 @@ GBool SplashXPathScanner::getNextSpan(int y, int *x0, int *x1) {
   return gTrue;
 }
 
+// The segments are sorted by their min y value, so the segments which
+// intersect [y, y+1) are kept in an active list: going down the page,
+// segments are added when y reaches their min y and dropped when it
+// passes their max y, instead of scanning all of the segments above y
+// for every row.  The list stays in <xPath> order, so the intersections
+// are the same as those from a scan of the whole path.  Moving up the
+// page rebuilds the list.
 void SplashXPathScanner::computeIntersections(int y) {
   SplashCoord xSegMin, xSegMax, ySegMin, ySegMax, xx0, xx1;
   SplashXPathSeg *seg;
+  SplashActiveSeg *act;
   int i, j;
 
-  // find the first segment that intersects [y, y+1)
-  i = (y >= interY) ? xPathIdx : 0;
-  while (i < xPath->length &&
-	 xPath->segs[i].y0 < y && xPath->segs[i].y1 < y) {
-    ++i;
+  // drop the segments which end above y
+  if (y < interY) {
+    activeLen = 0;
+    nextSeg = 0;
   }
-  xPathIdx = i;
+  for (i = j = 0; i < activeLen; ++i) {
+    seg = &xPath->segs[active[i].idx];
+    ySegMax = (seg->flags & splashXPathFlip) ? seg->y0 : seg->y1;
+    if (ySegMax >= y) {
+      active[j++] = active[i];
+    }
+  }
+  activeLen = j;
 
-  // find all of the segments that intersect [y, y+1) and create an
-  // Intersect element for each one
-  interLen = 0;
-  for (j = i; j < xPath->length; ++j) {
-    seg = &xPath->segs[j];
+  // add the segments which start in [y, y+1) (or above it, after a
+  // jump down the page)
+  for (; nextSeg < xPath->length; ++nextSeg) {
+    seg = &xPath->segs[nextSeg];
     if (seg->flags & splashXPathFlip) {
       ySegMin = seg->y1;
       ySegMax = seg->y0;
@@ -234,24 +267,47 @@ void SplashXPathScanner::computeIntersections(int y) {
       ySegMin = seg->y0;
       ySegMax = seg->y1;
     }
-
-    // ensure that:      ySegMin < y+1
-    //              y <= ySegMax
     if (ySegMin >= y + 1) {
       break;
     }
     if (ySegMax < y) {
       continue;
     }
-
-    if (interLen == interSize) {
-      if (interSize == 0) {
-	interSize = 16;
+    if (activeLen == activeSize) {
+      if (activeSize == 0) {
+	activeSize = 16;
       } else {
-	interSize *= 2;
+	activeSize *= 2;
       }
-      inter = (SplashIntersect *)greallocn(inter, interSize,
-					   sizeof(SplashIntersect));
+      active = (SplashActiveSeg *)greallocn(active, activeSize,
+					    sizeof(SplashActiveSeg));
+    }
+    active[activeLen].idx = nextSeg;
+    active[activeLen].nextY = y - 1;
+    ++activeLen;
+  }
+
+  // create an Intersect element for each active segment
+  if (activeLen > interSize) {
+    if (interSize == 0) {
+      interSize = 16;
+    }
+    while (interSize < activeLen) {
+      interSize *= 2;
+    }
+    inter = (SplashIntersect *)greallocn(inter, interSize,
+					 sizeof(SplashIntersect));
+  }
+  interLen = 0;
+  for (j = 0; j < activeLen; ++j) {
+    act = &active[j];
+    seg = &xPath->segs[act->idx];
+    if (seg->flags & splashXPathFlip) {
+      ySegMin = seg->y1;
+      ySegMax = seg->y0;
+    } else {
+      ySegMin = seg->y0;
+      ySegMax = seg->y1;
     }
 
     if (seg->flags & splashXPathHoriz) {
@@ -267,10 +323,17 @@ void SplashXPathScanner::computeIntersections(int y) {
 	xSegMin = seg->x1;
 	xSegMax = seg->x0;
       }
-      // intersection with top edge
-      xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+      // intersection with top edge -- this is the bottom edge
+      // intersection from the previous row, if that was y-1
+      if (act->nextY == y) {
+	xx0 = act->xNext;
+      } else {
+	xx0 = seg->x0 + ((SplashCoord)y - seg->y0) * seg->dxdy;
+      }
       // intersection with bottom edge
       xx1 = seg->x0 + ((SplashCoord)y + 1 - seg->y0) * seg->dxdy;
+      act->xNext = xx1;
+      act->nextY = y + 1;
       // the segment may not actually extend to the top and/or bottom edges
       if (xx0 < xSegMin) {
 	xx0 = xSegMin;
@@ -310,13 +373,14 @@ void SplashXPathScanner::computeIntersections(int y) {
 
 void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
 				      int *x0, int *x1, int y) {
-  int xx0, xx1, xx, xxMin, xxMax, yy;
+  int xx0, xx1, xx, xxMin, xxMax, yy, b0, b1, i;
   Guchar mask;
   SplashColorPtr p;
 
-  memset(aaBuf->getDataPtr(), 0, aaBuf->getRowSize() * aaBuf->getHeight());
+  // find the spans in the four rows
   xxMin = aaBuf->getWidth();
   xxMax = -1;
+  aaSpansLen = 0;
   for (yy = 0; yy < splashAASize; ++yy) {
     computeIntersections(splashAASize * y + yy);
     while (interIdx < interLen) {
@@ -340,24 +404,20 @@ void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
       if (xx1 > aaBuf->getWidth()) {
 	xx1 = aaBuf->getWidth();
       }
-      // set [xx0, xx1) to 1
       if (xx0 < xx1) {
-	xx = xx0;
-	p = aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + (xx >> 3);
-	if (xx & 7) {
-	  mask = 0xff >> (xx & 7);
-	  if ((xx & ~7) == (xx1 & ~7)) {
-	    mask &= (Guchar)(0xff00 >> (xx1 & 7));
+	if (aaSpansLen == aaSpansSize) {
+	  if (aaSpansSize == 0) {
+	    aaSpansSize = 16;
+	  } else {
+	    aaSpansSize *= 2;
 	  }
-	  *p++ |= mask;
-	  xx = (xx & ~7) + 8;
-	}
-	for (; xx + 7 < xx1; xx += 8) {
-	  *p++ |= 0xff;
-	}
-	if (xx < xx1) {
-	  *p |= (Guchar)(0xff00 >> (xx1 & 7));
+	  aaSpans = (SplashAASpan *)greallocn(aaSpans, aaSpansSize,
+					      sizeof(SplashAASpan));
 	}
+	aaSpans[aaSpansLen].yy = yy;
+	aaSpans[aaSpansLen].x0 = xx0;
+	aaSpans[aaSpansLen].x1 = xx1;
+	++aaSpansLen;
       }
       if (xx0 < xxMin) {
 	xxMin = xx0;
@@ -369,11 +429,48 @@ void SplashXPathScanner::renderAALine(SplashBitmap *aaBuf,
   }
   *x0 = xxMin / splashAASize;
   *x1 = (xxMax - 1) / splashAASize;
+
+  // clear the bytes holding pixels <x0>..<x1> -- nothing outside of
+  // them is read, so this doesn't need to clear the whole line
+  b0 = *x0 < 0 ? 0 : *x0 >> 1;
+  b1 = *x1 >> 1;
+  if (b1 >= aaBuf->getRowSize()) {
+    b1 = aaBuf->getRowSize() - 1;
+  }
+  if (b0 <= b1) {
+    for (yy = 0; yy < splashAASize; ++yy) {
+      memset(aaBuf->getDataPtr() + yy * aaBuf->getRowSize() + b0, 0,
+	     b1 - b0 + 1);
+    }
+  }
+
+  // set [xx0, xx1) to 1 for each span
+  for (i = 0; i < aaSpansLen; ++i) {
+    xx = xx0 = aaSpans[i].x0;
+    xx1 = aaSpans[i].x1;
+    p = aaBuf->getDataPtr() + aaSpans[i].yy * aaBuf->getRowSize() + (xx >> 3);
+    if (xx & 7) {
+      mask = 0xff >> (xx & 7);
+      if ((xx & ~7) == (xx1 & ~7)) {
+	mask &= (Guchar)(0xff00 >> (xx1 & 7));
+      }
+      *p++ |= mask;
+      xx = (xx & ~7) + 8;
+    }
+    if (xx + 7 < xx1) {
+      memset(p, 0xff, (xx1 - xx) >> 3);
+      p += (xx1 - xx) >> 3;
+      xx += (xx1 - xx) & ~7;
+    }
+    if (xx < xx1) {
+      *p |= (Guchar)(0xff00 >> (xx1 & 7));
+    }
+  }
 }
 
 void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf,
 				    int *x0, int *x1, int y) {
-  int xx0, xx1, xx, yy;
+  int xx0, xx1, xx, yy, n;
   Guchar mask;
   SplashColorPtr p;
 
@@ -408,8 +505,11 @@ void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf,
 	  *p++ &= mask;
 	  xx = (xx & ~7) + 8;
 	}
-	for (; xx + 7 <= xx0; xx += 8) {
-	  *p++ = 0x00;
+	if (xx + 7 <= xx0) {
+	  n = (xx0 - xx + 1) >> 3;
+	  memset(p, 0, n);
+	  p += n;
+	  xx += n << 3;
 	}
 	if (xx < xx0) {
 	  *p &= 0xff >> (xx0 & 7);
@@ -432,8 +532,11 @@ void SplashXPathScanner::clipAALine(SplashBitmap *aaBuf,
 	*p++ &= mask;
 	xx = (xx & ~7) + 8;
       }
-      for (; xx + 7 <= xx0; xx += 8) {
-	*p++ = 0x00;
+      if (xx + 7 <= xx0) {
+	n = (xx0 - xx + 1) >> 3;
+	memset(p, 0, n);
+	p += n;
+	xx += n << 3;
       }
       if (xx < xx0) {
 	*p &= 0xff >> (xx0 & 7);
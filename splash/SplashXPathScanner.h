@@ -16,6 +16,8 @@
 class SplashXPath;
 class SplashBitmap;
 struct SplashIntersect;
+struct SplashActiveSeg;
+struct SplashAASpan;
 
 //------------------------------------------------------------------------
 // SplashXPathScanner
@@ -75,8 +77,15 @@ private:
 				//   getNextSpan 
   int interCount;		// current EO/NZWN counter - used by
 				//   getNextSpan
-  int xPathIdx;			// current index into <xPath> - used by
-				//   computeIntersections
+  SplashActiveSeg *active;	// segments which intersect <interY>, in
+				//   <xPath> order
+  int activeLen;		// number of segments in <active>
+  int activeSize;		// size of the <active> array
+  int nextSeg;			// next segment in <xPath> to be added to
+				//   <active>
+  SplashAASpan *aaSpans;	// spans found by renderAALine
+  int aaSpansLen;		// number of spans in <aaSpans>
+  int aaSpansSize;		// size of the <aaSpans> array
   SplashIntersect *inter;	// intersections array for <interY>
   int interLen;			// number of intersections in <inter>
   int interSize;		// size of the <inter> array
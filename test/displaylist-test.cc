@@ -0,0 +1,168 @@
+//========================================================================
+//
+// displaylist-test.cc
+//
+// Check that replaying a DisplayList gives the same bitmap as
+// displaying the page directly, at the resolution the list was
+// recorded at and at others.
+//
+// This file is licensed under the GPLv2 or later
+//
+//========================================================================
+
+#include "config.h"
+#include <poppler-config.h>
+#include <stdio.h>
+#include <string.h>
+#include "goo/GooString.h"
+#include "GlobalParams.h"
+#include "Object.h"
+#include "Stream.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "DisplayListOutputDev.h"
+#include "splash/SplashBitmap.h"
+
+// resolution the display lists are recorded at
+#define recordDPI 150
+
+// resolutions they are replayed at
+static double replayDPIs[] = { 24, 36, 50, 72, 96, 150, 300 };
+#define nReplayDPIs ((int)(sizeof(replayDPIs) / sizeof(double)))
+
+#define nPages 2
+
+// Content of page <pageNum>: rules and thin strokes at fractional
+// positions, each under its own CTM, so that some of their edges fall
+// exactly on pixel boundaries at some resolution.
+static GooString *makeContent(int pageNum) {
+  GooString *s;
+  int i;
+
+  s = new GooString();
+  for (i = 0; i < 200; ++i) {
+    s->appendf("q 1 0 0 1 {0:.3f} {1:.3f} cm ",
+	       36 + (i % 10) * 54.3, 40 + (i / 10) * 36.15);
+    if (pageNum == 1) {
+      s->appendf("0 0 {0:.3f} {1:.3f} re f Q\n",
+		 30 + (i % 7) * 1.25, 0.4 + (i % 5) * 0.2);
+    } else {
+      s->appendf("{0:.2f} w 0 0 m {1:.3f} {2:.3f} l S Q\n",
+		 0.3 + (i % 4) * 0.15, 30 + (i % 7) * 1.25,
+		 (i % 3) * 0.5);
+    }
+  }
+  return s;
+}
+
+// Build a PDF file with nPages pages.
+static GooString *makePDF() {
+  GooString *pdf, *content;
+  int offsets[2 + 2 * nPages];
+  int nObjs, i;
+
+  pdf = new GooString("%PDF-1.4\n");
+  nObjs = 2 + 2 * nPages;
+  offsets[0] = pdf->getLength();
+  pdf->append("1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+  offsets[1] = pdf->getLength();
+  pdf->appendf("2 0 obj\n<< /Type /Pages /Count {0:d} /Kids [", nPages);
+  for (i = 0; i < nPages; ++i) {
+    pdf->appendf(" {0:d} 0 R", 3 + 2 * i);
+  }
+  pdf->append(" ] >>\nendobj\n");
+  for (i = 0; i < nPages; ++i) {
+    content = makeContent(i + 1);
+    offsets[2 + 2 * i] = pdf->getLength();
+    pdf->appendf("{0:d} 0 obj\n<< /Type /Page /Parent 2 0 R"
+		 " /MediaBox [0 0 612 792] /Contents {1:d} 0 R >>\nendobj\n",
+		 3 + 2 * i, 4 + 2 * i);
+    offsets[3 + 2 * i] = pdf->getLength();
+    pdf->appendf("{0:d} 0 obj\n<< /Length {1:d} >>\nstream\n",
+		 4 + 2 * i, content->getLength());
+    pdf->append(content);
+    pdf->append("\nendstream\nendobj\n");
+    delete content;
+  }
+  i = pdf->getLength();
+  pdf->appendf("xref\n0 {0:d}\n0000000000 65535 f \n", nObjs + 1);
+  for (int j = 0; j < nObjs; ++j) {
+    pdf->appendf("{0:010d} 00000 n \n", offsets[j]);
+  }
+  pdf->appendf("trailer\n<< /Size {0:d} /Root 1 0 R >>\n"
+	       "startxref\n{1:d}\n%EOF\n", nObjs + 1, i);
+  return pdf;
+}
+
+static SplashOutputDev *makeOutputDev(PDFDoc *doc) {
+  SplashOutputDev *out;
+  SplashColor paperColor;
+
+  paperColor[0] = paperColor[1] = paperColor[2] = 0xff;
+  out = new SplashOutputDev(splashModeRGB8, 4, gFalse, paperColor);
+  out->startDoc(doc->getXRef());
+  return out;
+}
+
+static GBool sameBitmaps(SplashBitmap *bmp1, SplashBitmap *bmp2) {
+  if (bmp1->getWidth() != bmp2->getWidth() ||
+      bmp1->getHeight() != bmp2->getHeight() ||
+      bmp1->getRowSize() != bmp2->getRowSize()) {
+    return gFalse;
+  }
+  return !memcmp(bmp1->getDataPtr(), bmp2->getDataPtr(),
+		 bmp1->getRowSize() * bmp1->getHeight());
+}
+
+int main(int argc, char *argv[]) {
+  GooString *pdf;
+  Object obj;
+  PDFDoc *doc;
+  DisplayListOutputDev *recorder;
+  DisplayList *list;
+  SplashOutputDev *direct, *replay;
+  int nFailed, pg, i;
+
+  globalParams = new GlobalParams();
+  pdf = makePDF();
+  obj.initNull();
+  doc = new PDFDoc(new MemStream(pdf->getCString(), 0, pdf->getLength(),
+				 &obj), NULL, NULL);
+  if (!doc->isOk()) {
+    fprintf(stderr, "Error loading the test document\n");
+    return 1;
+  }
+
+  nFailed = 0;
+  recorder = new DisplayListOutputDev();
+  for (pg = 1; pg <= doc->getNumPages(); ++pg) {
+    doc->displayPage(recorder, pg, recordDPI, recordDPI, 0,
+		     gFalse, gTrue, gFalse);
+    if (!(list = recorder->takeDisplayList())) {
+      fprintf(stderr, "page %d: no display list\n", pg);
+      ++nFailed;
+      continue;
+    }
+    for (i = 0; i < nReplayDPIs; ++i) {
+      direct = makeOutputDev(doc);
+      doc->displayPage(direct, pg, replayDPIs[i], replayDPIs[i], 0,
+		       gFalse, gTrue, gFalse);
+      replay = makeOutputDev(doc);
+      list->replay(replay, replayDPIs[i], replayDPIs[i]);
+      if (!sameBitmaps(direct->getBitmap(), replay->getBitmap())) {
+	fprintf(stderr, "page %d at %g dpi: replayed bitmap differs\n",
+		pg, replayDPIs[i]);
+	++nFailed;
+      }
+      delete replay;
+      delete direct;
+    }
+    delete list;
+  }
+  delete recorder;
+
+  delete doc;
+  delete pdf;
+  delete globalParams;
+  return nFailed ? 1 : 0;
+}
@@ -39,6 +39,7 @@
 #include <string.h>
 #include <errno.h>
 #include <time.h>
+#include <math.h>
 
 #ifdef HAVE_DIRENT_H
 #include <dirent.h>
@@ -50,11 +51,20 @@
 #include "goo/GooList.h"
 #include "goo/GooTimer.h"
 #include "GlobalParams.h"
+#include "Function.h"
+#include "GfxState.h"
 #include "splash/SplashBitmap.h"
+#include "splash/Splash.h"
+#include "splash/SplashPath.h"
+#include "splash/SplashPattern.h"
+#include "splash/SplashFontEngine.h"
+#include "splash/SplashGlyphCache.h"
 #include "Object.h" /* must be included before SplashOutputDev.h because of sloppiness in SplashOutputDev.h */
 #include "SplashOutputDev.h"
 #include "TextOutputDev.h"
+#include "DisplayListOutputDev.h"
 #include "PDFDoc.h"
+#include "XRef.h"
 #include "Link.h"
 
 #ifdef _MSC_VER
@@ -92,6 +102,7 @@ public:
     SplashBitmap *renderBitmap(int pageNo, double zoomReal, int rotation);
 
     SplashOutputDev *   outputDevice();
+    PDFDoc *            pdfDoc() { return _pdfDoc; }
 private:
     char *              _fileName;
     int                 _pageCount;
@@ -123,6 +134,17 @@ static StrList *gArgsListRoot = NULL;
 #define LOAD_ONLY_ARG       "-loadonly"
 #define PAGE_ARG            "-page"
 #define TEXT_ARG            "-text"
+#define STREAMS_ARG         "-streams"
+#define PREDICTORS_ARG      "-predictors"
+#define PROGRESSIVE_ARG     "-progressive"
+#define BANDS_ARG           "-bands"
+#define DISPLAY_LIST_ARG    "-displaylist"
+#define AA_FILL_ARG         "-aafill"
+#define HUGE_PATHS_ARG      "-hugepaths"
+#define PS_FUNCTIONS_ARG    "-psfunctions"
+#define IMAGE_LINES_ARG     "-imagelines"
+#define GLYPH_CACHE_ARG     "-glyphcache"
+#define DICT_LOOKUP_ARG     "-dictlookup"
 
 /* Should we record timings? True if -timings command-line argument was given. */
 static bool gfTimings = false;
@@ -164,6 +186,70 @@ static bool gfSlowPreview = false;
 /* If true, we only dump the text, not render */
 static bool gfTextOnly = false;
 
+/* If true, we don't render but decode every stream object in the file and
+   report the decoding throughput.
+   Controlled by -streams command-line argument. */
+static bool gfStreamsOnly = false;
+
+/* If true, we decode synthetic Flate streams with PNG and TIFF predictors
+   and report the decoding throughput. Doesn't need any pdf files.
+   Controlled by -predictors command-line argument. */
+static bool gfPredictorsOnly = false;
+
+/* If true, we open the file through a ByteRangeStream which only gets
+   the parts of the file that were asked for, after a delay, and render
+   the first page (or the one given with -page).
+   Controlled by -progressive command-line argument. */
+static bool gfProgressive = false;
+
+/* If not 0, we render each page with 1, 2, 4, ... up to this many threads
+   rasterizing horizontal bands of the page, report the times (of the
+   whole page, and of rasterizing the bands recorded up to the end of the
+   page) and check that the bitmaps are the same as the one rendered with
+   one thread.
+   Controlled by -bands N command-line argument. */
+static int gBandThreads = 0;
+
+/* If true, we render each page at two resolutions, once directly and once
+   by recording a display list and replaying it twice, report the times
+   and check that the bitmaps are the same.
+   Controlled by -displaylist command-line argument. */
+static bool gfDisplayList = false;
+
+/* If true, we draw synthetic dense vector maps and CAD drawings with
+   anti-aliasing and report the times. Doesn't need any pdf files.
+   Controlled by -aafill command-line argument. */
+static bool gfAAFillOnly = false;
+
+/* If true, we fill with, and clip to, generated contour map paths of
+   1000 up to 1000000 segments and report the times, to check that they
+   grow linearly with the number of segments. Doesn't need any pdf files.
+   Controlled by -hugepaths command-line argument. */
+static bool gfHugePathsOnly = false;
+
+/* If true, we evaluate a few PostScript calculator (type 4) functions
+   like the tint transforms of Separation and DeviceN color spaces, and
+   report the time per call. Doesn't need any pdf files.
+   Controlled by -psfunctions command-line argument. */
+static bool gfPSFunctionsOnly = false;
+
+/* If true, we convert lines of image samples in a few color spaces to RGB,
+   a pixel at a time and a line at a time, and report the time per pixel.
+   Doesn't need any pdf files.
+   Controlled by -imagelines command-line argument. */
+static bool gfImageLinesOnly = false;
+
+/* If true, we look up keys in dictionaries of various sizes, like the
+   /Font and /XObject resource dictionaries, and report the time per
+   lookup. Doesn't need any pdf files.
+   Controlled by -dictlookup command-line argument. */
+static bool gfDictLookupOnly = false;
+
+/* Size of the glyph bitmap cache in bytes, or -1 to use the default.
+   With -timings, the glyph cache hits and misses are reported for each
+   file. Controlled by -glyphcache command-line argument. */
+static int gGlyphCacheSize = -1;
+
 #define PAGE_NO_NOT_GIVEN -1
 
 /* If equals PAGE_NO_NOT_GIVEN, we're in default mode where we render all pages.
@@ -303,7 +389,7 @@ void sleep_milliseconds(int milliseconds)
     struct timespec tv;
     int             secs, nanosecs;
     secs = milliseconds / 1000;
-    nanosecs = (milliseconds - (secs * 1000)) * 1000;
+    nanosecs = (milliseconds - (secs * 1000)) * 1000000;
     tv.tv_sec = (time_t) secs;
     tv.tv_nsec = (long) nanosecs;
     while (1)
@@ -810,7 +896,7 @@ void LogInfo(char *fmt, ...)
 
 static void PrintUsageAndExit(int argc, char **argv)
 {
-    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
+    printf("Usage: pdftest [-preview|-slowpreview] [-loadonly] [-timings] [-text] [-streams] [-predictors] [-progressive] [-bands N] [-displaylist] [-aafill] [-hugepaths] [-psfunctions] [-imagelines] [-dictlookup] [-glyphcache N] [-resolution NxM] [-recursive] [-page N] [-out out.txt] pdf-files-to-process\n");
     for (int i=0; i < argc; i++) {
         printf("i=%d, '%s'\n", i, argv[i]);
     }
@@ -951,13 +1037,1120 @@ static void RenderPdf(const char *fileName)
         }
         delete bmpSplash;
     }
+    if (gfTimings) {
+        SplashGlyphCache *glyphCache = engineSplash->outputDevice()->getFontEngine()->getGlyphCache();
+        LogInfo("glyph cache: %u hits, %u misses, %d glyphs in %d bytes\n",
+                glyphCache->getHits(), glyphCache->getMisses(),
+                glyphCache->getNumGlyphs(), glyphCache->getBytes());
+        XRef *xref = engineSplash->pdfDoc()->getXRef();
+        LogInfo("object stream cache: %u hits, %u rebuilds, %d streams in %d bytes\n",
+                xref->getObjStrHits(), xref->getObjStrRebuilds(),
+                xref->getObjStrCacheLength(), xref->getObjStrCacheBytes());
+        LogInfo("object cache: %u hits, %u misses, %d objects in %d bytes\n",
+                xref->getObjCacheHits(), xref->getObjCacheMisses(),
+                xref->getObjCacheLength(), xref->getObjCacheBytes());
+    }
 Error:
     delete engineSplash;
     LogInfo("finished: %s\n", fileName);
 }
 
+#define DECODE_BUF_SIZE 65536
+
+/* Decode every stream object in the file with Stream::getChars(), the way
+   the image and content stream readers do. Reports bytes/second for all
+   streams and separately for the ones whose outermost filter is Flate. */
+static void DecodePdfStreams(const char *fileName)
+{
+    static Guchar       buf[DECODE_BUF_SIZE];
+    PDFDoc *            pdfDoc;
+    XRef *              xref;
+    XRefEntry *         entry;
+    Object              obj;
+    Stream *            str;
+    int                 streamCount = 0, flateCount = 0;
+    double              totalBytes = 0, flateBytes = 0;
+    double              timeInSecs, flateSecs = 0;
+    int                 n;
+    double              bytes;
+
+    LogInfo("started: %s\n", fileName);
+
+    /* note: PDFDoc takes ownership of the GooString */
+    pdfDoc = new PDFDoc(new GooString(fileName), NULL, NULL, NULL);
+    if (!pdfDoc->isOk()) {
+        error(-1, "DecodePdfStreams(): failed to open PDF file %s\n", fileName);
+        goto Exit;
+    }
+    xref = pdfDoc->getXRef();
+
+    {
+        GooTimer totalTimer;
+        for (int num = 0; num < xref->getNumObjects(); num++) {
+            entry = xref->getEntry(num);
+            if (entry->type == xrefEntryFree)
+                continue;
+            xref->fetch(num, entry->gen, &obj);
+            if (!obj.isStream()) {
+                obj.free();
+                continue;
+            }
+            str = obj.getStream();
+            GooTimer msTimer;
+            str->reset();
+            bytes = 0;
+            while ((n = str->getChars(DECODE_BUF_SIZE, buf)) > 0)
+                bytes += n;
+            str->close();
+            msTimer.stop();
+            ++streamCount;
+            totalBytes += bytes;
+            if (str->getKind() == strFlate) {
+                ++flateCount;
+                flateBytes += bytes;
+                flateSecs += msTimer.getElapsed();
+            }
+            obj.free();
+        }
+        totalTimer.stop();
+        timeInSecs = totalTimer.getElapsed();
+    }
+
+    LogInfo("streams: %d, %.0f bytes in %.2f ms (%.1f MB/s)\n",
+            streamCount, totalBytes, timeInSecs * 1000,
+            timeInSecs > 0 ? totalBytes / timeInSecs / 1e6 : 0);
+    LogInfo("flate streams: %d, %.0f bytes in %.2f ms (%.1f MB/s)\n",
+            flateCount, flateBytes, flateSecs * 1000,
+            flateSecs > 0 ? flateBytes / flateSecs / 1e6 : 0);
+
+Exit:
+    LogInfo("finished: %s\n", fileName);
+    delete pdfDoc;
+}
+
+#define PROGRESSIVE_BLOCK_SIZE  4096
+#define PROGRESSIVE_DELAY_MS    20
+#define PROGRESSIVE_MAX_TRIPS   10000
+
+/* Stand-in for a download: serves a file's bytes in blocks, but only
+   those that have been asked for and "arrived", which takes
+   PROGRESSIVE_DELAY_MS per round trip. */
+class DelayedFileProvider: public ByteRangeProvider {
+public:
+    DelayedFileProvider() : data(NULL), len(0), state(NULL), nBlocks(0), requested(0), arrived(0), trips(0) { }
+    virtual ~DelayedFileProvider() { free(data); free(state); }
+
+    bool load(const char *fileName);
+
+    virtual Guint getLength() { return len; }
+    virtual GBool hasRange(Guint start, Guint length);
+    virtual void requestRange(Guint start, Guint length);
+    virtual void readRange(Guint start, Guint length, char *buf) { memcpy(buf, data + start, length); }
+
+    /* Wait for the requested blocks to arrive. Returns false if
+       nothing was requested. */
+    bool waitForData();
+
+    int bytesArrived() const;
+    int roundTrips() const { return trips; }
+
+private:
+    enum { blockMissing, blockRequested, blockArrived };
+
+    char *      data;
+    Guint       len;
+    char *      state;
+    int         nBlocks;
+    int         requested;
+    int         arrived;
+    int         trips;
+};
+
+bool DelayedFileProvider::load(const char *fileName)
+{
+    FILE *f = fopen(fileName, "rb");
+    if (!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    len = (Guint)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (char*)malloc(len ? len : 1);
+    bool ok = data && fread(data, 1, len, f) == len;
+    fclose(f);
+    nBlocks = (len + PROGRESSIVE_BLOCK_SIZE - 1) / PROGRESSIVE_BLOCK_SIZE;
+    state = (char*)zmalloc(nBlocks ? nBlocks : 1);
+    return ok && state;
+}
+
+GBool DelayedFileProvider::hasRange(Guint start, Guint length)
+{
+    if (length == 0)
+        return gTrue;
+    for (Guint i = start / PROGRESSIVE_BLOCK_SIZE; i <= (start + length - 1) / PROGRESSIVE_BLOCK_SIZE; i++) {
+        if (state[i] != blockArrived)
+            return gFalse;
+    }
+    return gTrue;
+}
+
+void DelayedFileProvider::requestRange(Guint start, Guint length)
+{
+    if (length == 0)
+        return;
+    for (Guint i = start / PROGRESSIVE_BLOCK_SIZE; i <= (start + length - 1) / PROGRESSIVE_BLOCK_SIZE; i++) {
+        if (state[i] == blockMissing) {
+            state[i] = blockRequested;
+            requested++;
+        }
+    }
+}
+
+int DelayedFileProvider::bytesArrived() const
+{
+    int bytes = arrived * PROGRESSIVE_BLOCK_SIZE;
+    /* the last block is usually short */
+    if (nBlocks > 0 && state[nBlocks - 1] == blockArrived)
+        bytes -= nBlocks * PROGRESSIVE_BLOCK_SIZE - len;
+    return bytes;
+}
+
+bool DelayedFileProvider::waitForData()
+{
+    if (requested == 0)
+        return false;
+    sleep_milliseconds(PROGRESSIVE_DELAY_MS);
+    for (int i = 0; i < nBlocks; i++) {
+        if (state[i] == blockRequested) {
+            state[i] = blockArrived;
+            arrived++;
+        }
+    }
+    requested = 0;
+    trips++;
+    return true;
+}
+
+/* Open the file and render its first page through a ByteRangeStream
+   which only gets the bytes poppler asks for, the way a viewer showing a
+   pdf while it downloads would. Reports the time to the first page and
+   how much of the file had to be fetched. */
+static void RenderProgressive(const char *fileName)
+{
+    DelayedFileProvider provider;
+    PDFDoc *            pdfDoc = NULL;
+    SplashOutputDev *   outputDev = NULL;
+    SplashBitmap *      bmp = NULL;
+    Object              obj;
+    int                 pageNo;
+    Guint               missing;
+
+    LogInfo("started: %s\n", fileName);
+
+    if (!provider.load(fileName)) {
+        error(-1, "RenderProgressive(): failed to read file %s\n", fileName);
+        goto Exit;
+    }
+
+    {
+        GooTimer msTimer;
+
+        /* note: PDFDoc takes ownership of the stream */
+        while (1) {
+            obj.initNull();
+            pdfDoc = new PDFDoc(new ByteRangeStream(&provider, &obj), NULL, NULL, NULL);
+            if (pdfDoc->isOk() || pdfDoc->getErrorCode() != errDataNotAvailable ||
+                provider.roundTrips() >= PROGRESSIVE_MAX_TRIPS || !provider.waitForData())
+                break;
+            delete pdfDoc;
+        }
+        if (!pdfDoc->isOk()) {
+            error(-1, "RenderProgressive(): failed to open PDF file %s\n", fileName);
+            goto Exit;
+        }
+        LogInfo("load: %.2f ms, %d round trips, %d of %d bytes\n",
+                msTimer.getElapsed() * 1000, provider.roundTrips(),
+                provider.bytesArrived(), (int)provider.getLength());
+
+        pageNo = (gPageNo != PAGE_NO_NOT_GIVEN) ? gPageNo : 1;
+        if (pageNo < 1 || pageNo > pdfDoc->getNumPages())
+            goto Exit;
+        while (!pdfDoc->getCatalog()->getPage(pageNo)) {
+            if (provider.roundTrips() >= PROGRESSIVE_MAX_TRIPS || !provider.waitForData())
+                break;
+        }
+        if (!pdfDoc->getCatalog()->getPage(pageNo)) {
+            error(-1, "RenderProgressive(): failed to get page %d\n", pageNo);
+            goto Exit;
+        }
+
+        /* render whatever has arrived, until nothing was missing */
+        outputDev = new SplashOutputDev(gSplashColorMode, 4, gFalse, gBgColor, gTrue);
+        outputDev->startDoc(pdfDoc->getXRef());
+        while (1) {
+            missing = pdfDoc->getXRef()->getMissingCount();
+            pdfDoc->displayPage(outputDev, pageNo, PDF_FILE_DPI, PDF_FILE_DPI, 0, gFalse, gTrue, gFalse);
+            delete bmp;
+            bmp = outputDev->takeBitmap();
+            if (pdfDoc->getXRef()->getMissingCount() == missing ||
+                provider.roundTrips() >= PROGRESSIVE_MAX_TRIPS || !provider.waitForData())
+                break;
+        }
+        msTimer.stop();
+        LogInfo("page %d (%dx%d): %.2f ms, %d round trips, %d of %d bytes\n",
+                pageNo, bmp->getWidth(), bmp->getHeight(), msTimer.getElapsed() * 1000,
+                provider.roundTrips(), provider.bytesArrived(), (int)provider.getLength());
+    }
+
+Exit:
+    LogInfo("finished: %s\n", fileName);
+    delete bmp;
+    delete outputDev;
+    delete pdfDoc;
+}
+
+#define BANDS_DPI 150
+
+static bool SameBitmaps(SplashBitmap *bmp1, SplashBitmap *bmp2)
+{
+    int rowLen, y;
+
+    if (bmp1->getWidth() != bmp2->getWidth() ||
+        bmp1->getHeight() != bmp2->getHeight() ||
+        bmp1->getMode() != bmp2->getMode())
+        return false;
+    switch (bmp1->getMode()) {
+        case splashModeMono1:
+            rowLen = (bmp1->getWidth() + 7) / 8;
+            break;
+        case splashModeMono8:
+            rowLen = bmp1->getWidth();
+            break;
+        case splashModeRGB8:
+        case splashModeBGR8:
+            rowLen = bmp1->getWidth() * 3;
+            break;
+        default:
+            rowLen = bmp1->getWidth() * 4;
+            break;
+    }
+    for (y = 0; y < bmp1->getHeight(); y++) {
+        if (memcmp(bmp1->getDataPtr() + y * bmp1->getRowSize(),
+                   bmp2->getDataPtr() + y * bmp2->getRowSize(), rowLen))
+            return false;
+    }
+    if ((bmp1->getAlphaPtr() == NULL) != (bmp2->getAlphaPtr() == NULL))
+        return false;
+    if (bmp1->getAlphaPtr() &&
+        memcmp(bmp1->getAlphaPtr(), bmp2->getAlphaPtr(), bmp1->getWidth() * bmp1->getHeight()))
+        return false;
+    return true;
+}
+
+/* SplashOutputDev which times the rasterization of the bands recorded
+   up to the end of the page (the flushes in the middle of a page, e.g.
+   before drawing an image, are not included). */
+class BandTimingOutputDev: public SplashOutputDev {
+public:
+    BandTimingOutputDev()
+        : SplashOutputDev(gSplashColorMode, 4, gFalse, gBgColor, gTrue), flushTimeInMs(0) {}
+    virtual void endPage() {
+        GooTimer msTimer;
+        getSplash()->flushDeferred();
+        msTimer.stop();
+        flushTimeInMs = msTimer.getElapsed() * 1000;
+        SplashOutputDev::endPage();
+    }
+    double flushTimeInMs;
+};
+
+/* Render a page with <nThreads> threads rasterizing bands.  <flushInMs>
+   is the part of <timeInMs> spent rasterizing the bands at the end of the
+   page. */
+static SplashBitmap *RenderPageWithBands(PDFDoc *pdfDoc, int pageNo, int nThreads, double *timeInMs,
+                                         double *flushInMs)
+{
+    BandTimingOutputDev *outputDev;
+    SplashBitmap *bmp;
+
+    outputDev = new BandTimingOutputDev();
+    outputDev->startDoc(pdfDoc->getXRef());
+    outputDev->setBandThreads(nThreads);
+    GooTimer msTimer;
+    pdfDoc->displayPage(outputDev, pageNo, BANDS_DPI, BANDS_DPI, 0, gFalse, gTrue, gFalse);
+    msTimer.stop();
+    *timeInMs = msTimer.getElapsed() * 1000;
+    *flushInMs = outputDev->flushTimeInMs;
+    bmp = outputDev->takeBitmap();
+    delete outputDev;
+    return bmp;
+}
+
+/* Render each page with 1, 2, 4, ... gBandThreads threads rasterizing
+   horizontal bands, and check that the result doesn't depend on the
+   number of threads. */
+static void RenderBands(const char *fileName)
+{
+    PDFDoc *            pdfDoc;
+    SplashBitmap *      refBmp;
+    SplashBitmap *      bmp;
+    double              refTimeInMs, timeInMs, flushInMs;
+    int                 nThreads;
+
+    LogInfo("started: %s\n", fileName);
+
+    /* note: PDFDoc takes ownership of fileNameStr */
+    pdfDoc = new PDFDoc(new GooString(fileName), NULL, NULL, NULL);
+    if (!pdfDoc->isOk()) {
+        error(-1, "RenderBands(): failed to open PDF file %s\n", fileName);
+        goto Exit;
+    }
+
+    for (int curPage = 1; curPage <= pdfDoc->getNumPages(); curPage++) {
+        if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage))
+            continue;
+
+        refBmp = RenderPageWithBands(pdfDoc, curPage, 1, &refTimeInMs, &flushInMs);
+        LogInfo("page %d (%dx%d): 1 thread: %.2f ms\n", curPage,
+                refBmp->getWidth(), refBmp->getHeight(), refTimeInMs);
+        for (nThreads = 2; nThreads <= gBandThreads; nThreads *= 2) {
+            bmp = RenderPageWithBands(pdfDoc, curPage, nThreads, &timeInMs, &flushInMs);
+            LogInfo("page %d: %d threads: %.2f ms (%.2fx), bands at end of page: %.2f ms, %s\n",
+                    curPage, nThreads, timeInMs, timeInMs > 0 ? refTimeInMs / timeInMs : 0.0,
+                    flushInMs, SameBitmaps(refBmp, bmp) ? "same" : "DIFFERENT");
+            delete bmp;
+            if (nThreads < gBandThreads && nThreads * 2 > gBandThreads)
+                nThreads = gBandThreads / 2;
+        }
+        delete refBmp;
+    }
+
+Exit:
+    LogInfo("finished: %s\n", fileName);
+    delete pdfDoc;
+}
+
+#define THUMBNAIL_DPI 24
+
+static SplashBitmap *RenderPageDirectly(PDFDoc *pdfDoc, int pageNo, double dpi, double *timeInMs)
+{
+    SplashOutputDev *outputDev;
+    SplashBitmap *bmp;
+
+    outputDev = new SplashOutputDev(gSplashColorMode, 4, gFalse, gBgColor, gTrue);
+    outputDev->startDoc(pdfDoc->getXRef());
+    GooTimer msTimer;
+    pdfDoc->displayPage(outputDev, pageNo, dpi, dpi, 0, gFalse, gTrue, gFalse);
+    msTimer.stop();
+    *timeInMs = msTimer.getElapsed() * 1000;
+    bmp = outputDev->takeBitmap();
+    delete outputDev;
+    return bmp;
+}
+
+static SplashBitmap *ReplayDisplayList(PDFDoc *pdfDoc, DisplayList *list, double dpi, double *timeInMs)
+{
+    SplashOutputDev *outputDev;
+    SplashBitmap *bmp;
+
+    outputDev = new SplashOutputDev(gSplashColorMode, 4, gFalse, gBgColor, gTrue);
+    outputDev->startDoc(pdfDoc->getXRef());
+    GooTimer msTimer;
+    list->replay(outputDev, dpi, dpi);
+    msTimer.stop();
+    *timeInMs = msTimer.getElapsed() * 1000;
+    bmp = outputDev->takeBitmap();
+    delete outputDev;
+    return bmp;
+}
+
+/* Render each page as a thumbnail and at BANDS_DPI, first directly and
+   then by replaying a display list recorded at BANDS_DPI, and check that
+   the bitmaps are the same. */
+static void RenderDisplayList(const char *fileName)
+{
+    PDFDoc *                pdfDoc;
+    DisplayListOutputDev *  recorder;
+    DisplayList *           list;
+    SplashBitmap *          thumbBmp;
+    SplashBitmap *          bmp;
+    SplashBitmap *          replayThumbBmp;
+    SplashBitmap *          replayBmp;
+    double                  thumbTimeInMs, timeInMs, recordTimeInMs;
+    double                  replayThumbTimeInMs, replayTimeInMs;
+
+    LogInfo("started: %s\n", fileName);
+
+    /* note: PDFDoc takes ownership of fileNameStr */
+    pdfDoc = new PDFDoc(new GooString(fileName), NULL, NULL, NULL);
+    if (!pdfDoc->isOk()) {
+        error(-1, "RenderDisplayList(): failed to open PDF file %s\n", fileName);
+        goto Exit;
+    }
+
+    recorder = new DisplayListOutputDev();
+    for (int curPage = 1; curPage <= pdfDoc->getNumPages(); curPage++) {
+        if ((gPageNo != PAGE_NO_NOT_GIVEN) && (gPageNo != curPage))
+            continue;
+
+        thumbBmp = RenderPageDirectly(pdfDoc, curPage, THUMBNAIL_DPI, &thumbTimeInMs);
+        bmp = RenderPageDirectly(pdfDoc, curPage, BANDS_DPI, &timeInMs);
+
+        GooTimer msTimer;
+        pdfDoc->displayPage(recorder, curPage, BANDS_DPI, BANDS_DPI, 0, gFalse, gTrue, gFalse);
+        msTimer.stop();
+        recordTimeInMs = msTimer.getElapsed() * 1000;
+        list = recorder->takeDisplayList();
+        if (!list) {
+            error(-1, "RenderDisplayList(): no display list for page %d\n", curPage);
+            delete thumbBmp;
+            delete bmp;
+            continue;
+        }
+        replayThumbBmp = ReplayDisplayList(pdfDoc, list, THUMBNAIL_DPI, &replayThumbTimeInMs);
+        replayBmp = ReplayDisplayList(pdfDoc, list, BANDS_DPI, &replayTimeInMs);
+
+        LogInfo("page %d: direct: %.2f + %.2f ms, display list: %.2f + %.2f + %.2f ms "
+                "(%d ops, %d KB), thumbnail %s, page %s\n", curPage,
+                thumbTimeInMs, timeInMs,
+                recordTimeInMs, replayThumbTimeInMs, replayTimeInMs,
+                list->getNumOps(), list->getSize() / 1024,
+                SameBitmaps(thumbBmp, replayThumbBmp) ? "same" : "DIFFERENT",
+                SameBitmaps(bmp, replayBmp) ? "same" : "DIFFERENT");
+
+        delete replayBmp;
+        delete replayThumbBmp;
+        delete list;
+        delete bmp;
+        delete thumbBmp;
+    }
+    delete recorder;
+
+Exit:
+    LogInfo("finished: %s\n", fileName);
+    delete pdfDoc;
+}
+
+#define PRED_BENCH_WIDTH    1024
+#define PRED_BENCH_HEIGHT   1024
+
+/* Filter one row of a synthetic image the way a PNG encoder would.
+   'prev' is the previous row (all zeros for the first one). */
+static void PngFilterRow(int type, Guchar *cur, Guchar *prev, int bpp, int n, Guchar *out)
+{
+    int left, up, upLeft, p, pa, pb, pc, pred;
+
+    for (int i = 0; i < n; i++) {
+        left = i >= bpp ? cur[i - bpp] : 0;
+        up = prev[i];
+        upLeft = i >= bpp ? prev[i - bpp] : 0;
+        switch (type) {
+        case 1: pred = left; break;
+        case 2: pred = up; break;
+        case 3: pred = (left + up) >> 1; break;
+        case 4:
+            p = left + up - upLeft;
+            pa = abs(p - left);
+            pb = abs(p - up);
+            pc = abs(p - upLeft);
+            if (pa <= pb && pa <= pc)
+                pred = left;
+            else if (pb <= pc)
+                pred = up;
+            else
+                pred = upLeft;
+            break;
+        default: pred = 0; break;
+        }
+        out[i] = (Guchar)(cur[i] - pred);
+    }
+}
+
+/* Wrap 'data' in a zlib stream made of stored (uncompressed) deflate blocks,
+   so that the benchmark measures the predictor and not the inflater. */
+static Guchar *MakeStoredZlib(Guchar *data, int len, int *lenOut)
+{
+    Guchar *    buf, *p;
+    Guint       a = 1, b = 0;
+    int         blockLen;
+
+    buf = (Guchar *)gmalloc(len + (len / 65535 + 1) * 5 + 6);
+    p = buf;
+    *p++ = 0x78;
+    *p++ = 0x01;
+    for (int i = 0; i == 0 || i < len; i += 65535) {
+        blockLen = len - i < 65535 ? len - i : 65535;
+        *p++ = i + blockLen >= len ? 1 : 0;
+        *p++ = blockLen & 0xff;
+        *p++ = blockLen >> 8;
+        *p++ = ~blockLen & 0xff;
+        *p++ = (~blockLen >> 8) & 0xff;
+        memcpy(p, data + i, blockLen);
+        p += blockLen;
+    }
+    for (int i = 0; i < len; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    *p++ = b >> 8;
+    *p++ = b & 0xff;
+    *p++ = a >> 8;
+    *p++ = a & 0xff;
+    *lenOut = p - buf;
+    return buf;
+}
+
+/* Decode a synthetic 8 bpc image with 'comps' components, every row
+   filtered with PNG filter 'pngType' (-1 means cycle through all of them),
+   or with the TIFF predictor if 'pngType' is -2. */
+static void BenchPredictor(const char *name, int pngType, int comps)
+{
+    static Guchar   buf[DECODE_BUF_SIZE];
+    int             rowLen = PRED_BENCH_WIDTH * comps;
+    int             encRowLen = pngType == -2 ? rowLen : rowLen + 1;
+    Guchar *        image, *prev, *enc, *zbuf;
+    Object          dict, obj;
+    Stream *        str;
+    int             zlen, n, type, pos;
+    double          bytes, timeInSecs;
+    bool            ok = true;
+    const int       passes = 8;
+
+    image = (Guchar *)gmallocn(PRED_BENCH_HEIGHT, rowLen);
+    enc = (Guchar *)gmallocn(PRED_BENCH_HEIGHT, encRowLen);
+    prev = (Guchar *)gmalloc(rowLen);
+    memset(prev, 0, rowLen);
+    srand(1);
+    for (int y = 0; y < PRED_BENCH_HEIGHT; y++) {
+        Guchar *row = image + y * rowLen;
+        for (int x = 0; x < PRED_BENCH_WIDTH; x++) {
+            for (int k = 0; k < comps; k++)
+                row[x * comps + k] = (Guchar)(x / 4 + y / 2 + k * 60 + (rand() & 7));
+        }
+        if (pngType == -2) {
+            PngFilterRow(1, row, prev, comps, rowLen, enc + y * encRowLen);
+        } else {
+            type = pngType < 0 ? y % 5 : pngType;
+            enc[y * encRowLen] = (Guchar)type;
+            PngFilterRow(type, row, y > 0 ? row - rowLen : prev, comps, rowLen,
+                         enc + y * encRowLen + 1);
+        }
+    }
+    zbuf = MakeStoredZlib(enc, PRED_BENCH_HEIGHT * encRowLen, &zlen);
+
+    bytes = 0;
+    GooTimer timer;
+    for (int pass = 0; pass < passes; pass++) {
+        dict.initDict((XRef *)NULL);
+        dict.dictAdd(copyString("Filter"), obj.initName("FlateDecode"));
+        obj.initDict((XRef *)NULL);
+        {
+            Object num;
+            obj.dictAdd(copyString("Predictor"), num.initInt(pngType == -2 ? 2 : 15));
+            obj.dictAdd(copyString("Colors"), num.initInt(comps));
+            obj.dictAdd(copyString("Columns"), num.initInt(PRED_BENCH_WIDTH));
+        }
+        dict.dictAdd(copyString("DecodeParms"), &obj);
+        str = new MemStream((char *)zbuf, 0, zlen, &dict);
+        str = str->addFilters(&dict);
+        str->reset();
+        pos = 0;
+        while ((n = str->getChars(DECODE_BUF_SIZE, buf)) > 0) {
+            /* check the output on the first pass */
+            if (pass == 0 && (pos + n > PRED_BENCH_HEIGHT * rowLen ||
+                              memcmp(buf, image + pos, n) != 0))
+                ok = false;
+            pos += n;
+        }
+        if (pos != PRED_BENCH_HEIGHT * rowLen)
+            ok = false;
+        bytes += pos;
+        delete str;
+    }
+    timer.stop();
+    timeInSecs = timer.getElapsed();
+
+    if (!ok)
+        LogInfo("%s %d comps: wrong output\n", name, comps);
+    LogInfo("%-8s %d comps: %.0f bytes in %.2f ms (%.1f MB/s)\n",
+            name, comps, bytes, timeInSecs * 1000,
+            timeInSecs > 0 ? bytes / timeInSecs / 1e6 : 0);
+
+    gfree(zbuf);
+    gfree(prev);
+    gfree(enc);
+    gfree(image);
+}
+
+static void BenchPredictors(void)
+{
+    static const struct {
+        const char *    name;
+        int             pngType;
+    } filters[] = {
+        { "none", 0 }, { "sub", 1 }, { "up", 2 }, { "average", 3 },
+        { "paeth", 4 }, { "mixed", -1 }, { "tiff", -2 }
+    };
+    static const int comps[] = { 1, 3, 4 };
+
+    for (int i = 0; i < (int)dimof(filters); i++) {
+        for (int j = 0; j < (int)dimof(comps); j++)
+            BenchPredictor(filters[i].name, filters[i].pngType, comps[j]);
+    }
+}
+
+#define AA_BENCH_SIZE       2000
+
+static double RandCoord(double max)
+{
+    return (double)rand() / RAND_MAX * max;
+}
+
+static void SetRandomFill(Splash *splash)
+{
+    SplashColor col;
+
+    col[0] = (Guchar)rand();
+    col[1] = (Guchar)rand();
+    col[2] = (Guchar)rand();
+    col[3] = 0;
+    splash->setFillPattern(new SplashSolidColor(col));
+    splash->setStrokePattern(new SplashSolidColor(col));
+}
+
+/* A dense vector map: lots of small filled polygons (parcels, buildings)
+   with their outlines. */
+static void DrawDenseMap(Splash *splash)
+{
+    SplashPath *path;
+    double cx, cy, r;
+    int n;
+
+    splash->setLineWidth(1.5);
+    for (int i = 0; i < 20000; i++) {
+        SetRandomFill(splash);
+        cx = RandCoord(AA_BENCH_SIZE);
+        cy = RandCoord(AA_BENCH_SIZE);
+        r = 2 + RandCoord(20);
+        n = 3 + rand() % 8;
+        path = new SplashPath();
+        for (int j = 0; j < n; j++) {
+            double a = 2 * 3.14159265 * j / n;
+            double rr = r * (0.6 + RandCoord(0.4));
+            if (j == 0)
+                path->moveTo(cx + rr * cos(a), cy + rr * sin(a));
+            else
+                path->lineTo(cx + rr * cos(a), cy + rr * sin(a));
+        }
+        path->close();
+        splash->fill(path, gFalse);
+        if (i % 4 == 0)
+            splash->stroke(path);
+        delete path;
+    }
+}
+
+/* A CAD drawing: long straight and curved strokes of a few pixels, some
+   dashed, and a few large outlines with holes. */
+static void DrawCadDrawing(Splash *splash)
+{
+    SplashPath *path;
+    SplashCoord dash[2] = { 6, 3 };
+
+    for (int i = 0; i < 2000; i++) {
+        SetRandomFill(splash);
+        splash->setLineWidth(1 + RandCoord(3));
+        if (i % 5 == 0)
+            splash->setLineDash(dash, 2, 0);
+        else
+            splash->setLineDash(NULL, 0, 0);
+        path = new SplashPath();
+        path->moveTo(RandCoord(AA_BENCH_SIZE), RandCoord(AA_BENCH_SIZE));
+        if (i % 2)
+            path->lineTo(RandCoord(AA_BENCH_SIZE), RandCoord(AA_BENCH_SIZE));
+        else
+            path->curveTo(RandCoord(AA_BENCH_SIZE), RandCoord(AA_BENCH_SIZE),
+                          RandCoord(AA_BENCH_SIZE), RandCoord(AA_BENCH_SIZE),
+                          RandCoord(AA_BENCH_SIZE), RandCoord(AA_BENCH_SIZE));
+        splash->stroke(path);
+        delete path;
+    }
+    splash->setLineDash(NULL, 0, 0);
+    for (int i = 0; i < 50; i++) {
+        double x = RandCoord(AA_BENCH_SIZE), y = RandCoord(AA_BENCH_SIZE);
+        double w = 50 + RandCoord(500), h = 50 + RandCoord(500);
+
+        SetRandomFill(splash);
+        path = new SplashPath();
+        path->moveTo(x, y);
+        path->lineTo(x + w, y);
+        path->lineTo(x + w, y + h);
+        path->lineTo(x, y + h);
+        path->close();
+        path->moveTo(x + w / 4, y + h / 4);
+        path->lineTo(x + w / 4, y + 3 * h / 4);
+        path->lineTo(x + 3 * w / 4, y + 3 * h / 4);
+        path->lineTo(x + 3 * w / 4, y + h / 4);
+        path->close();
+        splash->fill(path, gFalse);
+        delete path;
+    }
+}
+
+static SplashBitmap *DrawAABench(void (*draw)(Splash *splash), double *timeInMs)
+{
+    SplashBitmap *  bmp;
+    Splash *        splash;
+    SplashColor     white;
+
+    bmp = new SplashBitmap(AA_BENCH_SIZE, AA_BENCH_SIZE, 4, splashModeXBGR8, gFalse);
+    splash = new Splash(bmp, gTrue);
+    white[0] = white[1] = white[2] = 0xff;
+    white[3] = 0;
+    splash->clear(white);
+    srand(1);
+    GooTimer msTimer;
+    draw(splash);
+    msTimer.stop();
+    *timeInMs = msTimer.getElapsed() * 1000;
+    delete splash;
+    return bmp;
+}
+
+#define AA_BENCH_RUNS 5
+
+/* Draw AA_BENCH_RUNS times and report the fastest run, which is less
+   sensitive to other load on the machine than a single run. */
+static void BenchAAFill(const char *name, void (*draw)(Splash *splash))
+{
+    SplashBitmap *  bmp;
+    double          bestMs, timeInMs;
+
+    bestMs = 0;
+    for (int run = 0; run < AA_BENCH_RUNS; run++) {
+        bmp = DrawAABench(draw, &timeInMs);
+        if (run == 0 || timeInMs < bestMs)
+            bestMs = timeInMs;
+        delete bmp;
+    }
+    LogInfo("%-10s %.2f ms (best of %d)\n", name, bestMs, AA_BENCH_RUNS);
+}
+
+static void BenchAAFills(void)
+{
+    BenchAAFill("dense map", DrawDenseMap);
+    BenchAAFill("CAD", DrawCadDrawing);
+}
+
+/* A contour map as one path of about 'nSegs' segments: a frame around
+   the page (its long edges stay active for every row) and ten wavy
+   concentric contours. */
+static SplashPath *MakeContourPath(int nSegs)
+{
+    SplashPath *    path;
+    const int       nContours = 10;
+    int             n = nSegs / nContours;
+    double          a, r, c = AA_BENCH_SIZE / 2;
+
+    path = new SplashPath();
+    path->moveTo(10, 10);
+    path->lineTo(AA_BENCH_SIZE - 10, 10);
+    path->lineTo(AA_BENCH_SIZE - 10, AA_BENCH_SIZE - 10);
+    path->lineTo(10, AA_BENCH_SIZE - 10);
+    path->close();
+    for (int i = 0; i < nContours; i++) {
+        for (int j = 0; j < n; j++) {
+            a = 2 * 3.14159265 * j / n;
+            r = 0.09 * AA_BENCH_SIZE * (i + 1) * (1 + 0.05 * sin(37 * a + i));
+            if (j == 0)
+                path->moveTo(c + r * cos(a), c + r * sin(a));
+            else
+                path->lineTo(c + r * cos(a), c + r * sin(a));
+        }
+        path->close();
+    }
+    return path;
+}
+
+static void BenchHugePath(int nSegs, GBool vectorAntialias)
+{
+    SplashBitmap *  bmp;
+    Splash *        splash;
+    SplashPath *    path, *rect;
+    SplashColor     col;
+    double          fillMs, clipMs;
+
+    bmp = new SplashBitmap(AA_BENCH_SIZE, AA_BENCH_SIZE, 4, splashModeXBGR8, gFalse);
+    splash = new Splash(bmp, vectorAntialias);
+    col[0] = col[1] = col[2] = col[3] = 0;
+    splash->setFillPattern(new SplashSolidColor(col));
+    path = MakeContourPath(nSegs);
+
+    GooTimer fillTimer;
+    splash->fill(path, gTrue);
+    fillTimer.stop();
+    fillMs = fillTimer.getElapsed() * 1000;
+
+    /* fill the page through a clip to the same path */
+    rect = new SplashPath();
+    rect->moveTo(0, 0);
+    rect->lineTo(AA_BENCH_SIZE, 0);
+    rect->lineTo(AA_BENCH_SIZE, AA_BENCH_SIZE);
+    rect->lineTo(0, AA_BENCH_SIZE);
+    rect->close();
+    GooTimer clipTimer;
+    splash->clipToPath(path, gTrue);
+    splash->fill(rect, gFalse);
+    clipTimer.stop();
+    clipMs = clipTimer.getElapsed() * 1000;
+
+    LogInfo("%7d segments, %-6s fill: %8.2f ms, clip: %8.2f ms\n",
+            nSegs, vectorAntialias ? "AA" : "no AA", fillMs, clipMs);
+    delete rect;
+    delete path;
+    delete splash;
+    delete bmp;
+}
+
+static void BenchHugePaths(void)
+{
+    for (int aa = 0; aa < 2; aa++) {
+        for (int nSegs = 1000; nSegs <= 1000000; nSegs *= 10)
+            BenchHugePath(nSegs, aa ? gTrue : gFalse);
+    }
+}
+
+static void MakePSFunctionStream(const char *code, int nIn, int nOut, Object *strObj)
+{
+    Object          dict, arr, obj;
+
+    dict.initDict((XRef *)NULL);
+    dict.dictAdd(copyString("FunctionType"), obj.initInt(4));
+    arr.initArray((XRef *)NULL);
+    for (int i = 0; i < 2 * nIn; i++)
+        arr.arrayAdd(obj.initReal(i & 1));
+    dict.dictAdd(copyString("Domain"), &arr);
+    arr.initArray((XRef *)NULL);
+    for (int i = 0; i < 2 * nOut; i++)
+        arr.arrayAdd(obj.initReal(i & 1));
+    dict.dictAdd(copyString("Range"), &arr);
+    strObj->initStream(new MemStream((char *)code, 0, strlen(code), &dict));
+}
+
+static Function *MakePSFunction(const char *code, int nIn, int nOut)
+{
+    Object          strObj;
+    Function *      func;
+
+    MakePSFunctionStream(code, nIn, nOut, &strObj);
+    func = Function::parse(&strObj);
+    strObj.free();
+    return func;
+}
+
+static void BenchPSFunctions(void)
+{
+    static const struct {
+        const char *    name;
+        int             nIn, nOut;
+        const char *    code;
+    } funcs[] = {
+        { "spot to CMYK", 1, 4,
+          "{ dup 0.9 mul exch dup 0.2 mul exch dup 0 mul exch 0.1 mul }" },
+        { "DeviceN to CMYK", 2, 4,
+          "{ 2 copy add 1 gt { pop pop 1 1 } if 0.5 mul exch 0.8 mul "
+          "2 copy add 3 1 roll 0 }" },
+        { "curve", 1, 3,
+          "{ dup 0.5 lt { 2 mul } { 1 exch sub 2 mul 1 exch sub } ifelse "
+          "dup 2.2 exp exch dup mul 1 index }" }
+    };
+    const int       calls = 1000000;
+    double          in[2], out[4], timeInMs;
+    Function *      func;
+
+    for (int i = 0; i < (int)dimof(funcs); i++) {
+        func = MakePSFunction(funcs[i].code, funcs[i].nIn, funcs[i].nOut);
+        if (!func) {
+            LogInfo("%s: couldn't parse function\n", funcs[i].name);
+            continue;
+        }
+        GooTimer timer;
+        for (int j = 0; j < calls; j++) {
+            in[0] = (double)j / calls;
+            in[1] = 1 - in[0];
+            func->transform(in, out);
+        }
+        timer.stop();
+        timeInMs = timer.getElapsed() * 1000;
+        LogInfo("%-16s %8.2f ms for %d calls (%.1f ns per call)\n",
+                funcs[i].name, timeInMs, calls, timeInMs * 1e6 / calls);
+        delete func;
+    }
+}
+
+static GfxColorSpace *MakeImageColorSpace(int which)
+{
+    Object          csObj, obj, arr;
+    GfxColorSpace * colorSpace;
+    char *          palette;
+
+    switch (which) {
+    case 0:
+        csObj.initName("DeviceRGB");
+        break;
+    case 1:
+        csObj.initName("DeviceCMYK");
+        break;
+    case 2:
+        palette = (char *)gmalloc(256 * 4);
+        for (int i = 0; i < 256 * 4; i++)
+            palette[i] = (char)(i * 37);
+        csObj.initArray((XRef *)NULL);
+        csObj.arrayAdd(obj.initName("Indexed"));
+        csObj.arrayAdd(obj.initName("DeviceCMYK"));
+        csObj.arrayAdd(obj.initInt(255));
+        csObj.arrayAdd(obj.initString(new GooString(palette, 256 * 4)));
+        gfree(palette);
+        break;
+    default:
+        csObj.initArray((XRef *)NULL);
+        csObj.arrayAdd(obj.initName("DeviceN"));
+        arr.initArray((XRef *)NULL);
+        arr.arrayAdd(obj.initName("Orange"));
+        arr.arrayAdd(obj.initName("Green"));
+        csObj.arrayAdd(&arr);
+        csObj.arrayAdd(obj.initName("DeviceCMYK"));
+        MakePSFunctionStream("{ 2 copy add 1 gt { pop pop 1 1 } if 0.5 mul "
+                             "exch 0.8 mul 2 copy add 3 1 roll 0 }", 2, 4, &obj);
+        csObj.arrayAdd(&obj);
+        break;
+    }
+    colorSpace = GfxColorSpace::parse(&csObj, NULL);
+    csObj.free();
+    return colorSpace;
+}
+
+static void BenchImageLines(void)
+{
+    static const char *names[] = {
+        "DeviceRGB", "DeviceCMYK", "Indexed", "DeviceN"
+    };
+    const int           width = 1000, lines = 1000;
+    GfxColorSpace *     colorSpace;
+    GfxImageColorMap *  colorMap;
+    GfxRGB              rgb;
+    Object              decode;
+    Guchar *            in, *out, *p;
+    int                 nComps;
+    double              pixelMs, lineMs;
+
+    for (int i = 0; i < (int)dimof(names); i++) {
+        colorSpace = MakeImageColorSpace(i);
+        if (!colorSpace) {
+            LogInfo("%s: couldn't parse color space\n", names[i]);
+            continue;
+        }
+        decode.initNull();
+        colorMap = new GfxImageColorMap(8, &decode, colorSpace);
+        nComps = colorMap->getNumPixelComps();
+        in = (Guchar *)gmallocn(width, nComps);
+        out = (Guchar *)gmallocn(width, 3);
+        // a photo-like line: smooth ramps with some noise
+        for (int x = 0; x < width * nComps; x++)
+            in[x] = (Guchar)((x / nComps) / 4 + (rand() & 7) + (x % nComps) * 40);
+
+        GooTimer pixelTimer;
+        for (int y = 0; y < lines; y++) {
+            p = out;
+            for (int x = 0; x < width; x++) {
+                colorMap->getRGB(in + x * nComps, &rgb);
+                *p++ = colToByte(rgb.r);
+                *p++ = colToByte(rgb.g);
+                *p++ = colToByte(rgb.b);
+            }
+        }
+        pixelTimer.stop();
+        pixelMs = pixelTimer.getElapsed() * 1000;
+
+        GooTimer lineTimer;
+        for (int y = 0; y < lines; y++)
+            colorMap->getRGBByteLine(in, out, width);
+        lineTimer.stop();
+        lineMs = lineTimer.getElapsed() * 1000;
+
+        LogInfo("%-10s per pixel %8.2f ms, per line %8.2f ms (%.1f / %.1f ns per pixel)\n",
+                names[i], pixelMs, lineMs, pixelMs * 1e6 / (width * lines),
+                lineMs * 1e6 / (width * lines));
+        gfree(in);
+        gfree(out);
+        delete colorMap;
+    }
+}
+
+static void BenchDictLookup(void)
+{
+    static const int sizes[] = { 4, 16, 64, 256, 3000 };
+    const int       lookups = 1000000;
+    char            key[32];
+    char **         keys;
+    Object          dict, obj;
+    int             n, found;
+    double          ms;
+
+    for (int i = 0; i < (int)dimof(sizes); i++) {
+        n = sizes[i];
+        keys = (char **)gmallocn(n, sizeof(char *));
+        dict.initDict((XRef *)NULL);
+        for (int k = 0; k < n; k++) {
+            sprintf(key, "F%d", k + 1);
+            keys[k] = copyString(key);
+            obj.initInt(k);
+            dict.dictAdd(copyString(key), &obj);
+        }
+
+        // look the keys up through separate copies, like the literal
+        // keys used by most callers
+        found = 0;
+        GooTimer timer;
+        for (int j = 0; j < lookups; j++) {
+            dict.dictLookupNF(keys[(int)(((Guint)j * 7919) % n)], &obj);
+            if (obj.isInt())
+                found++;
+            obj.free();
+        }
+        timer.stop();
+        ms = timer.getElapsed() * 1000;
+
+        LogInfo("%5d entries: %8.2f ms (%.1f ns per lookup)%s\n", n, ms,
+                ms * 1e6 / lookups, found == lookups ? "" : " MISSING KEYS");
+        for (int k = 0; k < n; k++)
+            gfree(keys[k]);
+        gfree(keys);
+        dict.free();
+    }
+}
+
 static void RenderFile(const char *fileName)
 {
+    if (gfStreamsOnly) {
+        DecodePdfStreams(fileName);
+        return;
+    }
+
+    if (gfProgressive) {
+        RenderProgressive(fileName);
+        return;
+    }
+
+    if (gBandThreads > 0) {
+        RenderBands(fileName);
+        return;
+    }
+
+    if (gfDisplayList) {
+        RenderDisplayList(fileName);
+        return;
+    }
+
     if (gfTextOnly) {
         RenderPdfAsText(fileName);
         return;
@@ -1057,6 +2250,40 @@ static void ParseCommandLine(int argc, char **argv)
                 gfPreview = true;
             } else if (str_ieq(arg, TEXT_ARG)) {
                 gfTextOnly = true;
+            } else if (str_ieq(arg, STREAMS_ARG)) {
+                gfStreamsOnly = true;
+            } else if (str_ieq(arg, PREDICTORS_ARG)) {
+                gfPredictorsOnly = true;
+            } else if (str_ieq(arg, PROGRESSIVE_ARG)) {
+                gfProgressive = true;
+            } else if (str_ieq(arg, BANDS_ARG)) {
+                /* expect an integer after that */
+                ++i;
+                if (i == argc)
+                    PrintUsageAndExit(argc, argv);
+                gBandThreads = atoi(argv[i]);
+                if (gBandThreads < 1)
+                    PrintUsageAndExit(argc, argv);
+            } else if (str_ieq(arg, GLYPH_CACHE_ARG)) {
+                /* expect an integer after that */
+                ++i;
+                if (i == argc)
+                    PrintUsageAndExit(argc, argv);
+                gGlyphCacheSize = atoi(argv[i]);
+                if (gGlyphCacheSize < 0)
+                    PrintUsageAndExit(argc, argv);
+            } else if (str_ieq(arg, DISPLAY_LIST_ARG)) {
+                gfDisplayList = true;
+            } else if (str_ieq(arg, AA_FILL_ARG)) {
+                gfAAFillOnly = true;
+            } else if (str_ieq(arg, HUGE_PATHS_ARG)) {
+                gfHugePathsOnly = true;
+            } else if (str_ieq(arg, PS_FUNCTIONS_ARG)) {
+                gfPSFunctionsOnly = true;
+            } else if (str_ieq(arg, IMAGE_LINES_ARG)) {
+                gfImageLinesOnly = true;
+            } else if (str_ieq(arg, DICT_LOOKUP_ARG)) {
+                gfDictLookupOnly = true;
             } else if (str_ieq(arg, SLOW_PREVIEW_ARG)) {
                 gfSlowPreview = true;
             } else if (str_ieq(arg, LOAD_ONLY_ARG)) {
@@ -1231,9 +2458,10 @@ int main(int argc, char **argv)
 {
     setErrorFunction(my_error);
     ParseCommandLine(argc, argv);
-    if (0 == StrList_Len(&gArgsListRoot))
+    if (0 == StrList_Len(&gArgsListRoot) && !gfPredictorsOnly && !gfAAFillOnly &&
+        !gfHugePathsOnly && !gfPSFunctionsOnly && !gfImageLinesOnly &&
+        !gfDictLookupOnly)
         PrintUsageAndExit(argc, argv);
-    assert(gArgsListRoot);
 
     SplashColorsInit();
     globalParams = new GlobalParams();
@@ -1241,6 +2469,8 @@ int main(int argc, char **argv)
         return 1;
     globalParams->setErrQuiet(gFalse);
     globalParams->setBaseDir("");
+    if (gGlyphCacheSize >= 0)
+        globalParams->setGlyphCacheSize(gGlyphCacheSize);
 
     FILE * outFile = NULL;
     if (gOutFileName) {
@@ -1261,6 +2491,19 @@ int main(int argc, char **argv)
 
     PreviewBitmapInit();
 
+    if (gfPredictorsOnly)
+        BenchPredictors();
+    if (gfAAFillOnly)
+        BenchAAFills();
+    if (gfHugePathsOnly)
+        BenchHugePaths();
+    if (gfPSFunctionsOnly)
+        BenchPSFunctions();
+    if (gfImageLinesOnly)
+        BenchImageLines();
+    if (gfDictLookupOnly)
+        BenchDictLookup();
+
     StrList * curr = gArgsListRoot;
     while (curr) {
         RenderCmdLineArg(curr->str);
@@ -40,6 +40,15 @@
 #include "splash/Splash.h"
 #include "SplashOutputDev.h"
 
+#if MULTITHREADED
+#include "goo/GooMutex.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
 #define PPM_FILE_SZ 512
 
 static int firstPage = 1;
@@ -66,6 +75,7 @@ static char vectorAntialiasStr[16] = "";
 static char ownerPassword[33] = "";
 static char userPassword[33] = "";
 static GBool quiet = gFalse;
+static int numThreads = 1;
 static GBool printVersion = gFalse;
 static GBool printHelp = gFalse;
 
@@ -128,6 +138,11 @@ static const ArgDesc argDesc[] = {
   {"-upw",    argString,   userPassword,   sizeof(userPassword),
    "user password (for encrypted files)"},
   
+#if MULTITHREADED
+  {"-j",      argInt,      &numThreads,    0,
+   "number of threads rendering pages in parallel (default is 1)"},
+#endif
+
   {"-q",      argFlag,     &quiet,         0,
    "don't print any messages or errors"},
   {"-v",      argFlag,     &printVersion,  0,
@@ -143,55 +158,281 @@ static const ArgDesc argDesc[] = {
   {NULL}
 };
 
-static void savePageSlice(PDFDoc *doc,
-                   SplashOutputDev *splashOut, 
-                   int pg, int x, int y, int w, int h, 
-                   double pg_w, double pg_h, 
-                   char *ppmFile) {
+// Compute the size in pixels and the resolution of page <pg>.  The
+// -scale-to options override the resolution per page.
+static void getPageSize(PDFDoc *doc, int pg, double *pg_w, double *pg_h,
+			double *x_res, double *y_res) {
+  double res, tmp;
+
+  if (useCropBox) {
+    *pg_w = doc->getPageCropWidth(pg);
+    *pg_h = doc->getPageCropHeight(pg);
+  } else {
+    *pg_w = doc->getPageMediaWidth(pg);
+    *pg_h = doc->getPageMediaHeight(pg);
+  }
+
+  *x_res = x_resolution;
+  *y_res = y_resolution;
+  if (scaleTo != 0) {
+    res = (72.0 * scaleTo) / (*pg_w > *pg_h ? *pg_w : *pg_h);
+    *x_res = *y_res = res;
+  } else {
+    if (x_scaleTo != 0) {
+      *x_res = (72.0 * x_scaleTo) / *pg_w;
+    }
+    if (y_scaleTo != 0) {
+      *y_res = (72.0 * y_scaleTo) / *pg_h;
+    }
+  }
+  *pg_w = *pg_w * (*x_res / 72.0);
+  *pg_h = *pg_h * (*y_res / 72.0);
+  if (doc->getPageRotate(pg)) {
+    tmp = *pg_w;
+    *pg_w = *pg_h;
+    *pg_h = tmp;
+  }
+}
+
+static void renderPageSlice(PDFDoc *doc,
+			    SplashOutputDev *splashOut,
+			    int pg, int x, int y, int w, int h,
+			    double pg_w, double pg_h,
+			    double x_res, double y_res) {
   if (w == 0) w = (int)ceil(pg_w);
   if (h == 0) h = (int)ceil(pg_h);
   w = (x+w > pg_w ? (int)ceil(pg_w-x) : w);
   h = (y+h > pg_h ? (int)ceil(pg_h-y) : h);
   doc->displayPageSlice(splashOut, 
-    pg, x_resolution, y_resolution, 
+    pg, x_res, y_res, 
     0,
     !useCropBox, gFalse, gFalse,
     x, y, w, h
   );
+}
 
-  SplashBitmap *bitmap = splashOut->getBitmap();
-  
+static void writePageBitmap(SplashBitmap *bitmap, char *ppmFile,
+			    double x_res, double y_res) {
   if (ppmFile != NULL) {
     if (png) {
-      bitmap->writeImgFile(splashFormatPng, ppmFile, x_resolution, y_resolution);
+      bitmap->writeImgFile(splashFormatPng, ppmFile, x_res, y_res);
     } else if (jpeg) {
-      bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_resolution, y_resolution);
+      bitmap->writeImgFile(splashFormatJpeg, ppmFile, x_res, y_res);
     } else {
       bitmap->writePNMFile(ppmFile);
     }
   } else {
     if (png) {
-      bitmap->writeImgFile(splashFormatPng, stdout, x_resolution, y_resolution);
+      bitmap->writeImgFile(splashFormatPng, stdout, x_res, y_res);
     } else if (jpeg) {
-      bitmap->writeImgFile(splashFormatJpeg, stdout, x_resolution, y_resolution);
+      bitmap->writeImgFile(splashFormatJpeg, stdout, x_res, y_res);
     } else {
       bitmap->writePNMFile(stdout);
     }
   }
 }
 
+static SplashOutputDev *makeSplashOutputDev(PDFDoc *doc) {
+  SplashColor paperColor;
+  SplashOutputDev *splashOut;
+
+  paperColor[0] = 255;
+  paperColor[1] = 255;
+  paperColor[2] = 255;
+  splashOut = new SplashOutputDev(mono ? splashModeMono1 :
+				    gray ? splashModeMono8 :
+				             splashModeRGB8, 4,
+				  gFalse, paperColor);
+  splashOut->startDoc(doc->getXRef());
+  return splashOut;
+}
+
+static void getPageFileName(char *ppmFile, char *ppmRoot,
+			    int pg_num_len, int pg) {
+  snprintf(ppmFile, PPM_FILE_SZ, "%.*s-%0*d.%s",
+	   PPM_FILE_SZ - 32, ppmRoot, pg_num_len, pg,
+	   png ? "png" : jpeg ? "jpg" : mono ? "pbm" : gray ? "pgm" : "ppm");
+}
+
+#if MULTITHREADED
+
+//------------------------------------------------------------------------
+// Parallel rendering
+//
+// Each worker thread has its own SplashOutputDev (and so its own font
+// engine) and takes the next page to render from a shared counter.
+// The rendered bitmaps are handed back to the main thread, which
+// writes them out in page order.  Workers don't run more than
+// 2*numThreads pages ahead of the writer, which bounds the number of
+// bitmaps held in memory.
+//------------------------------------------------------------------------
+
+struct RenderedPage {
+  GBool done;			// set once the page has been rendered
+  SplashBitmap *bitmap;		// NULL if the page is missing
+  double x_res, y_res;
+};
+
+struct RenderQueue {
+  PDFDoc *doc;
+  int nextPage;			// next page to be rendered
+  int nextOutPage;		// next page to be written
+  RenderedPage *pages;		// rendered pages, indexed by
+				//   page - firstPage
+  GooMutex mutex;
+  GooCond cond;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI renderThread(LPVOID arg) {
+#else
+static void *renderThread(void *arg) {
+#endif
+  RenderQueue *queue = (RenderQueue *)arg;
+  SplashOutputDev *splashOut;
+  SplashBitmap *bitmap;
+  double pg_w, pg_h, x_res, y_res;
+  int pg;
+
+  splashOut = makeSplashOutputDev(queue->doc);
+  while (1) {
+    gLockMutex(&queue->mutex);
+    while (queue->nextPage <= lastPage &&
+	   queue->nextPage - queue->nextOutPage >= 2 * numThreads) {
+      gCondWait(&queue->cond, &queue->mutex);
+    }
+    pg = queue->nextPage++;
+    gUnlockMutex(&queue->mutex);
+    if (pg > lastPage) {
+      break;
+    }
+
+    bitmap = NULL;
+    x_res = y_res = 0;
+    if (queue->doc->getCatalog()->getPage(pg)) {
+      getPageSize(queue->doc, pg, &pg_w, &pg_h, &x_res, &y_res);
+      renderPageSlice(queue->doc, splashOut, pg, x, y, w, h,
+		      pg_w, pg_h, x_res, y_res);
+      bitmap = splashOut->takeBitmap();
+    }
+
+    gLockMutex(&queue->mutex);
+    queue->pages[pg - firstPage].x_res = x_res;
+    queue->pages[pg - firstPage].y_res = y_res;
+    queue->pages[pg - firstPage].bitmap = bitmap;
+    queue->pages[pg - firstPage].done = gTrue;
+    gCondBroadcast(&queue->cond);
+    gUnlockMutex(&queue->mutex);
+  }
+  delete splashOut;
+  return 0;
+}
+
+// Render and write the pages on numThreads threads.  Returns false,
+// without having rendered anything, if no thread could be started.
+static GBool renderPagesParallel(PDFDoc *doc, char *ppmRoot,
+				 int pg_num_len) {
+  RenderQueue queue;
+  RenderedPage *page;
+  char ppmFile[PPM_FILE_SZ];
+  int nStarted, pg, i;
+#ifdef _WIN32
+  HANDLE *threads;
+#else
+  pthread_t *threads;
+#endif
+
+  queue.doc = doc;
+  queue.nextPage = firstPage;
+  queue.nextOutPage = firstPage;
+  queue.pages = (RenderedPage *)gmallocn(lastPage - firstPage + 1,
+					 sizeof(RenderedPage));
+  for (pg = firstPage; pg <= lastPage; ++pg) {
+    queue.pages[pg - firstPage].done = gFalse;
+    queue.pages[pg - firstPage].bitmap = NULL;
+  }
+  gInitMutex(&queue.mutex);
+  gInitCond(&queue.cond);
+
+  // if some threads can't be started, the others render all the
+  // pages; if none can, fall back to rendering on this thread
+#ifdef _WIN32
+  threads = (HANDLE *)gmallocn(numThreads, sizeof(HANDLE));
+  for (nStarted = 0; nStarted < numThreads; ++nStarted) {
+    if (!(threads[nStarted] = CreateThread(NULL, 0, &renderThread,
+					   &queue, 0, NULL))) {
+      break;
+    }
+  }
+#else
+  threads = (pthread_t *)gmallocn(numThreads, sizeof(pthread_t));
+  for (nStarted = 0; nStarted < numThreads; ++nStarted) {
+    if (pthread_create(&threads[nStarted], NULL, &renderThread, &queue)) {
+      break;
+    }
+  }
+#endif
+  if (nStarted == 0) {
+    fprintf(stderr, "Couldn't start any rendering threads\n");
+    gfree(threads);
+    gDestroyCond(&queue.cond);
+    gDestroyMutex(&queue.mutex);
+    gfree(queue.pages);
+    return gFalse;
+  }
+
+  for (pg = firstPage; pg <= lastPage; ++pg) {
+    page = &queue.pages[pg - firstPage];
+    gLockMutex(&queue.mutex);
+    while (!page->done) {
+      gCondWait(&queue.cond, &queue.mutex);
+    }
+    gUnlockMutex(&queue.mutex);
+
+    if (page->bitmap) {
+      if (ppmRoot != NULL) {
+	getPageFileName(ppmFile, ppmRoot, pg_num_len, pg);
+	writePageBitmap(page->bitmap, ppmFile, page->x_res, page->y_res);
+      } else {
+	writePageBitmap(page->bitmap, NULL, page->x_res, page->y_res);
+      }
+      delete page->bitmap;
+    }
+
+    gLockMutex(&queue.mutex);
+    queue.nextOutPage = pg + 1;
+    gCondBroadcast(&queue.cond);
+    gUnlockMutex(&queue.mutex);
+  }
+
+  for (i = 0; i < nStarted; ++i) {
+#ifdef _WIN32
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], NULL);
+#endif
+  }
+  gfree(threads);
+  gDestroyCond(&queue.cond);
+  gDestroyMutex(&queue.mutex);
+  gfree(queue.pages);
+  return gTrue;
+}
+
+#endif // MULTITHREADED
+
 int main(int argc, char *argv[]) {
   PDFDoc *doc;
   GooString *fileName = NULL;
   char *ppmRoot = NULL;
   char ppmFile[PPM_FILE_SZ];
   GooString *ownerPW, *userPW;
-  SplashColor paperColor;
   SplashOutputDev *splashOut;
-  GBool ok;
+  GBool ok, rendered;
   int exitCode;
   int pg, pg_num_len;
-  double pg_w, pg_h, tmp;
+  double pg_w, pg_h, x_res, y_res;
 
   exitCode = 99;
 
@@ -200,6 +441,9 @@ int main(int argc, char *argv[]) {
   if (mono && gray) {
     ok = gFalse;
   }
+  if (numThreads < 1) {
+    ok = gFalse;
+  }
   if ( resolution != 0.0 &&
        (x_resolution == 150.0 ||
         y_resolution == 150.0)) {
@@ -276,53 +520,33 @@ int main(int argc, char *argv[]) {
     lastPage = doc->getNumPages();
 
   // write PPM files
-  paperColor[0] = 255;
-  paperColor[1] = 255;
-  paperColor[2] = 255;
-  splashOut = new SplashOutputDev(mono ? splashModeMono1 :
-				    gray ? splashModeMono8 :
-				             splashModeRGB8, 4,
-				  gFalse, paperColor);
-  splashOut->startDoc(doc->getXRef());
   if (sz != 0) w = h = sz;
   pg_num_len = (int)ceil(log((double)doc->getNumPages()) / log((double)10));
-  for (pg = firstPage; pg <= lastPage; ++pg) {
-    if (useCropBox) {
-      pg_w = doc->getPageCropWidth(pg);
-      pg_h = doc->getPageCropHeight(pg);
-    } else {
-      pg_w = doc->getPageMediaWidth(pg);
-      pg_h = doc->getPageMediaHeight(pg);
-    }
-
-    if (scaleTo != 0) {
-      resolution = (72.0 * scaleTo) / (pg_w > pg_h ? pg_w : pg_h);
-      x_resolution = y_resolution = resolution;
-    } else {
-      if (x_scaleTo != 0) {
-        x_resolution = (72.0 * x_scaleTo) / pg_w;
+  rendered = gFalse;
+#if MULTITHREADED
+  if (numThreads > 1 && lastPage > firstPage) {
+    rendered = renderPagesParallel(doc, ppmRoot, pg_num_len);
+  }
+#endif
+  if (!rendered) {
+    splashOut = makeSplashOutputDev(doc);
+    for (pg = firstPage; pg <= lastPage; ++pg) {
+      // the page tree can turn out to have fewer pages than it claimed
+      if (!doc->getCatalog()->getPage(pg)) {
+	continue;
       }
-      if (y_scaleTo != 0) {
-        y_resolution = (72.0 * y_scaleTo) / pg_h;
+      getPageSize(doc, pg, &pg_w, &pg_h, &x_res, &y_res);
+      renderPageSlice(doc, splashOut, pg, x, y, w, h,
+		      pg_w, pg_h, x_res, y_res);
+      if (ppmRoot != NULL) {
+	getPageFileName(ppmFile, ppmRoot, pg_num_len, pg);
+	writePageBitmap(splashOut->getBitmap(), ppmFile, x_res, y_res);
+      } else {
+	writePageBitmap(splashOut->getBitmap(), NULL, x_res, y_res);
       }
     }
-    pg_w = pg_w * (x_resolution / 72.0);
-    pg_h = pg_h * (y_resolution / 72.0);
-    if (doc->getPageRotate(pg)) {
-      tmp = pg_w;
-      pg_w = pg_h;
-      pg_h = tmp;
-    }
-    if (ppmRoot != NULL) {
-      snprintf(ppmFile, PPM_FILE_SZ, "%.*s-%0*d.%s",
-              PPM_FILE_SZ - 32, ppmRoot, pg_num_len, pg,
-              png ? "png" : jpeg ? "jpg" : mono ? "pbm" : gray ? "pgm" : "ppm");
-      savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, ppmFile);
-    } else {
-      savePageSlice(doc, splashOut, pg, x, y, w, h, pg_w, pg_h, NULL);
-    }
+    delete splashOut;
   }
-  delete splashOut;
 
   exitCode = 0;
 